@@ -13,19 +13,119 @@ public:
  DWORD rolls; //B,G,R,A rolls
  DWORD mask[4]; //B,G,R,A masks
  DWORD Imask; //index mask
+ NAT Ipal; //palette entries (0: Imask+1 overflowed, 32 bit indexes)
  void*pDst,*pSrc,*pLUT;
  void (*DoIt)(BLTRGB*); //pointer to function who performs blit
  DWORD Dpixform,Spixform;
+ PFCONV cv; //conversion kernels set up by PFs
+ PFROWFN row; //PFs: kernels specialized for Spixform->Dpixform (NULL: use cv)
+ PFPIXFN pix;
 
  void PFs(DWORD);
  void Copy(void*,int,DWORD,void*,int,DWORD,NAT,NAT,int);
  void Zoom(void*,int,DWORD,NAT,NAT,void*,int,DWORD,NAT,NAT,int);
- void Lut(void*,int,DWORD,void*,int,DWORD,NAT,NAT,void*,NAT);
+ void Lut(void*,int,DWORD,void*,int,DWORD,NAT,NAT,void*,NAT,NAT=0);
 #ifdef _DEBUG
  void IDF();
 #endif
 };
 
+//compile-time pixel formats ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//constexpr twins of PF_bcch/PF_msb/BitMask and of the masks'n'rolls made by PFs (shift<0: shr)
+constexpr NAT PFT_nib(DWORD pf,NAT k) { return (pf>>(k<<2))&0xf; }
+constexpr NAT PFT_sum(DWORD pf,NAT k) { return PFT_nib(pf,k)+(k?PFT_sum(pf,k-1):0); } //nibbles 0..k
+constexpr NAT PFT_bcch(DWORD pf,NAT ch) { return PFT_nib(pf,PFT_nib(pf,ch+4)); }
+constexpr int PFT_msb(DWORD pf,NAT ch) { return (int)PFT_sum(pf,PFT_nib(pf,ch+4))-1; }
+constexpr DWORD PFT_bits(int msb,NAT n) { return n?(DWORD)((((QWORD)1<<n)-1)<<(msb+1-(int)n)):0; }
+constexpr DWORD PFT_mask(DWORD S,DWORD D,NAT ch)
+ { return PFT_bcch(S,ch)&&PFT_bcch(D,ch)?PFT_bits(PFT_msb(S,ch),MIN(PFT_bcch(S,ch),PFT_bcch(D,ch))):0; }
+constexpr int PFT_shift(DWORD S,DWORD D,NAT ch) { return PFT_msb(D,ch)-PFT_msb(S,ch); }
+constexpr bool PFT_same(DWORD S,DWORD D,NAT a,NAT b) { return PFT_mask(S,D,a)&&PFT_shift(S,D,a)==PFT_shift(S,D,b); }
+//channels moved by the same shift share one and+shift, the first of them carries the group mask
+constexpr bool PFT_first(DWORD S,DWORD D,NAT ch)
+ { return !(ch>0&&PFT_same(S,D,0,ch))&&!(ch>1&&PFT_same(S,D,1,ch))&&!(ch>2&&PFT_same(S,D,2,ch)); }
+constexpr DWORD PFT_group(DWORD S,DWORD D,NAT ch)
+ {
+ return PFT_mask(S,D,ch)&&PFT_first(S,D,ch)?PFT_mask(S,D,ch)|(ch<1&&PFT_same(S,D,1,ch)?PFT_mask(S,D,1):0)
+  |(ch<2&&PFT_same(S,D,2,ch)?PFT_mask(S,D,2):0)|(ch<3&&PFT_same(S,D,3,ch)?PFT_mask(S,D,3):0):0;
+ }
+//pshufb tables: SB bytes pixels->32 bit lanes, 32 bit lanes->DB bytes pixels (4 pixels/lane)
+constexpr char PFT_ex(NAT SB,NAT i) { return (char)(i%4<SB?i/4*SB+i%4:0x80); }
+constexpr char PFT_cp(NAT DB,NAT i) { return (char)(i<4*DB?i/DB*4+i%DB:0x80); }
+#define PFT_X16(f,n) f(n,0),f(n,1),f(n,2),f(n,3),f(n,4),f(n,5),f(n,6),f(n,7),f(n,8),f(n,9),f(n,10),f(n,11),f(n,12),f(n,13),f(n,14),f(n,15)
+
+//kernels for one Spf->Dpf pair, every mask and shift folded to constants ..........................
+template<DWORD S,DWORD D> struct PFSPEC
+{
+ static const NAT SB=(PF_bpix(S)+7)>>3,DB=(PF_bpix(D)+7)>>3;
+
+ template<NAT ch> static inline DWORD Ch(DWORD s)
+ {
+ const DWORD m=PFT_group(S,D,ch);
+ const int sh=PFT_shift(S,D,ch);
+ return !m?0:sh>=0?(s&m)<<(sh>=0?sh:0):(s&m)>>(sh<0?-sh:0);
+ }
+ static DWORD Pix(DWORD s) { return Ch<0>(s)|Ch<1>(s)|Ch<2>(s)|Ch<3>(s); }
+
+#if defined(VSIMD_AVX2)
+ template<NAT ch> static inline __m256i Ch8(__m256i x)
+ {
+ const DWORD m=PFT_group(S,D,ch);
+ const int sh=PFT_shift(S,D,ch);
+ if(!m) return _mm256_setzero_si256();
+ x=_mm256_and_si256(x,_mm256_set1_epi32(m));
+ return sh>0?_mm256_slli_epi32(x,sh>0?sh:0):sh<0?_mm256_srli_epi32(x,sh<0?-sh:0):x;
+ }
+#endif
+
+ static void Row(BYTE*pd,const BYTE*ps,NAT count)
+ {
+ NAT i=0;
+#if defined(VSIMD_AVX2)
+ static const char ex[16]={PFT_X16(PFT_ex,SB)},cp[16]={PFT_X16(PFT_cp,DB)};
+ const __m256i vex=_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)ex));
+ const __m256i vcp=_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)cp));
+ __m256i x;
+ for(;(i+4)*SB+16<=count*SB&&(i+4)*DB+16<=count*DB;i+=8) //8 pixels: 2 lanes of 4
+  {
+  if(SB==4) x=_mm256_loadu_si256((const __m256i*)(ps+i*4));
+  else x=_mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(ps+i*SB))),
+   _mm_loadu_si128((const __m128i*)(ps+(i+4)*SB)),1),vex);
+  x=_mm256_or_si256(_mm256_or_si256(Ch8<0>(x),Ch8<1>(x)),_mm256_or_si256(Ch8<2>(x),Ch8<3>(x)));
+  if(DB==4) _mm256_storeu_si256((__m256i*)(pd+i*4),x);
+  else
+   {
+   x=_mm256_shuffle_epi8(x,vcp);
+   _mm_storeu_si128((__m128i*)(pd+i*DB),_mm256_castsi256_si128(x));
+   _mm_storeu_si128((__m128i*)(pd+(i+4)*DB),_mm256_extracti128_si256(x,1));
+   }
+  }
+#endif
+ for(;i<count;i++)
+  PFStore(pd+i*DB,Pix(PFLoad(ps+i*SB,SB)),DB);
+ }
+};
+
+//instantiated pairs, looked up by PFs (the generic PFCONV kernels handle the rest) ...............
+//only pairs moving bit fields: whole byte pairs (8888<->0888, RGB<->BGR) are a single pshufb in
+//PFCONV already and run as fast there (see BltBench in membench.cpp)
+struct BLTRGB_SPEC
+{
+ DWORD Spf,Dpf;
+ PFROWFN row;
+ PFPIXFN pix;
+};
+#define BLTRGB_SPEC_(s,d) { s,d,PFSPEC<s,d>::Row,PFSPEC<s,d>::Pix }
+static const BLTRGB_SPEC BLTRGBspec[]=
+{
+ BLTRGB_SPEC_(0x32108888,0x32100565), BLTRGB_SPEC_(0x32100565,0x32108888),
+ BLTRGB_SPEC_(0x32108888,0x32101555), BLTRGB_SPEC_(0x32101555,0x32108888),
+ BLTRGB_SPEC_(0x32100888,0x32100565), BLTRGB_SPEC_(0x32100565,0x32100888),
+ BLTRGB_SPEC_(0x32100888,0x32101555), BLTRGB_SPEC_(0x32101555,0x32100888),
+ BLTRGB_SPEC_(0x32100565,0x32101555), BLTRGB_SPEC_(0x32101555,0x32100565),
+};
+#undef BLTRGB_SPEC_
+
 //do nothing ----------------------------------------------------------------------------------
 void BLTRGBnull(BLTRGB*pthis=NULL)
 {
@@ -35,181 +135,47 @@ WARN(1,"Do nothing function called");
 //copy rect with no format change ----------------------------------------------------------------
 void BLTRGBsamepf(BLTRGB*pthis=NULL)
 {
-__asm
- {
- mov ebx,pthis
- push ebp
- mov edi,[ebx]pthis.pDst
- mov esi,[ebx]pthis.pSrc
- mov eax,[ebx]pthis.Dlng
- mov edx,[ebx]pthis.DBpp
- imul edx //eax=Dlng*DBpp
- mov ebp,[ebx]pthis.Dlat //use ebp as outer counter
- mov edx,[ebx]pthis.DeBpl
- mov ebx,[ebx]pthis.SeBpl //no more need for pthis
-LNextLine:
-  mov ecx,eax
-  rep movsb
-  add edi,edx       //next d line
-  add esi,ebx       //next s line
-  dec ebp //lat--
-  jnz LNextLine //loop if lat>0
- pop ebp
- }
+PFConvRect(NULL,pthis->DBpp,pthis->pDst,pthis->DBpl,pthis->pSrc,pthis->SBpl,pthis->Dlng,pthis->Dlat);
 }
 
 //stretch rect same pf PFs ----------------------------------------------------------------
 void BLTRGBstretch(BLTRGB*pthis=NULL)
 {
-__asm
- {
- mov ebx,pthis
- push ebp
- mov edi,[ebx]pthis.pDst
- mov esi,[ebx]pthis.pSrc    //load pointers
- mov gpr0,0                 //use as vertical decision (vrap)
- mov eax,[ebx]pthis.Dlat
- mov gpr1,eax               //use as outer loop counter
-LNextDLine:
-  push esi                  //save pointer to begining of line
-  xor edx,edx               //use EDX as hrap
-  mov ebp,[ebx]pthis.Dlng   //use EBP as counter for inner loop
-LNextDPixel:
-   mov ecx,[ebx]pthis.DBpp
-   rep movsb
-   mov eax,edx
-   add eax,[ebx]pthis.Slng
-   cdq
-   idiv [ebx]pthis.Dlng
-   dec eax                  //esi already incresead by Bpp
-   imul eax,[ebx]pthis.DBpp //eax=(edx+Slng)/Dlng*Bpp
-   add esi,eax              //next src X
-   dec ebp
-   jnz LNextDPixel          //loop if ebp>0
-  add edi,[ebx]pthis.DeBpl  //edi+=extra B
-  pop esi                   //restore src pointer to begining of line
-  mov eax,gpr0
-  add eax,[ebx]pthis.Slat
-  cdq
-  idiv [ebx]pthis.Dlat
-  mov gpr0,edx              //vrap%=Dlng
-  imul [ebx]pthis.SBpl      //eax=(vrap+Slat)/Dlat*SBpl
-  add esi,eax               //next src Y
-  dec gpr1
-  jnz LNextDLine            //loop if --Dlat>0
- pop ebp
- }
+PFConvZoom(NULL,pthis->DBpp,pthis->pDst,pthis->DBpl,pthis->Dlng,pthis->Dlat,pthis->pSrc,pthis->SBpl,pthis->Slng,pthis->Slat);
 }
 
 //copy rect with diffrent PFs ----------------------------------------------------------------
 void BLTRGBcopy(BLTRGB*pthis=NULL)
 {
-__asm
- {
- mov ebx,pthis                  //ebx=this
- push ebp
- mov edi,[ebx]pthis.pDst
- mov esi,[ebx]pthis.pSrc        //load pointers
- mov ecx,[ebx]pthis.rolls       //ecx=rolls
- mov ebp,[ebx]pthis.Slng        //use ebp as inner loop counter
-LNextLinePix:                   //label for both inner and outer loop
-   mov eax,[esi]                //read pixel 1
-   mov edx,eax                  //read pixel 2
-   and eax,[ebx]pthis.mask[0]   //eax&=mask[0]
-   rol eax,cl                   //eax=B
-   ror ecx,8                    //cl=roll[1]
-   and edx,[ebx]pthis.mask[4]   //edx&=mask[1]
-   rol edx,cl
-   or eax,edx                   //eax|=G
-   ror ecx,8                    //cl=roll[2]
-   mov edx,[esi]                //read pixel 3
-   and edx,[ebx]pthis.mask[8]   //edx&=mask[2]
-   rol edx,cl
-   or eax,edx                   //eax|=R
-   ror ecx,8                    //cl=roll[3]
-   mov edx,[esi]                //read pixel 4
-   and edx,[ebx]pthis.mask[12]  //edx&=mask[3]
-   rol edx,cl
-   or eax,edx                   //eax|=A
-   ror ecx,8                    //cl=roll[0]
-   mov [edi],eax                //write pixel
-   add edi,[ebx]pthis.DBpp      //pdc+=DBpp
-   add esi,[ebx]pthis.SBpp      //next src X
-   dec ebp
-   jnz LNextLinePix             //loop if lng>0
-  add edi,[ebx]pthis.DeBpl      //edi+=extra B
-  add esi,[ebx]pthis.SeBpl      //esi+=extra B
-  mov ebp,[ebx]pthis.Slng
-  dec [ebx]pthis.Slat
-  jnz LNextLinePix              //loop if Slat>0
- mov eax,[ebx]pthis.Dlat
- mov [ebx]pthis.Slat,eax        //restore Slat=Dlat
- pop ebp
- }
-} //takes advantage of the fact that Dlat=Slat
+PFConvRect(&pthis->cv,0,pthis->pDst,pthis->DBpl,pthis->pSrc,pthis->SBpl,pthis->Slng,pthis->Slat,pthis->row);
+}
 
 //stretch rect any PFs ---------------------------------------------------------------------------
 void BLTRGBzoom(BLTRGB*pthis=NULL)
 {
-__asm
+PFConvZoom(&pthis->cv,0,pthis->pDst,pthis->DBpl,pthis->Dlng,pthis->Dlat,pthis->pSrc,pthis->SBpl,pthis->Slng,pthis->Slat,pthis->row);
+}
+
+//translate indexed rect through the palette --------------------------------------------------------
+void BLTRGBlut(BLTRGB*pthis=NULL)
+{
+BYTE*pd=(BYTE*)pthis->pDst,*ps=(BYTE*)pthis->pSrc,*pp=(BYTE*)pthis->pLUT;
+NAT y;
+if(pthis->Imask>0xff) //wide indexes
  {
- mov ebx,pthis                  //ebx=this
- push ebp
- mov ecx,[ebx]pthis.rolls       //ecx=rolls
- mov edi,[ebx]pthis.pDst
- mov esi,[ebx]pthis.pSrc        //load pointers
- mov eax,[ebx]pthis.Dlat
- mov gpr0,eax                   //use as outer loop counter
- mov gpr2,0                     //vrap
-LNextDLine:
-  xor ebp,ebp                   //hrap
-  push esi                      //save pointer to begining of line
-  mov eax,[ebx]pthis.Dlng
-  mov gpr1,eax                  //use as counter for inner loop
-LNextDPixel:
-   mov eax,[esi]                //read pixel 1
-   mov edx,eax                  //read pixel 2
-   and eax,[ebx]pthis.mask[0]   //eax&=mask[0]
-   rol eax,cl                   //eax=B
-   ror ecx,8                    //cl=roll[1]
-   and edx,[ebx]pthis.mask[4]   //edx&=mask[1]
-   rol edx,cl
-   or eax,edx                   //eax|=G
-   ror ecx,8                    //cl=roll[2]
-   mov edx,[esi]                //read pixel 3
-   and edx,[ebx]pthis.mask[8]   //edx&=mask[2]
-   rol edx,cl
-   or eax,edx                   //eax|=R
-   ror ecx,8                    //cl=roll[3]
-   mov edx,[esi]                //read pixel 4
-   and edx,[ebx]pthis.mask[12]  //edx&=mask[3]
-   rol edx,cl
-   or eax,edx                   //eax|=A
-   ror ecx,8                    //cl=roll[0]
-   mov [edi],eax                //write pixel
-   add edi,[ebx]pthis.DBpp      //pdc+=DBpp
-   mov eax,ebp
-   add eax,[ebx]pthis.Slng
-   cdq
-   idiv [ebx]pthis.Dlng
-   mov ebp,edx                  //hrap%=dlng
-   imul [ebx]pthis.SBpp         //eax=(hrap+slng)/dlng*SBpp
-   add esi,eax                  //next src X
-   dec gpr1
-   jnz LNextDPixel              //loop if gpr1>0
-  add edi,[ebx]pthis.DeBpl      //edi+=extra B
-  pop esi                       //restore src pointer to begining of line
-  mov eax,gpr2
-  add eax,[ebx]pthis.Slat
-  cdq
-  idiv [ebx]pthis.Dlat
-  mov gpr2,edx                  //vrap%=dlng
-  imul [ebx]pthis.SBpl          //eax=(vrap+slat)/dlat*sspan
-  add esi,eax                   //next src Y
-  dec gpr0
-  jnz LNextDLine                //loop if gpr0>0
- pop ebp
+ for(y=0;y<pthis->Dlat;y++,pd+=pthis->DBpl,ps+=pthis->SBpl)
+  PFConvLut(&pthis->cv,pd,pp,ps,pthis->Dlng,pthis->Bpi,pthis->Imask,pthis->Ipal);
+ return;
  }
+DWORD lut[256]; //palette converted once for all rows, indexes past its end give 0
+if(pthis->pix)
+ for(y=0;y<pthis->Ipal;y++)
+  lut[y]=pthis->pix(PFLoad(pp+y*pthis->SBpp,pthis->SBpp));
+else
+ PFConvPal(&pthis->cv,lut,pp,pthis->Ipal);
+ZeroMemory(lut+pthis->Ipal,(pthis->Imask+1-pthis->Ipal)*sizeof(DWORD));
+for(y=0;y<pthis->Dlat;y++,pd+=pthis->DBpl,ps+=pthis->SBpl)
+ PFConvIdx(pthis->DBpp,pd,lut,ps,pthis->Dlng,pthis->Bpi,pthis->Imask);
 }
 
 // BLTRGB <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -218,6 +184,7 @@ LNextDPixel:
 inline void BLTRGB::PFs(DWORD channels=0x3210) //channels is used for "grey" or "alpha" copy
 {
 NAT Sbpc,Dbpc,Smsb,Dmsb; //bits per channel
+NAT spec=channels==0x3210;
 rolls=0;
 if(!(Spixform&0xffff0000)) Spixform|=0x32100000;
 if(!(Dpixform&0xffff0000)) Dpixform|=0x32100000;
@@ -236,6 +203,19 @@ for(int ch=0;ch<=3;ch++)
   mask[ch]=0;
  channels>>=4; //next nibble
  }
+PFConvInit(&cv,mask,(BYTE*)&rolls,SBpp,DBpp);
+row=NULL;
+pix=NULL;
+#if defined(VSIMD_AVX2)
+if(spec&&SimdCPU()&SIMD_CPU_AVX2) //specialized kernels are built around AVX2, else the SSSE3 ones are faster
+ for(NAT k=0;k<sizeof(BLTRGBspec)/sizeof(BLTRGB_SPEC);k++)
+  if(BLTRGBspec[k].Spf==Spixform&&BLTRGBspec[k].Dpf==Dpixform)
+   {
+   row=BLTRGBspec[k].row;
+   pix=BLTRGBspec[k].pix;
+   break;
+   }
+#endif
 }
 
 //simple rect image copy .......................................................................
@@ -297,10 +277,27 @@ else
 }
 
 //copy indexed (palette) image to ARGB image (no resize) .........................................
-inline void BLTRGB::Lut(void*pD,int Dspan,DWORD Dpf,void*pSi,int Sspan,DWORD Spf,NAT w,NAT h,void*plut,NAT bpi) //channels contains the source channels
+inline void BLTRGB::Lut(void*pD,int Dspan,DWORD Dpf,void*pSi,int Sspan,DWORD Spf,NAT w,NAT h,void*plut,NAT bpi,NAT npal) //Spf is the palette format, npal its entries (0: 1<<bpi)
 {
+if(!pD||!pSi||!plut)
+ {
+ DoIt=BLTRGBnull;
+ return;
+ }
+pDst=pD;        pSrc=pSi;       pLUT=plut;
+Dlng=Slng=w;    Dlat=Slat=h;
+Dpixform=Dpf;   Spixform=Spf;
 Imask=BitMask(bpi-1,bpi);
+Ipal=npal&&npal<=Imask?npal:Imask+1;
 Bpi=ALIGN(bpi,7)>>3;
+DBpp=ALIGN(PF_bpix(Dpixform),7)>>3;
+SBpp=ALIGN(PF_bpix(Spixform),7)>>3; //B/palette entry
+DBpl=Dspan?Dspan:DBpp*Dlng;
+SBpl=Sspan?Sspan:Bpi*Slng;
+DeBpl=DBpl-DBpp*Dlng;
+SeBpl=SBpl-Bpi*Slng;
+PFs();
+DoIt=BLTRGBlut;
 }
 
 #ifdef _DEBUG
@@ -310,11 +307,13 @@ void BLTRGB::IDF()
 if(DoIt==BLTRGBsamepf)
  sc(strbuf,"SamePF");
 else if(DoIt==BLTRGBcopy)
- sc(strbuf,"Copy");
+ sc(strbuf,row?"Copy<>":"Copy");
 else if(DoIt==BLTRGBstretch)
  sc(strbuf,"Stretch");
 else if(DoIt==BLTRGBzoom)
- sc(strbuf,"Zoom");
+ sc(strbuf,row?"Zoom<>":"Zoom");
+else if(DoIt==BLTRGBlut)
+ sc(strbuf,pix?"Lut<>":"Lut");
 else if(DoIt==BLTRGBnull)
  sc(strbuf,"Null");
 else
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <io.h>
 #include <ustruct.cpp>
 
 //INHX32 is the only one suppoarted yet
@@ -11,6 +12,7 @@
 #define HEX_VERIFY_CHECKSUM         0x10000 //when reading, do check sum
 
 #define HEX_MARK_LINE              ':' //marks start of record
+#define HEX_RECMAX                 0xff //data bytes of a record (the default when writing)
 
 #define HEX_REC_DATA                0 //data
 #define HEX_REC_EOF                 1 //eof
@@ -23,73 +25,181 @@ struct HEXfile_record //type is by default 0=data
  {
  DWORD szB;   //size in Bytes
  DWORD adr;   //address(offset)
- DWORD chk; //checksum
  BYTE data[];
  };
 
+//a data record while parsing: its bytes are at of in the decoded data
+struct HEXfile_raw
+ {
+ DWORD adr,szB,of;
+ };
+
+//hex digit -> value, 0x100 for anything else (a pair with a bad digit has bits 8-15 set)
+const WORD HexNib[256]=
+ {
+ 0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0,1,2,3,4,5,6,7,8,9,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,10,11,12,13,14,15,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,10,11,12,13,14,15,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,
+ 0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100,0x100
+ };
+
 //Intel hex file ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~`
+//recs holds the image as contiguous segments sorted by address (adjacent records are merged)
 class HEXfile
 {
 public:
  FILE* fhex; //handle to file
  FLAGS stat; 
- USTRUCT <HEXfile_record> recs; //array of records found in file
+ USTRUCT <HEXfile_record> recs; //segments, sorted by address, not touching
+ DWORD start; //start address (CS:IP or EIP) of a HEX_REC_SSAR/HEX_REC_SLAR record
+ NAT starttype; //that record type, 0: none
+ NAT reclen; //data bytes per record written (0: HEX_RECMAX)
 
  HEXfile() { ZEROCLASS(HEXfile); }
  ~HEXfile() { Free(); }
- void Add(NAT,NAT,BYTE*);
- BYTE Checksum1(NAT);
+ NAT Add(NAT,NAT,BYTE*);
+ NAT Find(NAT);
+ BYTE*At(NAT,NAT*);
  NAT MaxAddress();
  FAIL Load(LPSTR,FLAGS);
  FAIL Save(LPSTR,FLAGS);
- FAIL ParseIHX32();
+ FAIL ParseIHX32(char*,NAT);
  FAIL DumpIHX32();
+ void Segments(HEXfile_raw*,NAT,BYTE*);
  void Free()
   {
   recs.Free();
   FCLOSE(fhex);
+  starttype=0;
   }
 };
 
-//append a record.............................................................................................
-inline void HEXfile::Add(NAT adr,NAT szB,BYTE*pdata=NULL)
+//value of the hex pair at s (>0xff: not hex)..........................................................................................
+inline NAT HexByte(char*s)
+{
+return (HexNib[(BYTE)s[0]]<<4)|HexNib[(BYTE)s[1]];
+}
+
+//segment holding adr or R_NULL (binary search).............................................................................................
+NAT HEXfile::Find(NAT adr)
+{
+NAT lo=0,hi=recs.nrit,m;
+while(lo<hi)
+ {
+ m=(lo+hi)>>1;
+ if(adr<recs.item[m]->adr)
+  hi=m;
+ else if(adr-recs.item[m]->adr>=recs.item[m]->szB)
+  lo=m+1;
+ else
+  return m;
+ }
+return R_NULL;
+}
+
+//the byte at adr, and in *n the bytes that follow it in its segment (NULL: no data there).............................................................................................
+BYTE*HEXfile::At(NAT adr,NAT*n=NULL)
 {
-NAT ind=recs.nrit;
-recs.dimit(ind,szB);
-recs.item[ind]->adr=adr;
-recs.item[ind]->szB=szB;
-if(!pdata) return;
-CopyMemory(recs.item[ind]->data,pdata,szB);
+NAT s=Find(adr);
+if(s==R_NULL)
+ {
+ if(n) *n=0;
+ return NULL;
+ }
+if(n) *n=recs.item[s]->szB-(adr-recs.item[s]->adr);
+return recs.item[s]->data+(adr-recs.item[s]->adr);
 }
 
-//compute checksum.............................................................................................
-inline BYTE HEXfile::Checksum1(NAT ind)
+//write szB bytes at adr (pdata NULL: zeroes), merged with the segments it touches; returns the segment ..........................
+NAT HEXfile::Add(NAT adr,NAT szB,BYTE*pdata=NULL)
 {
-if(ind>=recs.nrit) return 0;
-recs.item[ind]->chk=(recs.item[ind]->szB&0xff)+(recs.item[ind]->adr&0xff)+((recs.item[ind]->adr>>8)&0xff);
-for(int b=0;b<recs.item[ind]->szB;b++)
- recs.item[ind]->chk+=recs.item[ind]->data[b];
-return recs.item[ind]->chk=(-recs.item[ind]->chk)&0xff;
+NAT lo=0,hi=recs.nrit,m,a,s;
+QWORD beg=adr,end=(QWORD)adr+szB;
+HEXfile_record*seg;
+if(!szB) return Find(adr);
+while(lo<hi) //first segment ending at or after adr (it touches or follows the range)
+ {
+ m=(lo+hi)>>1;
+ if((QWORD)recs.item[m]->adr+recs.item[m]->szB<beg)
+  lo=m+1;
+ else
+  hi=m;
+ }
+for(a=lo;a<recs.nrit&&recs.item[a]->adr<=end;a++) //[lo,a) are merged
+ {
+ beg=MIN(beg,(QWORD)recs.item[a]->adr);
+ end=MAX(end,(QWORD)recs.item[a]->adr+recs.item[a]->szB);
+ }
+seg=(HEXfile_record*)ALLOC0(sizeof(HEXfile_record)+(NAT)(end-beg));
+if(!seg) return R_NULL;
+seg->adr=(DWORD)beg;
+seg->szB=(DWORD)(end-beg);
+for(s=lo;s<a;s++)
+ CopyMemory(seg->data+(recs.item[s]->adr-seg->adr),recs.item[s]->data,recs.item[s]->szB);
+if(pdata)
+ CopyMemory(seg->data+(adr-seg->adr),pdata,szB);
+else
+ ZeroMemory(seg->data+(adr-seg->adr),szB);
+if(a==lo)
+ {
+ m=recs.nrit;
+ recs.ins(lo,1);
+ if(recs.nrit==m)
+  {
+  FREE(seg);
+  return R_NULL;
+  }
+ }
+else
+ {
+ for(s=lo;s<a;s++)
+  FREE(recs.item[s]);
+ recs.del(lo+1,a-lo-1);
+ }
+recs.item[lo]=seg;
+return lo;
 }
 
-//find maximum address.............................................................................................
+//address of the last data byte (0 if none).............................................................................................
 inline NAT HEXfile::MaxAddress()
 {
-NAT maxadr=0;
-for(int r=0;r<recs.nrit;r++)
- if(recs.item[r]->adr>maxadr) 
-  maxadr=recs.item[r]->adr;
-return maxadr;  
+if(!recs.nrit) return 0;
+return recs.item[recs.nrit-1]->adr+recs.item[recs.nrit-1]->szB-1;
 }
 
-//load and parse file.............................................................................................
+//load and parse file (mapped): 1 can't open, else the ParseIHX32() result .............................................................................................
 FAIL HEXfile::Load(LPSTR path,FLAGS flags=HEX_FORMAT_INHX32)
 {
+HANDLE hf,hm;
+LARGE_INTEGER sz;
+char*map;
+FAIL ret;
 FCLOSE(fhex);
 fhex=FOPEN(path,"r+b");
 ifn(fhex) return 1; //can't open file
-ParseIHX32();
-return 0; //ok
+hf=(HANDLE)_get_osfhandle(_fileno(fhex));
+if(!GetFileSizeEx(hf,&sz)||sz.HighPart) return 1;
+if(!sz.LowPart) return ParseIHX32("",0);
+hm=CreateFileMapping(hf,NULL,PAGE_READONLY,0,0,NULL);
+if(!hm) return 1;
+map=(char*)MapViewOfFile(hm,FILE_MAP_READ,0,0,0);
+CloseHandle(hm); //the view keeps the mapping open
+if(!map) return 1;
+ret=ParseIHX32(map,sz.LowPart);
+UnmapViewOfFile(map);
+return ret;
 }
 
 //save to file.............................................................................................
@@ -98,90 +208,245 @@ FAIL HEXfile::Save(LPSTR path,FLAGS flags=HEX_FORMAT_INHX32)
 FCLOSE(fhex);
 fhex=FOPEN(path,"wb");
 ifn(fhex) return 1; //can't open file
-DumpIHX32();
-return 0; //ok
+return DumpIHX32();
+}
+
+//recs from the data records rr (file order), bytes in dat; later records win where they overlap .............................................................................................
+int HexRawCmp(const void*a,const void*b)
+{
+const HEXfile_raw*x=(const HEXfile_raw*)a,*y=(const HEXfile_raw*)b;
+if(x->adr!=y->adr) return x->adr<y->adr?-1:1;
+return x->of<y->of?-1:x->of>y->of; //file order
+}
+
+void HEXfile::Segments(HEXfile_raw*rr,NAT nr,BYTE*dat)
+{
+HEXfile_raw*sr=rr;
+NAT r,s,nrs=0;
+QWORD end;
+for(r=1;r<nr;r++)
+ if(rr[r].adr<(QWORD)rr[r-1].adr+rr[r-1].szB) break; //out of order or overlapping
+if(r<nr)
+ {
+ sr=(HEXfile_raw*)ALLOC(nr*sizeof(HEXfile_raw));
+ if(!sr) return;
+ CopyMemory(sr,rr,nr*sizeof(HEXfile_raw));
+ qsort(sr,nr,sizeof(HEXfile_raw),HexRawCmp);
+ }
+for(r=0;r<nr;r=s) //count
+ {
+ end=(QWORD)sr[r].adr+sr[r].szB;
+ for(s=r+1;s<nr&&sr[s].adr<=end;s++)
+  end=MAX(end,(QWORD)sr[s].adr+sr[s].szB);
+ nrs++;
+ }
+recs.reserve(nrs);
+for(r=0;r<nr;r=s) //size
+ {
+ end=(QWORD)sr[r].adr+sr[r].szB;
+ for(s=r+1;s<nr&&sr[s].adr<=end;s++)
+  end=MAX(end,(QWORD)sr[s].adr+sr[s].szB);
+ NAT i=recs.dimit(recs.nrit,(NAT)(end-sr[r].adr));
+ recs.item[i]->adr=sr[r].adr;
+ recs.item[i]->szB=(DWORD)(end-sr[r].adr);
+ }
+if(sr!=rr) FREE(sr);
+for(r=0,s=0;r<nr;r++) //fill in file order
+ {
+ if(s>=recs.nrit||rr[r].adr-recs.item[s]->adr>=recs.item[s]->szB) s=Find(rr[r].adr);
+ if(s==R_NULL) break; //out of memory above
+ CopyMemory(recs.item[s]->data+(rr[r].adr-recs.item[s]->adr),dat+rr[r].of,rr[r].szB);
+ }
 }
 
-//parse file.............................................................................................
-FAIL HEXfile::ParseIHX32()
-{ //carefull !!! when reading with fscanf you must provide at least a WORD at the address
-NAT reclen,address,rectype,csum,tdat,ladr,nrr;
-char c=0;
-reclen=address=rectype=csum=tdat=ladr=nrr=0;
+//parse nc chars of INHX32 text: 0 ok, 1/2/3 truncated record header/data/checksum, 4/5 truncated address, 6 bad checksum .............................................................................................
+FAIL HEXfile::ParseIHX32(char*txt,NAT nc)
+{
+char*p=txt,*end=txt+nc;
+BYTE tmp[HEX_RECMAX],*d;
+BYTE*dat=NULL; //decoded data of all records
+HEXfile_raw*rr=NULL;
+NAT datcap=0,datsz=0,rrcap=0,nrr=0;
+NAT reclen,adrh,adrl,address,rectype,csum,sum,bad,b,v,ladr=0;
+FAIL ret=0;
 recs.Free();
-fseek(fhex,0,SEEK_SET);
-while(c!=EOF)
- {
- do{ 
-  c=fgetc(fhex);
-  if(c==EOF)
-   return 0; //done
-  }while(c!=HEX_MARK_LINE); //search next record
- if(fscanf(fhex,"%2hx%4hx%2hx",&reclen,&address,&rectype)==EOF)
-  return 1; //possible incomplete or truncated file
+starttype=0;
+ArrayCap((void**)&dat,&datcap,nc/2,1,1); //data is at most half the text
+while(p<end)
+ {
+ p=(char*)memchr(p,HEX_MARK_LINE,end-p); //search next record
+ if(!p) break; //done
+ p++;
+ if(end-p<8)
+  {
+  ret=1; //possible incomplete or truncated file
+  break;
+  }
+ reclen=HexByte(p);
+ adrh=HexByte(p+2);
+ adrl=HexByte(p+4);
+ rectype=HexByte(p+6);
+ if((reclen|adrh|adrl|rectype)&0xff00)
+  {
+  ret=1;
+  break;
+  }
+ address=(adrh<<8)|adrl;
+ p+=8;
+ if((NAT)(end-p)<2*reclen)
+  {
+  ret=2;
+  break;
+  }
+ d=tmp;
+ if(rectype==HEX_REC_DATA)
+  {
+  if(!ArrayCap((void**)&dat,&datcap,datsz+reclen,1)||!ArrayCap((void**)&rr,&rrcap,nrr+1,sizeof(HEXfile_raw)))
+   {
+   ret=2;
+   break;
+   }
+  d=dat+datsz;
+  }
+ sum=reclen+(address>>8)+(address&0xff)+rectype;
+ for(b=0,bad=0;b<reclen;b++,p+=2)
+  {
+  v=HexByte(p);
+  bad|=v;
+  d[b]=(BYTE)v;
+  sum+=v;
+  }
+ if(bad&0xff00||end-p<2||(csum=HexByte(p))&0xff00)
+  {
+  ret=bad&0xff00?2:3; //possible incomplete or truncated file
+  break;
+  }
+ p+=2;
+ if((stat&HEX_VERIFY_CHECKSUM)&&((sum+csum)&0xff))
+  {
+  ret=6;
+  break;
+  }
  if(rectype==HEX_REC_DATA)
   {
-  Add(address+ladr,reclen);
-  for(int b=0;b<reclen;b++)
+  if(reclen)
    {
-   if(fscanf(fhex,"%2hx",&tdat)==EOF)
-    return 2; //possible incomplete or truncated file
-   recs.item[nrr]->data[b]=tdat;
+   rr[nrr].adr=ladr+address;
+   rr[nrr].szB=reclen;
+   rr[nrr].of=datsz;
+   nrr++;
+   datsz+=reclen;
    }
-  //printbox("%u: &%x [%u]",nrr,address,reclen);
-  nrr++;
-  ladr=0; //reset address
   }
  else if(rectype==HEX_REC_EOF)
-  return 0; //done
- else if(rectype==HEX_REC_ESAR)
+  break; //done
+ else if(rectype==HEX_REC_ESAR||rectype==HEX_REC_ELAR)
   {
-  if(fscanf(fhex,"%2hx",&ladr)==EOF)
-   return 4; //possible incomplete or truncated file
-  ladr<<=4;
+  if(reclen<2)
+   {
+   ret=rectype==HEX_REC_ESAR?4:5; //possible incomplete or truncated file
+   break;
+   }
+  ladr=(d[0]<<8)|d[1];
+  ladr<<=rectype==HEX_REC_ESAR?4:16;
   }
- else if(rectype==HEX_REC_ELAR)
+ else if(rectype==HEX_REC_SSAR||rectype==HEX_REC_SLAR)
   {
-  if(fscanf(fhex,"%2hx",&ladr)==EOF)
-   return 5; //possible incomplete or truncated file
-  ladr<<=16;
+  if(reclen>=4)
+   {
+   start=(d[0]<<24)|(d[1]<<16)|(d[2]<<8)|d[3];
+   starttype=rectype;
+   }
   }
  else
   error("Unsupported record type in HEXfile");
- if(fscanf(fhex,"%2hx",&csum)==EOF)
-  return 3; //possible incomplete or truncated file
- if(stat&HEX_VERIFY_CHECKSUM)
-  {
-  if(csum!=(tdat=Checksum1(recs.nrit-1)))
-   printbox("Check sum (read)%x!=%x(calc) ",csum,tdat);
-  } 
  }
-return 0; 
+Segments(rr,nrr,dat);
+FREE(rr);
+FREE(dat);
+return ret; 
+}
+
+//one record of n bytes at offset into o, returns its chars .............................................................................................
+NAT HexRec(char*o,NAT rectype,NAT offset,BYTE*d,NAT n)
+{
+static const char hx[]="0123456789ABCDEF";
+NAT b,l=0,sum=n+(offset>>8)+(offset&0xff)+rectype;
+o[l++]=HEX_MARK_LINE;
+o[l++]=hx[n>>4]; o[l++]=hx[n&15];
+o[l++]=hx[(offset>>12)&15]; o[l++]=hx[(offset>>8)&15]; o[l++]=hx[(offset>>4)&15]; o[l++]=hx[offset&15];
+o[l++]=hx[rectype>>4]; o[l++]=hx[rectype&15];
+for(b=0;b<n;b++)
+ {
+ sum+=d[b];
+ o[l++]=hx[d[b]>>4];
+ o[l++]=hx[d[b]&15];
+ }
+sum=(-sum)&0xff;
+o[l++]=hx[sum>>4]; o[l++]=hx[sum&15];
+o[l++]='\r'; o[l++]='\n';
+return l;
 }
 
-//save.............................................................................................
+//save: records of up to reclen bytes, split only at segment and 64KB ends; a HEX_REC_ELAR where b31-b16 change .............................................................................................
 FAIL HEXfile::DumpIHX32()
 {
-NAT csum,tdat;
-fseek(fhex,0,SEEK_SET);
-//fprintf(fhex,":020000040000FA\r\n"); //start address 0
-for(int r=0;r<recs.nrit;r++)
- {
- if(recs.item[r]->adr&0xffff0000)
-  printbox("Large address found"); //TODO: generate HEX_REC_ELAR 
- if(recs.item[r]->szB&0xffffff00)
-  printbox("Record is larger than 256B; must split"); //TODO: split it
- fprintf(fhex,":%02X%04X00",recs.item[r]->szB&0xff,recs.item[r]->adr&0xffff); //start address
- csum=(recs.item[r]->szB&0xff)+(recs.item[r]->adr&0xff)+((recs.item[r]->adr>>8)&0xff);
- for(int b=0;b<(recs.item[r]->szB);b++)
+NAT r,n,left,hi=0,rl=reclen&&reclen<HEX_RECMAX?reclen:HEX_RECMAX;
+DWORD a;
+QWORD sz=13+(starttype?13+2*4:0); //EOF and start records
+BYTE ext[4],*d;
+char*out;
+NAT l=0;
+for(r=0;r<recs.nrit;r++) //exact size of the text: the records below are 13 chars + 2 per data byte
+ {
+ a=recs.item[r]->adr;
+ left=recs.item[r]->szB;
+ while(left)
   {
-  csum+=tdat=recs.item[r]->data[b];
-  fprintf(fhex,"%02X",tdat);
+  if((a>>16)!=hi)
+   {
+   hi=a>>16;
+   sz+=13+2*2;
+   }
+  n=MIN(left,MIN(rl,0x10000-(a&0xffff)));
+  sz+=13+2*n;
+  a+=n;
+  left-=n;
   }
- fprintf(fhex,"%02X\r\n",(-csum)&0xff);
  }
-fprintf(fhex,":00000001FF"); //EOF
-return 0; 
+if(sz>0xffffffff) return 2;
+hi=0;
+out=SALLOC((NAT)sz);
+if(!out) return 2;
+for(r=0;r<recs.nrit;r++)
+ {
+ a=recs.item[r]->adr;
+ d=recs.item[r]->data;
+ left=recs.item[r]->szB;
+ while(left)
+  {
+  if((a>>16)!=hi)
+   {
+   hi=a>>16;
+   ext[0]=hi>>8;
+   ext[1]=hi&0xff;
+   l+=HexRec(out+l,HEX_REC_ELAR,0,ext,2);
+   }
+  n=MIN(left,MIN(rl,0x10000-(a&0xffff)));
+  l+=HexRec(out+l,HEX_REC_DATA,a&0xffff,d,n);
+  a+=n;
+  d+=n;
+  left-=n;
+  }
+ }
+if(starttype)
+ {
+ ext[0]=start>>24; ext[1]=start>>16; ext[2]=start>>8; ext[3]=start;
+ l+=HexRec(out+l,starttype,0,ext,4);
+ }
+l+=HexRec(out+l,HEX_REC_EOF,0,NULL,0);
+fseek(fhex,0,SEEK_SET);
+n=fwrite(out,1,l,fhex);
+FREE(out);
+return n!=l;
 }
-
-
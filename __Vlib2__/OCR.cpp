@@ -2,10 +2,39 @@
 #pragma once
 
 #include <img.cpp>
+#include <simd.cpp>
+#include <parallel.cpp>
+#include <float.h>
 
 #define SYNAPSE_PREC float   //data type used for neuron weights
 #define OCRSOM_SAVECOMMON		48  //4*4+4*8= how much to save from OCRSOM
 #define OCRSOM_SAVENEURON		28  //4+3*8= how much to save from OCR_NEURON_O
+#define OCRSOM_PACKALIGN		8   //packed rows are padded to this many floats (one AVX register)
+#define OCRSOM_TRAINSLICE		64  //samples summed into one delta accumulator (fixed, so results don't depend on threads)
+#define OCRSOM_TRAINROUND		16  //slices summed at once, then added to the batch sums (bounds the accumulators)
+
+//learning rate schedules (OCRSOM_TRAIN::schedule)
+#define OCRSOM_LR_CONST		0 //rate0
+#define OCRSOM_LR_STEP		1 //rate0*decay^(epoch/step)
+#define OCRSOM_LR_EXP		2 //rate0*exp(-decay*epoch)
+#define OCRSOM_LR_INV		3 //rate0/(1+decay*epoch)
+
+class OCRSOM;
+//parameters for OCRSOM::Fit
+struct OCRSOM_TRAIN
+{
+ NAT epochs;     //epochs to run
+ NAT epoch0;     //number of the first one (to resume from a checkpoint with the same schedule)
+ NAT batch;      //mini-batch size, 0=all samples
+ NAT threads;    //0=one per processor
+ int schedule;   //OCRSOM_LR_xxx
+ double rate0;   //<0: running average of all samples ever trained (as Train with rate<0)
+ double decay;
+ NAT step;       //epochs per step for OCRSOM_LR_STEP
+ DWORD seed;     //samples are shuffled every epoch if not 0
+ LPSTR checkpoint; //Save() here after every epoch (NULL=no)
+ int (*progress)(OCRSOM*,NAT epoch,double rate,double err); //after every epoch, return !0 to stop
+};
 
 //status
 #define OCRSOM_EXTERNALDRAW  			0x1 //window is used by external
@@ -47,6 +76,13 @@ public:
  RCT nnr; //rect for nnimg
  HFONT hfnt1,hfnt2; 
  int activ;
+ //packed weights for batched scoring (RunBatch), rebuilt after any change of weights or chset
+ float*pack;      //one row of packs floats per active neuron, 32B aligned, zero padded
+ NAT*packidx;     //neuron of each row
+ NAT packn,packs; //rows, row stride
+ BYTE*packmem;    //allocation behind pack
+ ASCIISET packset; //chset the pack was made for
+ BOOL packok;     //set packok=0 after writing output[].w from outside
  
 OCRSOM() { ZEROCLASS(OCRSOM); }
 void Init(NAT,NAT,char,char);
@@ -57,10 +93,17 @@ void Inputs(Image*,RCT*,char*,NAT,COLOR,int,int);
 void NeuronFromImg(SYNAPSE_PREC*,Image*,Image*,RCT,COLOR,int,int);
 char RunDot(NAT);
 char RunDif(NAT);
+void Pack();
+BOOL Packed() { return packok&&CmpMem(&packset,&chset,sizeof(ASCIISET)); }
+void Winners(SYNAPSE_PREC**,NAT,NAT*,double*,NAT*,double*);
+void RunBatch(NAT,NAT);
+void Scores(NAT);
 void RunAll();
 void GetStr(char*);
 void Train(NAT,NAT,double);
 void TrainAll(char*,double);
+NAT TrainBatch(SYNAPSE_PREC**,char*,NAT,double,NAT);
+double Fit(SYNAPSE_PREC**,char*,NAT,OCRSOM_TRAIN*);
 void Free();
 void DrawInImage(SYNAPSE_PREC*,Image*,int,int);
 void ToImage(Image*,int);
@@ -92,6 +135,11 @@ for(n=0;n<neurons;n++)
  FREE(output[n].w);
  }
 FREE(output);
+FREE(packmem);
+FREE(packidx);
+pack=NULL;
+packn=0;
+packok=0;
 nrchars=0;
 neurons=0;
 nnimg.Free();
@@ -349,14 +397,244 @@ input[in].dif=output[winner].dif;
 return winner+mincode;
 }
 
+//Batched scoring ===================================================================================
+//X: nx inputs, W: nw neurons, both rows of stride floats (stride%8==0, zero padded, 32B aligned).
+//For every input returns the neuron with the largest dot product and the one with the smallest
+//squared difference |x-w|^2, first one on ties (as RunDot/RunDif).
+//The difference is summed as such, not as |x|^2-2x.w+|w|^2 (cancels to noise when x~w).
+#define OCR_TILEX 2 //inputs per tile
+#define OCR_TILEW 3 //neurons per tile
+
+//keeps the winners of input x up to date with one more neuron
+inline void OCRBest(NAT x,NAT w,double dot,double dif,NAT*windot,double*bdot,NAT*windif,double*bdif)
+{
+if(dot>bdot[x])
+ {
+ bdot[x]=dot;
+ windot[x]=w;
+ }
+if(dif<bdif[x])
+ {
+ bdif[x]=dif;
+ windif[x]=w;
+ }
+}
+
+void OCRScore1(const float*X,NAT nx,const float*W,NAT nw,NAT stride,NAT*windot,double*bdot,NAT*windif,double*bdif)
+{
+for(NAT x=0;x<nx;x++)
+ for(NAT w=0;w<nw;w++)
+  {
+  const float*px=X+x*stride,*pw=W+w*stride;
+  double dot=0.,dif=0.;
+  for(NAT s=0;s<stride;s++)
+   {
+   dot+=px[s]*pw[s];
+   dif+=(px[s]-pw[s])*(px[s]-pw[s]);
+   }
+  OCRBest(x,w,dot,dif,windot,bdot,windif,bdif);
+  }
+}
+
+#if defined(VSIMD_FMA)
+inline double OCRHSum(__m256 v)
+{
+__m128 s=_mm_add_ps(_mm256_castps256_ps128(v),_mm256_extractf128_ps(v,1));
+__m128d d=_mm_add_pd(_mm_cvtps_pd(s),_mm_cvtps_pd(_mm_movehl_ps(s,s)));
+return _mm_cvtsd_f64(_mm_add_sd(d,_mm_unpackhi_pd(d,d)));
+}
+
+//one more 8 synapses of x against w: dot and squared difference
+inline void OCRAcc(__m256 v,__m256 u,__m256&dot,__m256&dif)
+{
+__m256 t=_mm256_sub_ps(v,u);
+dot=_mm256_fmadd_ps(v,u,dot);
+dif=_mm256_fmadd_ps(t,t,dif);
+}
+
+//2 inputs x 3 neurons per tile: 12 accumulators, each input row loaded once per 3 neurons
+void OCRScoreAVX2(const float*X,NAT nx,const float*W,NAT nw,NAT stride,NAT*windot,double*bdot,NAT*windif,double*bdif)
+{
+NAT x,w,s,i,j;
+for(x=0;x+OCR_TILEX<=nx;x+=OCR_TILEX)
+ {
+ const float*x0=X+x*stride,*x1=x0+stride;
+ for(w=0;w+OCR_TILEW<=nw;w+=OCR_TILEW)
+  {
+  const float*w0=W+w*stride,*w1=w0+stride,*w2=w1+stride;
+  __m256 a[OCR_TILEX][OCR_TILEW],d[OCR_TILEX][OCR_TILEW];
+  for(i=0;i<OCR_TILEX;i++)
+   for(j=0;j<OCR_TILEW;j++)
+    a[i][j]=d[i][j]=_mm256_setzero_ps();
+  for(s=0;s<stride;s+=8)
+   {
+   __m256 v0=_mm256_load_ps(x0+s),v1=_mm256_load_ps(x1+s),u;
+   u=_mm256_load_ps(w0+s); OCRAcc(v0,u,a[0][0],d[0][0]); OCRAcc(v1,u,a[1][0],d[1][0]);
+   u=_mm256_load_ps(w1+s); OCRAcc(v0,u,a[0][1],d[0][1]); OCRAcc(v1,u,a[1][1],d[1][1]);
+   u=_mm256_load_ps(w2+s); OCRAcc(v0,u,a[0][2],d[0][2]); OCRAcc(v1,u,a[1][2],d[1][2]);
+   }
+  for(j=0;j<OCR_TILEW;j++) //neuron order kept for the tie rule
+   for(i=0;i<OCR_TILEX;i++)
+    OCRBest(x+i,w+j,OCRHSum(a[i][j]),OCRHSum(d[i][j]),windot,bdot,windif,bdif);
+  }
+ for(;w<nw;w++) //neurons left over
+  {
+  const float*w0=W+w*stride;
+  __m256 a0=_mm256_setzero_ps(),a1=a0,d0=a0,d1=a0;
+  for(s=0;s<stride;s+=8)
+   {
+   __m256 u=_mm256_load_ps(w0+s);
+   OCRAcc(_mm256_load_ps(x0+s),u,a0,d0);
+   OCRAcc(_mm256_load_ps(x1+s),u,a1,d1);
+   }
+  OCRBest(x,w,OCRHSum(a0),OCRHSum(d0),windot,bdot,windif,bdif);
+  OCRBest(x+1,w,OCRHSum(a1),OCRHSum(d1),windot,bdot,windif,bdif);
+  }
+ }
+for(;x<nx;x++) //inputs left over
+ {
+ const float*x0=X+x*stride;
+ for(w=0;w<nw;w++)
+  {
+  const float*w0=W+w*stride;
+  __m256 a0=_mm256_setzero_ps(),d0=a0;
+  for(s=0;s<stride;s+=8)
+   OCRAcc(_mm256_load_ps(x0+s),_mm256_load_ps(w0+s),a0,d0);
+  OCRBest(x,w,OCRHSum(a0),OCRHSum(d0),windot,bdot,windif,bdif);
+  }
+ }
+}
+#endif
+
+//packs the weights of the active neurons for RunBatch ...........................................
+void OCRSOM::Pack()
+{
+NAT n,r,s;
+FREE(packmem);
+FREE(packidx);
+packs=ALIGN(synapses,OCRSOM_PACKALIGN-1);
+packn=0;
+for(n=0;n<neurons;n++)
+ if(chset[n+mincode]&&output[n].w)
+  packn++;
+packmem=(BYTE*)ALLOC0(packn*packs*sizeof(float)+32);
+pack=(float*)ALIGN((size_t)packmem,31);
+packidx=ALLOC_NAT(packn);
+r=0;
+for(n=0;n<neurons;n++)
+ {
+ ifn(chset[n+mincode]&&output[n].w)
+  continue;
+ float*row=pack+r*packs;
+ for(s=0;s<synapses;s++)
+  row[s]=output[n].w[s];
+ packidx[r]=n;
+ r++;
+ }
+packset=chset;
+packok=1;
+}
+
+//winners of nr samples against all active neurons, as RunDot+RunDif (any arg but x can be NULL) ..
+//safe to call from several threads once the weights are packed
+void OCRSOM::Winners(SYNAPSE_PREC**x,NAT nr,NAT*windot,double*dot,NAT*windif,double*dif)
+{
+NAT c,s;
+if(!Packed())
+ Pack();
+if(!packn||!nr) return;
+BYTE*xmem=(BYTE*)ALLOC0(nr*packs*sizeof(float)+32);
+float*X=(float*)ALIGN((size_t)xmem,31);
+double*bdot=ALLOC_DOUBLE(nr),*bdif=ALLOC_DOUBLE(nr);
+NAT*wdot=ALLOC_NAT(nr),*wdif=ALLOC_NAT(nr);
+for(c=0;c<nr;c++)
+ {
+ float*row=X+c*packs;
+ for(s=0;s<synapses;s++)
+  row[s]=x[c][s];
+ bdot[c]=-DBL_MAX;
+ bdif[c]=DBL_MAX;
+ wdot[c]=wdif[c]=0;
+ }
+#if defined(VSIMD_FMA)
+if((SimdCPU()&(SIMD_CPU_AVX2|SIMD_CPU_FMA))==(SIMD_CPU_AVX2|SIMD_CPU_FMA))
+ OCRScoreAVX2(X,nr,pack,packn,packs,wdot,bdot,wdif,bdif);
+else
+#endif
+ OCRScore1(X,nr,pack,packn,packs,wdot,bdot,wdif,bdif);
+for(c=0;c<nr;c++)
+ {
+ if(windot) windot[c]=packidx[wdot[c]];
+ if(dot) dot[c]=bdot[c];
+ if(windif) windif[c]=packidx[wdif[c]];
+ if(dif) dif[c]=bdif[c];
+ }
+FREE(xmem);
+FREE(bdot);
+FREE(bdif);
+FREE(wdot);
+FREE(wdif);
+}
+
+//scores inputs [first,first+nr) against all neurons at once, as RunDot+RunDif on each ...........
+//(the winners are taken among the active neurons only)
+void OCRSOM::RunBatch(NAT first,NAT nr)
+{
+NAT c,n;
+if(first>=nrchars) return;
+nr=MIN(nr,nrchars-first);
+if(!Packed())
+ Pack();
+if(!packn||!nr) return;
+SYNAPSE_PREC**x=(SYNAPSE_PREC**)ALLOC_POINTER(nr);
+NAT*windot=ALLOC_NAT(nr),*windif=ALLOC_NAT(nr);
+double*dot=ALLOC_DOUBLE(nr),*dif=ALLOC_DOUBLE(nr);
+for(c=0;c<nr;c++)
+ x[c]=input[first+c].w;
+Winners(x,nr,windot,dot,windif,dif);
+for(c=0;c<nr;c++)
+ {
+ OCR_NEURON_I*pi=input+first+c;
+ pi->windot=windot[c];
+ pi->dot=dot[c];
+ pi->windif=windif[c];
+ pi->dif=dif[c];
+ }
+for(n=0;n<packn;n++)
+ output[packidx[n]].totalruns+=nr;
+Scores(first+nr-1);
+FREE(x);
+FREE(windot);
+FREE(windif);
+FREE(dot);
+FREE(dif);
+}
+
+//output[].dot/.dif of input in against each active neuron, as RunDot+RunDif leave them (OCRSOM_SHOWSCORES) ....
+void OCRSOM::Scores(NAT in)
+{
+NAT n,s;
+if(in>=nrchars) return;
+for(n=0;n<neurons;n++)
+ {
+ ifn(chset[n+mincode]&&output[n].w)
+  continue;
+ output[n].dot=output[n].dif=0.;
+ for(s=0;s<synapses;s++)
+  {
+  output[n].dot+=input[in].w[s]*output[n].w[s];
+  output[n].dif+=(input[in].w[s]-output[n].w[s])*(input[in].w[s]-output[n].w[s]);
+  }
+ }
+}
+
 //should call InputImg first (n should be the winner)..............................................
 void OCRSOM::RunAll()
 {
 NAT c;
+RunBatch(0,nrchars);
 for(c=0;c<nrchars;c++)
  {
- RunDot(c);
- RunDif(c);
  if(input[c].windot!=input[c].windif)
   {
   input[c].estim=input[c].windif+mincode;
@@ -418,6 +696,7 @@ if(in>=nrchars)
 if(input[in].windot!=out)
  output[input[in].windot].failed++;
 output[out].trained++;
+packok=0;
 if(rate<0)
  rate=1./(output[out].trained);
 output[out].weight=0.;
@@ -444,6 +723,261 @@ for(int c=0;c<nrchars;c++)
  }
 }
 
+//Mini-batch training ================================================================================
+//one TrainBatch: the slices of OCRSOM_TRAINSLICE samples are summed per trained neuron, OCRSOM_TRAINROUND
+//slices at a time, and the rounds are added to the batch sums in slice order
+struct OCR_BATCH
+{
+ OCRSOM*som;
+ SYNAPSE_PREC**x;
+ char*label;
+ NAT nr,nslices;
+ NAT sl0,nsl; //slices of the current round
+ double rate;
+ double*acc; //[slice of the round][neuron][synapse] sum of samples (valid where cnt!=0)
+ NAT*cnt;    //[slice of the round][neuron] samples summed
+ NAT*fcnt;   //[slice of the round][neuron] times the neuron won for another label
+ NAT*fails;  //[slice of the round]
+ double*sum; //[neuron][synapse] the rounds so far (valid where scnt!=0)
+ NAT*scnt,*sfcnt; //[neuron] their cnt and fcnt
+};
+
+//phase 1: winners and sums, slice by slice
+void OCRBatchSlices(void*ctx,NAT t,NAT nt)
+{
+OCR_BATCH*pb=(OCR_BATCH*)ctx;
+OCRSOM*som=pb->som;
+NAT i,c,s,n,nn=som->neurons,syn=som->synapses;
+NAT windot[OCRSOM_TRAINSLICE];
+for(i=t;i<pb->nsl;i+=nt)
+ {
+ NAT first=(pb->sl0+i)*OCRSOM_TRAINSLICE,nr=MIN(OCRSOM_TRAINSLICE,pb->nr-first);
+ double*acc=pb->acc+(size_t)i*nn*syn;
+ NAT*cnt=pb->cnt+i*nn,*fcnt=pb->fcnt+i*nn;
+ ZeroMemory(cnt,nn*sizeof(NAT));
+ ZeroMemory(fcnt,nn*sizeof(NAT));
+ pb->fails[i]=0;
+ som->Winners(pb->x+first,nr,windot,NULL,NULL,NULL);
+ for(c=0;c<nr;c++)
+  {
+  n=(BYTE)pb->label[first+c]-som->mincode;
+  if(windot[c]!=n)
+   {
+   fcnt[windot[c]]++;
+   pb->fails[i]++;
+   }
+  const SYNAPSE_PREC*px=pb->x[first+c];
+  double*pa=acc+n*syn;
+  if(cnt[n]++)
+   for(s=0;s<syn;s++)
+    pa[s]+=px[s];
+  else
+   for(s=0;s<syn;s++)
+    pa[s]=px[s];
+  }
+ }
+}
+
+//phase 2: per neuron, adds the slices of the round to the batch sums in slice order
+void OCRBatchSum(void*ctx,NAT t,NAT nt)
+{
+OCR_BATCH*pb=(OCR_BATCH*)ctx;
+OCRSOM*som=pb->som;
+NAT n,i,s,nn=som->neurons,syn=som->synapses;
+for(n=t;n<nn;n+=nt)
+ {
+ double*sum=pb->sum+(size_t)n*syn;
+ for(i=0;i<pb->nsl;i++)
+  {
+  pb->sfcnt[n]+=pb->fcnt[i*nn+n];
+  if(!pb->cnt[i*nn+n])
+   continue;
+  double*pa=pb->acc+((size_t)i*nn+n)*syn;
+  if(pb->scnt[n])
+   for(s=0;s<syn;s++)
+    sum[s]+=pa[s];
+  else
+   for(s=0;s<syn;s++)
+    sum[s]=pa[s];
+  pb->scnt[n]+=pb->cnt[i*nn+n];
+  }
+ }
+}
+
+//phase 3: per neuron, moves the weights towards the batch sums
+void OCRBatchApply(void*ctx,NAT t,NAT nt)
+{
+OCR_BATCH*pb=(OCR_BATCH*)ctx;
+OCRSOM*som=pb->som;
+NAT n,s,syn=som->synapses;
+for(n=t;n<som->neurons;n+=nt)
+ {
+ double*sum=pb->sum+(size_t)n*syn;
+ NAT m=pb->scnt[n];
+ OCRSOM::OCR_NEURON_O*po=som->output+n;
+ po->failed+=pb->sfcnt[n];
+ if(!m)
+  continue;
+ //w=w*(1-keep)+k*sum: running average over all samples ever trained, or a step of rate towards their mean
+ double k,keep;
+ if(pb->rate<0)
+  {
+  k=1./(po->trained+m);
+  keep=m*k;
+  }
+ else
+  {
+  k=pb->rate/m;
+  keep=pb->rate;
+  }
+ po->trained+=m;
+ double weight=0.;
+ SYNAPSE_PREC*pw=po->w;
+ for(s=0;s<syn;s++)
+  {
+  pw[s]=(SYNAPSE_PREC)(pw[s]*(1.-keep)+k*sum[s]);
+  weight+=ABS(pw[s]);
+  }
+ po->weight=weight;
+ }
+}
+
+//trains nr samples (x[i] labeled label[i]) as one mini-batch on nthreads threads (0=processors)
+//returns how many were not recognized (RunDot winner) before the update ..........................
+NAT OCRSOM::TrainBatch(SYNAPSE_PREC**x,char*label,NAT nr,double rate=-1.,NAT nthreads=0)
+{
+NAT c,k=0,fails=0;
+OCR_BATCH b;
+SYNAPSE_PREC**xs=(SYNAPSE_PREC**)ALLOC_POINTER(nr);
+char*ls=(char*)ALLOC(nr+1);
+for(c=0;c<nr;c++) //drop what Train would skip
+ {
+ BYTE ch=label[c];
+ if(!chset[ch]||ch<mincode||ch>maxcode||!output[ch-mincode].w)
+  continue;
+ xs[k]=x[c];
+ ls[k]=ch;
+ k++;
+ }
+if(!k)
+ {
+ FREE(xs);
+ FREE(ls);
+ return 0;
+ }
+if(!nthreads) nthreads=ParThreads();
+if(!Packed()) //before the threads read it
+ Pack();
+SimdCPU();
+b.som=this;
+b.x=xs;
+b.label=ls;
+b.nr=k;
+b.nslices=(k+OCRSOM_TRAINSLICE-1)/OCRSOM_TRAINSLICE;
+b.rate=rate;
+k=MIN(b.nslices,OCRSOM_TRAINROUND);
+b.acc=ALLOC_DOUBLE((size_t)k*neurons*synapses);
+b.cnt=ALLOC_NAT(k*neurons);
+b.fcnt=ALLOC_NAT(k*neurons);
+b.fails=ALLOC_NAT(k);
+b.sum=ALLOC_DOUBLE((size_t)neurons*synapses);
+b.scnt=ALLOC_NAT(neurons);
+b.sfcnt=ALLOC_NAT(neurons);
+ZeroMemory(b.scnt,neurons*sizeof(NAT));
+ZeroMemory(b.sfcnt,neurons*sizeof(NAT));
+for(b.sl0=0;b.sl0<b.nslices;b.sl0+=b.nsl)
+ {
+ b.nsl=MIN(b.nslices-b.sl0,OCRSOM_TRAINROUND);
+ ParRun(OCRBatchSlices,&b,MIN(nthreads,b.nsl));
+ ParRun(OCRBatchSum,&b,MIN(nthreads,neurons));
+ for(c=0;c<b.nsl;c++)
+  fails+=b.fails[c];
+ }
+ParRun(OCRBatchApply,&b,MIN(nthreads,neurons));
+packok=0;
+FREE(b.acc);
+FREE(b.cnt);
+FREE(b.fcnt);
+FREE(b.fails);
+FREE(b.sum);
+FREE(b.scnt);
+FREE(b.sfcnt);
+FREE(xs);
+FREE(ls);
+return fails;
+}
+
+//learning rate of an epoch ........................................................................
+inline double OCRRate(OCRSOM_TRAIN*tp,NAT epoch)
+{
+if(tp->rate0<0)
+ return tp->rate0;
+switch(tp->schedule)
+ {
+ case OCRSOM_LR_STEP: return tp->rate0*pow(tp->decay,(double)(epoch/MAX(tp->step,1)));
+ case OCRSOM_LR_EXP: return tp->rate0*exp(-tp->decay*epoch);
+ case OCRSOM_LR_INV: return tp->rate0/(1.+tp->decay*epoch);
+ }
+return tp->rate0;
+}
+
+//trains nr labeled samples for tp->epochs epochs of mini-batches, returns last epoch error rate ....
+double OCRSOM::Fit(SYNAPSE_PREC**x,char*label,NAT nr,OCRSOM_TRAIN*tp)
+{
+NAT e,c,b,nb;
+double err=0.;
+char path[PATHSZ];
+if(!nr) return 0.;
+NAT batch=tp->batch?MIN(tp->batch,nr):nr;
+NAT*order=ALLOC_NAT(nr);
+SYNAPSE_PREC**xb=(SYNAPSE_PREC**)ALLOC_POINTER(batch);
+char*lb=(char*)ALLOC(batch);
+for(c=0;c<nr;c++)
+ order[c]=c;
+for(e=tp->epoch0;e<tp->epoch0+tp->epochs;e++)
+ {
+ if(tp->seed) //Fisher-Yates with a fixed LCG, so runs (and resumed runs) are repeatable
+  {
+  NAT r=tp->seed^(e*2654435761u);
+  for(c=nr-1;c>0;c--)
+   {
+   r=r*1664525u+1013904223u;
+   NAT j=(NAT)(((QWORD)r*(c+1))>>32);
+   NAT t=order[c];
+   order[c]=order[j];
+   order[j]=t;
+   }
+  }
+ double rate=OCRRate(tp,e);
+ NAT fails=0;
+ for(b=0;b<nr;b+=batch)
+  {
+  nb=MIN(batch,nr-b);
+  for(c=0;c<nb;c++)
+   {
+   xb[c]=x[order[b+c]];
+   lb[c]=label[order[b+c]];
+   }
+  fails+=TrainBatch(xb,lb,nb,rate,tp->threads);
+  }
+ err=(double)fails/nr;
+ if(tp->checkpoint) //Save changes the extension in place
+  {
+  strncpy(path,tp->checkpoint,PATHSZ-1);
+  path[PATHSZ-1]=0;
+  Save(path);
+  }
+ if(tp->progress&&tp->progress(this,e,rate,err))
+  break;
+ }
+FREE(order);
+FREE(xb);
+FREE(lb);
+ToImage(&nnimg,ncols);
+InvalidateRect(ownd,NULL,0);
+return err;
+}
+
 #ifdef _DEBUG
 //..................................................................................................
 void OCRSOM::ShowNeuron(HWND hwnd,SYNAPSE_PREC*layer)
@@ -2,6 +2,9 @@
 #ifndef V_BASICTOOLS
 #define V_BASICTOOLS
 
+#include <string.h>
+#include <simd.cpp>
+
 //inline assembly macros
 #define DISCARD_ST0 __asm ffree st(0) __asm fincstp //pops the stack discarding value
 
@@ -167,36 +170,51 @@ LSkip2:
  }
 }
 
+//bit scans and population count for the memory primitives ----------------------------------------
+inline NAT MemLSB(NAT m) //m!=0
+{
+#if defined(_MSC_VER)
+unsigned long r;
+_BitScanForward(&r,m);
+return r;
+#else
+return __builtin_ctz(m);
+#endif
+}
+
+inline NAT MemPopCnt(NAT m)
+{
+#if defined(_MSC_VER)
+return __popcnt(m);
+#else
+return __builtin_popcount(m);
+#endif
+}
+
 //compares to blocks ------------------------------------------------------------------------------
 inline BOOL __cdecl CmpMem(void*str1,void*str2,NAT bsz=0)
 {
-__asm
- {
- xor eax,eax
- mov ecx,bsz
- jecxz LRetTrue
- mov edi,str1
- mov esi,str2
- repz cmpsb
- jnz LRetFalse
-LRetTrue:
- mov eax,1
-LRetFalse:
- }
+return !memcmp(str1,str2,bsz);
 }
 
-//compares to blocks and returns address of first difference ------------------------------------------------------------------------------
+//compares to blocks and returns 1+offset of the first difference (bsz if none) ------------------------
 inline NAT __cdecl MemDif(void*str1,void*str2,NAT bsz=0)
 {
-__asm
- {
- mov ecx,bsz
- mov edi,str1
- mov esi,str2
- repz cmpsb
- mov eax,edi
- sub eax,str1
- }
+const BYTE*p1=(const BYTE*)str1,*p2=(const BYTE*)str2;
+NAT i=0;
+#if defined(VSIMD_AVX2)
+if(SimdCPU()&SIMD_CPU_AVX2)
+ for(;i+32<=bsz;i+=32)
+  {
+  NAT ne=~(NAT)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p1+i)),_mm256_loadu_si256((const __m256i*)(p2+i))));
+  if(ne) return i+MemLSB(ne)+1;
+  }
+#endif
+for(;i+8<=bsz;i+=8)
+ if(*(const QWORD*)(p1+i)!=*(const QWORD*)(p2+i)) break;
+for(;i<bsz;i++)
+ if(p1[i]!=p2[i]) return i+1;
+return bsz;
 }
 
 //returns most significant set bit------------------------------------------------------------
@@ -281,25 +299,10 @@ LNextItem:
  }
 }
 
-//copies memory on a DW granularity ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//copies memory, overlapping blocks are allowed (memmove) ~~~~~~~~~~~~~~~~~~~~~
 inline void CopyMem(void*pdst,void*psrc,NAT memszB=0)
 {
-__asm
- {
- mov edi,pdst
- mov esi,psrc
- mov ecx,memszB
- mov edx,ecx //save ecx
- shr ecx,2
- jz LSkip1
- rep movsd
-LSkip1:
- mov ecx,edx
- and ecx,0x3
- jz LSkip2
- rep movsb
-LSkip2:
- }
+memmove(pdst,psrc,memszB);
 }
 
 //copy to dest limit or to term ----------------------------------------------------------
@@ -539,89 +542,107 @@ LNextDPixel:
 //left shifts a memory block (<--)-----------------------------------------------------------
 void* __cdecl ShiftMemL(void*psrc,int delta=1,NAT count=1)
 {
-__asm
- {
- mov esi,psrc
- mov edi,esi
- sub edi,delta
- mov eax,edi
- mov ecx,count
- rep movsb
- }
+BYTE*pdst=(BYTE*)psrc-delta;
+memmove(pdst,psrc,count);
+return pdst;
 }
 
 //right shifts a memory block (-->)-----------------------------------------------------------
 void* __cdecl ShiftMemR(void*psrc,int delta=1,NAT count=1)
 {
-__asm
- {
- mov ecx,count
- mov esi,psrc
- add esi,ecx
- dec esi //esi=psrc+count-1
- mov edi,esi
- add edi,delta
- pushfd
- std
- rep movsb
- popfd
- mov eax,edi
- inc eax
- }
+BYTE*pdst=(BYTE*)psrc+delta;
+memmove(pdst,psrc,count);
+return pdst;
+}
+
+//(re)sizes a block of *cap items of itsz bytes to hold n items -----------------------------
+//grows x1.5 (at least 8 items), so appending one at a time is amortized O(1), and shrinks only when
+//less than a quarter is used (to 2*n), so add/del around a size don't reallocate; exact: grow to n
+//(reserve), never shrink. 0: out of memory (*pblock is kept)
+BOOL ArrayCap(void**pblock,NAT*cap,NAT n,NAT itsz,BOOL exact=0)
+{
+NAT lcap=*cap;
+void*p;
+if(n>lcap)
+ lcap=exact?n:MAX(n,lcap<8?8:lcap+lcap/2);
+else if(!exact&&lcap>16&&n<lcap/4)
+ lcap=2*n;
+if(lcap==*cap) return 1;
+if(!lcap)
+ {
+ FREE(*pblock);
+ *cap=0;
+ return 1;
+ }
+p=REALLOC(*pblock,lcap*itsz);
+if(!p) return n<=*cap; //a failed shrink keeps the bigger block
+*pblock=p;
+*cap=lcap;
+return 1;
+}
+
+//fills szB bytes repeating a Bpi bytes pattern ---------------------------------------------
+//2/4/8 byte patterns are broadcast in a register, 3 byte ones rotate through 3 registers (96B period),
+//anything else doubles the filled part with memcpy
+void __cdecl FillPat(BYTE*pdst,const BYTE*pat,NAT Bpi,NAT szB)
+{
+NAT i=0;
+if(!Bpi||!szB) return;
+if(Bpi==1)
+ {
+ memset(pdst,*pat,szB);
+ return;
+ }
+#if defined(VSIMD_AVX2)
+if((Bpi==2||Bpi==3||Bpi==4||Bpi==8)&&szB>=64&&SimdCPU()&SIMD_CPU_AVX2)
+ {
+ BYTE rep[96+8];
+ for(NAT k=0;k<96+8;k++) rep[k]=pat[k%Bpi];
+ __m256i v0=_mm256_loadu_si256((const __m256i*)rep),v1=v0,v2=v0;
+ if(Bpi==3)
+  {
+  v1=_mm256_loadu_si256((const __m256i*)(rep+32)); //pattern phase 32%3=2
+  v2=_mm256_loadu_si256((const __m256i*)(rep+64)); //pattern phase 64%3=1
+  }
+ for(;i+96<=szB;i+=96)
+  {
+  _mm256_storeu_si256((__m256i*)(pdst+i),v0);
+  _mm256_storeu_si256((__m256i*)(pdst+i+32),v1);
+  _mm256_storeu_si256((__m256i*)(pdst+i+64),v2);
+  }
+ if(i+32<=szB) _mm256_storeu_si256((__m256i*)(pdst+i),v0),i+=32;
+ if(i+32<=szB) _mm256_storeu_si256((__m256i*)(pdst+i),v1),i+=32;
+ for(;i<szB;i++) pdst[i]=rep[i%96]; //i is a multiple of 96 plus 0/32/64
+ return;
+ }
+#endif
+memmove(pdst,pat,MIN(Bpi,szB)); //pat may lie inside pdst
+for(i=MIN(Bpi,szB);i<szB;i*=2) //doubling copies
+ memcpy(pdst+i,pdst,MIN(i,szB-i));
 }
 
 //copies Bpi bytes from psrc to pdest itemcnt times --------------------------------------
 void __cdecl FillMem(void*pdst,void*psrc,NAT Bpi=1,NAT itemcnt=1)
 {
-__asm
- {
- mov edi,pdst
- mov edx,psrc
- mov ebx,Bpi
- mov eax,itemcnt
-LNextItem:
- mov esi,edx
- mov ecx,ebx
- rep movsb
- dec eax
- jnz LNextItem
- }
+FillPat((BYTE*)pdst,(const BYTE*)psrc,Bpi,Bpi*itemcnt);
 }
 
 //copies b in pb count times -----------------------------------------------------------
 inline void __cdecl FillB(BYTE*pb,BYTE b=0,NAT count=1)
 {
-__asm
- {
- mov edi,pb
- mov al,b
- mov ecx,count
- rep stosb
- }
+memset(pb,b,count);
 }
 
 //copies dw in pdw count times ----------------------------------------------------------
 inline void __cdecl FillDW(DWORD*pdw,DWORD dw=0,NAT count=1)
 {
-__asm
- {
- mov edi,pdw
- mov eax,dw
- mov ecx,count
- rep stosd
- }
+FillPat((BYTE*)pdw,(const BYTE*)&dw,4,count*4);
 }
 
 //copies f in pf count times ------------------------------------------------------------
 inline void __cdecl FillF(float *pf,float f=0.0f,NAT count=1)
 {
-__asm
- {
- mov edi,pf
- mov eax,f
- mov ecx,count
- rep stosd
- }
+FillPat((BYTE*)pf,(const BYTE*)&f,4,count*4);
 }
 
 //--------------------------------------------------------------------------------------------------------------
@@ -645,73 +666,78 @@ LNextItem:
 //numarul de aparitii al sep in pmem --------------------------------------------------------
 NAT __cdecl MemCnt(char sep,void*pmem,NAT msz=0)
 {
-__asm
+const BYTE*pm=(const BYTE*)pmem;
+NAT i=0,cnt=0;
+#if defined(VSIMD_AVX2)
+if(SimdCPU()&SIMD_CPU_AVX2)
  {
- xor eax,eax
- mov ecx,msz
- jecxz LBreakOut
- mov bl,sep
- mov edx,pmem
-LNextChar:
-  cmp bl,[edx]
-  jne LNoInc
-  inc eax
-LNoInc:
-  inc edx
-  loop LNextChar
-LBreakOut:
+ __m256i vs=_mm256_set1_epi8(sep);
+ for(;i+32<=msz;i+=32)
+  cnt+=MemPopCnt((NAT)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(pm+i)),vs)));
  }
+#endif
+for(;i<msz;i++)
+ cnt+=pm[i]==(BYTE)sep;
+return cnt;
 }
 
-//searches for b in memory [pmem,pmem+szb] and returns pointer ---------------------------
+//searches for b in memory [pmem,pmem+szb) and returns pointer (pmem+szb if not found) ---------------
 inline void* __cdecl FindMemB(BYTE b,void*pmem,NAT szb=0)
 {
-__asm
- {
- mov eax,pmem
- mov dl,b
- mov ecx,szb
-LNextByte:
-  cmp [eax],dl
-  je Lreturn
-  inc eax
-  loop LNextByte
-Lreturn:
- }
+void*pf=memchr(pmem,b,szb);
+return pf?pf:(BYTE*)pmem+szb;
 }
 
-//searches for w in memory [pmem,pmem+szb] and returns pointer ---------------------------
+//searches for w at any byte offset in [pmem,pmem+szb) and returns pointer (pmem+szb if not found) -----
 inline void* __cdecl FindMemW(WORD w,void*pmem,NAT szb=0)
 {
-__asm
+const BYTE*pm=(const BYTE*)pmem;
+NAT i=0;
+#if defined(VSIMD_AVX2)
+if(SimdCPU()&SIMD_CPU_AVX2)
  {
- mov eax,pmem
- mov dx,w
- mov ecx,szb
-LNextByte:
-  cmp [eax],dx
-  je Lreturn
-  inc eax
-  loop LNextByte
-Lreturn:
+ __m256i b0=_mm256_set1_epi8((char)w),b1=_mm256_set1_epi8((char)(w>>8));
+ for(;i+32<=szb;i+=32)
+  {
+  NAT eq=(NAT)_mm256_movemask_epi8(_mm256_and_si256(
+   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(pm+i)),b0),
+   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(pm+i+1)),b1)));
+  if(eq) return (void*)(pm+i+MemLSB(eq));
+  }
  }
+#endif
+for(;i<szb;i++)
+ if(*(const WORD*)(pm+i)==w) break;
+return (void*)(pm+i);
 }
 
-//searches for dw in memory [pmem,pmem+szb] and returns pointer ---------------------------
+//searches for dw at any byte offset in [pmem,pmem+szb) and returns pointer (pmem+szb if not found) ---
 inline void* __cdecl FindMemDW(DWORD dw,void*pmem,NAT szb=0)
 {
-__asm
- {
- mov eax,pmem
- mov edx,dw
- mov ecx,szb
-LNextByte:
-  cmp [eax],edx
-  je Lreturn
-  inc eax
-  loop LNextByte
-Lreturn:
- }
+const BYTE*pm=(const BYTE*)pmem;
+NAT i=0;
+#if defined(VSIMD_AVX2)
+if(SimdCPU()&SIMD_CPU_AVX2)
+ {
+ __m256i b0=_mm256_set1_epi8((char)dw),b1=_mm256_set1_epi8((char)(dw>>8)),
+  b2=_mm256_set1_epi8((char)(dw>>16)),b3=_mm256_set1_epi8((char)(dw>>24));
+ for(;i+32<=szb;i+=32)
+  {
+  __m256i e=_mm256_and_si256(
+   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(pm+i)),b0),
+   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(pm+i+1)),b1));
+  NAT eq=(NAT)_mm256_movemask_epi8(e);
+  if(!eq) continue; //most blocks end here
+  eq&=(NAT)_mm256_movemask_epi8(_mm256_and_si256(
+   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(pm+i+2)),b2),
+   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(pm+i+3)),b3)));
+  if(eq) return (void*)(pm+i+MemLSB(eq));
+  }
+ }
+#endif
+for(;i<szb;i++)
+ if(*(const DWORD*)(pm+i)==dw) break;
+return (void*)(pm+i);
 }
 
 //copies a buffer to delta between B with a specified granularity ---------------------------------------------------------
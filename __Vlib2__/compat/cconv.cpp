@@ -1,6 +1,8 @@
 #ifndef V_COLOR_CONVERTOR
 #define V_COLOR_CONVERTOR
 
+#include <pfconv.cpp>
+
 //Color Convertor ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 struct CCONV
 {
@@ -15,7 +17,7 @@ public: //must keep THIS order, Info is for both modes (Tf|Ed)
 //convert 
  void Tf(DWORD Spixform=0,DWORD Dpixform=0,int bpi=0,DWORD channels=0x3210);//sets up for color conversion
  DWORD BGRA(void*pc,BYTE b=0,BYTE g=0,BYTE r=0,BYTE a=0); //pc must not be NULL, but can be any memory
- void Blt(void*pdc,void*psc,NAT count=1); //pdc,psc must be at least 3B longer than required
+ void Blt(void*pdc,void*psc,NAT count=1); //converts exactly count pixels
  void Cpr(void*pdc,int dspan,void *psc,int sspan,int lng,int lat); //copy pixel rects
  void Spr(void*pdc,int dspan,int dlng,int dlat,void *psc,int sspan,int slng,int slat); //stretch pixel rects
  void Rpr(void*pdc,int dspan,int dlng,int dlat,void *psc,int sspan,int slng,int slat); //reduce pixel rects
@@ -27,6 +29,8 @@ public: //must keep THIS order, Info is for both modes (Tf|Ed)
  void Col(BYTE*,BYTE*,BYTE*,BYTE*); //get pixel
  void Pix(BYTE,BYTE,BYTE,BYTE); //put pixel
  void Mip(void*,void*,int,int,int); //halves dimensions
+
+ PFCONV cv; //Tf mode: conversion kernels (Blt,Cpr,Spr,Ptl)
 }REGcc; //global register color convertor (use on inner level only)
 /*
 Tf mode:
@@ -82,6 +86,7 @@ SBpp=ALIGN(sbpp,7)>>3;
 DBpp=ALIGN(dbpp,7)>>3;
 Bpi=ALIGN(bpi,7)>>3;
 Imask=imask;
+PFConvInit(&cv,mask,roll,SBpp,DBpp);
 }
 
 //creates masks'n'rools for color conversion ...........................................
@@ -110,6 +115,7 @@ SBpp=ALIGN(PF_bpix(Spixform),7)>>3;
 DBpp=ALIGN(PF_bpix(Dpixform),7)>>3;
 Imask=BitMask(bpi-1,bpi);
 Bpi=ALIGN(bpi,7)>>3;
+PFConvInit(&cv,mask,roll,SBpp,DBpp);
 }
 
 //creates masks'n'rolls for image processing ..............................................
@@ -171,197 +177,25 @@ __asm
 //BitbLockTransfer: converts a linear buffer ...............................................................
 void CCONV::Blt(void *pdc,void *psc,NAT count)
 {
-__asm
- {
- mov ebx,ecx //ebx=this
- mov edi,pdc
- mov esi,psc
- mov ecx,[ebx] //ecx=rolls
-LNextPixel:
-  mov eax,[esi] //eax=*psc
-  and eax,[ebx+4] //eax&=mask[0]
-  rol eax,cl //eax=B
-  ror ecx,8 //cl=roll[1]
-  mov edx,[esi]
-  and edx,[ebx+8] //edx&=mask[1]
-  rol edx,cl
-  or eax,edx //eax|=G
-  ror ecx,8 //cl=roll[2]
-  mov edx,[esi]
-  and edx,[ebx+12] //edx&=mask[2]
-  rol edx,cl
-  or eax,edx //eax|=R
-  ror ecx,8 //cl=roll[3]
-  mov edx,[esi]
-  and edx,[ebx+16] //edx&=mask[3]
-  rol edx,cl
-  or eax,edx //eax|=A
-  ror ecx,8 //cl=roll[0]
-  mov [edi],eax //*pdc=eax
-  add esi,[ebx]this.SBpp //psc+=SBpp
-  add edi,[ebx]this.DBpp //pdc+=DBpp
-  dec count
- jnz LNextPixel //loop if count>0
- }
+PFConvRow(&cv,pdc,psc,count);
 }
 
 //PaletteTransLate: converts paletted images to ARGB in desired format ...................................
 void CCONV::Ptl(void *pdc,void *pal,void *psi,NAT count)
 {
-__asm
- {
- mov ebx,ecx //ebx=this
- mov edi,pdc
- mov esi,psi
- mov ecx,[ebx] //ecx=rolls
-LNextPixel:
-  mov eax,[esi] //eax=index
-  add esi,[ebx]this.Bpi //next index
-  push esi
-  and eax,[ebx]this.Imask //mask index
-  mul [ebx]this.SBpp //scale index
-  mov esi,pal //esi=pal
-  add esi,eax //esi=pal+index*SBpp
-  mov eax,[esi] //eax=pal[index]
-  and eax,[ebx+4] //eax&=mask[0]
-  rol eax,cl //eax=B
-  ror ecx,8 //cl=roll[1]
-  mov edx,[esi] //edx=pal[index]
-  and edx,[ebx+8] //edx&=mask[1]
-  rol edx,cl
-  or eax,edx //eax|=G
-  ror ecx,8 //cl=roll[2]
-  mov edx,[esi]
-  and edx,[ebx+12] //edx&=mask[2]
-  rol edx,cl
-  or eax,edx //eax|=R
-  ror ecx,8 //cl=roll[3]
-  mov edx,[esi]
-  and edx,[ebx+16] //edx&=mask[3]
-  rol edx,cl
-  or eax,edx //eax|=A
-  ror ecx,8 //cl=roll[0]
-  pop esi
-  mov [edi],eax //*pdc=eax
-  add edi,[ebx]this.DBpp //pdc+=DBpp
-  dec count
- jnz LNextPixel //loop if count>0
- }
+PFConvLut(&cv,pdc,pal,psi,count,Bpi,Imask);
 }
 
 //CopyPixelRects: converts rectangular buffers ........................................
 void CCONV::Cpr(void *pdc,int dspan,void *psc,int sspan,int lng,int lat)
 {
-__asm
- {
- mov ebx,ecx          //ebx=this
- mov ecx,[ebx]        //ecx=rolls
- mov edi,pdc
- mov esi,psc          //load pointers
- mov eax,lng
- mov edx,eax
- mov psc,eax          //use psc to save lng
- imul edx,[ebx]this.DBpp
- sub dspan,edx        //dspan-=lng*DBpp extra dst B
- imul [ebx]this.SBpp
- sub sspan,eax        //sspan-=lng*SBpp extra src B
-LNextLinePix:         //label for both inner and outer loop
-   mov eax,[esi]      //read pixel 1
-   mov edx,eax        //read pixel 2
-   and eax,[ebx+4]    //eax&=mask[0]
-   rol eax,cl         //eax=B
-   ror ecx,8          //cl=roll[1]
-   and edx,[ebx+8]    //edx&=mask[1]
-   rol edx,cl
-   or eax,edx         //eax|=G
-   ror ecx,8          //cl=roll[2]
-   mov edx,[esi]      //read pixel 3
-   and edx,[ebx+12]   //edx&=mask[2]
-   rol edx,cl
-   or eax,edx         //eax|=R
-   ror ecx,8          //cl=roll[3]
-   mov edx,[esi]      //read pixel 4
-   and edx,[ebx+16]   //edx&=mask[3]
-   rol edx,cl
-   or eax,edx         //eax|=A
-   ror ecx,8          //cl=roll[0]
-   mov [edi],eax      //write pixel
-   add edi,[ebx]this.DBpp//pdc+=DBpp
-   add esi,[ebx]this.SBpp//next src X
-   dec lng
-   jnz LNextLinePix   //loop if lng>0
-  add edi,dspan       //edi+=extra B
-  add esi,sspan       //esi+=extra B
-  mov eax,psc
-  mov lng,eax         //restore lng
-  dec lat
-  jnz LNextLinePix    //loop if lat>0
- }
+PFConvRect(&cv,0,pdc,dspan,psc,sspan,lng,lat);
 }
 
 //StretchPixelRects: converts rectangular buffers ........................................
 void CCONV::Spr(void *pdc,int dspan,int dlng,int dlat,void *psc,int sspan,int slng,int slat)
 {
-int loopi,hrap,vrap=0;
-__asm
- {
- mov ebx,ecx          //ebx=this
- mov ecx,[ebx]        //ecx=rolls
- mov edi,pdc
- mov esi,psc          //load pointers
- mov eax,dlng
- imul [ebx]this.DBpp
- sub dspan,eax        //dspan-=dlng*DBpp extra B
- mov eax,dlat
- mov pdc,eax          //use pdc as outer loop counter
-LNextDLine:
-  mov hrap,0
-  mov psc,esi         //save pointer to begining of line
-  mov eax,dlng
-  mov loopi,eax       //use as counter for inner loop
-LNextDPixel:
-   mov eax,[esi]      //read pixel 1
-   mov edx,eax        //read pixel 2
-   and eax,[ebx+4]    //eax&=mask[0]
-   rol eax,cl         //eax=B
-   ror ecx,8          //cl=roll[1]
-   and edx,[ebx+8]    //edx&=mask[1]
-   rol edx,cl
-   or eax,edx         //eax|=G
-   ror ecx,8          //cl=roll[2]
-   mov edx,[esi]      //read pixel 3
-   and edx,[ebx+12]   //edx&=mask[2]
-   rol edx,cl
-   or eax,edx         //eax|=R
-   ror ecx,8          //cl=roll[3]
-   mov edx,[esi]      //read pixel 4
-   and edx,[ebx+16]   //edx&=mask[3]
-   rol edx,cl
-   or eax,edx         //eax|=A
-   ror ecx,8          //cl=roll[0]
-   mov [edi],eax      //write pixel
-   add edi,[ebx]this.DBpp //pdc+=DBpp
-   mov eax,hrap
-   add eax,slng
-   cdq
-   idiv dlng
-   mov hrap,edx       //hrap%=dlng
-   imul [ebx]this.SBpp//eax=(hrap+slng)/dlng*SBpp
-   add esi,eax        //next src X
-   dec loopi
-   jnz LNextDPixel    //loop if loopi>0
-  add edi,dspan       //edi+=extra B
-  mov esi,psc         //restore src pointer to begining of line
-  mov eax,vrap
-  add eax,slat
-  cdq
-  idiv dlat
-  mov vrap,edx        //vrap%=dlng
-  imul sspan          //eax=(vrap+slat)/dlat*sspan
-  add esi,eax         //next src Y
-  dec pdc
-  jnz LNextDLine      //loop if pdc>0
- }
+PFConvZoom(&cv,0,pdc,dspan,dlng,dlat,psc,sspan,slng,slat);
 }
 
 //ReducePixelRects: reduces rectangular buffers (dlng,dlat MUST BE <= slng,slat)........................................
@@ -1,6 +1,67 @@
 #ifndef V_DATASET
 #define V_DATASET
 
+//file: "DS" header {Tip,NrRec,first record offset}, then records {next offset,size,data[size],8 spare
+//bytes} chained by their next offsets (record 0 is the header link at 8). Record offsets and sizes are
+//kept in RecTab, so Open() does no I/O. The table is saved as an index block at the end of the file on
+//Flush()/unbind: {"DSIX",NrRec,{of,sz,room}[NrRec+1],sum,ixof,"DSIX"}. Readers that don't know it walk
+//the chain as before and append after it. Bind() loads it when it is still the tail of the file and
+//matches the header, otherwise (old files, appended or crashed sessions) builds the table by walking
+//the chain once; the first change drops it. Open() still reads the record size: the only change old
+//readers make in place is a downsize.
+//The bound file is one read/write view, Get/Put copy from/to it. Each header/link change is written
+//to a log first (file.wal: {"DSWL",n,{offset,value}[n],sum}, the last change only), then made in the
+//view: if the session dies in between, Bind() redoes it (open a crashed set with this code first).
+//With DS_SYNC the view reaches the disk before each change is logged, so this holds on power loss too.
+//The log is opened without write sharing: a set has one writer, a second Bind() of it (from another
+//DataSet or process) fails with 2 while the first is bound, its RecTab and free lists would go stale.
+//Deleted and moved records go to free lists by size class and are reused; Bind() finds that space
+//again (and the space old readers leaked) as the gaps between records.
+//A record keeps the room of its block: it grows in place while it fits, else moves with its data.
+//Compact() rewrites the file without gaps, records in order.
+#define DS_ID		0x5344		//"DS"
+#define DS_IXID		0x58495344	//"DSIX"
+#define DS_WALID	0x4C575344	//"DSWL"
+#define DS_SYNC		0x1			//Bind() flag: flush the view and the log on every change (slow, survives power loss)
+#define DS_LOGMAX	8			//most {offset,value} pairs in one logged change
+#define DS_MAPSTEP	0x10000		//the view grows by 1/4 at least, in steps of this
+#define DS_NRCLASS	32			//free size classes: class k holds blocks of 2^k..2^(k+1)-1 bytes
+#define DS_MINBLK	32			//smaller free gaps are left to Compact()
+#define DS_CMPBUF	0x100000	//Compact() write buffer
+#define DS_GAPMAX	0x10000		//GetMany/PutMany: pieces closer than this are fetched as one range
+
+struct DS_REC
+{
+ NAT of,sz,room; //record offset (of its next link), data size, data bytes its block can hold
+};
+
+struct DS_FREE
+{
+ NAT of,len; //free block offset, length (with the 16 bytes of link, size and spare)
+};
+
+struct DS_CLASS
+{
+ DS_FREE*blk; //free blocks of one size class, unordered
+ NAT nr,cap;
+};
+
+struct DS_IO
+{
+ NAT rec,stb,bcnt; //record, first byte, byte count (0: to its end), as for Get/Put
+ BYTE*buf;
+ NAT done; //bytes read/written, 0: invalid record or range
+ void*user;
+};
+typedef void (*DS_DONE)(DS_IO*,void*); //GetMany/PutMany report each piece done
+
+struct DS_RANGE
+{
+ void*va; //WIN32_MEMORY_RANGE_ENTRY
+ SIZE_T sz;
+};
+typedef BOOL (WINAPI*DS_PREFETCHVM)(HANDLE,ULONG_PTR,DS_RANGE*,ULONG);
+
 ///////////////////////////////////////////////////////////////////////////////////////////
 class DataSet
 {
@@ -9,135 +70,595 @@ public:
  DWORD Tip; //LOW: Id-0x5344="DS", HIW: 0-uncompresed
  NAT NrRec; //Number of data records in set
  NAT Rec,RecOf,RecSz; //curent record info: nr, offset(from begin), size(in B)
- 
- int Bind(LPSTR,WORD); //0=Ok
+ DS_REC*RecTab; //records 0..NrRec (0: the header link)
+ NAT RecCap; //allocated RecTab items (ArrayCap)
+ NAT IxOf; //offset of the index block at the end of the file, 0=none
+ BOOL IxDirty; //RecTab differs from the saved index
+ LPSTR Path; //bound file
+ DWORD Flags; //DS_SYNC
+ BYTE*Map; //read/write view of the file
+ NAT MapSz; //view size (the file is as big while bound)
+ NAT DataEnd; //end of the last block, new blocks go here when no free one fits
+ HANDLE hWAL; //the log
+ BOOL Bound; //Bind() succeeded: Close() saves the view and the index, else it leaves the file alone
+ DS_CLASS FreeCls[DS_NRCLASS]; //free blocks by size class
+
+ DataSet() { ZEROCLASS(DataSet); hDSFile=hWAL=INVALID_HANDLE_VALUE; }
+ ~DataSet() { Bind(NULL,0,0); }
+ DWORD& Fld(NAT of) { return *(DWORD*)(Map+of); } //link or size field in the view
+ NAT Size(NAT rec) { return MIN(Fld(RecTab[rec].of+4),RecTab[rec].room); } //the size on disk: an old reader may have cut it in place
+ int Bind(LPSTR,WORD,DWORD); //0=Ok
+ int Flush();
+ int Compact();
  int Open(NAT,NAT); //must use before any valid get/put (valid records are 1..NrRec)
  int Ins(NAT,NAT); //use Open after
  int Del(NAT); //use Open after
  int Put(BYTE*,NAT,NAT);
  int Get(BYTE*,NAT,NAT);
+ NAT GetMany(DS_IO*,NAT,DS_DONE,void*);
+ NAT PutMany(DS_IO*,NAT,DS_DONE,void*);
+ NAT Many(DS_IO*,NAT,BOOL,DS_DONE,void*);
+ NAT Append(NAT,NAT*);
+ BOOL LoadIndex();
+ BOOL BuildIndex(NAT);
+ BOOL FindFree();
+ int SaveIndex();
+ void Close();
+ void Touch();
+ BOOL Remap(NAT);
+ void Unmap();
+ BOOL Replay();
+ void Log(DWORD*,NAT);
+ void Checkpoint();
+ NAT Alloc(NAT,NAT*);
+ void Release(NAT,NAT);
+ BOOL TabIns(NAT);
 };
 ///////////////////////////////////////////////////////////////////////////////////////////
 
 // Data Set <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
-int DataSet::Bind(LPSTR dfname=NULL,WORD comp=0)
+//positioned read (wr=0) or write of n bytes at file offset of, returns the bytes done ...............
+NAT DataSetIO(HANDLE hf,NAT of,void*buf,NAT n,BOOL wr=0)
 {
-if(hDSFile!=INVALID_HANDLE_VALUE) CloseHandle(hDSFile);
-hDSFile=INVALID_HANDLE_VALUE;
-Rec=0;
-NrRec=0;
+DWORD done=0;
+OVERLAPPED ov;
+ZeroMemory(&ov,sizeof(ov));
+ov.Offset=of;
+if(wr)
+ WriteFile(hf,buf,n,&done,&ov);
+else
+ ReadFile(hf,buf,n,&done,&ov);
+return done;
+}
+
+//checksum of a saved index ...........................................................................
+inline DWORD DataSetSum(DS_REC*tab,NAT n)
+{
+DWORD sum=n;
+for(NAT i=0;i<=n;i++)
+ sum=(sum<<5|sum>>27)^tab[i].of^(tab[i].sz*0x9E3779B1);
+return sum;
+}
+
+//checksum of a log record (n DWORDs from its count on) ..................................................
+inline DWORD DataSetLogSum(DWORD*rec,NAT n)
+{
+DWORD sum=DS_WALID;
+for(NAT i=0;i<n;i++)
+ sum=(sum<<5|sum>>27)^(rec[i]*0x9E3779B1);
+return sum;
+}
+
+//log file name: file.wal (SALLOC-ed) ....................................................................
+inline LPSTR DataSetLogName(LPSTR path)
+{
+LPSTR wal=SALLOC(strlen(path)+4);
+if(wal)
+ {
+ strcpy(wal,path);
+ strcat(wal,".wal");
+ }
+return wal;
+}
+
+//free size class of a block: floor(log2(len)) ...........................................................
+inline NAT DataSetClass(NAT len)
+{
+NAT c=0;
+while(len>>(c+1))
+ c++;
+return c;
+}
+
+//loads the index block if it is the tail of the file and matches the header ..........................
+BOOL DataSet::LoadIndex()
+{
+DWORD trail[2],hd[2],sum;
+NAT fsz=GetFileSize(hDSFile,NULL),ixsz=(NrRec+1)*sizeof(DS_REC);
+if(fsz<12+8+12) return 0;
+if(DataSetIO(hDSFile,fsz-8,trail,8)!=8||trail[1]!=DS_IXID) return 0;
+IxOf=trail[0];
+if(IxOf<12||IxOf+8+ixsz+12!=fsz) return 0;
+if(DataSetIO(hDSFile,IxOf,hd,8)!=8||hd[0]!=DS_IXID||hd[1]!=NrRec) return 0;
+if(DataSetIO(hDSFile,IxOf+8,RecTab,ixsz)!=ixsz) return 0;
+if(DataSetIO(hDSFile,fsz-12,&sum,4)!=4||sum!=DataSetSum(RecTab,NrRec)) return 0;
+return RecTab[0].of==8;
+}
+
+//walks the record chain once in the view (files without a valid index) .................................
+BOOL DataSet::BuildIndex(NAT fsz)
+{
+NAT of=Fld(8);
+RecTab[0].of=8;
+RecTab[0].sz=RecTab[0].room=0;
+for(NAT i=1;i<=NrRec;i++)
+ {
+ if(fsz<16||of<12||of>fsz-16||Fld(of+4)>fsz-16-of) return 0; //broken chain
+ RecTab[i].of=of;
+ RecTab[i].sz=Fld(of+4);
+ of=Fld(of);
+ }
+return 1;
+}
+
+//orders 0..n-1 by key[] (radix sort, a byte a pass), tmp: n items ..............................................
+void DataSetOrder(NAT*key,NAT*ord,NAT*tmp,NAT n)
+{
+NAT i,k,c,sh,cnt[256],*t;
+for(i=0;i<n;i++)
+ ord[i]=i;
+for(sh=0;sh<32;sh+=8)
+ {
+ ZeroMemory(cnt,sizeof(cnt));
+ for(i=0;i<n;i++)
+  cnt[key[ord[i]]>>sh&0xff]++;
+ for(i=0,k=0;i<256;i++)
+  {
+  c=cnt[i];
+  cnt[i]=k;
+  k+=c;
+  }
+ for(i=0;i<n;i++)
+  tmp[cnt[key[ord[i]]>>sh&0xff]++]=ord[i];
+ t=ord; //4 passes: ends in ord
+ ord=tmp;
+ tmp=t;
+ }
+}
+
+//free space: the gaps between the records in file order, also sets their room and DataEnd ..............
+BOOL DataSet::FindFree()
+{
+NAT i,k,end=12,n=NrRec;
+NAT*key;
+for(i=0;i<DS_NRCLASS;i++)
+ FreeCls[i].nr=0;
+DataEnd=12;
+if(!n) return 1;
+key=(NAT*)ALLOC(3*n*sizeof(NAT));
+if(!key) return 0;
+for(i=0;i<n;i++)
+ key[i]=RecTab[i+1].of;
+DataSetOrder(key,key+n,key+2*n,n);
+DataEnd=0xffffffff; //Release() mustn't cut the end yet
+for(i=0;i<n;i++)
+ {
+ DS_REC*r=RecTab+key[n+i]+1;
+ if(r->of>end) Release(end,r->of-end);
+ k=i+1<n?key[key[n+i+1]]:r->of+16+r->sz; //its block ends where the next one begins
+ r->room=k>=r->of+16+r->sz?k-r->of-16:r->sz; //overlapping records (broken file): no room
+ end=MAX(end,r->of+16+r->room);
+ }
+DataEnd=end;
+FREE(key);
+return 1;
+}
+
+//maps need bytes of the file, a growing view takes 1/4 more (the file grows with it) ...................
+BOOL DataSet::Remap(NAT need)
+{
+if(Map&&need<=MapSz) return 1;
+QWORD sz=need;
+if(Map)
+ {
+ sz=MAX(sz,(QWORD)MapSz+MapSz/4);
+ sz=MIN((sz+DS_MAPSTEP-1)&~(QWORD)(DS_MAPSTEP-1),(QWORD)0xffffffff);
+ }
+HANDLE hm=CreateFileMapping(hDSFile,NULL,PAGE_READWRITE,0,(DWORD)sz,NULL);
+if(!hm) return 0;
+BYTE*map=(BYTE*)MapViewOfFile(hm,FILE_MAP_WRITE,0,0,(SIZE_T)sz);
+CloseHandle(hm); //the view keeps the mapping open
+if(!map) return 0; //the old view stays
+Unmap();
+Map=map;
+MapSz=(NAT)sz;
+return 1;
+}
+
+void DataSet::Unmap()
+{
+if(Map) UnmapViewOfFile(Map);
+Map=NULL;
+MapSz=0;
+}
+
+//redoes the last change if a crashed session left it in the log, returns 0 if there was none ..........
+BOOL DataSet::Replay()
+{
+DWORD rec[3+2*DS_LOGMAX];
+NAT i,n=0,sz=DataSetIO(hWAL,0,rec,sizeof(rec));
+if(sz>=12&&rec[0]==DS_WALID&&rec[1]<=DS_LOGMAX&&sz>=(3+2*rec[1])*4&&rec[2+2*rec[1]]==DataSetLogSum(rec+1,1+2*rec[1]))
+ {
+ n=rec[1];
+ for(i=0;i<n;i++)
+  DataSetIO(hDSFile,rec[2+2*i],rec+3+2*i,4,1);
+ FlushFileBuffers(hDSFile);
+ }
+SetFilePointer(hWAL,0,NULL,FILE_BEGIN);
+SetEndOfFile(hWAL);
+return n!=0;
+}
+
+//logs n {offset,value} header/link changes over the last ones, then makes them in the view .................
+void DataSet::Log(DWORD*fv,NAT n)
+{
+DWORD rec[3+2*DS_LOGMAX];
+if(Flags&DS_SYNC) Checkpoint(); //the changes before (and the data of a moved record) are on the disk
+rec[0]=DS_WALID;
+rec[1]=n;
+CopyMemory(rec+2,fv,n*8);
+rec[2+2*n]=DataSetLogSum(rec+1,1+2*n);
+DataSetIO(hWAL,0,rec,(3+2*n)*4,1);
+if(Flags&DS_SYNC) FlushFileBuffers(hWAL);
+for(NAT i=0;i<n;i++)
+ Fld(fv[2*i])=fv[2*i+1];
+}
+
+//the view reaches the disk ...........................................................................
+void DataSet::Checkpoint()
+{
+if(Map) FlushViewOfFile(Map,0);
+FlushFileBuffers(hDSFile);
+}
+
+//a block for size data bytes: a free one (split when much bigger) or at the end, returns 0 if none ......
+NAT DataSet::Alloc(NAT size,NAT*room)
+{
+NAT len=size+16,of,blen,i,c;
+if(len<size) return 0;
+for(c=DataSetClass(len);c<DS_NRCLASS;c++)
+ {
+ DS_CLASS*fc=FreeCls+c;
+ for(i=0;i<fc->nr;i++) //in the classes above the first fits
+  if(fc->blk[i].len>=len)
+   {
+   of=fc->blk[i].of;
+   blen=fc->blk[i].len;
+   fc->blk[i]=fc->blk[--fc->nr];
+   if(blen-len>=DS_MINBLK)
+    Release(of+len,blen-len);
+   else
+    len=blen;
+   *room=len-16;
+   return of;
+   }
+ }
+if(len>~DataEnd||!Remap(DataEnd+len)) return 0; //file full or no view
+of=DataEnd;
+DataEnd+=len;
+*room=size;
+return of;
+}
+
+//gives a block back: cuts the end, or goes to the free list of its size class .............................
+void DataSet::Release(NAT of,NAT len)
+{
+if(of+len==DataEnd)
+ {
+ DataEnd=of;
+ return;
+ }
+if(len<DS_MINBLK) return; //left to Compact()
+DS_CLASS*fc=FreeCls+DataSetClass(len);
+if(!ArrayCap((void**)&fc->blk,&fc->cap,fc->nr+1,sizeof(DS_FREE))) return; //lost until Compact()
+fc->blk[fc->nr].of=of;
+fc->blk[fc->nr].len=len;
+fc->nr++;
+}
+
+int DataSet::Bind(LPSTR dfname=NULL,WORD comp=0,DWORD flags=0)
+{
+DWORD hd[3];
+NAT fsz;
+BOOL fresh=0;
+LPSTR wal;
+if(hDSFile!=INVALID_HANDLE_VALUE) Close();
 if(!dfname) return 1; //unbind successful
+Path=SALLOC(strlen(dfname));
+wal=DataSetLogName(dfname);
+if(!Path||!wal)
+ {
+ FREE(wal);
+ Close();
+ return 3;
+ }
+strcpy(Path,dfname);
+Flags=flags;
+Bound=0;
 hDSFile=CreateFile(dfname,GENERIC_READ|GENERIC_WRITE,FILE_SHARE_READ|FILE_SHARE_WRITE,NULL,OPEN_EXISTING,0,NULL);
 if(hDSFile==INVALID_HANDLE_VALUE) //create
  {
  hDSFile=CreateFile(dfname,GENERIC_READ|GENERIC_WRITE,FILE_SHARE_READ|FILE_SHARE_WRITE,NULL,CREATE_NEW,0,NULL);
- if(hDSFile==INVALID_HANDLE_VALUE) return 2; //unable to bind to file (invalid name ?)
- Tip=(comp<<16)|0x5344;
- RecOf=12;
- WriteFile(hDSFile,&Tip,4,(DWORD*)&RecSz,NULL);
- WriteFile(hDSFile,&NrRec,4,(DWORD*)&RecSz,NULL);
- WriteFile(hDSFile,&RecOf,4,(DWORD*)&RecSz,NULL);
+ if(hDSFile==INVALID_HANDLE_VALUE) //unable to bind to file (invalid name ?)
+  {
+  FREE(wal);
+  Close();
+  return 2;
+  }
+ Tip=(comp<<16)|DS_ID;
+ hd[0]=Tip;
+ hd[1]=0;
+ hd[2]=12;
+ DataSetIO(hDSFile,0,hd,12,1);
+ fresh=1;
+ }
+if(DataSetIO(hDSFile,0,hd,12)!=12||(hd[0]&0xffff)!=DS_ID) //not a data set: no log is replayed into it
+ {
+ FREE(wal);
+ Close();
+ return 2;
+ }
+hWAL=CreateFile(wal,GENERIC_READ|GENERIC_WRITE,FILE_SHARE_READ,NULL,OPEN_ALWAYS,0,NULL); //one writer
+FREE(wal);
+if(hWAL==INVALID_HANDLE_VALUE)
+ {
+ Close();
+ return 2; //can't log, or the set is bound elsewhere
+ }
+if(fresh) //a log left by a removed file isn't ours
+ {
+ SetFilePointer(hWAL,0,NULL,FILE_BEGIN);
+ SetEndOfFile(hWAL);
+ }
+else if((fresh=Replay())) //the saved index is stale then, and the header may have changed
+ if(DataSetIO(hDSFile,0,hd,12)!=12)
+  {
+  Close();
+  return 2;
+  }
+Tip=hd[0];
+NrRec=hd[1];
+fsz=GetFileSize(hDSFile,NULL);
+if(!ArrayCap((void**)&RecTab,&RecCap,NrRec+1,sizeof(DS_REC),1)||!Remap(fsz))
+ {
+ Close();
+ return 3; //no memory for the index or the view
  }
-else //open
+if(fresh||!LoadIndex())
  {
- ReadFile(hDSFile,&Tip,4,(DWORD*)&RecSz,NULL);
- ReadFile(hDSFile,&NrRec,4,(DWORD*)&RecSz,NULL);
- ReadFile(hDSFile,&RecOf,4,(DWORD*)&RecSz,NULL);
- if(Tip&0xffff!=0x5344) return 2; //not a data set
+ IxOf=0; //not (or no longer) an index: Touch() mustn't clear it
+ if(!BuildIndex(fsz))
+  {
+  Close();
+  return 2; //broken record chain
+  }
+ IxDirty=1; //saved on Flush()/unbind, the next Bind() won't walk again
+ }
+if(!FindFree())
+ {
+ Close();
+ return 3;
  }
+Bound=1;
+RecOf=8;
 return 0; //Ok
 }
 
+//saves the changes and the index: the view reaches the disk ...................................................
+int DataSet::Flush()
+{
+if(!Map) return 1;
+Checkpoint();
+if(!IxDirty) return 0;
+int r=SaveIndex();
+if(!Remap(GetFileSize(hDSFile,NULL)))
+ {
+ Close();
+ return 3; //lost the view
+ }
+return r;
+}
+
+//drops the view, cuts its slack off the file and saves the index after the records .....................
+int DataSet::SaveIndex()
+{
+DWORD hd[2],tail[3];
+NAT ixsz=(NrRec+1)*sizeof(DS_REC);
+Unmap();
+if(!IxDirty&&IxOf==DataEnd) //still there
+ {
+ SetFilePointer(hDSFile,IxOf+8+ixsz+12,NULL,FILE_BEGIN);
+ SetEndOfFile(hDSFile);
+ return 0;
+ }
+SetFilePointer(hDSFile,DataEnd,NULL,FILE_BEGIN);
+SetEndOfFile(hDSFile);
+IxOf=DataEnd;
+hd[0]=DS_IXID;
+hd[1]=NrRec;
+tail[0]=DataSetSum(RecTab,NrRec);
+tail[1]=IxOf;
+tail[2]=DS_IXID;
+if(DataSetIO(hDSFile,IxOf,hd,8,1)!=8||DataSetIO(hDSFile,IxOf+8,RecTab,ixsz,1)!=ixsz||DataSetIO(hDSFile,IxOf+8+ixsz,tail,12,1)!=12)
+ {
+ SetFilePointer(hDSFile,DataEnd,NULL,FILE_BEGIN); //don't leave half an index
+ SetEndOfFile(hDSFile);
+ IxOf=0;
+ return 2;
+ }
+IxDirty=0;
+return 0;
+}
+
+//unbinds: saves, closes and removes the log; after a failed Bind() only closes (the file stays as found) ...
+void DataSet::Close()
+{
+LPSTR wal;
+if(Map&&Bound)
+ {
+ Checkpoint();
+ SaveIndex();
+ }
+Unmap();
+if(hDSFile!=INVALID_HANDLE_VALUE) CloseHandle(hDSFile);
+if(hWAL!=INVALID_HANDLE_VALUE)
+ {
+ if(Bound)
+  {
+  SetFilePointer(hWAL,0,NULL,FILE_BEGIN); //nothing to redo, even if it can't be removed
+  SetEndOfFile(hWAL);
+  }
+ BOOL empty=!GetFileSize(hWAL,NULL); //a failed Bind() keeps a crashed session's log
+ CloseHandle(hWAL);
+ wal=empty?DataSetLogName(Path):NULL;
+ if(wal) DeleteFile(wal);
+ FREE(wal);
+ }
+hDSFile=hWAL=INVALID_HANDLE_VALUE;
+Bound=0;
+for(NAT c=0;c<DS_NRCLASS;c++)
+ {
+ FREE(FreeCls[c].blk);
+ FreeCls[c].nr=FreeCls[c].cap=0;
+ }
+FREE(Path);
+FREE(RecTab);
+RecCap=0;
+Rec=0;
+NrRec=0;
+IxOf=0;
+IxDirty=0;
+DataEnd=0;
+}
+
+//before changing the file: drops the saved index (the records end where it began) ............................
+void DataSet::Touch()
+{
+if(IxOf)
+ {
+ Fld(IxOf)=0; //no longer an index, even if the session crashes
+ IxOf=0;
+ }
+IxDirty=1;
+}
+
+//table item for a record inserted at recpos .............................................................
+BOOL DataSet::TabIns(NAT recpos)
+{
+if(!ArrayCap((void**)&RecTab,&RecCap,NrRec+2,sizeof(DS_REC))) return 0;
+ShiftMemR(RecTab+recpos,sizeof(DS_REC),(NrRec+1-recpos)*sizeof(DS_REC));
+return 1;
+}
+
 int DataSet::Open(NAT recpos=0,NAT newsize=0)
 {
+DWORD fv[8];
+NAT of,room;
+if(!Map) return 2;
 if(recpos>NrRec) //create
  {
  if(newsize==0) return 2; //can't create
- Open(NrRec);
- recpos=SetFilePointer(hDSFile,0,NULL,FILE_END);
- SetFilePointer(hDSFile,RecOf,NULL,FILE_BEGIN);
- WriteFile(hDSFile,&recpos,4,(DWORD*)&RecSz,NULL);
- RecOf=SetFilePointer(hDSFile,recpos,NULL,FILE_BEGIN);
- RecSz=0;
- WriteFile(hDSFile,&RecSz,4,(DWORD*)&recpos,NULL);
- RecSz=newsize;
- WriteFile(hDSFile,&RecSz,4,(DWORD*)&recpos,NULL);
- SetFilePointer(hDSFile,RecSz+7,NULL,FILE_CURRENT);
- WriteFile(hDSFile,&RecSz,1,(DWORD*)&recpos,NULL);
+ Touch();
+ if(!(of=Alloc(newsize,&room))) return 2;
+ if(!TabIns(NrRec+1))
+  {
+  Release(of,room+16);
+  return 2;
+  }
+ ZeroMemory(Map+of+8,newsize);
+ fv[0]=of; fv[1]=0;
+ fv[2]=of+4; fv[3]=newsize;
+ fv[4]=RecTab[NrRec].of; fv[5]=of; //link from the last record
+ fv[6]=4; fv[7]=NrRec+1;
+ Log(fv,4);
  NrRec++;
- SetFilePointer(hDSFile,4,NULL,FILE_BEGIN);
- WriteFile(hDSFile,&NrRec,4,(DWORD*)&recpos,NULL);
+ RecTab[NrRec].of=of;
+ RecTab[NrRec].sz=newsize;
+ RecTab[NrRec].room=room;
  Rec=NrRec;
+ RecOf=of;
+ RecSz=newsize;
+ return 0;
  }
-else //open
+Rec=recpos;
+RecOf=RecTab[recpos].of;
+if(recpos==0) return 1; //get/put will fail
+RecSz=Size(recpos);
+RecTab[recpos].sz=RecSz;
+if(newsize==0||newsize==RecSz) return 0;
+Touch();
+if(newsize<=RecTab[recpos].room) //downsize, or grow in its block
  {
- Rec=0;
- RecOf=8;
- while(Rec<recpos)
-  {
-  SetFilePointer(hDSFile,RecOf,NULL,FILE_BEGIN);
-  ReadFile(hDSFile,&RecOf,4,(DWORD*)&RecSz,NULL);
-  Rec++;
-  }
- if(recpos==0) return 1; //get/put will fail
- SetFilePointer(hDSFile,RecOf+4,NULL,FILE_BEGIN);
- ReadFile(hDSFile,&RecSz,4,(DWORD*)&recpos,NULL);
- if(newsize==0||newsize==RecSz)
-  return 0;
- else if(newsize<RecSz) //downsize
-  {
-  RecSz=newsize;
-  SetFilePointer(hDSFile,RecOf+4,NULL,FILE_BEGIN);
-  WriteFile(hDSFile,&RecSz,4,(DWORD*)&recpos,NULL);
-  }
- else if(newsize>RecSz) //resize
-  {
-  recpos=Rec;
-  Del(recpos);
-  if(recpos<=NrRec)
-   {
-   Ins(recpos,newsize);
-   Open(recpos);
-   }
-  else Open(recpos,newsize);
-  }
+ if(newsize>RecSz) ZeroMemory(Map+RecOf+8+RecSz,newsize-RecSz);
+ fv[0]=RecOf+4; fv[1]=newsize;
+ Log(fv,1);
  }
+else //moves to a bigger block with its data
+ {
+ if(!(of=Alloc(newsize,&room))) return 2;
+ CopyMemory(Map+of+8,Map+RecOf+8,RecSz);
+ ZeroMemory(Map+of+8+RecSz,newsize-RecSz);
+ fv[0]=of; fv[1]=Fld(RecOf);
+ fv[2]=of+4; fv[3]=newsize;
+ fv[4]=RecTab[recpos-1].of; fv[5]=of;
+ Log(fv,3);
+ Release(RecOf,RecTab[recpos].room+16);
+ RecTab[recpos].of=RecOf=of;
+ RecTab[recpos].room=room;
+ }
+RecTab[recpos].sz=RecSz=newsize;
 return 0; //can get/put
 }
 
 int DataSet::Ins(NAT recpos,NAT newsize)
 {
+DWORD fv[8];
+NAT of,room;
 if(recpos==0||recpos>NrRec||newsize==0) return 1;
-Open(recpos-1);
-SetFilePointer(hDSFile,RecOf,NULL,FILE_BEGIN);
-ReadFile(hDSFile,&Rec,4,(DWORD*)&RecSz,NULL);
-recpos=SetFilePointer(hDSFile,0,NULL,FILE_END);
-WriteFile(hDSFile,&Rec,4,(DWORD*)&RecSz,NULL);
-WriteFile(hDSFile,&newsize,4,(DWORD*)&RecSz,NULL);
-SetFilePointer(hDSFile,newsize+7,NULL,FILE_CURRENT);
-WriteFile(hDSFile,&newsize,1,(DWORD*)&RecSz,NULL);
-SetFilePointer(hDSFile,RecOf,NULL,FILE_BEGIN);
-WriteFile(hDSFile,&recpos,4,(DWORD*)&RecSz,NULL);
+Touch();
+if(!(of=Alloc(newsize,&room))) return 1;
+if(!TabIns(recpos))
+ {
+ Release(of,room+16);
+ return 1;
+ }
+ZeroMemory(Map+of+8,newsize);
+fv[0]=of; fv[1]=RecTab[recpos+1].of; //links to the record it moves up
+fv[2]=of+4; fv[3]=newsize;
+fv[4]=RecTab[recpos-1].of; fv[5]=of;
+fv[6]=4; fv[7]=NrRec+1;
+Log(fv,4);
+RecTab[recpos].of=of;
+RecTab[recpos].sz=newsize;
+RecTab[recpos].room=room;
 NrRec++;
-SetFilePointer(hDSFile,4,NULL,FILE_BEGIN);
-WriteFile(hDSFile,&NrRec,4,(DWORD*)&Rec,NULL);
-Open();
+Open(0,0);
 return 0;
 }
 
 int DataSet::Del(NAT recpos)
 {
+DWORD fv[4];
 if(recpos==0||recpos>NrRec) return 1; //doesn't exist
-Open(recpos);
-SetFilePointer(hDSFile,RecOf,NULL,FILE_BEGIN);
-ReadFile(hDSFile,&recpos,4,(DWORD*)&RecSz,NULL);
-Open(Rec-1);
-SetFilePointer(hDSFile,RecOf,NULL,FILE_BEGIN);
-WriteFile(hDSFile,&recpos,4,(DWORD*)&RecSz,NULL);
+Touch();
+fv[0]=RecTab[recpos-1].of; fv[1]=Fld(RecTab[recpos].of); //unlink it
+fv[2]=4; fv[3]=NrRec-1;
+Log(fv,2);
+Release(RecTab[recpos].of,RecTab[recpos].room+16);
+ShiftMemL(RecTab+recpos+1,sizeof(DS_REC),(NrRec-recpos)*sizeof(DS_REC));
 NrRec--;
-SetFilePointer(hDSFile,4,NULL,FILE_BEGIN);
-WriteFile(hDSFile,&NrRec,4,(DWORD*)&recpos,NULL);
-Open();
+ArrayCap((void**)&RecTab,&RecCap,NrRec+1,sizeof(DS_REC));
+Open(0,0);
 return 0;
 }
 
@@ -146,9 +667,8 @@ int DataSet::Get(BYTE*recbuf,NAT stb=0,NAT bcnt=0)
 if(Rec==0||Rec>NrRec) return 0; //invalid record
 if(stb>=RecSz) return 0; //out of range
 if(bcnt==0||stb+bcnt>RecSz) bcnt=RecSz-stb;
-SetFilePointer(hDSFile,RecOf+8+stb,NULL,FILE_BEGIN);
-ReadFile(hDSFile,recbuf,bcnt,(DWORD*)&stb,NULL);
-return stb; //actual bytes read
+CopyMemory(recbuf,Map+RecOf+8+stb,bcnt);
+return bcnt; //actual bytes read
 }
 
 int DataSet::Put(BYTE*recbuf,NAT stb=0,NAT bcnt=0)
@@ -156,9 +676,197 @@ int DataSet::Put(BYTE*recbuf,NAT stb=0,NAT bcnt=0)
 if(Rec==0||Rec>NrRec) return 0; //invalid record
 if(stb>=RecSz) return 0; //out of range
 if(bcnt==0||stb+bcnt>RecSz) bcnt=RecSz-stb;
-SetFilePointer(hDSFile,RecOf+8+stb,NULL,FILE_BEGIN);
-WriteFile(hDSFile,recbuf,bcnt,(DWORD*)&stb,NULL);
-return stb; //actual bytes read
+CopyMemory(Map+RecOf+8+stb,recbuf,bcnt);
+return bcnt; //actual bytes written
+}
+
+//asks for the pages of n ranges of the view in one request (PrefetchVirtualMemory, Windows 8 on) .........
+void DataSetPrefetch(DS_RANGE*rng,NAT n)
+{
+static DS_PREFETCHVM prefetch=(DS_PREFETCHVM)GetProcAddress(GetModuleHandleA("kernel32.dll"),"PrefetchVirtualMemory");
+if(prefetch&&n) prefetch(GetCurrentProcess(),n,rng,0);
+}
+
+//reads (wr=0) or writes n pieces {rec,stb,bcnt,buf}: in file order, the merged ranges are fetched with one
+//vectored request first; fn(req,ctx) reports each piece (also the invalid ones), returns the pieces done .....
+NAT DataSet::Many(DS_IO*req,NAT n,BOOL wr,DS_DONE fn,void*ctx)
+{
+NAT i,of,sz,nrok=0,nrng=0,*key,*ord;
+DS_RANGE*rng;
+DS_IO*r;
+if(!n) return 0;
+key=(NAT*)ALLOC(3*n*sizeof(NAT)+n*sizeof(DS_RANGE));
+if(!key) return 0;
+ord=key+n;
+rng=(DS_RANGE*)(key+3*n);
+for(i=0;i<n;i++)
+ {
+ r=req+i;
+ r->done=0;
+ key[i]=0xffffffff; //invalid: last
+ if(r->rec==0||r->rec>NrRec||!Map) continue;
+ sz=Size(r->rec);
+ if(r->stb>=sz) continue;
+ r->done=r->bcnt==0||r->stb+r->bcnt>sz?sz-r->stb:r->bcnt; //length until done
+ key[i]=RecTab[r->rec].of+8+r->stb;
+ }
+DataSetOrder(key,ord,key+2*n,n);
+for(i=0;i<n&&key[ord[i]]!=0xffffffff;i++) //merge the ranges
+ {
+ of=key[ord[i]];
+ if(nrng&&of<=(NAT)((BYTE*)rng[nrng-1].va-Map+rng[nrng-1].sz)+DS_GAPMAX)
+  rng[nrng-1].sz=MAX(rng[nrng-1].sz,(SIZE_T)(of+req[ord[i]].done-((BYTE*)rng[nrng-1].va-Map)));
+ else
+  {
+  rng[nrng].va=Map+of;
+  rng[nrng++].sz=req[ord[i]].done;
+  }
+ }
+DataSetPrefetch(rng,nrng);
+for(i=0;i<n;i++)
+ {
+ r=req+ord[i];
+ if(r->done)
+  {
+  if(wr)
+   CopyMemory(Map+key[ord[i]],r->buf,r->done);
+  else
+   CopyMemory(r->buf,Map+key[ord[i]],r->done);
+  nrok++;
+  }
+ if(fn) fn(r,ctx);
+ }
+FREE(key);
+return nrok;
+}
+
+NAT DataSet::GetMany(DS_IO*req,NAT n,DS_DONE fn=NULL,void*ctx=NULL)
+{
+return Many(req,n,0,fn,ctx);
+}
+
+NAT DataSet::PutMany(DS_IO*req,NAT n,DS_DONE fn=NULL,void*ctx=NULL)
+{
+return Many(req,n,1,fn,ctx);
+}
+
+//adds nr records of sizes[] at the end with one logged change (bulk import), returns the first one, 0=failed .
+NAT DataSet::Append(NAT nr,NAT*sizes)
+{
+DWORD fv[4];
+NAT i,of,room,first=NrRec+1;
+if(!Map||!nr) return 0;
+if(!ArrayCap((void**)&RecTab,&RecCap,NrRec+1+nr,sizeof(DS_REC))) return 0;
+Touch();
+for(i=0;i<nr;i++) //chained to each other, the set links to them at the end
+ {
+ if(sizes[i]==0||!(of=Alloc(sizes[i],&room))) break;
+ Fld(of)=0;
+ Fld(of+4)=sizes[i];
+ ZeroMemory(Map+of+8,sizes[i]);
+ if(i) Fld(RecTab[NrRec+i].of)=of;
+ RecTab[NrRec+1+i].of=of;
+ RecTab[NrRec+1+i].sz=sizes[i];
+ RecTab[NrRec+1+i].room=room;
+ }
+if(i<nr) //no space (or a 0 size): gives back what it took
+ {
+ while(i--)
+  Release(RecTab[NrRec+1+i].of,RecTab[NrRec+1+i].room+16);
+ return 0;
+ }
+fv[0]=RecTab[NrRec].of; fv[1]=RecTab[first].of;
+fv[2]=4; fv[3]=NrRec+nr;
+Log(fv,2);
+NrRec+=nr;
+Open(first,0);
+return first;
+}
+
+//buffered sequential write for Compact(), n=0 writes out the buffer ......................................
+BOOL DataSetOut(HANDLE hf,BYTE*buf,NAT*bn,void*src,NAT n)
+{
+DWORD done;
+if(*bn&&(!n||*bn+n>DS_CMPBUF))
+ {
+ if(!WriteFile(hf,buf,*bn,&done,NULL)||done!=*bn) return 0;
+ *bn=0;
+ }
+if(n>=DS_CMPBUF) return WriteFile(hf,src,n,&done,NULL)&&done==n;
+CopyMemory(buf+*bn,src,n);
+*bn+=n;
+return 1;
+}
+
+//rewrites the file without gaps, records in order, and binds it again (0=Ok) ..............................
+int DataSet::Compact()
+{
+HANDLE hf;
+LPSTR tmp,path;
+DWORD hd[3],tail[3],spare[2]={0,0},flags=Flags;
+BYTE*buf;
+DS_REC*tab;
+NAT i,of=12,bn=0,n=NrRec;
+BOOL ok=1;
+if(!Map) return 1;
+path=SALLOC(strlen(Path));
+tmp=SALLOC(strlen(Path)+4);
+buf=(BYTE*)ALLOC(DS_CMPBUF);
+tab=(DS_REC*)ALLOC((n+1)*sizeof(DS_REC));
+if(!path||!tmp||!buf||!tab)
+ {
+ FREE(path);
+ FREE(tmp);
+ FREE(buf);
+ FREE(tab);
+ return 3;
+ }
+strcpy(path,Path);
+strcpy(tmp,Path);
+strcat(tmp,".cmp");
+tab[0].of=8;
+tab[0].sz=tab[0].room=0;
+for(i=1;i<=n;i++)
+ {
+ tab[i].of=of;
+ tab[i].sz=tab[i].room=Size(i);
+ of+=16+tab[i].sz;
+ }
+hf=CreateFile(tmp,GENERIC_READ|GENERIC_WRITE,0,NULL,CREATE_ALWAYS,FILE_FLAG_SEQUENTIAL_SCAN,NULL);
+if(hf==INVALID_HANDLE_VALUE) ok=0;
+hd[0]=Tip;
+hd[1]=n;
+hd[2]=12;
+if(ok) ok=DataSetOut(hf,buf,&bn,hd,12);
+for(i=1;i<=n&&ok;i++)
+ {
+ hd[0]=i<n?tab[i+1].of:0;
+ hd[1]=tab[i].sz;
+ ok=DataSetOut(hf,buf,&bn,hd,8)&&DataSetOut(hf,buf,&bn,Map+RecTab[i].of+8,tab[i].sz)&&DataSetOut(hf,buf,&bn,spare,8);
+ }
+hd[0]=DS_IXID;
+hd[1]=n;
+tail[0]=DataSetSum(tab,n);
+tail[1]=of;
+tail[2]=DS_IXID;
+if(ok) ok=DataSetOut(hf,buf,&bn,hd,8)&&DataSetOut(hf,buf,&bn,tab,(n+1)*sizeof(DS_REC))&&DataSetOut(hf,buf,&bn,tail,12)&&DataSetOut(hf,buf,&bn,NULL,0);
+if(ok) ok=FlushFileBuffers(hf);
+if(hf!=INVALID_HANDLE_VALUE) CloseHandle(hf);
+FREE(buf);
+FREE(tab);
+if(!ok)
+ {
+ DeleteFile(tmp);
+ FREE(tmp);
+ FREE(path);
+ return 2; //can't write the copy, the set is as it was
+ }
+Close();
+ok=MoveFileEx(tmp,path,MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH);
+int r=Bind(path,0,flags);
+FREE(tmp);
+FREE(path);
+return r?r:ok?0:4; //4: can't replace the file, bound to the old one
 }
 // DataSet >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
@@ -178,7 +886,14 @@ else
   return 2; //invalid destination
  }
 BYTE *recbuf;
-NAT rec;
+NAT rec,*sizes=(NAT*)ALLOC((sds.NrRec+1)*sizeof(NAT));
+if(sizes&&!dds.NrRec) //one logged change for all
+ {
+ for(rec=1;rec<=sds.NrRec;rec++)
+  sizes[rec-1]=sds.Size(rec);
+ dds.Append(sds.NrRec,sizes);
+ }
+FREE(sizes);
 for(rec=1;rec<=sds.NrRec;rec++)
  {
  sds.Open(rec);
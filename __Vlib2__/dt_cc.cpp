@@ -1,5 +1,6 @@
 #pragma once
 
+#include <hash.cpp> //before sha-1.cpp (it #defines uint32_t)
 #include <ext/sha-1.cpp>
 #include <ext/md5.c>
 #undef F
@@ -18,8 +19,11 @@
 
 #define HASH_SHA1             1
 #define HASH_MD5              5
-#define HASH_FNV1            11
-#define HASH_FNV1a           12
+#define HASH_FNV1            11 //32 bit digests differ from the ones saved before the asm was replaced:
+#define HASH_FNV1a           12 //that hashed the first byte msgnc times, read those with the _COMPAT methods
+#define HASH_FNV1_COMPAT     13 //32b: the old HASH_FNV1 values (64b never changed)
+#define HASH_FNV1a_COMPAT    14 //32b: the old HASH_FNV1a values
+#define HASH_VX              21 //VHash64/VHash128 (see hash.cpp)
 #define HASH_WIN          10000
 
 //adds all dwords returning sum -----------------------------------------------------------------------
@@ -63,101 +67,6 @@ return rest&((unsigned)-1>>((sizeof(unsigned)<<3)-nrbits));
 
 #define VCRC32(msg,msgsz) V_CRC((unsigned char*)msg,msgsz,32,0xffffffff,GENERATOR_CRC_32)^0xffffffff
 
-#define FNV32_prime  16777619 //0x1000193
-#define FNV32_offset 2166136261
-#define FNV64_prime  1099511628211ui64 //0x100000001B3
-#define FNV64_offset 14695981039346656037ui64
-
-//Fowler / Noll / Vo (FNV) Hash -----------------------------------------------------------------------
-DWORD __cdecl FNV1_32b(char*msg,NAT msgnc=0)
-{
-if(!msgnc) msgnc=sl(msg);
-__asm
- {
- mov eax,FNV32_offset
- mov ecx,msgnc
- mov esi,msg
- jecxz Lret
-LNextByte:
-  mov edx,eax
-  shl edx,1
-  add eax,edx
-  shl edx,3 //4
-  add eax,edx
-  shl edx,3 //7
-  add eax,edx
-  shl edx,1 //8
-  add eax,edx
-  shl edx,16 //24
-  add eax,edx
-  xor al,byte ptr [esi]
-  dec ecx
-  jnz LNextByte
-Lret:
- }
-}
-
-//Fowler / Noll / Vo (FNV) Hash -----------------------------------------------------------------------
-DWORD __cdecl FNV1a_32b(char*msg,NAT msgnc=0)
-{
-if(!msgnc) msgnc=sl(msg);
-__asm
- {
- mov eax,FNV32_offset
- mov ecx,msgnc
- mov esi,msg
- jecxz Lret
-LNextByte:
-  xor al,byte ptr [esi]
-  mov edx,eax
-  shl edx,1
-  add eax,edx
-  shl edx,3 //4
-  add eax,edx
-  shl edx,3 //7
-  add eax,edx
-  shl edx,1 //8
-  add eax,edx
-  shl edx,16 //24
-  add eax,edx
-  dec ecx
-  jnz LNextByte
-Lret:
- }
-}
-
-//Fowler / Noll / Vo (FNV) Hash -----------------------------------------------------------------------
-QWORD __cdecl FNV1_64b(char*msg,NAT msgnc=0)
-{
-if(!msgnc) msgnc=sl(msg);
-QUADW hashval;
-hashval.u64=FNV64_offset;
-while(msgnc)
- {
- hashval.u64*=FNV64_prime;
- *hashval.b^=*msg;
- msg++;
- msgnc--;
- }
-return hashval.u64;
-}
-
-//Fowler / Noll / Vo (FNV) Hash -----------------------------------------------------------------------
-QWORD __cdecl FNV1a_64b(char*msg,NAT msgnc=0)
-{
-if(!msgnc) msgnc=sl(msg);
-QUADW hashval;
-hashval.u64=FNV64_offset;
-while(msgnc)
- {
- *hashval.b^=*msg;
- hashval.u64*=FNV64_prime;
- msg++;
- msgnc--;
- }
-return hashval.u64;
-}
-
 //Hash data (returns size of hash in Bytes)------------------------------------------------------------------------------------------
 NAT HashX(char*message,NAT messagenc,BYTE*msgdigest,int method=HASH_WIN,int keysz=0)
 {
@@ -183,12 +92,12 @@ else if(method==HASH_FNV1a) //32b,64b,128b,256b
  {
  if(keysz==4)
   {
-  *(DWORD*)msgdigest=FNV1a_32b(message,messagenc);
+  *(uint32_t*)msgdigest=FNV1a_32b(message,messagenc);
   return 4;
   }
  else if(keysz==8)
   {
-  *(QWORD*)msgdigest=FNV1a_64b(message,messagenc);
+  *(uint64_t*)msgdigest=FNV1a_64b(message,messagenc);
   return 8;
   }
  }
@@ -196,15 +105,39 @@ else if(method==HASH_FNV1) //32b,64b,128b,256b
  {
  if(keysz==4)
   {
-  *(DWORD*)msgdigest=FNV1_32b(message,messagenc);
+  *(uint32_t*)msgdigest=FNV1_32b(message,messagenc);
   return 4;
   }
  else if(keysz==8)
   {
-  *(QWORD*)msgdigest=FNV1_64b(message,messagenc);
+  *(uint64_t*)msgdigest=FNV1_64b(message,messagenc);
   return 8;
   }
  }
+else if(method==HASH_FNV1_COMPAT&&keysz==4)
+ {
+ *(uint32_t*)msgdigest=FNV1_32b_compat(message,messagenc);
+ return 4;
+ }
+else if(method==HASH_FNV1a_COMPAT&&keysz==4)
+ {
+ *(uint32_t*)msgdigest=FNV1a_32b_compat(message,messagenc);
+ return 4;
+ }
+else if(method==HASH_VX) //64b,128b
+ {
+ if(keysz==8)
+  {
+  *(uint64_t*)msgdigest=VHash64(message,messagenc);
+  return 8;
+  }
+ else if(keysz==16)
+  {
+  VHASH128 h=VHash128(message,messagenc);
+  memcpy(msgdigest,&h,16);
+  return 16;
+  }
+ }
 else if(method==HASH_WIN) //2048b=256B=64DW
  {
  keysz=CLAMP(keysz,1,256); //repeats after 256B (smaller than 256 are just truncated to that size)
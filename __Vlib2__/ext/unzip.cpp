@@ -70,6 +70,7 @@
 #define ZIP_HANDLE   1
 #define ZIP_FILENAME 2
 #define ZIP_MEMORY   3
+#define ZIP_MAPPED   4 // a filename, opened as a read-only mapping of the whole file
 
 
 #define zmalloc(len) malloc(len)
@@ -3753,22 +3754,47 @@ FILETIME dosdatetime2filetime(WORD dosdate,WORD dostime)
 
 
 
+// One central-directory entry of a zip that lies whole in memory (ZIP_MEMORY or ZIP_MAPPED).
+// The entries are chained into two hash tables by name, case-sensitive and case-insensitive.
+typedef struct
+{ const char *name; unsigned int namelen; // points into the central directory, not terminated
+  unsigned long hash,ihash;               // of the name, as-is and upper-cased
+  int next,inext;                         // next entry in the same hash bucket, or -1
+  unsigned long cdpos;                    // offset of the central header, as in unz_s::pos_in_central_dir
+  unsigned long localoff;                 // offset of the local header
+  unsigned long datapos;                  // offset of the item's data in the archive, 0 until first needed
+  unsigned long comp_size,unc_size;
+  unsigned long crc;                      // crc32 of the uncompressed data, checked by UnzipDirect
+  unsigned int flag,method;
+} TUnzipIdx;
+
 class TUnzip
 { public:
-  TUnzip(const char *pwd) : uf(0), unzbuf(0), currentfile(-1), czei(-1), password(0) {if (pwd!=0) {password=new char[strlen(pwd)+1]; strcpy(password,pwd);}}
-  ~TUnzip() {if (password!=0) delete[] password; password=0; if (unzbuf!=0) delete[] unzbuf; unzbuf=0;}
+  TUnzip(const char *pwd) : uf(0), unzbuf(0), currentfile(-1), czei(-1), password(0), hmapf(0), hmap(0), mapbase(0), zbase(0), zlen(0), idx(0), nidx(0), hidx(0), hmask(0) {if (pwd!=0) {password=new char[strlen(pwd)+1]; strcpy(password,pwd);}}
+  ~TUnzip() {if (password!=0) delete[] password; password=0; if (unzbuf!=0) delete[] unzbuf; unzbuf=0; Unmap();}
 
   unzFile uf; int currentfile; ZIPENTRY cze; int czei;
   char *password;
   char *unzbuf;            // lazily created and destroyed, used by Unzip
   TCHAR rootdir[MAX_PATH]; // includes a trailing slash
+  HANDLE hmapf,hmap; void *mapbase;  // for ZIP_MAPPED
+  const unsigned char *zbase; unsigned long zlen; // the whole archive, if it's in memory
+  TUnzipIdx *idx; int nidx; int *hidx; unsigned int hmask; // name index, if it's in memory
 
   ZRESULT Open(void *z,unsigned int len,DWORD flags);
   ZRESULT Get(int index,ZIPENTRY *ze);
   ZRESULT Find(const TCHAR *name,bool ic,int *index,ZIPENTRY *ze);
   ZRESULT Unzip(int index,void *dst,unsigned int len,DWORD flags);
+  ZRESULT GetPtr(int index,const void **ptr,unsigned int *len);
   ZRESULT SetUnzipBaseDir(const TCHAR *dir);
   ZRESULT Close();
+
+  ZRESULT Index();
+  int Lookup(const char *name,bool ic);
+  void Goto(int index);
+  ZRESULT ItemData(int index,const unsigned char **data);
+  ZRESULT UnzipDirect(int index,void *dst);
+  void Unmap();
 };
 
 
@@ -3789,13 +3815,176 @@ ZRESULT TUnzip::Open(void *z,unsigned int len,DWORD flags)
     bool canseek = (res!=0xFFFFFFFF);
     if (!canseek) return ZR_SEEK;
   }
+  if (flags==ZIP_MAPPED)
+  { // map the file once; from then on it's read exactly like a memory zip
+    hmapf = CreateFile((const TCHAR*)z,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+    if (hmapf==INVALID_HANDLE_VALUE) {hmapf=0; return ZR_NOFILE;}
+    DWORD size = GetFileSize(hmapf,NULL);
+    if (size==0xFFFFFFFF) return ZR_READ;
+    if (size==0) return ZR_CORRUPT;
+    hmap = CreateFileMapping(hmapf,NULL,PAGE_READONLY,0,0,NULL);
+    if (hmap==0) return ZR_NOALLOC;
+    mapbase = MapViewOfFile(hmap,FILE_MAP_READ,0,0,0);
+    if (mapbase==0) return ZR_NOALLOC;
+    z=mapbase; len=size; flags=ZIP_MEMORY;
+  }
   ZRESULT e; LUFILE *f = lufopen(z,len,flags,&e);
   if (f==NULL) return e;
   uf = unzOpenInternal(f);
   if (uf==0) return ZR_NOFILE;
+  if (flags==ZIP_MEMORY)
+  { zbase=(const unsigned char*)z; zlen=len;
+    Index(); // if the central directory doesn't parse, we just go without the index
+  }
   return ZR_OK;
 }
 
+
+#define LU_GET16(p) ((unsigned long)(p)[0] | ((unsigned long)(p)[1]<<8))
+#define LU_GET32(p) (LU_GET16(p) | (LU_GET16((p)+2)<<16))
+
+// FNV-1a over the name; with ic, letters are folded as in strcmpcasenosensitive_internal
+unsigned long lu_namehash(const char *name,unsigned int len,bool ic)
+{ unsigned long h=2166136261UL;
+  for (unsigned int i=0; i<len; i++)
+  { unsigned char c=(unsigned char)name[i];
+    if (ic && c>='a' && c<='z') c-=0x20;
+    h=(h^c)*16777619UL;
+  }
+  return h;
+}
+
+// Parses the whole central directory of an in-memory zip into idx[] and the two hash tables.
+ZRESULT TUnzip::Index()
+{ unsigned int n = (unsigned int)uf->gi.number_entry;
+  if (n==0) return ZR_OK;
+  TUnzipIdx *x = new TUnzipIdx[n];
+  unsigned long pos = uf->byte_before_the_zipfile + uf->offset_central_dir;
+  for (unsigned int i=0; i<n; i++)
+  { if (pos+SIZECENTRALDIRITEM>zlen || LU_GET32(zbase+pos)!=0x02014b50) {delete[] x; return ZR_CORRUPT;}
+    const unsigned char *c = zbase+pos;
+    unsigned long fnlen=LU_GET16(c+28), extralen=LU_GET16(c+30), commentlen=LU_GET16(c+32);
+    if (pos+SIZECENTRALDIRITEM+fnlen>zlen) {delete[] x; return ZR_CORRUPT;}
+    x[i].name = (const char*)c+SIZECENTRALDIRITEM; x[i].namelen = fnlen;
+    x[i].hash = lu_namehash(x[i].name,fnlen,false);
+    x[i].ihash = lu_namehash(x[i].name,fnlen,true);
+    x[i].cdpos = pos - uf->byte_before_the_zipfile;
+    x[i].flag = LU_GET16(c+8); x[i].method = LU_GET16(c+10);
+    x[i].crc = LU_GET32(c+16);
+    x[i].comp_size = LU_GET32(c+20); x[i].unc_size = LU_GET32(c+24);
+    x[i].localoff = LU_GET32(c+42);
+    x[i].datapos = 0;
+    pos += SIZECENTRALDIRITEM+fnlen+extralen+commentlen;
+  }
+  unsigned int hsize=16; while (hsize<2*n) hsize<<=1;
+  int *h = new int[2*hsize];
+  for (unsigned int i=0; i<2*hsize; i++) h[i]=-1;
+  // filled backwards, so that a bucket lists duplicates in zip order and Lookup finds the first, like unzLocateFile
+  for (unsigned int i=n; i-->0; )
+  { unsigned int b=x[i].hash&(hsize-1), ib=hsize+(x[i].ihash&(hsize-1));
+    x[i].next=h[b]; h[b]=(int)i;
+    x[i].inext=h[ib]; h[ib]=(int)i;
+  }
+  idx=x; nidx=(int)n; hidx=h; hmask=hsize-1;
+  return ZR_OK;
+}
+
+int TUnzip::Lookup(const char *name,bool ic)
+{ unsigned int len=(unsigned int)strlen(name);
+  unsigned long hash=lu_namehash(name,len,ic);
+  if (!ic)
+  { for (int i=hidx[hash&hmask]; i!=-1; i=idx[i].next)
+    { if (idx[i].hash==hash && idx[i].namelen==len && memcmp(idx[i].name,name,len)==0) return i;
+    }
+    return -1;
+  }
+  for (int i=hidx[hmask+1+(hash&hmask)]; i!=-1; i=idx[i].inext)
+  { if (idx[i].ihash!=hash || idx[i].namelen!=len) continue;
+    unsigned int k=0;
+    for (; k<len; k++)
+    { char c1=idx[i].name[k], c2=name[k];
+      if (c1>='a' && c1<='z') c1-=(char)0x20;
+      if (c2>='a' && c2<='z') c2-=(char)0x20;
+      if (c1!=c2) break;
+    }
+    if (k==len) return i;
+  }
+  return -1;
+}
+
+// Makes index the current file of uf: directly if we have the index, otherwise by walking to it.
+void TUnzip::Goto(int index)
+{ if (idx!=0 && index>=0 && index<nidx)
+  { if (uf->current_file_ok && (int)uf->num_file==index) return;
+    uf->num_file=index; uf->pos_in_central_dir=idx[index].cdpos;
+    int err=unzlocal_GetCurrentFileInfoInternal(uf,&uf->cur_file_info,&uf->cur_file_info_internal,NULL,0,NULL,0,NULL,0);
+    uf->current_file_ok = (err==UNZ_OK);
+    return;
+  }
+  if (index<(int)uf->num_file) unzGoToFirstFile(uf);
+  while ((int)uf->num_file<index) unzGoToNextFile(uf);
+}
+
+// Finds where the item's (compressed) data starts. Only for indexed zips.
+ZRESULT TUnzip::ItemData(int index,const unsigned char **data)
+{ TUnzipIdx *x=&idx[index];
+  if (x->datapos==0)
+  { unsigned long lh = uf->byte_before_the_zipfile + x->localoff;
+    if (lh+SIZEZIPLOCALHEADER>zlen || LU_GET32(zbase+lh)!=0x04034b50) return ZR_CORRUPT;
+    unsigned long dp = lh+SIZEZIPLOCALHEADER+LU_GET16(zbase+lh+26)+LU_GET16(zbase+lh+28);
+    if (dp+x->comp_size>zlen) return ZR_CORRUPT;
+    x->datapos=dp;
+  }
+  *data = zbase+x->datapos;
+  return ZR_OK;
+}
+
+// Unzips a whole unencrypted item of an indexed zip in one go: stored items are
+// copied and deflated ones inflated straight from the archive into dst. Like the
+// streaming path, a crc32 that doesn't match the central directory is an error.
+ZRESULT TUnzip::UnzipDirect(int index,void *dst)
+{ const unsigned char *data; ZRESULT zr=ItemData(index,&data);
+  if (zr!=ZR_OK) return zr;
+  TUnzipIdx *x=&idx[index];
+  if (x->method==0)
+  { if (x->comp_size!=x->unc_size) return ZR_CORRUPT;
+    memcpy(dst,data,x->unc_size);
+    if (ucrc32(0,(const Byte*)dst,(uInt)x->unc_size)!=x->crc) return ZR_CORRUPT;
+    return ZR_OK;
+  }
+  z_stream zs; zs.zalloc=(alloc_func)0; zs.zfree=(free_func)0; zs.opaque=(voidpf)0;
+  if (inflateInit2(&zs)!=Z_OK) return ZR_NOALLOC;
+  zs.next_in=(Byte*)data; zs.avail_in=(uInt)x->comp_size;
+  zs.next_out=(Byte*)dst; zs.avail_out=(uInt)x->unc_size; zs.total_out=0;
+  int err=Z_OK;
+  while (err==Z_OK && zs.avail_out>0) err=inflate(&zs,Z_SYNC_FLUSH);
+  inflateEnd(&zs);
+  if (zs.total_out!=x->unc_size) return ZR_FLATE;
+  if (ucrc32(0,(const Byte*)dst,(uInt)x->unc_size)!=x->crc) return ZR_CORRUPT;
+  return ZR_OK;
+}
+
+ZRESULT TUnzip::GetPtr(int index,const void **ptr,unsigned int *len)
+{ if (idx==0) return ZR_NOTMMAP;
+  if (index<0 || index>=nidx) return ZR_ARGS;
+  TUnzipIdx *x=&idx[index];
+  if (x->method!=0 || (x->flag&1)!=0) return ZR_NOTSTORED;
+  if (x->comp_size!=x->unc_size) return ZR_CORRUPT;
+  const unsigned char *data; ZRESULT zr=ItemData(index,&data);
+  if (zr!=ZR_OK) return zr;
+  *ptr=data; *len=(unsigned int)x->unc_size;
+  return ZR_OK;
+}
+
+void TUnzip::Unmap()
+{ if (idx!=0) delete[] idx; idx=0; nidx=0;
+  if (hidx!=0) delete[] hidx; hidx=0;
+  zbase=0; zlen=0;
+  if (mapbase!=0) UnmapViewOfFile(mapbase); mapbase=0;
+  if (hmap!=0) CloseHandle(hmap); hmap=0;
+  if (hmapf!=0) CloseHandle(hmapf); hmapf=0;
+}
+
 ZRESULT TUnzip::SetUnzipBaseDir(const TCHAR *dir)
 { _tcscpy(rootdir,dir);
   TCHAR lastchar = rootdir[_tcslen(rootdir)-1];
@@ -3818,8 +4007,7 @@ ZRESULT TUnzip::Get(int index,ZIPENTRY *ze)
     ze->unc_size=0;
     return ZR_OK;
   }
-  if (index<(int)uf->num_file) unzGoToFirstFile(uf);
-  while ((int)uf->num_file<index) unzGoToNextFile(uf);
+  Goto(index);
   unz_file_info ufi; char fn[MAX_PATH];
   unzGetCurrentFileInfo(uf,&ufi,fn,MAX_PATH,NULL,0,NULL,0);
   // now get the extra header. We do this ourselves, instead of
@@ -3933,14 +4121,15 @@ ZRESULT TUnzip::Find(const TCHAR *tname,bool ic,int *index,ZIPENTRY *ze)
 #else
   strcpy(name,tname);
 #endif
-  int res = unzLocateFile(uf,name,ic?CASE_INSENSITIVE:CASE_SENSITIVE);
-  if (res!=UNZ_OK)
+  int i=-1;
+  if (idx!=0) i=Lookup(name,ic);
+  else if (unzLocateFile(uf,name,ic?CASE_INSENSITIVE:CASE_SENSITIVE)==UNZ_OK) i=(int)uf->num_file;
+  if (i==-1)
   { if (index!=0) *index=-1;
     if (ze!=NULL) {ZeroMemory(ze,sizeof(ZIPENTRY)); ze->index=-1;}
     return ZR_NOTFOUND;
   }
   if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
-  int i = (int)uf->num_file;
   if (index!=NULL) *index=i;
   if (ze!=NULL)
   { ZRESULT zres = Get(i,ze);
@@ -3973,8 +4162,12 @@ ZRESULT TUnzip::Unzip(int index,void *dst,unsigned int len,DWORD flags)
   { if (index!=currentfile)
     { if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
       if (index>=(int)uf->gi.number_entry) return ZR_ARGS;
-      if (index<(int)uf->num_file) unzGoToFirstFile(uf);
-      while ((int)uf->num_file<index) unzGoToNextFile(uf);
+      if (idx!=0 && index>=0)
+      { TUnzipIdx *x=&idx[index];
+        bool whole = ((x->flag&1)==0 && len>=x->unc_size && (x->method==0 || x->method==Z_DEFLATED));
+        if (whole) return UnzipDirect(index,dst);
+      }
+      Goto(index);
       unzOpenCurrentFile(uf,password); currentfile=index;
     }
     bool reached_eof;
@@ -3988,8 +4181,7 @@ ZRESULT TUnzip::Unzip(int index,void *dst,unsigned int len,DWORD flags)
   // otherwise we're writing to a handle or a file
   if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
   if (index>=(int)uf->gi.number_entry) return ZR_ARGS;
-  if (index<(int)uf->num_file) unzGoToFirstFile(uf);
-  while ((int)uf->num_file<index) unzGoToNextFile(uf);
+  Goto(index);
   ZIPENTRY ze; Get(index,&ze);
   // zipentry=directory is handled specially
   if ((ze.attr&FILE_ATTRIBUTE_DIRECTORY)!=0)
@@ -4074,6 +4266,7 @@ unsigned int FormatZipMessageU(ZRESULT code, TCHAR *buf,unsigned int len)
     case ZR_FAILED: msg=_T("Caller: there was a previous error"); break;
     case ZR_ENDED: msg=_T("Caller: additions to the zip have already been ended"); break;
     case ZR_ZMODE: msg=_T("Caller: mixing creation and opening of zip"); break;
+    case ZR_NOTSTORED: msg=_T("Caller: can only get a pointer to a stored, unencrypted item"); break;
     case ZR_NOTINITED: msg=_T("Zip-bug: internal initialisation not completed"); break;
     case ZR_SEEK: msg=_T("Zip-bug: trying to seek the unseekable"); break;
     case ZR_MISSIZE: msg=_T("Zip-bug: the anticipated size turned out wrong"); break;
@@ -4103,6 +4296,7 @@ HZIP OpenZipInternal(void *z,unsigned int len,DWORD flags, const char *password)
 HZIP OpenZipHandle(HANDLE h, const char *password) {return OpenZipInternal((void*)h,0,ZIP_HANDLE,password);}
 HZIP OpenZip(const TCHAR *fn, const char *password) {return OpenZipInternal((void*)fn,0,ZIP_FILENAME,password);}
 HZIP OpenZip(void *z,unsigned int len, const char *password) {return OpenZipInternal(z,len,ZIP_MEMORY,password);}
+HZIP OpenZipMapped(const TCHAR *fn, const char *password) {return OpenZipInternal((void*)fn,0,ZIP_MAPPED,password);}
 
 
 ZRESULT GetZipItem(HZIP hz, int index, ZIPENTRY *ze)
@@ -4136,6 +4330,16 @@ ZRESULT UnzipItemHandle(HZIP hz, int index, HANDLE h) {return UnzipItemInternal(
 ZRESULT UnzipItem(HZIP hz, int index, const TCHAR *fn) {return UnzipItemInternal(hz,index,(void*)fn,0,ZIP_FILENAME);}
 ZRESULT UnzipItem(HZIP hz, int index, void *z,unsigned int len) {return UnzipItemInternal(hz,index,z,len,ZIP_MEMORY);}
 
+ZRESULT GetZipItemPtr(HZIP hz, int index, const void **ptr, unsigned int *len)
+{ *ptr=0; *len=0;
+  if (hz==0) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
+  TUnzipHandleData *han = (TUnzipHandleData*)hz;
+  if (han->flag!=1) {lasterrorU=ZR_ZMODE;return ZR_ZMODE;}
+  TUnzip *unz = han->unz;
+  lasterrorU = unz->GetPtr(index,ptr,len);
+  return lasterrorU;
+}
+
 ZRESULT SetUnzipBaseDir(HZIP hz, const TCHAR *dir)
 { if (hz==0) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
   TUnzipHandleData *han = (TUnzipHandleData*)hz;
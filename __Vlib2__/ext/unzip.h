@@ -30,6 +30,7 @@ typedef struct
 HZIP OpenZip(const TCHAR *fn, const char *password);
 HZIP OpenZip(void *z,unsigned int len, const char *password);
 HZIP OpenZipHandle(HANDLE h, const char *password);
+HZIP OpenZipMapped(const TCHAR *fn, const char *password);
 // OpenZip - opens a zip file and returns a handle with which you can
 // subsequently examine its contents. You can open a zip file from:
 // from a pipe:             OpenZipHandle(hpipe_read,0);
@@ -45,6 +46,11 @@ HZIP OpenZipHandle(HANDLE h, const char *password);
 // Note: for windows-ce, you cannot close the handle until after CloseZip.
 // but for real windows, the zip makes its own copy of your handle, so you
 // can close yours anytime.
+// OpenZipMapped maps the file into memory instead of reading it, and then
+// treats it like a memory block. Zips opened from memory (either way) have
+// their central directory indexed by name, so GetZipItem and FindZipItem
+// don't walk the entries, and UnzipItem to a buffer that holds the whole
+// item copies or inflates it straight from the archive.
 
 ZRESULT GetZipItem(HZIP hz, int index, ZIPENTRY *ze);
 // GetZipItem - call this to get information about an item in the zip.
@@ -78,6 +84,8 @@ ZRESULT UnzipItemHandle(HZIP hz, int index, HANDLE h);
 // In the final case, if the buffer isn't large enough to hold it all,
 // then the return code indicates that more is yet to come. If it was
 // large enough, and you want to know precisely how big, GetZipItem.
+// With a memory or mapped zip and a buffer of at least ze.unc_size, the item
+// is unzipped in a single call without any intermediate copies.
 // Note: zip files are normally stored with relative pathnames. If you
 // unzip with ZIP_FILENAME a relative pathname then the item gets created
 // relative to the current directory - it first ensures that all necessary
@@ -85,6 +93,12 @@ ZRESULT UnzipItemHandle(HZIP hz, int index, HANDLE h);
 // If you unzip a directory with ZIP_FILENAME, then the directory gets created.
 // If you unzip it to a handle or a memory block, then nothing gets created
 // and it emits 0 bytes.
+ZRESULT GetZipItemPtr(HZIP hz, int index, const void **ptr, unsigned int *len);
+// GetZipItemPtr - for a zip opened from memory or with OpenZipMapped, returns
+// a pointer to a stored (uncompressed, unencrypted) item inside the archive
+// itself, without copying. It stays valid until CloseZip. Compressed or
+// encrypted items give ZR_NOTSTORED; use UnzipItem for those.
+
 ZRESULT SetUnzipBaseDir(HZIP hz, const TCHAR *dir);
 // if unzipping to a filename, and it's a relative filename, then it will be relative to here.
 // (defaults to current-directory).
@@ -123,6 +137,7 @@ unsigned int FormatZipMessage(ZRESULT code, TCHAR *buf,unsigned int len);
 #define ZR_MISSIZE    0x00060000     // the indicated input file size turned out mistaken
 #define ZR_PARTIALUNZ 0x00070000     // the file had already been partially unzipped
 #define ZR_ZMODE      0x00080000     // tried to mix creating/opening a zip 
+#define ZR_NOTSTORED  0x00090000     // tried to GetZipItemPtr an item that's compressed or encrypted
 // The following come from bugs within the zip library itself
 #define ZR_BUGMASK    0xFF000000
 #define ZR_NOTINITED  0x01000000     // initialisation didn't work
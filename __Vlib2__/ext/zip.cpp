@@ -1475,7 +1475,7 @@ void copy_block(TState &state, char *block, unsigned len, int header)
  */
 
 void fill_window  (TState &state);
-ulg deflate_fast  (TState &state);
+ulg deflate_fast  (TState &state, int last=1);
 
 int  longest_match (TState &state,IPos cur_match);
 
@@ -1509,8 +1509,11 @@ int  longest_match (TState &state,IPos cur_match);
  *    window_size is sufficient to contain the whole input file plus
  *    MIN_LOOKAHEAD bytes (to avoid referencing memory beyond the end
  *    of window[] when looking for matches towards the end).
+ * A preset dictionary (at most WSIZE bytes, used by the parallel deflater)
+ *    is put in front of the input and entered in the hash chains, so that
+ *    matches may refer to it, but it is not itself compressed.
  */
-void lm_init (TState &state, int pack_level, ush *flags)
+void lm_init (TState &state, int pack_level, ush *flags, const uch *dict=NULL, unsigned dictlen=0)
 {
     register unsigned j;
 
@@ -1546,10 +1549,16 @@ void lm_init (TState &state, int pack_level, ush *flags)
 
     state.ds.strstart = 0;
     state.ds.block_start = 0L;
+    if (dictlen != 0) {
+       Assert(state,dictlen<=WSIZE,"dictionary too big");
+       memcpy(state.ds.window, dict, dictlen);
+       state.ds.strstart = dictlen;
+       state.ds.block_start = (long)dictlen;
+    }
 
     j = WSIZE;
     j <<= 1; // Can read 64K in one step
-    state.ds.lookahead = state.readfunc(state, (char*)state.ds.window, j);
+    state.ds.lookahead = state.readfunc(state, (char*)state.ds.window+dictlen, j-dictlen);
 
     if (state.ds.lookahead == 0 || state.ds.lookahead == (unsigned)EOF) {
        state.ds.eofile = 1, state.ds.lookahead = 0;
@@ -1561,8 +1570,14 @@ void lm_init (TState &state, int pack_level, ush *flags)
      */
     if (state.ds.lookahead < MIN_LOOKAHEAD) fill_window(state);
 
+    if (dictlen >= MIN_MATCH) {
+       IPos hash_head;
+       state.ds.ins_h = 0;
+       for (j=0; j<MIN_MATCH-1; j++) UPDATE_HASH(state.ds.ins_h, state.ds.window[j]);
+       for (j=0; j<=dictlen-MIN_MATCH; j++) INSERT_STRING(j, hash_head);
+    }
     state.ds.ins_h = 0;
-    for (j=0; j<MIN_MATCH-1; j++) UPDATE_HASH(state.ds.ins_h, state.ds.window[j]);
+    for (j=0; j<MIN_MATCH-1; j++) UPDATE_HASH(state.ds.ins_h, state.ds.window[state.ds.strstart+j]);
     /* If lookahead < MIN_MATCH, ins_h is garbage, but this is
      * not important since only literal bytes will be emitted.
      */
@@ -1764,13 +1779,30 @@ void fill_window(TState &state)
    flush_block(state,state.ds.block_start >= 0L ? (char*)&state.ds.window[(unsigned)state.ds.block_start] : \
                 (char*)NULL, (long)state.ds.strstart - state.ds.block_start, (eof))
 
+/* ===========================================================================
+ * Flush the last block of the input. If this is not the last piece of the
+ * stream (parallel deflate), the block is not marked final and an empty
+ * stored block is appended, so the output ends on a byte boundary and the
+ * next piece can simply be concatenated after it.
+ */
+ulg flush_last(TState &state, int last)
+{
+    ulg len = FLUSH_BLOCK(state,last);
+    if (last) return len;
+    send_bits(state,(STORED_BLOCK<<1), 3);
+    copy_block(state,state.bs.out_buf, 0, 1);
+    state.ts.cmpr_bytelen += ((state.ts.cmpr_len_bits + 3 + 7) >> 3) + 4;
+    state.ts.cmpr_len_bits = 0L;
+    return state.ts.cmpr_bytelen;
+}
+
 /* ===========================================================================
  * Processes a new input file and return its compressed length. This
  * function does not perform lazy evaluation of matches and inserts
  * new strings in the dictionary only for unmatched strings or for short
  * matches. It is used only for the fast compression options.
  */
-ulg deflate_fast(TState &state)
+ulg deflate_fast(TState &state, int last)
 {
     IPos hash_head = NIL;       /* head of the hash chain */
     int flush;                  /* set if current block must be flushed */
@@ -1843,7 +1875,7 @@ ulg deflate_fast(TState &state)
          */
         if (state.ds.lookahead < MIN_LOOKAHEAD) fill_window(state);
     }
-    return FLUSH_BLOCK(state,1); /* eof */
+    return flush_last(state,last); /* eof */
 }
 
 /* ===========================================================================
@@ -1851,7 +1883,7 @@ ulg deflate_fast(TState &state)
  * evaluation for matches: a match is finally adopted only if there is
  * no better match at the next window position.
  */
-ulg deflate(TState &state)
+ulg deflate(TState &state, int last=1)
 {
     IPos hash_head = NIL;       /* head of hash chain */
     IPos prev_match;            /* previous match */
@@ -1859,7 +1891,7 @@ ulg deflate(TState &state)
     int match_available = 0;    /* set if previous match exists */
     register unsigned match_length = MIN_MATCH-1; /* length of best match */
 
-    if (state.level <= 3) return deflate_fast(state); /* optimized for speed */
+    if (state.level <= 3) return deflate_fast(state,last); /* optimized for speed */
 
     /* Process the input block. */
     while (state.ds.lookahead != 0) {
@@ -1952,7 +1984,7 @@ ulg deflate(TState &state)
     }
     if (match_available) ct_tally (state,0, state.ds.window[state.ds.strstart-1]);
 
-    return FLUSH_BLOCK(state,1); /* eof */
+    return flush_last(state,last); /* eof */
 }
 
 
@@ -2114,6 +2146,36 @@ ulg crc32(ulg crc, const uch *buf, extent len)
 }
 
 
+// crc32_combine: crc of A|B from crc(A), crc(B) and len(B), by applying len(B)
+// zero bytes to crc(A) as a GF(2) matrix power (same method as zlib).
+ulg gf2_matrix_times(ulg *mat, ulg vec)
+{ ulg sum=0;
+  while (vec) {if (vec&1) sum^=*mat; vec>>=1; mat++;}
+  return sum;
+}
+void gf2_matrix_square(ulg *square, ulg *mat)
+{ for (int n=0; n<32; n++) square[n]=gf2_matrix_times(mat,mat[n]);
+}
+ulg crc32_combine(ulg crc1, ulg crc2, ulg len2)
+{ ulg even[32], odd[32], row=1;
+  if (len2==0) return crc1;
+  odd[0]=0xedb88320L; // operator for one zero bit
+  for (int n=1; n<32; n++) {odd[n]=row; row<<=1;}
+  gf2_matrix_square(even,odd); // two zero bits
+  gf2_matrix_square(odd,even); // four zero bits
+  do
+  { gf2_matrix_square(even,odd); // first pass: one zero byte
+    if (len2&1) crc1=gf2_matrix_times(even,crc1);
+    len2>>=1;
+    if (len2==0) break;
+    gf2_matrix_square(odd,even);
+    if (len2&1) crc1=gf2_matrix_times(odd,crc1);
+    len2>>=1;
+  } while (len2!=0);
+  return crc1^crc2;
+}
+
+
 void update_keys(unsigned long *keys, char c)
 { keys[0] = CRC32(keys[0],c);
   keys[1] += keys[0] & 0xFF;
@@ -2228,9 +2290,63 @@ ZRESULT GetFileInfo(HANDLE hf, ulg *attr, long *size, iztimes *times, ulg *times
 
 
 
+// Parallel deflate (pigz style): an entry is cut in ZIP_PCHUNK pieces, each piece is
+// deflated by a worker with the previous WSIZE bytes as preset dictionary, and the
+// pieces (which end on byte boundaries) are written in order as one deflate stream.
+#define ZIP_PCHUNK (128*1024)
+
+typedef struct
+{ TState *state;          // each piece has its own 500k state
+  char *in;               // dictionary followed by the piece
+  unsigned dictlen, inlen, inpos;
+  char *out; unsigned outlen, outsize; // compressed piece
+  char obuf[16384];       // bit buffer flushed into out
+  int last;               // last piece of the entry: ends with a final block
+  ush att;                // ascii/binary guess from the piece
+  ulg crc;                // crc of the piece (without dictionary)
+  HANDLE done;            // signalled when the worker has finished
+  const char *err;
+} TZipChunk;
+
+unsigned chunk_read(TState &s,char *buf,unsigned size)
+{ TZipChunk *c=(TZipChunk*)s.param;
+  unsigned red=c->inlen-c->inpos; if (red>size) red=size;
+  memcpy(buf,c->in+c->dictlen+c->inpos,red); c->inpos+=red;
+  return red;
+}
+unsigned chunk_flush(void *param,const char *buf, unsigned *size)
+{ if (*size==0) return 0;
+  TZipChunk *c=(TZipChunk*)param;
+  if (c->outlen+*size>c->outsize)
+  { c->outsize=2*(c->outlen+*size); char *o=new char[c->outsize];
+    memcpy(o,c->out,c->outlen); delete[] c->out; c->out=o;
+  }
+  memcpy(c->out+c->outlen,buf,*size); c->outlen+=*size;
+  unsigned writ=*size; *size=0; return writ;
+}
+DWORD WINAPI chunk_deflate(LPVOID param)
+{ TZipChunk *c=(TZipChunk*)param;
+  TState &s=*c->state;
+  ush flg=0;
+  c->crc=crc32(CRCVAL_INITIAL,(uch*)c->in+c->dictlen,c->inlen);
+  c->inpos=0; c->outlen=0; c->att=(ush)UNKNOWN;
+  s.err=NULL; s.readfunc=chunk_read; s.flush_outbuf=chunk_flush;
+  s.param=c; s.level=8; s.seekable=true;
+  s.ts.static_dtree[0].dl.len = 0;
+  s.ds.window_size=0;
+  bi_init(s,c->obuf,sizeof(c->obuf),TRUE);
+  ct_init(s,&c->att);
+  lm_init(s,s.level,&flg,(uch*)c->in,c->dictlen);
+  deflate(s,c->last);
+  c->err=s.err;
+  SetEvent(c->done);
+  return 0;
+}
+
+
 class TZip
 { public:
-  TZip(const char *pwd) : hfout(0),mustclosehfout(false),hmapout(0),zfis(0),obuf(0),hfin(0),writ(0),oerr(false),hasputcen(false),ooffset(0),encwriting(false),encbuf(0),password(0), state(0) {if (pwd!=0 && *pwd!=0) {password=new char[strlen(pwd)+1]; strcpy(password,pwd);}}
+  TZip(const char *pwd) : hfout(0),mustclosehfout(false),hmapout(0),zfis(0),obuf(0),hfin(0),writ(0),oerr(false),hasputcen(false),ooffset(0),encwriting(false),encbuf(0),password(0), state(0), nthreads(0) {if (pwd!=0 && *pwd!=0) {password=new char[strlen(pwd)+1]; strcpy(password,pwd);}}
   ~TZip() {if (state!=0) delete state; state=0; if (encbuf!=0) delete[] encbuf; encbuf=0; if (password!=0) delete[] password; password=0;}
 
   // These variables say about the file we're writing into
@@ -2254,6 +2370,7 @@ class TZip
   //
   TZipFileInfo *zfis;       // each file gets added onto this list, for writing the table at the end
   TState *state;            // we use just one state object per zip, because it's big (500k)
+  int nthreads;             // >1: deflate big entries in ZIP_PCHUNK pieces on this many threads
 
   ZRESULT Create(void *z,unsigned int len,DWORD flags);
   static unsigned sflush(void *param,const char *buf, unsigned *size);
@@ -2282,10 +2399,12 @@ class TZip
   ZRESULT open_mem(void *src,unsigned int len);
   ZRESULT open_dir();
   static unsigned sread(TState &s,char *buf,unsigned size);
-  unsigned read(char *buf, unsigned size);
+  unsigned read(char *buf, unsigned size, bool docrc=true);
+  unsigned readfull(char *buf, unsigned size);
   ZRESULT iclose();
 
   ZRESULT ideflate(TZipFileInfo *zfi);
+  ZRESULT ipdeflate(TZipFileInfo *zfi);
   ZRESULT istore();
 
   ZRESULT Add(const TCHAR *odstzn, void *src,unsigned int len, DWORD flags);
@@ -2485,7 +2604,7 @@ unsigned TZip::sread(TState &s,char *buf,unsigned size)
   return zip->read(buf,size);
 }
 
-unsigned TZip::read(char *buf, unsigned size)
+unsigned TZip::read(char *buf, unsigned size, bool docrc)
 { if (bufin!=0)
   { if (posin>=lenin) return 0; // end of input
     ulg red = lenin-posin;
@@ -2493,7 +2612,7 @@ unsigned TZip::read(char *buf, unsigned size)
     memcpy(buf, bufin+posin, red);
     posin += red;
     ired += red;
-    crc = crc32(crc, (uch*)buf, red);
+    if (docrc) crc = crc32(crc, (uch*)buf, red);
     return red;
   }
   else if (hfin!=0)
@@ -2501,12 +2620,23 @@ unsigned TZip::read(char *buf, unsigned size)
     BOOL ok = ReadFile(hfin,buf,size,&red,NULL);
     if (!ok) return 0;
     ired += red;
-    crc = crc32(crc, (uch*)buf, red);
+    if (docrc) crc = crc32(crc, (uch*)buf, red);
     return red;
   }
   else {oerr=ZR_NOTINITED; return 0;}
 }
 
+unsigned TZip::readfull(char *buf, unsigned size)
+{ // pipes may return less than asked; the crc is left to the parallel workers
+  unsigned red=0;
+  while (red<size)
+  { unsigned r=read(buf+red,size-red,false);
+    if (r==0 || r==(unsigned)EOF) break;
+    red+=r;
+  }
+  return red;
+}
+
 ZRESULT TZip::iclose()
 { if (selfclosehf && hfin!=0) CloseHandle(hfin); hfin=0;
   bool mismatch = (isize!=-1 && isize!=ired);
@@ -2539,6 +2669,56 @@ ZRESULT TZip::ideflate(TZipFileInfo *zfi)
   return r;
 }
 
+ZRESULT TZip::ipdeflate(TZipFileInfo *zfi)
+{ // pieces are read here, deflated on the thread pool, and written back in order
+  int nslots=2*nthreads, first=0, inflight=0, cur=0, i;
+  ZRESULT r=ZR_OK;
+  TZipChunk *ck=new TZipChunk[nslots];
+  for (i=0; i<nslots; i++)
+  { ck[i].state=new TState(); ck[i].in=new char[WSIZE+ZIP_PCHUNK];
+    ck[i].out=new char[ZIP_PCHUNK/2]; ck[i].outsize=ZIP_PCHUNK/2;
+    ck[i].done=CreateEvent(NULL,FALSE,FALSE,NULL);
+  }
+  csize=0; crc=CRCVAL_INITIAL;
+  ck[0].dictlen=0; ck[0].inlen=readfull(ck[0].in,ZIP_PCHUNK);
+  if (ck[0].inlen==0)
+  { // empty entry: a single empty final block with static trees
+    char empty[2]={3,0};
+    if (write(empty,2)!=2) r=ZR_WRITE;
+    csize=2;
+  }
+  else for (;;)
+  { while (inflight>0 && (inflight>=nslots-1 || ck[cur].inlen==0))
+    { // write out the oldest piece
+      TZipChunk &c=ck[first];
+      WaitForSingleObject(c.done,INFINITE);
+      if (c.err!=NULL) r=ZR_FLATE;
+      if (r==ZR_OK && write(c.out,c.outlen)!=c.outlen) r=ZR_WRITE;
+      if (first==0 && csize==0) zfi->att=c.att;
+      crc=crc32_combine(crc,c.crc,c.inlen);
+      csize+=c.outlen;
+      first=(first+1)%nslots; inflight--;
+    }
+    if (ck[cur].inlen==0) break;
+    // the next piece gets the last WSIZE bytes of this one as dictionary
+    TZipChunk &c=ck[cur];
+    int nxt=(cur+1)%nslots;
+    ck[nxt].dictlen=c.inlen<WSIZE?c.inlen:WSIZE;
+    memcpy(ck[nxt].in,c.in+c.dictlen+c.inlen-ck[nxt].dictlen,ck[nxt].dictlen);
+    ck[nxt].inlen=readfull(ck[nxt].in+ck[nxt].dictlen,ZIP_PCHUNK);
+    c.last=(ck[nxt].inlen==0);
+    if (!QueueUserWorkItem(chunk_deflate,&c,WT_EXECUTEDEFAULT)) chunk_deflate(&c);
+    inflight++;
+    cur=nxt;
+  }
+  zfi->flg|=SLOW; // what lm_init sets for level 8
+  for (i=0; i<nslots; i++)
+  { delete ck[i].state; delete[] ck[i].in; delete[] ck[i].out; CloseHandle(ck[i].done);
+  }
+  delete[] ck;
+  return r;
+}
+
 ZRESULT TZip::istore()
 { ulg size=0;
   for (;;)
@@ -2660,7 +2840,8 @@ ZRESULT TZip::Add(const TCHAR *odstzn, void *src,unsigned int len, DWORD flags)
   //(2) Write deflated/stored file to zip file
   ZRESULT writeres=ZR_OK;
   encwriting = (password!=0 && !isdir);  // an object member variable to say whether we write to disk encrypted
-  if (!isdir && method==DEFLATE) writeres=ideflate(&zfi);
+  if (!isdir && method==DEFLATE && nthreads>1 && (isize<0 || isize>ZIP_PCHUNK)) writeres=ipdeflate(&zfi);
+  else if (!isdir && method==DEFLATE) writeres=ideflate(&zfi);
   else if (!isdir && method==STORE) writeres=istore();
   else if (isdir) csize=0;
   encwriting = false;
@@ -2805,6 +2986,16 @@ ZRESULT ZipAddHandle(HZIP hz,const TCHAR *dstzn, HANDLE h) {return ZipAddInterna
 ZRESULT ZipAddHandle(HZIP hz,const TCHAR *dstzn, HANDLE h, unsigned int len) {return ZipAddInternal(hz,dstzn,h,len,ZIP_HANDLE);}
 ZRESULT ZipAddFolder(HZIP hz,const TCHAR *dstzn) {return ZipAddInternal(hz,dstzn,0,0,ZIP_FOLDER);}
 
+ZRESULT ZipSetThreads(HZIP hz,int nthreads)
+{ if (hz==0) {lasterrorZ=ZR_ARGS;return ZR_ARGS;}
+  TZipHandleData *han = (TZipHandleData*)hz;
+  if (han->flag!=2) {lasterrorZ=ZR_ZMODE;return ZR_ZMODE;}
+  if (nthreads<0) {SYSTEM_INFO si; GetSystemInfo(&si); nthreads=(int)si.dwNumberOfProcessors;}
+  han->zip->nthreads=nthreads;
+  lasterrorZ=ZR_OK;
+  return ZR_OK;
+}
+
 
 
 ZRESULT ZipGetMemory(HZIP hz, void **buf, unsigned long *len)
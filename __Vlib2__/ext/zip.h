@@ -72,6 +72,13 @@ ZRESULT ZipAddFolder(HZIP hz,const TCHAR *dstzn);
 // compressed item itself, which in turn makes it easier when unzipping the
 // zipfile from a pipe.
 
+ZRESULT ZipSetThreads(HZIP hz, int nthreads);
+// ZipSetThreads - lets ZipAdd deflate large items on several threads at once.
+// The item is cut into 128k pieces, each compressed with the previous 32k as
+// its dictionary, and the pieces are stitched into one ordinary deflate stream.
+// nthreads<0 means one per processor; 0 or 1 (the default) is single-threaded.
+// The output is a normal zip, slightly larger than the single-threaded one.
+
 ZRESULT ZipGetMemory(HZIP hz, void **buf, unsigned long *len);
 // ZipGetMemory - If the zip was created in memory, via ZipCreate(0,len),
 // then this function will return information about that memory block.
@@ -0,0 +1,388 @@
+#pragma once
+#define V_HASH //portable non-cryptographic hashes (no asm, builds on x86/x64, MSVC/GCC/Clang)
+
+#include <string.h>
+#include <stdint.h>
+
+#if !defined(VHASH_NO_SIMD)&&(defined(__AVX2__))
+ #include <immintrin.h>
+ #define VHASH_AVX2
+#elif !defined(VHASH_NO_SIMD)&&(defined(_M_X64)||defined(__x86_64__)||defined(__SSE2__)||(defined(_M_IX86_FP)&&_M_IX86_FP>=2))
+ #include <emmintrin.h>
+ #define VHASH_SSE2
+#endif
+#if defined(_MSC_VER)&&defined(_M_X64)
+ #include <intrin.h>
+ #pragma intrinsic(_umul128)
+#endif
+
+#define FNV32_prime  16777619u //0x1000193
+#define FNV32_offset 2166136261u
+#define FNV64_prime  1099511628211ull //0x100000001B3
+#define FNV64_offset 14695981039346656037ull
+
+//Fowler / Noll / Vo (FNV) Hash -----------------------------------------------------------------------
+inline uint32_t FNV1_32b(const char*msg,NAT msgnc=0)
+{
+const BYTE*p=(const BYTE*)msg;
+uint32_t h=FNV32_offset;
+if(!msgnc) msgnc=(NAT)strlen(msg);
+for(;msgnc>=4;msgnc-=4,p+=4)
+ {
+ h=(h*FNV32_prime)^p[0];
+ h=(h*FNV32_prime)^p[1];
+ h=(h*FNV32_prime)^p[2];
+ h=(h*FNV32_prime)^p[3];
+ }
+while(msgnc--)
+ h=(h*FNV32_prime)^*p++;
+return h;
+}
+
+//Fowler / Noll / Vo (FNV) Hash -----------------------------------------------------------------------
+inline uint32_t FNV1a_32b(const char*msg,NAT msgnc=0)
+{
+const BYTE*p=(const BYTE*)msg;
+uint32_t h=FNV32_offset;
+if(!msgnc) msgnc=(NAT)strlen(msg);
+for(;msgnc>=4;msgnc-=4,p+=4)
+ {
+ h=(h^p[0])*FNV32_prime;
+ h=(h^p[1])*FNV32_prime;
+ h=(h^p[2])*FNV32_prime;
+ h=(h^p[3])*FNV32_prime;
+ }
+while(msgnc--)
+ h=(h^*p++)*FNV32_prime;
+return h;
+}
+
+//Fowler / Noll / Vo (FNV) Hash -----------------------------------------------------------------------
+inline uint64_t FNV1_64b(const char*msg,NAT msgnc=0)
+{
+const BYTE*p=(const BYTE*)msg;
+uint64_t h=FNV64_offset;
+if(!msgnc) msgnc=(NAT)strlen(msg);
+while(msgnc--)
+ h=(h*FNV64_prime)^*p++;
+return h;
+}
+
+//Fowler / Noll / Vo (FNV) Hash -----------------------------------------------------------------------
+inline uint64_t FNV1a_64b(const char*msg,NAT msgnc=0)
+{
+const BYTE*p=(const BYTE*)msg;
+uint64_t h=FNV64_offset;
+if(!msgnc) msgnc=(NAT)strlen(msg);
+while(msgnc--)
+ h=(h^*p++)*FNV64_prime;
+return h;
+}
+
+//the 32 bit FNVs of the old dt_cc.cpp asm: it never advanced the message pointer, so it hashed the
+//first byte msgnc times. Only for digests saved with it (HASH_FNV1_COMPAT/HASH_FNV1a_COMPAT) .........
+inline uint32_t FNV1_32b_compat(const char*msg,NAT msgnc=0)
+{
+uint32_t h=FNV32_offset;
+if(!msgnc) msgnc=(NAT)strlen(msg);
+while(msgnc--)
+ h=(h*FNV32_prime)^(BYTE)msg[0];
+return h;
+}
+
+inline uint32_t FNV1a_32b_compat(const char*msg,NAT msgnc=0)
+{
+uint32_t h=FNV32_offset;
+if(!msgnc) msgnc=(NAT)strlen(msg);
+while(msgnc--)
+ h=(h^(BYTE)msg[0])*FNV32_prime;
+return h;
+}
+
+//VHASH: 64/128 bit hash with the structure of xxHash3 (8 lane accumulators, 64B stripes, 1KB blocks)
+//NOT bit compatible with XXH3 (uses its own secret); keys are stable across compilers/CPUs, little endian only
+#define VH_P32_1 0x9E3779B1u
+#define VH_P32_2 0x85EBCA77u
+#define VH_P32_3 0xC2B2AE3Du
+#define VH_P64_1 0x9E3779B185EBCA87ull
+#define VH_P64_2 0xC2B2AE3D27D4EB4Full
+#define VH_P64_3 0x165667B19E3779F9ull
+#define VH_P64_4 0x85EBCA77C2B2AE63ull
+#define VH_P64_5 0x27D4EB2F165667C5ull
+#define VH_SECRETSZ  192
+#define VH_STRIPE     64
+#define VH_BLOCKSTRP ((VH_SECRETSZ-VH_STRIPE)/8) //stripes per block
+#define VH_MIDMAX    240 //longest input hashed without accumulators
+
+struct VHASH128
+{
+ uint64_t lo,hi;
+};
+
+//splitmix64 output seeded with the fraction of pi
+static const BYTE VHashSecret[VH_SECRETSZ]={
+ 0x21,0xa2,0xbe,0x4a,0x9f,0xf6,0xb0,0x2c,0x89,0x89,0x14,0x23,0x47,0x03,0x17,0x94,
+ 0x03,0xfe,0x9d,0x60,0x50,0x59,0x55,0xdd,0x00,0x28,0xb1,0xde,0x50,0xb1,0xaf,0xdb,
+ 0xb6,0x2c,0x44,0x6c,0x2e,0x9b,0x78,0x7e,0xc4,0xf8,0xe4,0xc7,0x36,0x56,0x1e,0xf4,
+ 0xe4,0xa7,0xfb,0xf8,0x50,0xd1,0x59,0x09,0xea,0x9e,0xdb,0x3c,0xf1,0x16,0x73,0xa9,
+ 0x68,0x00,0x52,0xf9,0x58,0x82,0xcd,0x74,0x8b,0x86,0x16,0xe1,0x62,0x4a,0xc7,0x55,
+ 0xbd,0x3c,0x02,0xa2,0x99,0xc7,0xf4,0xd2,0xb9,0x51,0x7b,0xa3,0x79,0xcb,0x98,0xdf,
+ 0x05,0x39,0x4f,0x52,0x85,0x58,0x6f,0x39,0x76,0xb2,0xa3,0x6c,0x38,0x56,0x1d,0xaf,
+ 0x5a,0xe8,0x04,0x51,0x6b,0xbe,0xff,0xa9,0xb3,0x33,0xd5,0x9f,0x1b,0xc5,0xd0,0x6b,
+ 0x56,0x4b,0xab,0x50,0x1c,0xe9,0x0c,0x98,0xc5,0x62,0xfe,0x80,0x57,0x39,0xac,0x28,
+ 0xc7,0xed,0xbc,0xa6,0xe3,0x12,0x89,0x76,0x88,0x7c,0x2c,0x33,0xc9,0xe8,0xb3,0x50,
+ 0xda,0x47,0xbd,0x20,0xe5,0xbf,0x3b,0xce,0x4f,0x7c,0xbb,0xe0,0xe8,0xc8,0xa6,0xcb,
+ 0x6d,0x34,0x4a,0x43,0xb8,0x4d,0x19,0xbf,0x7f,0x6d,0x41,0x60,0x7b,0x2a,0x8f,0x7d,
+ };
+
+//unaligned little endian reads -------------------------------------------------------------------
+inline uint32_t vh_rd32(const BYTE*p) { uint32_t v; memcpy(&v,p,4); return v; }
+inline uint64_t vh_rd64(const BYTE*p) { uint64_t v; memcpy(&v,p,8); return v; }
+inline void vh_wr64(BYTE*p,uint64_t v) { memcpy(p,&v,8); }
+inline uint64_t vh_rotl64(uint64_t v,int r) { return (v<<r)|(v>>(64-r)); }
+inline uint64_t vh_bswap64(uint64_t v)
+{
+v=((v&0x00FF00FF00FF00FFull)<<8)|((v>>8)&0x00FF00FF00FF00FFull);
+v=((v&0x0000FFFF0000FFFFull)<<16)|((v>>16)&0x0000FFFF0000FFFFull);
+return (v<<32)|(v>>32);
+}
+
+//64x64->128 multiply folded to 64 bits (lo^hi) -------------------------------------------------
+inline uint64_t vh_mulfold64(uint64_t a,uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+unsigned __int128 r=(unsigned __int128)a*b;
+return (uint64_t)r^(uint64_t)(r>>64);
+#elif defined(_MSC_VER)&&defined(_M_X64)
+uint64_t hi,lo=_umul128(a,b,&hi);
+return lo^hi;
+#else
+uint64_t lolo=(a&0xFFFFFFFF)*(b&0xFFFFFFFF),hilo=(a>>32)*(b&0xFFFFFFFF);
+uint64_t lohi=(a&0xFFFFFFFF)*(b>>32),hihi=(a>>32)*(b>>32);
+uint64_t cross=(lolo>>32)+(hilo&0xFFFFFFFF)+lohi;
+return ((cross<<32)|(lolo&0xFFFFFFFF))^(hihi+(hilo>>32)+(cross>>32));
+#endif
+}
+
+//final mixers -----------------------------------------------------------------------------------
+inline uint64_t vh_avalanche(uint64_t h)
+{
+h^=h>>37;
+h*=0x165667919E3779F9ull;
+return h^(h>>32);
+}
+inline uint64_t vh_avalanche64(uint64_t h) //xxh64 style
+{
+h^=h>>33; h*=VH_P64_2;
+h^=h>>29; h*=VH_P64_3;
+return h^(h>>32);
+}
+inline uint64_t vh_rrmxmx(uint64_t h,uint64_t len)
+{
+h^=vh_rotl64(h,49)^vh_rotl64(h,24);
+h*=0x9FB21C651E98DF25ull;
+h^=(h>>35)+len;
+h*=0x9FB21C651E98DF25ull;
+return h^(h>>28);
+}
+inline uint64_t vh_mix16(const BYTE*p,const BYTE*s,uint64_t seed)
+{
+return vh_mulfold64(vh_rd64(p)^(vh_rd64(s)+seed),vh_rd64(p+8)^(vh_rd64(s+8)-seed));
+}
+
+//0..240 bytes -----------------------------------------------------------------------------------
+inline uint64_t vh_short64(const BYTE*p,size_t len,const BYTE*s,uint64_t seed)
+{
+if(len<=16)
+ {
+ if(len>8)
+  {
+  uint64_t lo=vh_rd64(p)^((vh_rd64(s+24)^vh_rd64(s+32))+seed);
+  uint64_t hi=vh_rd64(p+len-8)^((vh_rd64(s+40)^vh_rd64(s+48))-seed);
+  return vh_avalanche(len+vh_bswap64(lo)+hi+vh_mulfold64(lo,hi));
+  }
+ if(len>=4)
+  {
+  uint64_t in64=vh_rd32(p+len-4)+((uint64_t)vh_rd32(p)<<32);
+  return vh_rrmxmx(in64^((vh_rd64(s+8)^vh_rd64(s+16))-seed),len);
+  }
+ if(len)
+  {
+  uint32_t comb=((uint32_t)p[0]<<16)|((uint32_t)p[len>>1]<<24)|p[len-1]|((uint32_t)len<<8);
+  return vh_avalanche64(comb^((uint64_t)(vh_rd32(s)^vh_rd32(s+4))+seed));
+  }
+ return vh_avalanche64(seed^vh_rd64(s+56)^vh_rd64(s+64));
+ }
+uint64_t acc=len*VH_P64_1;
+if(len<=128)
+ {
+ if(len>32)
+  {
+  if(len>64)
+   {
+   if(len>96)
+    acc+=vh_mix16(p+48,s+96,seed)+vh_mix16(p+len-64,s+112,seed);
+   acc+=vh_mix16(p+32,s+64,seed)+vh_mix16(p+len-48,s+80,seed);
+   }
+  acc+=vh_mix16(p+16,s+32,seed)+vh_mix16(p+len-32,s+48,seed);
+  }
+ acc+=vh_mix16(p,s,seed)+vh_mix16(p+len-16,s+16,seed);
+ return vh_avalanche(acc);
+ }
+NAT i,nr=(NAT)(len/16);
+for(i=0;i<8;i++)
+ acc+=vh_mix16(p+16*i,s+16*i,seed);
+acc=vh_avalanche(acc);
+for(i=8;i<nr;i++)
+ acc+=vh_mix16(p+16*i,s+16*(i-8)+3,seed);
+acc+=vh_mix16(p+len-16,s+136-17,seed);
+return vh_avalanche(acc);
+}
+
+//one 64B stripe into 8 accumulators: acc[i]+=lo32(d^k)*hi32(d^k), acc[i^1]+=d -------------------
+inline void vh_accumulate512(uint64_t*acc,const BYTE*p,const BYTE*s)
+{
+#if defined(VHASH_AVX2)
+for(int i=0;i<2;i++)
+ {
+ __m256i d=_mm256_loadu_si256((const __m256i*)p+i);
+ __m256i dk=_mm256_xor_si256(d,_mm256_loadu_si256((const __m256i*)s+i));
+ __m256i prod=_mm256_mul_epu32(dk,_mm256_srli_epi64(dk,32));
+ __m256i a=_mm256_loadu_si256((__m256i*)acc+i);
+ a=_mm256_add_epi64(a,_mm256_shuffle_epi32(d,_MM_SHUFFLE(1,0,3,2)));
+ _mm256_storeu_si256((__m256i*)acc+i,_mm256_add_epi64(a,prod));
+ }
+#elif defined(VHASH_SSE2)
+for(int i=0;i<4;i++)
+ {
+ __m128i d=_mm_loadu_si128((const __m128i*)p+i);
+ __m128i dk=_mm_xor_si128(d,_mm_loadu_si128((const __m128i*)s+i));
+ __m128i prod=_mm_mul_epu32(dk,_mm_srli_epi64(dk,32));
+ __m128i a=_mm_loadu_si128((__m128i*)acc+i);
+ a=_mm_add_epi64(a,_mm_shuffle_epi32(d,_MM_SHUFFLE(1,0,3,2)));
+ _mm_storeu_si128((__m128i*)acc+i,_mm_add_epi64(a,prod));
+ }
+#else
+for(int i=0;i<8;i++)
+ {
+ uint64_t d=vh_rd64(p+8*i),dk=d^vh_rd64(s+8*i);
+ acc[i^1]+=d;
+ acc[i]+=(dk&0xFFFFFFFF)*(dk>>32);
+ }
+#endif
+}
+
+//acc=(acc^(acc>>47)^key)*P32_1 ------------------------------------------------------------------
+inline void vh_scramble(uint64_t*acc,const BYTE*s)
+{
+#if defined(VHASH_AVX2)
+const __m256i prime=_mm256_set1_epi32((int)VH_P32_1);
+for(int i=0;i<2;i++)
+ {
+ __m256i a=_mm256_loadu_si256((__m256i*)acc+i);
+ a=_mm256_xor_si256(a,_mm256_srli_epi64(a,47));
+ a=_mm256_xor_si256(a,_mm256_loadu_si256((const __m256i*)s+i));
+ __m256i lo=_mm256_mul_epu32(a,prime),hi=_mm256_mul_epu32(_mm256_srli_epi64(a,32),prime);
+ _mm256_storeu_si256((__m256i*)acc+i,_mm256_add_epi64(lo,_mm256_slli_epi64(hi,32)));
+ }
+#elif defined(VHASH_SSE2)
+const __m128i prime=_mm_set1_epi32((int)VH_P32_1);
+for(int i=0;i<4;i++)
+ {
+ __m128i a=_mm_loadu_si128((__m128i*)acc+i);
+ a=_mm_xor_si128(a,_mm_srli_epi64(a,47));
+ a=_mm_xor_si128(a,_mm_loadu_si128((const __m128i*)s+i));
+ __m128i lo=_mm_mul_epu32(a,prime),hi=_mm_mul_epu32(_mm_srli_epi64(a,32),prime);
+ _mm_storeu_si128((__m128i*)acc+i,_mm_add_epi64(lo,_mm_slli_epi64(hi,32)));
+ }
+#else
+for(int i=0;i<8;i++)
+ {
+ uint64_t a=acc[i];
+ a^=a>>47;
+ a^=vh_rd64(s+8*i);
+ acc[i]=a*VH_P32_1;
+ }
+#endif
+}
+
+//>240 bytes: fills the 8 accumulators ------------------------------------------------------------
+inline void vh_long(uint64_t*acc,const BYTE*p,size_t len,const BYTE*s)
+{
+const size_t blocksz=VH_STRIPE*VH_BLOCKSTRP;
+size_t b,nrblocks=(len-1)/blocksz;
+NAT n,nrstripes;
+acc[0]=VH_P32_3; acc[1]=VH_P64_1; acc[2]=VH_P64_2; acc[3]=VH_P64_3;
+acc[4]=VH_P64_4; acc[5]=VH_P32_2; acc[6]=VH_P64_5; acc[7]=VH_P32_1;
+for(b=0;b<nrblocks;b++,p+=blocksz)
+ {
+ for(n=0;n<VH_BLOCKSTRP;n++)
+  vh_accumulate512(acc,p+n*VH_STRIPE,s+n*8);
+ vh_scramble(acc,s+VH_SECRETSZ-VH_STRIPE);
+ }
+len-=nrblocks*blocksz;
+nrstripes=(NAT)((len-1)/VH_STRIPE);
+for(n=0;n<nrstripes;n++)
+ vh_accumulate512(acc,p+n*VH_STRIPE,s+n*8);
+vh_accumulate512(acc,p+len-VH_STRIPE,s+VH_SECRETSZ-VH_STRIPE-7); //last (overlapping) stripe
+}
+
+inline uint64_t vh_merge(const uint64_t*acc,const BYTE*s,uint64_t start)
+{
+for(int i=0;i<4;i++)
+ start+=vh_mulfold64(acc[2*i]^vh_rd64(s+16*i),acc[2*i+1]^vh_rd64(s+16*i+8));
+return vh_avalanche(start);
+}
+
+//a seeded hash uses a secret derived from the default one (only for long inputs) ----------------
+inline void vh_seedsecret(BYTE*dst,uint64_t seed)
+{
+for(int i=0;i<VH_SECRETSZ;i+=16)
+ {
+ vh_wr64(dst+i,vh_rd64(VHashSecret+i)+seed);
+ vh_wr64(dst+i+8,vh_rd64(VHashSecret+i+8)-seed);
+ }
+}
+
+//64 bit hash ----------------------------------------------------------------------------------------
+inline uint64_t VHash64(const void*msg,size_t msgszB,uint64_t seed=0)
+{
+const BYTE*p=(const BYTE*)msg;
+if(msgszB<=VH_MIDMAX)
+ return vh_short64(p,msgszB,VHashSecret,seed);
+uint64_t acc[8];
+BYTE secret[VH_SECRETSZ];
+const BYTE*s=VHashSecret;
+if(seed)
+ {
+ vh_seedsecret(secret,seed);
+ s=secret;
+ }
+vh_long(acc,p,msgszB,s);
+return vh_merge(acc,s+11,msgszB*VH_P64_1);
+}
+
+//128 bit hash (short inputs are hashed twice with independent seeds) --------------------------------
+inline VHASH128 VHash128(const void*msg,size_t msgszB,uint64_t seed=0)
+{
+VHASH128 h;
+const BYTE*p=(const BYTE*)msg;
+if(msgszB<=VH_MIDMAX)
+ {
+ h.lo=vh_short64(p,msgszB,VHashSecret,seed);
+ h.hi=vh_short64(p,msgszB,VHashSecret,seed^VH_P64_4);
+ return h;
+ }
+uint64_t acc[8];
+BYTE secret[VH_SECRETSZ];
+const BYTE*s=VHashSecret;
+if(seed)
+ {
+ vh_seedsecret(secret,seed);
+ s=secret;
+ }
+vh_long(acc,p,msgszB,s);
+h.lo=vh_merge(acc,s+11,msgszB*VH_P64_1);
+h.hi=vh_merge(acc,s+VH_SECRETSZ-VH_STRIPE-11,~(msgszB*VH_P64_2));
+return h;
+}
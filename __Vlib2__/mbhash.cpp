@@ -0,0 +1,643 @@
+#pragma once
+#define V_MBHASH //multi-buffer MD5/SHA-1: 4 lanes (SSE2), 8 lanes (AVX2), SHA-NI for single streams
+
+#include <string.h>
+#include <stdint.h>
+
+#if defined(_M_X64)||defined(__x86_64__)||defined(__SSE2__)||(defined(_M_IX86_FP)&&_M_IX86_FP>=2)
+ #define VMB_SSE2
+ #include <emmintrin.h>
+ #if defined(_MSC_VER) //MSVC compiles any intrinsic, use is decided at run time by MBHashCPU()
+  #include <intrin.h>
+  #include <immintrin.h>
+  #define VMB_AVX2
+  #define VMB_SHANI
+ #else
+  #include <cpuid.h>
+  #include <immintrin.h>
+  #if defined(__AVX2__)
+   #define VMB_AVX2
+  #endif
+  #if defined(__SHA__)&&defined(__SSE4_1__)
+   #define VMB_SHANI
+  #endif
+ #endif
+#endif
+
+#ifndef HASH_SHA1 //same ids as HashX (dt_cc.cpp)
+ #define HASH_SHA1 1
+ #define HASH_MD5  5
+#endif
+
+#define MBHASH_MAXLANES    8
+#define MBHASH_BATCH      64 //files read ahead by MBHashFiles
+#define MBHASH_BIGFILE    0x400000 //files above this are hashed as a single stream (4MB)
+#define MBHASH_CHUNK      0x100000 //read size for big files (1MB)
+
+#define VMB_CPU_AVX2     0x1
+#define VMB_CPU_SHANI    0x2
+
+//one message to hash -------------------------------------------------------------------------------
+struct MBHASH_JOB
+{
+ const BYTE*msg;
+ size_t szB;
+ BYTE*digest; //16B for MD5, 20B for SHA-1 (same bytes as md5_finish/SHA1Result)
+};
+
+//CPU features usable by the SIMD paths (cached) --------------------------------------------------
+inline NAT MBHashCPU()
+{
+static int feat=-1;
+if(feat>=0) return feat;
+feat=0;
+#if defined(VMB_SSE2)
+unsigned r[4]={0},r7[4]={0};
+#if defined(_MSC_VER)
+__cpuid((int*)r,0);
+if(r[0]>=7)
+ {
+ __cpuidex((int*)r7,7,0);
+ __cpuid((int*)r,1);
+ }
+#else
+__get_cpuid(0,&r[0],&r[1],&r[2],&r[3]);
+if(r[0]>=7)
+ {
+ __get_cpuid_count(7,0,&r7[0],&r7[1],&r7[2],&r7[3]);
+ __get_cpuid(1,&r[0],&r[1],&r[2],&r[3]);
+ }
+#endif
+if((r7[1]>>29)&1&&(r[2]>>19)&1) //SHA + SSE4.1
+ feat|=VMB_CPU_SHANI;
+if((r7[1]>>5)&1&&(r[2]>>27)&1) //AVX2 + OSXSAVE
+ {
+ #if defined(_MSC_VER)
+ unsigned __int64 xcr0=_xgetbv(0);
+ #else
+ unsigned lo,hi;
+ __asm__ __volatile__("xgetbv":"=a"(lo),"=d"(hi):"c"(0));
+ uint64_t xcr0=((uint64_t)hi<<32)|lo;
+ #endif
+ if((xcr0&6)==6) //OS saves YMM
+  feat|=VMB_CPU_AVX2;
+ }
+#endif
+return feat;
+}
+
+//Lane traits: R holds one 32 bit word per lane; words() transposes 16 LE words from each lane's block
+//scalar (1 lane) ...................................................................................
+struct VMB_V1
+{
+ typedef uint32_t R;
+ enum { N=1 };
+ static R add(R a,R b) { return a+b; }
+ static R xor_(R a,R b) { return a^b; }
+ static R and_(R a,R b) { return a&b; }
+ static R or_(R a,R b) { return a|b; }
+ static R andn(R a,R b) { return ~a&b; }
+ static R not_(R a) { return ~a; }
+ static R set1(uint32_t v) { return v; }
+ static R rotl(R a,int n) { return (a<<n)|(a>>(32-n)); }
+ static R bswap(R a) { return (a<<24)|((a<<8)&0xff0000)|((a>>8)&0xff00)|(a>>24); }
+ static R load(const uint32_t*p) { return *p; }
+ static void store(uint32_t*p,R a) { *p=a; }
+ static void words(R*w,const BYTE*const*blk) { memcpy(w,blk[0],64); }
+};
+
+#if defined(VMB_SSE2)
+//4 lanes .............................................................................................
+struct VMB_V128
+{
+ typedef __m128i R;
+ enum { N=4 };
+ static R add(R a,R b) { return _mm_add_epi32(a,b); }
+ static R xor_(R a,R b) { return _mm_xor_si128(a,b); }
+ static R and_(R a,R b) { return _mm_and_si128(a,b); }
+ static R or_(R a,R b) { return _mm_or_si128(a,b); }
+ static R andn(R a,R b) { return _mm_andnot_si128(a,b); }
+ static R not_(R a) { return _mm_xor_si128(a,_mm_set1_epi32(-1)); }
+ static R set1(uint32_t v) { return _mm_set1_epi32((int)v); }
+ static R rotl(R a,int n) { return _mm_or_si128(_mm_slli_epi32(a,n),_mm_srli_epi32(a,32-n)); }
+ static R bswap(R a)
+ {
+ a=_mm_or_si128(_mm_slli_epi16(a,8),_mm_srli_epi16(a,8)); //swap bytes in words
+ return _mm_shufflelo_epi16(_mm_shufflehi_epi16(a,0xB1),0xB1); //swap words
+ }
+ static R load(const uint32_t*p) { return _mm_loadu_si128((const R*)p); }
+ static void store(uint32_t*p,R a) { _mm_storeu_si128((R*)p,a); }
+ static void words(R*w,const BYTE*const*blk)
+ {
+ for(int j=0;j<4;j++)
+  {
+  R r0=_mm_loadu_si128((const R*)blk[0]+j),r1=_mm_loadu_si128((const R*)blk[1]+j);
+  R r2=_mm_loadu_si128((const R*)blk[2]+j),r3=_mm_loadu_si128((const R*)blk[3]+j);
+  R t0=_mm_unpacklo_epi32(r0,r1),t1=_mm_unpacklo_epi32(r2,r3);
+  R t2=_mm_unpackhi_epi32(r0,r1),t3=_mm_unpackhi_epi32(r2,r3);
+  w[4*j]=_mm_unpacklo_epi64(t0,t1);
+  w[4*j+1]=_mm_unpackhi_epi64(t0,t1);
+  w[4*j+2]=_mm_unpacklo_epi64(t2,t3);
+  w[4*j+3]=_mm_unpackhi_epi64(t2,t3);
+  }
+ }
+};
+#endif
+
+#if defined(VMB_AVX2)
+//8 lanes (lanes 0-3 in the low half, 4-7 in the high half) ..........................................
+struct VMB_V256
+{
+ typedef __m256i R;
+ enum { N=8 };
+ static R add(R a,R b) { return _mm256_add_epi32(a,b); }
+ static R xor_(R a,R b) { return _mm256_xor_si256(a,b); }
+ static R and_(R a,R b) { return _mm256_and_si256(a,b); }
+ static R or_(R a,R b) { return _mm256_or_si256(a,b); }
+ static R andn(R a,R b) { return _mm256_andnot_si256(a,b); }
+ static R not_(R a) { return _mm256_xor_si256(a,_mm256_set1_epi32(-1)); }
+ static R set1(uint32_t v) { return _mm256_set1_epi32((int)v); }
+ static R rotl(R a,int n) { return _mm256_or_si256(_mm256_slli_epi32(a,n),_mm256_srli_epi32(a,32-n)); }
+ static R bswap(R a)
+ {
+ const R m=_mm256_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
+ return _mm256_shuffle_epi8(a,m);
+ }
+ static R load(const uint32_t*p) { return _mm256_loadu_si256((const R*)p); }
+ static void store(uint32_t*p,R a) { _mm256_storeu_si256((R*)p,a); }
+ static void words(R*w,const BYTE*const*blk)
+ {
+ R r[4];
+ for(int j=0;j<4;j++)
+  {
+  for(int k=0;k<4;k++)
+   r[k]=_mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)blk[k]+j)),_mm_loadu_si128((const __m128i*)blk[k+4]+j),1);
+  R t0=_mm256_unpacklo_epi32(r[0],r[1]),t1=_mm256_unpacklo_epi32(r[2],r[3]);
+  R t2=_mm256_unpackhi_epi32(r[0],r[1]),t3=_mm256_unpackhi_epi32(r[2],r[3]);
+  w[4*j]=_mm256_unpacklo_epi64(t0,t1);
+  w[4*j+1]=_mm256_unpackhi_epi64(t0,t1);
+  w[4*j+2]=_mm256_unpacklo_epi64(t2,t3);
+  w[4*j+3]=_mm256_unpackhi_epi64(t2,t3);
+  }
+ }
+};
+#endif
+
+//MD5 compression of one 64B block per lane (RFC 1321) --------------------------------------------
+static const uint32_t VMB_MD5T[64]={
+ 0xd76aa478,0xe8c7b756,0x242070db,0xc1bdceee,0xf57c0faf,0x4787c62a,0xa8304613,0xfd469501,
+ 0x698098d8,0x8b44f7af,0xffff5bb1,0x895cd7be,0x6b901122,0xfd987193,0xa679438e,0x49b40821,
+ 0xf61e2562,0xc040b340,0x265e5a51,0xe9b6c7aa,0xd62f105d,0x02441453,0xd8a1e681,0xe7d3fbc8,
+ 0x21e1cde6,0xc33707d6,0xf4d50d87,0x455a14ed,0xa9e3e905,0xfcefa3f8,0x676f02d9,0x8d2a4c8a,
+ 0xfffa3942,0x8771f681,0x6d9d6122,0xfde5380c,0xa4beea44,0x4bdecfa9,0xf6bb4b60,0xbebfbc70,
+ 0x289b7ec6,0xeaa127fa,0xd4ef3085,0x04881d05,0xd9d4d039,0xe6db99e5,0x1fa27cf8,0xc4ac5665,
+ 0xf4292244,0x432aff97,0xab9423a7,0xfc93a039,0x655b59c3,0x8f0ccc92,0xffeff47d,0x85845dd1,
+ 0x6fa87e4f,0xfe2ce6e0,0xa3014314,0x4e0811a1,0xf7537e82,0xbd3af235,0x2ad7d2bb,0xeb86d391,
+ };
+static const BYTE VMB_MD5S[16]={7,12,17,22,5,9,14,20,4,11,16,23,6,10,15,21};
+
+template <class V> void vmb_md5(uint32_t*st,const BYTE*const*blk)
+{
+typedef typename V::R R;
+R w[16],f,t;
+R a=V::load(st),b=V::load(st+V::N),c=V::load(st+2*V::N),d=V::load(st+3*V::N);
+R a0=a,b0=b,c0=c,d0=d;
+int i;
+V::words(w,blk);
+#define VMB_MD5STEP(fun,k) t=d; d=c; c=b; \
+  b=V::add(b,V::rotl(V::add(V::add(a,fun),V::add(w[k],V::set1(VMB_MD5T[i]))),VMB_MD5S[((i>>4)<<2)|(i&3)])); a=t;
+for(i=0;i<16;i++)
+ {
+ f=V::or_(V::and_(b,c),V::andn(b,d));
+ VMB_MD5STEP(f,i)
+ }
+for(;i<32;i++)
+ {
+ f=V::or_(V::and_(b,d),V::andn(d,c));
+ VMB_MD5STEP(f,(5*i+1)&15)
+ }
+for(;i<48;i++)
+ {
+ f=V::xor_(V::xor_(b,c),d);
+ VMB_MD5STEP(f,(3*i+5)&15)
+ }
+for(;i<64;i++)
+ {
+ f=V::xor_(c,V::or_(b,V::not_(d)));
+ VMB_MD5STEP(f,(7*i)&15)
+ }
+#undef VMB_MD5STEP
+V::store(st,V::add(a,a0));
+V::store(st+V::N,V::add(b,b0));
+V::store(st+2*V::N,V::add(c,c0));
+V::store(st+3*V::N,V::add(d,d0));
+}
+
+//SHA-1 compression of one 64B block per lane (FIPS 180) ------------------------------------------
+template <class V> void vmb_sha1(uint32_t*st,const BYTE*const*blk)
+{
+typedef typename V::R R;
+R w[16],f,t;
+R a=V::load(st),b=V::load(st+V::N),c=V::load(st+2*V::N),d=V::load(st+3*V::N),e=V::load(st+4*V::N);
+R a0=a,b0=b,c0=c,d0=d,e0=e,k;
+int i;
+V::words(w,blk);
+for(i=0;i<16;i++)
+ w[i]=V::bswap(w[i]);
+#define VMB_SHA1STEP if(i>=16) w[i&15]=V::rotl(V::xor_(V::xor_(w[(i-3)&15],w[(i-8)&15]),V::xor_(w[(i-14)&15],w[i&15])),1); \
+  t=V::add(V::add(V::rotl(a,5),f),V::add(V::add(e,w[i&15]),k)); e=d; d=c; c=V::rotl(b,30); b=a; a=t;
+for(i=0,k=V::set1(0x5A827999);i<20;i++)
+ {
+ f=V::or_(V::and_(b,c),V::andn(b,d));
+ VMB_SHA1STEP
+ }
+for(k=V::set1(0x6ED9EBA1);i<40;i++)
+ {
+ f=V::xor_(V::xor_(b,c),d);
+ VMB_SHA1STEP
+ }
+for(k=V::set1(0x8F1BBCDC);i<60;i++)
+ {
+ f=V::or_(V::and_(b,c),V::and_(d,V::or_(b,c)));
+ VMB_SHA1STEP
+ }
+for(k=V::set1(0xCA62C1D6);i<80;i++)
+ {
+ f=V::xor_(V::xor_(b,c),d);
+ VMB_SHA1STEP
+ }
+#undef VMB_SHA1STEP
+V::store(st,V::add(a,a0));
+V::store(st+V::N,V::add(b,b0));
+V::store(st+2*V::N,V::add(c,c0));
+V::store(st+3*V::N,V::add(d,d0));
+V::store(st+4*V::N,V::add(e,e0));
+}
+
+#if defined(VMB_SHANI)
+//SHA-1 with SHA extensions, nrblk consecutive 64B blocks of one stream ----------------------------
+inline void vmb_sha1_ni(uint32_t*st,const BYTE*data,size_t nrblk)
+{
+const __m128i mask=_mm_set_epi64x(0x0001020304050607LL,0x08090a0b0c0d0e0fLL);
+__m128i abcd=_mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)st),0x1B);
+__m128i e0=_mm_set_epi32((int)st[4],0,0,0),e1,abcd0,e00,msg[4];
+for(;nrblk;nrblk--,data+=64)
+ {
+ abcd0=abcd;
+ e00=e0;
+ //rounds 0-15
+ msg[0]=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data),mask);
+ e0=_mm_add_epi32(e0,msg[0]);
+ e1=abcd;
+ abcd=_mm_sha1rnds4_epu32(abcd,e0,0);
+ msg[1]=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data+1),mask);
+ e1=_mm_sha1nexte_epu32(e1,msg[1]);
+ e0=abcd;
+ abcd=_mm_sha1rnds4_epu32(abcd,e1,0);
+ msg[0]=_mm_sha1msg1_epu32(msg[0],msg[1]);
+ msg[2]=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data+2),mask);
+ e0=_mm_sha1nexte_epu32(e0,msg[2]);
+ e1=abcd;
+ abcd=_mm_sha1rnds4_epu32(abcd,e0,0);
+ msg[1]=_mm_sha1msg1_epu32(msg[1],msg[2]);
+ msg[0]=_mm_xor_si128(msg[0],msg[2]);
+ msg[3]=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data+3),mask);
+ e1=_mm_sha1nexte_epu32(e1,msg[3]);
+ e0=abcd;
+ msg[0]=_mm_sha1msg2_epu32(msg[0],msg[3]);
+ abcd=_mm_sha1rnds4_epu32(abcd,e1,0);
+ msg[2]=_mm_sha1msg1_epu32(msg[2],msg[3]);
+ msg[1]=_mm_xor_si128(msg[1],msg[3]);
+ //rounds 16-79, 4 per group (extra schedule words computed in the last groups are unused)
+ #define VMB_SHANI_GROUP(g,E,F) E=_mm_sha1nexte_epu32(E,msg[(g)&3]); F=abcd; \
+   msg[((g)+1)&3]=_mm_sha1msg2_epu32(msg[((g)+1)&3],msg[(g)&3]); abcd=_mm_sha1rnds4_epu32(abcd,E,(g)/5); \
+   msg[((g)+3)&3]=_mm_sha1msg1_epu32(msg[((g)+3)&3],msg[(g)&3]); msg[((g)+2)&3]=_mm_xor_si128(msg[((g)+2)&3],msg[(g)&3]);
+ VMB_SHANI_GROUP(4,e0,e1) VMB_SHANI_GROUP(5,e1,e0) VMB_SHANI_GROUP(6,e0,e1) VMB_SHANI_GROUP(7,e1,e0)
+ VMB_SHANI_GROUP(8,e0,e1) VMB_SHANI_GROUP(9,e1,e0) VMB_SHANI_GROUP(10,e0,e1) VMB_SHANI_GROUP(11,e1,e0)
+ VMB_SHANI_GROUP(12,e0,e1) VMB_SHANI_GROUP(13,e1,e0) VMB_SHANI_GROUP(14,e0,e1) VMB_SHANI_GROUP(15,e1,e0)
+ VMB_SHANI_GROUP(16,e0,e1) VMB_SHANI_GROUP(17,e1,e0) VMB_SHANI_GROUP(18,e0,e1) VMB_SHANI_GROUP(19,e1,e0)
+ #undef VMB_SHANI_GROUP
+ e0=_mm_sha1nexte_epu32(e0,e00);
+ abcd=_mm_add_epi32(abcd,abcd0);
+ }
+_mm_storeu_si128((__m128i*)st,_mm_shuffle_epi32(abcd,0x1B));
+st[4]=(uint32_t)_mm_extract_epi32(e0,3);
+}
+#endif
+
+//initial state ----------------------------------------------------------------------------------
+inline void vmb_init(int method,uint32_t*st,NAT stride=1)
+{
+st[0]=0x67452301;
+st[stride]=0xEFCDAB89;
+st[2*stride]=0x98BADCFE;
+st[3*stride]=0x10325476;
+if(method==HASH_SHA1)
+ st[4*stride]=0xC3D2E1F0;
+}
+
+//builds the 1 or 2 padding blocks from the last szB%64 bytes; returns number of blocks -------------
+inline NAT vmb_pad(int method,BYTE*tail,const BYTE*last,uint64_t szB)
+{
+NAT rem=(NAT)(szB&63),nrblk=rem+9>64?2:1;
+uint64_t bits=szB<<3;
+memcpy(tail,last,rem);
+tail[rem]=0x80;
+memset(tail+rem+1,0,nrblk*64-rem-1);
+for(int i=0;i<8;i++)
+ tail[nrblk*64-8+i]=(BYTE)(method==HASH_SHA1?bits>>(56-8*i):bits>>(8*i));
+return nrblk;
+}
+
+inline void vmb_digest(int method,BYTE*digest,const uint32_t*st,NAT stride=1)
+{
+if(method==HASH_SHA1)
+ for(int i=0;i<20;i++)
+  digest[i]=(BYTE)(st[(i>>2)*stride]>>(8*(3-(i&3))));
+else
+ for(int i=0;i<16;i++)
+  digest[i]=(BYTE)(st[(i>>2)*stride]>>(8*(i&3)));
+}
+
+//compress consecutive blocks of one stream ---------------------------------------------------------
+inline void vmb_blocks1(int method,uint32_t*st,const BYTE*data,size_t nrblk)
+{
+#if defined(VMB_SHANI)
+if(method==HASH_SHA1&&(MBHashCPU()&VMB_CPU_SHANI))
+ {
+ vmb_sha1_ni(st,data,nrblk);
+ return;
+ }
+#endif
+for(;nrblk;nrblk--,data+=64)
+ if(method==HASH_SHA1)
+  vmb_sha1<VMB_V1>(st,&data);
+ else
+  vmb_md5<VMB_V1>(st,&data);
+}
+
+//Lane scheduler: each lane runs its own job; a lane that finishes picks up the next one --------------
+template <class V> void vmb_run(int method,MBHASH_JOB*job,NAT nrjobs)
+{
+struct VMB_LANE
+ {
+ const BYTE*p; //next full block in message
+ size_t full; //full blocks left
+ BYTE tail[128]; //padding blocks
+ NAT nrtail,tailpos;
+ MBHASH_JOB*job;
+ } lane[V::N];
+static const BYTE idle[64]={0}; //block fed to lanes without work
+uint32_t st[5*V::N];
+const BYTE*blk[V::N];
+NAT l,next=0,active=0;
+for(l=0;l<V::N;l++)
+ {
+ lane[l].job=NULL;
+ if(next<nrjobs)
+  {
+  VMB_LANE&ln=lane[l];
+  ln.job=job+next++;
+  ln.p=ln.job->msg;
+  ln.full=ln.job->szB>>6;
+  ln.nrtail=vmb_pad(method,ln.tail,ln.job->msg+(ln.job->szB&~(size_t)63),ln.job->szB);
+  ln.tailpos=0;
+  vmb_init(method,st+l,V::N);
+  active++;
+  }
+ }
+while(active)
+ {
+ for(l=0;l<V::N;l++)
+  if(!lane[l].job) blk[l]=idle;
+  else if(lane[l].full) blk[l]=lane[l].p;
+  else blk[l]=lane[l].tail+(lane[l].tailpos<<6);
+ if(method==HASH_SHA1)
+  vmb_sha1<V>(st,blk);
+ else
+  vmb_md5<V>(st,blk);
+ for(l=0;l<V::N;l++)
+  {
+  VMB_LANE&ln=lane[l];
+  if(!ln.job) continue;
+  if(ln.full)
+   {
+   ln.full--;
+   ln.p+=64;
+   continue;
+   }
+  if(++ln.tailpos<ln.nrtail) continue;
+  vmb_digest(method,ln.job->digest,st+l,V::N);
+  ln.job=NULL;
+  active--;
+  if(next<nrjobs)
+   {
+   ln.job=job+next++;
+   ln.p=ln.job->msg;
+   ln.full=ln.job->szB>>6;
+   ln.nrtail=vmb_pad(method,ln.tail,ln.job->msg+(ln.job->szB&~(size_t)63),ln.job->szB);
+   ln.tailpos=0;
+   vmb_init(method,st+l,V::N);
+   active++;
+   }
+  }
+ }
+}
+
+//Hash independent messages, as many in parallel as the CPU has lanes ---------------------------------
+void MBHash(int method,MBHASH_JOB*job,NAT nrjobs)
+{
+if(!nrjobs) return;
+#if defined(VMB_SHANI)
+if(method==HASH_SHA1&&nrjobs==1&&(MBHashCPU()&VMB_CPU_SHANI))
+ {
+ uint32_t st[5];
+ BYTE tail[128];
+ vmb_init(method,st);
+ vmb_sha1_ni(st,job->msg,job->szB>>6);
+ vmb_sha1_ni(st,tail,vmb_pad(method,tail,job->msg+(job->szB&~(size_t)63),job->szB));
+ vmb_digest(method,job->digest,st);
+ return;
+ }
+#endif
+#if defined(VMB_AVX2)
+if(nrjobs>4&&(MBHashCPU()&VMB_CPU_AVX2))
+ {
+ vmb_run<VMB_V256>(method,job,nrjobs);
+ return;
+ }
+#endif
+#if defined(VMB_SSE2)
+if(nrjobs>1)
+ {
+ vmb_run<VMB_V128>(method,job,nrjobs);
+ return;
+ }
+#endif
+vmb_run<VMB_V1>(method,job,nrjobs);
+}
+
+//Incremental single stream (used for big files) ----------------------------------------------------
+struct MBHASH_CTX
+{
+ int method;
+ uint32_t st[5];
+ BYTE buf[64];
+ NAT bufnc;
+ uint64_t szB;
+//.................................................................................................
+ void Init(int lmethod=HASH_SHA1)
+ {
+ method=lmethod;
+ vmb_init(method,st);
+ bufnc=0;
+ szB=0;
+ }
+//.................................................................................................
+ void Update(const BYTE*data,size_t datasz)
+ {
+ szB+=datasz;
+ if(bufnc)
+  {
+  NAT n=(NAT)MIN((size_t)(64-bufnc),datasz);
+  memcpy(buf+bufnc,data,n);
+  bufnc+=n;
+  data+=n;
+  datasz-=n;
+  if(bufnc<64) return;
+  vmb_blocks1(method,st,buf,1);
+  bufnc=0;
+  }
+ vmb_blocks1(method,st,data,datasz>>6);
+ data+=datasz&~(size_t)63;
+ bufnc=(NAT)(datasz&63);
+ memcpy(buf,data,bufnc);
+ }
+//.................................................................................................
+ void Final(BYTE*digest)
+ {
+ BYTE tail[128];
+ NAT nrtail=vmb_pad(method,tail,buf,szB);
+ vmb_blocks1(method,st,tail,nrtail);
+ vmb_digest(method,digest,st);
+ }
+};
+
+//SHA-1 of one buffer (SHA-NI when available) ---------------------------------------------------------
+inline void SHA1Fast(const BYTE*msg,size_t szB,BYTE*digest)
+{
+MBHASH_JOB job={msg,szB,digest};
+MBHash(HASH_SHA1,&job,1);
+}
+
+#if defined(_WIN32)
+//one file of a read-ahead batch ......................................................................
+struct MBHASH_FILE
+{
+ HANDLE hf;
+ OVERLAPPED ov;
+ BYTE*buf;
+ DWORD szB;
+ FAIL err; //0=ok, 1=open, 2=read, -1=big (hashed as stream)
+};
+
+//opens the files and starts overlapped reads of their whole content .................................
+inline void vmb_readbatch(MBHASH_FILE*bf,LPSTR*path,NAT nr)
+{
+LARGE_INTEGER fsz;
+for(NAT i=0;i<nr;i++)
+ {
+ MBHASH_FILE&f=bf[i];
+ ZeroMemory(&f,sizeof(f));
+ f.hf=CreateFile(path[i],GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_FLAG_OVERLAPPED|FILE_FLAG_SEQUENTIAL_SCAN,NULL);
+ if(f.hf==INVALID_HANDLE_VALUE)
+  {
+  f.hf=NULL;
+  f.err=1;
+  continue;
+  }
+ GetFileSizeEx(f.hf,&fsz);
+ if(fsz.QuadPart>MBHASH_BIGFILE)
+  {
+  f.err=-1;
+  continue;
+  }
+ f.szB=fsz.LowPart;
+ f.buf=ALLOC_BYTE(f.szB?f.szB:1);
+ if(!f.szB) continue;
+ f.ov.hEvent=CreateEvent(NULL,TRUE,FALSE,NULL);
+ if(!ReadFile(f.hf,f.buf,f.szB,NULL,&f.ov)&&GetLastError()!=ERROR_IO_PENDING)
+  f.err=2;
+ }
+}
+
+//waits for the batch and hashes it in lanes .........................................................
+inline void vmb_hashbatch(int method,MBHASH_FILE*bf,LPSTR*path,NAT nr,BYTE*digests,FAIL*err)
+{
+MBHASH_JOB job[MBHASH_BATCH];
+NAT i,nrjobs=0,dsz=method==HASH_SHA1?20:16;
+DWORD rd;
+for(i=0;i<nr;i++)
+ {
+ MBHASH_FILE&f=bf[i];
+ if(f.ov.hEvent)
+  {
+  if(!f.err&&(!GetOverlappedResult(f.hf,&f.ov,&rd,TRUE)||rd!=f.szB))
+   f.err=2;
+  CloseHandle(f.ov.hEvent);
+  }
+ if(f.err==-1) //stream big files from a plain handle
+  {
+  MBHASH_CTX ctx;
+  HANDLE hs=CreateFile(path[i],GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,NULL);
+  BYTE*chunk=ALLOC_BYTE(MBHASH_CHUNK);
+  f.err=hs==INVALID_HANDLE_VALUE?1:0;
+  ctx.Init(method);
+  while(!f.err)
+   {
+   ifn(ReadFile(hs,chunk,MBHASH_CHUNK,&rd,NULL)) f.err=2;
+   if(!rd) break;
+   ctx.Update(chunk,rd);
+   }
+  if(!f.err) ctx.Final(digests+i*dsz);
+  if(hs!=INVALID_HANDLE_VALUE) CloseHandle(hs);
+  FREE(chunk);
+  }
+ else if(!f.err)
+  {
+  job[nrjobs].msg=f.buf;
+  job[nrjobs].szB=f.szB;
+  job[nrjobs].digest=digests+i*dsz;
+  nrjobs++;
+  }
+ if(f.err>0) ZeroMemory(digests+i*dsz,dsz);
+ if(err) err[i]=f.err;
+ }
+MBHash(method,job,nrjobs);
+for(i=0;i<nr;i++)
+ {
+ FREE(bf[i].buf);
+ if(bf[i].hf) CloseHandle(bf[i].hf);
+ }
+}
+
+//Fingerprint files: reads of batch k+1 are in flight while batch k is hashed; returns nr of files hashed
+NAT MBHashFiles(int method,LPSTR*path,NAT nrfiles,BYTE*digests,FAIL*err=NULL)
+{
+MBHASH_FILE*bf=(MBHASH_FILE*)ALLOC(2*MBHASH_BATCH*sizeof(MBHASH_FILE));
+NAT b,nr,nrnext,ok=0,dsz=method==HASH_SHA1?20:16;
+nr=MIN(nrfiles,MBHASH_BATCH);
+vmb_readbatch(bf,path,nr);
+for(b=0;b<nrfiles;b+=nr,nr=nrnext)
+ {
+ MBHASH_FILE*cur=bf+((b/MBHASH_BATCH)&1)*MBHASH_BATCH,*ahead=bf+(((b/MBHASH_BATCH)+1)&1)*MBHASH_BATCH;
+ nrnext=MIN(nrfiles-b-nr,MBHASH_BATCH);
+ if(nrnext) vmb_readbatch(ahead,path+b+nr,nrnext);
+ vmb_hashbatch(method,cur,path+b,nr,digests+b*dsz,err?err+b:NULL);
+ for(NAT i=0;i<nr;i++)
+  if(!cur[i].err) ok++;
+ }
+FREE(bf);
+return ok;
+}
+#endif
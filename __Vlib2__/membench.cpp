@@ -0,0 +1,352 @@
+#pragma once
+#define V_MEMBENCH //micro-benchmarks for the bas.cpp memory primitives, the str.cpp scans and number conversions, the BLTRGB kernels and UTREE::Dir against their old behavior
+
+#include <bas.cpp>
+#include <str.cpp>
+#include <rgb.cpp>
+#include <utree.cpp>
+
+//reference loops, one step per byte/item like the replaced asm ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void MBRefCopy(BYTE*d,const BYTE*s,NAT n) { for(NAT i=0;i<n;i++) d[i]=s[i]; }
+void MBRefShiftR(BYTE*p,int delta,NAT n) { for(NAT i=n;i;i--) p[i-1+delta]=p[i-1]; }
+void MBRefFill(BYTE*d,const BYTE*pat,NAT Bpi,NAT cnt) { for(NAT k=0;k<cnt;k++) for(NAT b=0;b<Bpi;b++) *d++=pat[b]; }
+BOOL MBRefCmp(const BYTE*a,const BYTE*b,NAT n) { for(NAT i=0;i<n;i++) if(a[i]!=b[i]) return 0; return 1; }
+NAT MBRefDif(const BYTE*a,const BYTE*b,NAT n) { for(NAT i=0;i<n;i++) if(a[i]!=b[i]) return i+1; return n; }
+NAT MBRefCnt(char c,const BYTE*p,NAT n) { NAT r=0; for(NAT i=0;i<n;i++) r+=p[i]==(BYTE)c; return r; }
+const BYTE* MBRefFind(const BYTE*pat,NAT Bpi,const BYTE*p,NAT n)
+{
+NAT i;
+for(i=0;i<n;i++)
+ if(!memcmp(p+i,pat,Bpi)) break;
+return p+i;
+}
+
+//keeps the compiler from hoisting pure calls (memcmp/memchr) out of the timing loops
+inline BYTE* MBHide(BYTE*p) { BYTE*volatile q=p; return q; }
+
+//seconds since the first call .......................................................................
+double MBTime()
+{
+static LARGE_INTEGER freq={0},t0;
+LARGE_INTEGER t;
+if(!freq.QuadPart)
+ {
+ QueryPerformanceFrequency(&freq);
+ QueryPerformanceCounter(&t0);
+ }
+QueryPerformanceCounter(&t);
+return (double)(t.QuadPart-t0.QuadPart)/freq.QuadPart;
+}
+
+//runs every primitive and its reference on szB bytes, reps times; prints MB/s and checks results ...
+//returns the number of mismatches (0: the primitives behave like the old ones)
+NAT MemBench(FILE*out=stdout,NAT szB=1<<20,NAT reps=100)
+{
+BYTE*a=(BYTE*)ALLOC(szB+64),*b=(BYTE*)ALLOC(szB+64),*c=(BYTE*)ALLOC(szB+64);
+NAT r,k,bad=0;
+double t,tref,tnew;
+NAT v1=0,v2=0;
+if(!a||!b||!c)
+ {
+ FREE(a); FREE(b); FREE(c);
+ return 1;
+ }
+for(k=0;k<szB+64;k++) a[k]=(BYTE)(k%90); //no 0x5a byte but the needle
+CopyMem(b,a,szB+64);
+b[szB-3]^=1; //difference near the end
+const DWORD needle=0x5a5a5a5a;
+*(DWORD*)(a+szB-9)=needle; //needle near the end, at an odd offset
+const BYTE pat3[3]={1,2,3},pat8[8]={1,2,3,4,5,6,7,8};
+#define MB_RUN(name,refcode,newcode,check) \
+ t=MBTime(); for(r=0;r<reps;r++) { refcode; } tref=MBTime()-t; \
+ t=MBTime(); for(r=0;r<reps;r++) { newcode; } tnew=MBTime()-t; \
+ if(!(check)) bad++; \
+ fprintf(out,"%-10s %9.1f MB/s %9.1f MB/s  x%.1f%s\n",name,szB*(double)reps/1e6/MAX(tref,1e-9),szB*(double)reps/1e6/MAX(tnew,1e-9),tref/MAX(tnew,1e-9),(check)?"":"  MISMATCH");
+fprintf(out,"%-10s %14s %14s\n","MemBench","old","new");
+MB_RUN("CopyMem",MBRefCopy(c,a,szB),CopyMem(c,a,szB),!memcmp(c,a,szB));
+MB_RUN("ShiftMemR",MBRefShiftR(c,7,szB-8),ShiftMemR(c,7,szB-8),1);
+MB_RUN("FillMem1",MBRefFill(c,pat3,1,szB),FillMem(c,(void*)pat3,1,szB),c[szB-1]==1);
+MB_RUN("FillMem3",MBRefFill(c,pat3,3,szB/3),FillMem(c,(void*)pat3,3,szB/3),c[szB/3*3-1]==3&&c[szB/3*3-2]==2);
+MB_RUN("FillDW",MBRefFill(c,(const BYTE*)&needle,4,szB/4),FillDW((DWORD*)c,needle,szB/4),((DWORD*)c)[szB/4-1]==needle);
+MB_RUN("FillMem8",MBRefFill(c,pat8,8,szB/8),FillMem(c,(void*)pat8,8,szB/8),c[szB/8*8-1]==8);
+MB_RUN("CmpMem",v1=MBRefCmp(a,b,szB-(r&1)),v2=CmpMem(MBHide(a),b,szB-(r&1)),v1==v2);
+MB_RUN("MemDif",v1=MBRefDif(a,b,szB-(r&1)),v2=MemDif(MBHide(a),b,szB-(r&1)),v1==v2);
+MB_RUN("MemCnt",v1=MBRefCnt(0x5a,a,szB),v2=MemCnt(0x5a,MBHide(a),szB),v1==v2);
+MB_RUN("FindMemB",v1=(NAT)(MBRefFind((const BYTE*)&needle,1,a,szB)-a),v2=(NAT)((BYTE*)FindMemB(0x5a,MBHide(a),szB)-a),v1==v2);
+MB_RUN("FindMemW",v1=(NAT)(MBRefFind((const BYTE*)&needle,2,a,szB)-a),v2=(NAT)((BYTE*)FindMemW(0x5a5a,MBHide(a),szB)-a),v1==v2);
+MB_RUN("FindMemDW",v1=(NAT)(MBRefFind((const BYTE*)&needle,4,a,szB)-a),v2=(NAT)((BYTE*)FindMemDW(needle,MBHide(a),szB)-a),v1==v2);
+#undef MB_RUN
+FREE(a); FREE(b); FREE(c);
+return bad;
+}
+
+//string scans ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//reference loops, one char per step like the replaced asm
+NAT SBRefLen(const char*p,char term) { NAT i=0; while(p[i]!=term) i++; return i; }
+NAT SBRefCount(char sep,const char*p,char term) { NAT r=0; for(;*p!=term;p++) r+=*p==sep; return r; }
+NAT SBRefAny(const char*p,const char*terms,NAT nrt,NAT maxsz)
+{
+for(NAT i=0;i<maxsz;i++)
+ for(NAT k=0;k<nrt;k++)
+  if(p[i]==terms[k]) return i;
+return R_NULL;
+}
+NAT SBRefSeq(const char*p,NAT maxsz,const char*seq,NAT seqsz,NAT fold)
+{
+NAT i,c;
+for(i=0;i+seqsz<=maxsz;i++)
+ {
+ for(c=0;c<seqsz;c++)
+  if(fold?StrFold(p[i+c])!=StrFold(seq[c]):p[i+c]!=seq[c]) break;
+ if(c==seqsz) return i;
+ }
+return R_NULL;
+}
+NAT SBRefCh(char ch,const char*p) { NAT i=0; while(p[i]&&p[i]!=ch) i++; return i; }
+
+//scans szB bytes of text lines for chars and sequences found only at their end, reps times, with
+//the reference loops and the str.cpp functions; prints MB/s and returns the mismatching results
+NAT StrBench(FILE*out=stdout,NAT szB=1<<24,NAT reps=4)
+{
+char*txt=(char*)ALLOC(szB+64);
+NAT k,r,bad=0,v1=0,v2=0;
+double t,tref,tnew;
+if(!txt) return 1;
+for(k=0;k<szB;k++)
+ txt[k]="abcdefgh ijklmnop\n"[k%18];
+CopyMem(txt+szB-16,(void*)"Needle=Value;#",14);
+txt[szB]=0;
+char set3[]="=;#",set12[]="=;#@$%&*!?<>",seq[]="Needle",seqI[]="NEEDLE";
+#define SB_RUN(name,refcode,newcode) \
+ t=MBTime(); for(r=0;r<reps;r++) { v1=refcode; } tref=MBTime()-t; \
+ t=MBTime(); for(r=0;r<reps;r++) { v2=newcode; } tnew=MBTime()-t; \
+ if(v1!=v2) bad++; \
+ fprintf(out,"%-10s %9.1f MB/s %9.1f MB/s  x%.1f%s\n",name,szB*(double)reps/1e6/MAX(tref,1e-9),szB*(double)reps/1e6/MAX(tnew,1e-9),tref/MAX(tnew,1e-9),v1==v2?"":"  MISMATCH");
+fprintf(out,"%-10s %14s %14s\n","StrBench","old","new");
+SB_RUN("sl",SBRefLen(txt,0),sl((char*)MBHide((BYTE*)txt)));
+SB_RUN("sl '='",SBRefLen(txt,'='),sl((char*)MBHide((BYTE*)txt),'='));
+SB_RUN("countch",SBRefCount('\n',txt,0),countch('\n',(char*)MBHide((BYTE*)txt)));
+SB_RUN("s_anych 3",SBRefAny(txt,set3,3,szB),s_anych((char*)MBHide((BYTE*)txt),set3,3,szB));
+SB_RUN("s_anych 12",SBRefAny(txt,set12,12,szB),s_anych((char*)MBHide((BYTE*)txt),set12,12,szB));
+SB_RUN("s_seq",SBRefSeq(txt,szB,seq,6,0),s_seq((char*)MBHide((BYTE*)txt),seq,6,szB));
+SB_RUN("s_seqI",SBRefSeq(txt,szB,seqI,6,1),s_seqI((char*)MBHide((BYTE*)txt),seqI,6,szB));
+SB_RUN("chinstr",SBRefCh('=',txt),(NAT)chinstr('=',(char*)MBHide((BYTE*)txt)));
+#undef SB_RUN
+FREE(txt);
+return bad;
+}
+
+//number conversions ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//the old decimal StoR/RtoS: digit by digit in floating point (inexact)
+double NBRefStoR(LPSTR str,NAT maxnc)
+{
+double val=0.,dig=1.;
+int decs=0,sgn=0;
+for(;*str&&maxnc;str++,maxnc--)
+ {
+ if(*str>='0'&&*str<='9')
+  {
+  if(decs) val+=dig*(*str-'0');
+  else val=val*10+*str-'0';
+  }
+ else if(*str=='-') { if(sgn) break; sgn=1; }
+ else if(*str=='.'||*str==',') { if(decs) break; decs=1; }
+ else if(val) break;
+ if(decs) dig/=10;
+ }
+return sgn?-val:val;
+}
+NAT NBRefRtoS(double val,char*str,int lstrnc,int prec)
+{
+double intval;
+char*p=str+lstrnc;
+int neg=val<0;
+if(neg) val=-val;
+val=modf(val,&intval);
+for(int d=0;d<prec;d++)
+ {
+ val*=10;
+ p[d-prec]=(char)val;
+ val-=p[d-prec];
+ p[d-prec]+='0';
+ }
+p-=prec;
+if(prec) *--p='.';
+do *--p=(char)('0'+fmod(intval,10)),intval/=10; while(intval>=1.&&p>str);
+if(neg&&p>str) *--p='-';
+return (NAT)(str+lstrnc-p);
+}
+
+//parses every field of a CSV-like text (';', tab or line separated, ',' or '.' decimals) with the old
+//and the new StoR, formats the values back with RtoS; prints MB/s and values/s, counts the fields the
+//old parser got wrong and checks the new one reads back its own shortest output.
+//csv=NULL: a generated table of prices, quantities and ratios; returns the round trip failures
+NAT NumBench(FILE*out=stdout,LPSTR csv=NULL,NAT reps=10)
+{
+NAT nf=0,k,r,bad=0,oldbad=0,gen=!csv,szB;
+double t,tref,tnew;
+volatile double sink=0;
+char txt[NUMFMT_SZ];
+if(gen) //100000 rows
+ {
+ csv=(LPSTR)ALLOC(100000*64);
+ if(!csv) return 1;
+ LPSTR p=csv;
+ for(k=0;k<100000;k++)
+  p+=sprintf(p,"%u;%u.%02u;%d;0,%06u;%u.%u\n",k,(k*7919)%100000,(k*31)%100,(int)(k%2000)-1000,(k*104729)%1000000,k*3,(k*13)%10);
+ }
+szB=sl(csv);
+LPSTR*fld=(LPSTR*)ALLOC_POINTER(szB/2+1);
+double*v=ALLOC_DOUBLE(szB/2+1);
+if(!fld||!v)
+ {
+ FREE(fld); FREE(v);
+ if(gen) FREE(csv);
+ return 1;
+ }
+for(LPSTR p=csv;*p;) //field starts
+ {
+ while(*p==';'||*p=='\t'||*p=='\n'||*p=='\r') p++;
+ if(!*p) break;
+ fld[nf++]=p;
+ while(*p&&*p!=';'&&*p!='\t'&&*p!='\n'&&*p!='\r') p++;
+ }
+#define NB_RUN(name,unit,ul,refcode,newcode) \
+ t=MBTime(); for(r=0;r<reps;r++) for(k=0;k<nf;k++) { refcode; } tref=MBTime()-t; \
+ t=MBTime(); for(r=0;r<reps;r++) for(k=0;k<nf;k++) { newcode; } tnew=MBTime()-t; \
+ fprintf(out,"%-10s %9.1f %s %9.1f %s  x%.1f\n",name,unit*(double)reps/1e6/MAX(tref,1e-9),ul,unit*(double)reps/1e6/MAX(tnew,1e-9),ul,tref/MAX(tnew,1e-9));
+fprintf(out,"%-10s %14s %14s  (%u fields)\n","NumBench","old","new",nf);
+NB_RUN("StoR",szB,"MB/s",sink+=NBRefStoR(fld[k],32),sink+=StoR(fld[k],10,32));
+for(k=0;k<nf;k++)
+ v[k]=StoR(fld[k],10,32);
+NB_RUN("RtoS 2",nf,"M/s ",sink+=NBRefRtoS(v[k],txt,32,2),sink+=RtoS(v[k],txt,32,10,2));
+NB_RUN("RtoS min",nf,"M/s ",sink+=NBRefRtoS(v[k],txt,32,6),sink+=RtoS(v[k],txt,32,10,-1));
+#undef NB_RUN
+for(k=0;k<nf;k++)
+ {
+ if(NBRefStoR(fld[k],32)!=v[k]) oldbad++;
+ NAT l=RtoS(v[k],txt,NUMFMT_SZ-1,10,-1);
+ if(StoR(txt,10,l)!=v[k]) bad++;
+ }
+fprintf(out,"old StoR inexact on %u fields, new round trip failures %u\n",oldbad,bad);
+FREE(fld); FREE(v);
+if(gen) FREE(csv);
+return bad;
+}
+
+//BLTRGB kernels ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//copies a lng*lat rect through every pair of BLTRGBspec with the generic PFCONV kernels and with the
+//specialized ones, next to a plain CopyMem of the dst bytes; prints MB/s of dst and checks both
+//kernels write the same pixels. Returns the mismatches (no AVX2: nothing specialized, returns 0)
+NAT BltBench(FILE*out=stdout,NAT lng=1024,NAT lat=1024,NAT reps=20)
+{
+NAT k,r,bad=0,szB=lng*lat*4;
+double t,tcpy,tgen,tspec,MB;
+BYTE*s=(BYTE*)ALLOC(szB),*d1=(BYTE*)ALLOC(szB),*d2=(BYTE*)ALLOC(szB);
+BLTRGB b;
+if(!s||!d1||!d2)
+ {
+ FREE(s); FREE(d1); FREE(d2);
+ return 1;
+ }
+for(k=0;k<szB;k++) s[k]=(BYTE)(k*7+(k>>11));
+ZeroMemory(d1,szB); //pages faulted in before timing
+ZeroMemory(d2,szB);
+fprintf(out,"%-18s %14s %14s %14s\n","BltBench","CopyMem","generic","specialized");
+for(k=0;k<sizeof(BLTRGBspec)/sizeof(BLTRGB_SPEC);k++)
+ {
+ b.Copy(d1,0,BLTRGBspec[k].Dpf,s,0,BLTRGBspec[k].Spf,lng,lat);
+ if(!b.row) continue; //not picked by PFs
+ MB=(double)b.DBpp*lng*lat*reps/1e6;
+ t=MBTime(); for(r=0;r<reps;r++) CopyMem(d2,s,b.DBpp*lng*lat); tcpy=MBTime()-t;
+ t=MBTime(); for(r=0;r<reps;r++) PFConvRect(&b.cv,0,d2,b.DBpl,s,b.SBpl,lng,lat); tgen=MBTime()-t;
+ t=MBTime(); for(r=0;r<reps;r++) b.DoIt(&b); tspec=MBTime()-t;
+ NAT same=!memcmp(d1,d2,b.DBpp*lng*lat);
+ if(!same) bad++;
+ fprintf(out,"%08x>%08x %9.1f MB/s %9.1f MB/s %9.1f MB/s  x%.1f%s\n",BLTRGBspec[k].Spf,BLTRGBspec[k].Dpf,MB/MAX(tcpy,1e-9),MB/MAX(tgen,1e-9),MB/MAX(tspec,1e-9),tgen/MAX(tspec,1e-9),same?"":"  MISMATCH");
+ }
+FREE(s); FREE(d1); FREE(d2);
+return bad;
+}
+
+//folder walks ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//the old serial UTREE::Dir (recursive)
+void DBRefDir(UTREE*tree,LPSTR root,int flags,LPSTR filter)
+{ //b0=fullpath, b1=only folders, b2=only files, b3=skip subfolders
+HANDLE hff;
+WIN32_FIND_DATA wfd;
+char lBufDir[PATHSZ];
+VTIME ltm;
+ltm.init(VTMF_VLAD);
+mergepath(lBufDir,root,filter);
+hff=FindFirstFile(lBufDir,&wfd);
+if(hff!=INVALID_HANDLE_VALUE)
+ {
+ do{
+  if(wfd.cFileName[0]=='.') continue;
+  if(!(wfd.dwFileAttributes&FILE_ATTRIBUTE_DIRECTORY)&&flags&0x2) continue;
+  if(wfd.dwFileAttributes&FILE_ATTRIBUTE_DIRECTORY&&flags&0x4) continue;
+  ltm=wfd.ftCreationTime;
+  mergepath(lBufDir,root,wfd.cFileName);
+  tree->Add(flags&0x1?lBufDir:wfd.cFileName,wfd.dwFileAttributes,&ltm);
+  }while(FindNextFile(hff,&wfd));
+ FindClose(hff);
+ }
+if(flags&0xC) return;
+for(NAT i=0;i<tree->nrnodes;i++)
+ if(tree->node[i].nr&FILE_ATTRIBUTE_DIRECTORY)
+  {
+  ifn(tree->node[i].next)
+   tree->node[i].next=(UTREE*)ALLOC0(sizeof(UTREE));
+  if(flags&0x1)
+   DBRefDir(tree->node[i].next,tree->node[i].name,flags,filter);
+  else
+   {
+   mergepath(lBufDir,root,tree->node[i].name);
+   DBRefDir(tree->node[i].next,lBufDir,flags,filter);
+   }
+  }
+}
+
+//0: same entries in the same order with the same subtrees (an empty subtree matches none)
+BOOL DBTreeDif(UTREE*a,UTREE*b)
+{
+NAT na=a?a->nrnodes:0,nb=b?b->nrnodes:0;
+if(na!=nb) return 1;
+for(NAT i=0;i<na;i++)
+ {
+ UTREE_NODE*x=a->node+i,*y=b->node+i;
+ if(x->nr!=y->nr||!scmp(x->name,y->name)||!CmpMem(&x->tm,&y->tm,sizeof(VTIME))) return 1;
+ if(DBTreeDif(x->next,y->next)) return 1;
+ }
+return 0;
+}
+
+//walks root (NULL: current folder) for every combination of the b0..b3 flags and both filters with the
+//old Dir, with the new one on 1 thread and on ParThreads(); prints the ms of each filter's 16 walks and
+//returns the walks whose tree differs from the old one
+NAT DirBench(FILE*out=stdout,LPSTR root=NULL)
+{
+LPSTR filter[2]={"*","*.cpp"};
+NAT f,k,nt=ParThreads(),bad=0;
+double t,tref,t1,tn;
+UTREE warm;
+warm.Dir(root); //file system caches filled before timing
+fprintf(out,"%-10s %12s %12s %9s %u\n","DirBench","old","1 thread","threads",nt);
+for(f=0;f<2;f++)
+ {
+ tref=t1=tn=0;
+ for(k=0;k<16;k++)
+  {
+  UTREE a,b,c;
+  t=MBTime(); DBRefDir(&a,root,k,filter[f]); tref+=MBTime()-t;
+  t=MBTime(); b.Dir(root,k,filter[f],1); t1+=MBTime()-t;
+  t=MBTime(); c.Dir(root,k,filter[f],nt); tn+=MBTime()-t;
+  if(DBTreeDif(&a,&b)) bad++;
+  if(DBTreeDif(&a,&c)) bad++;
+  }
+ fprintf(out,"%-10s %9.1f ms %9.1f ms %9.1f ms  x%.1f\n",filter[f],tref*1e3,t1*1e3,tn*1e3,tref/MAX(tn,1e-9));
+ }
+fprintf(out,"trees differing from the old Dir: %u\n",bad);
+return bad;
+}
@@ -15,6 +15,7 @@
 //#endif
 
 #define MAX_QUERY_NC 10240 //8KB
+#define VMYSQL_MAXPARAMS 65535 //? per statement
 
 //Interface class for MySQL 
 class VMYSQL:public USQLDB
@@ -24,6 +25,15 @@ public:
  int ret; //last mysql_*() return value
  NAT qnc; //last query size in chars
  char myQuery[MAX_QUERY_NC]; //buffer for last query
+ MYSQL_STMT*stmt; //Prepare()d statement
+ MYSQL_STMT*mstmt; //the same INSERT with mstmtrows VALUES tuples
+ NAT mstmtrows;
+ char*psql; //Prepare()d SQL
+ NAT vof,vnc; //its VALUES tuple (vnc=0: executed row by row)
+ USQL_PARAM*param;
+ NAT nrparams;
+ MYSQL_BIND*pbind;
+ NAT pbindcap;
  
  VMYSQL() { ZEROCLASSV(VMYSQL);  type=USQL_MYSQL; }
  int checkret(int,char*,...);
@@ -38,18 +48,25 @@ public:
  virtual BOOL E_value(LPSTR,LPSTR,int);
  virtual BOOL DropTable(LPSTR);  //drop table
  virtual BOOL Query(char*,...);
+ virtual BOOL QueryRaw(char*,NAT);
  virtual void StartQuery();
  virtual BOOL Astr(char*,...);
  virtual BOOL Abin(void*,NAT);
  virtual BOOL DoQuery();
  virtual BOOL QResult(UTABLE*);
+ virtual BOOL QStream(UTABLE*,NAT,USQL_BATCHFN,void*);
+ virtual BOOL Prepare(char*);
+ virtual BOOL Bind(UTABLE*,NAT*,BYTE**);
+ virtual BOOL ExecuteBatch(NAT,NAT);
  virtual int Database(LPSTR);
  virtual BOOL DropDB(LPSTR);  //drop database
+ virtual BOOL Ping();
+ virtual void Thread(BOOL);
  //~USQLDB
  BOOL E_user(LPSTR);
  void ShowResult(MYSQL_RES*);
  void DiscardResult();
- BOOL Ping();
+ MYSQL_STMT*RowsStmt(NAT);
  void Info();
  void Status();
  ~VMYSQL() { Disconnect(); }
@@ -68,10 +85,15 @@ va_start(vparam,formstr);
 retv=sprintf(lsbuf,"%s\nCodes: %i %i %5s\n",mysql_error(mySQL),condition,mysql_errno(mySQL),mysql_sqlstate(mySQL));
 if(formstr)
  retv=vsprintf(lsbuf+retv,formstr,vparam);
+va_end(vparam);
+if(noui)
+ {
+ sc(err,lsbuf,USQL_ERRNC-1);
+ return 0;
+ }
 retv=MessageBox(HWND_DESKTOP,lsbuf,"MySQL ERROR",MB_ICONWARNING|MB_ABORTRETRYIGNORE|MB_TASKMODAL|MB_TOPMOST);
 if(retv==IDABORT) exit(condition);
 if(retv==IDRETRY) DebugBreak();
-va_end(vparam);
 return (retv==IDRETRY);	//should retry
 }
 
@@ -148,7 +170,7 @@ if(connections>1) return 1;
 mySQL=mysql_init(NULL);
 if(!mySQL)
  {
- checkret(!mySQL);
+ connections=0;
  return 0;
  }
 if(!li->port)  li->port=MYSQL_PORT;
@@ -163,8 +185,10 @@ for(;;)
  {
  if(mysql_real_connect(mySQL,li->host,li->username,li->password,defdb,li->port,NULL,CLIENT_ODBC))
   break;//connected
- if(!li->UI())
+ if((li->flags&ODBC_LOGON_NOUI)||!li->UI())
   {
+  mysql_close(mySQL);
+  mySQL=NULL;
   connections=0;
   return 0;
   }
@@ -178,6 +202,7 @@ BOOL VMYSQL::Disconnect()
 {
 connections--;
 if(connections>0) return 1;
+Prepare(NULL);
 mysql_close(mySQL);
 mySQL=NULL;
 return 1;
@@ -298,6 +323,17 @@ checkret(ret,myQuery);
 return !ret;
 }
 
+//send nc chars of sql as they are, of any size (myQuery keeps the start for messages).................................................................................................................................
+inline BOOL VMYSQL::QueryRaw(char*sql,NAT nc)
+{
+qnc=MIN(nc,MAX_QUERY_NC-1);
+CopyMemory(myQuery,sql,qnc);
+myQuery[qnc]=0;
+ret=mysql_real_query(mySQL,sql,nc);
+checkret(ret,"%.4096s",myQuery);
+return !ret;
+}
+
 //start a composite query .................................................................................................................................
 inline void VMYSQL::StartQuery()
 {
@@ -385,7 +421,11 @@ MYSQL_ROW row;
 NAT nrr,nrf;
 int f,r;
 DWORD*rownc;
-if(!ut) mysql_free_result(mysql_use_result(mySQL));
+if(!ut)
+ {
+ mysql_free_result(mysql_use_result(mySQL));
+ return 1;
+ }
 myResult=mysql_store_result(mySQL);
 if(!myResult)
  {
@@ -420,6 +460,236 @@ mysql_free_result(myResult);
 return 1;
 }
 
+//QStream() rows of a mysql_use_result() .................................................................................................................................
+NAT VMySqlFetch(USQL_RAW*raw,void*res)
+{
+MYSQL_ROW row;
+DWORD*rownc;
+NAT f,n=0;
+while(raw->nrrows<raw->cap&&(row=mysql_fetch_row((MYSQL_RES*)res)))
+ {
+ rownc=mysql_fetch_lengths((MYSQL_RES*)res);
+ for(f=0;f<raw->nrf;f++)
+  if(!USqlRawCell(raw,row[f],rownc[f])) return n;
+ raw->nrrows++;
+ n++;
+ }
+return n;
+}
+
+//get query results in batches of rows, row by row from the server (mysql_use_result) .................................................................................................................................
+BOOL VMYSQL::QStream(UTABLE*ut,NAT batch,USQL_BATCHFN fn,void*ctx=NULL)
+{
+MYSQL_RES*myResult;
+MYSQL_FIELD*fields;
+NAT nrf,f;
+BITS32 utype;
+NAT uitsz;
+BOOL ok;
+if(!batch) batch=USQL_BATCH;
+myResult=mysql_use_result(mySQL);
+if(!myResult)
+ {
+ checkret(mysql_field_count(mySQL),"Couldn't get result for: %s",myQuery);
+ return 0;
+ }
+nrf=mysql_num_fields(myResult);
+fields=mysql_fetch_fields(myResult);
+if(!fields)
+ {
+ mysql_free_result(myResult);
+ return 0;
+ }
+ut->Free();
+for(f=0;f<nrf;f++)
+ {
+ UTYPE(fields[f].type,fields[f].decimals,fields[f].length,&utype,&uitsz);
+ ut->AddField(fields[f].name,utype,batch,uitsz,0);
+ } 
+ok=USqlStream(ut,batch,VMySqlFetch,myResult,fn,ctx);
+if(mysql_errno(mySQL))
+ {
+ checkret(mysql_errno(mySQL),"Fetch failed for: %s",myQuery);
+ ok=0;
+ }
+mysql_free_result(myResult); //reads and drops the rows left if fn stopped
+return ok;
+}
+
+//Prepare()d statements .................................................................................................................................
+//MySQL has no parameter arrays: an INSERT ... VALUES (?,...) is prepared again with one tuple per row, so
+//ExecuteBatch() sends up to USQL_PARAMROWS rows (at most VMYSQL_MAXPARAMS parameters) in one round trip,
+//any other statement is executed once per row (still without parsing or escaping)
+
+//the (...) tuple that ends an INSERT ... VALUES (...): offset in *of and size, 0 if none ....................
+NAT VMySqlTuple(char*sql,NAT*of)
+{
+NAT e=sl(sql),i,d=0;
+while(e&&(sql[e-1]==' '||sql[e-1]=='\t'||sql[e-1]=='\r'||sql[e-1]=='\n'||sql[e-1]==';')) e--;
+if(!e||sql[e-1]!=')') return 0;
+i=e;
+do{
+ i--;
+ if(sql[i]==')') d++;
+ else if(sql[i]=='(') d--;
+}while(d&&i);
+if(d||s_anych(sql+i,"?",1,e-i)==R_NULL) return 0; //VALUES(col) of ON DUPLICATE KEY UPDATE has no ?
+*of=i;
+while(i&&(sql[i-1]==' '||sql[i-1]=='\t'||sql[i-1]=='\r'||sql[i-1]=='\n')) i--;
+if(i<6||s_seqI(sql+i-6,"VALUES",6,6)) return 0;
+if(i>6&&sql[i-7]!=' '&&sql[i-7]!='\t'&&sql[i-7]!='\r'&&sql[i-7]!='\n'&&sql[i-7]!=')') return 0;
+return e-*of;
+}
+
+//parameter p of row r (packed row pr) .................................................................................................................................
+void VMySqlParam(MYSQL_BIND*b,USQL_PARAM*p,NAT r,NAT pr)
+{
+if(p->len[pr]==USQL_NULL)
+ {
+ b->buffer_type=MYSQL_TYPE_NULL;
+ return;
+ }
+switch(p->kind)
+ {
+ case UDK_I8: case UDK_U8: b->buffer_type=MYSQL_TYPE_TINY; break;
+ case UDK_I16: case UDK_U16: b->buffer_type=MYSQL_TYPE_SHORT; break;
+ case UDK_I32: case UDK_U32: b->buffer_type=MYSQL_TYPE_LONG; break;
+ case UDK_I64: case UDK_U64: b->buffer_type=MYSQL_TYPE_LONGLONG; break;
+ case UDK_F32: b->buffer_type=MYSQL_TYPE_FLOAT; break;
+ case UDK_F64: b->buffer_type=MYSQL_TYPE_DOUBLE; break;
+ default: //text (length NULL: buffer_length is the length)
+  b->buffer_type=MYSQL_TYPE_STRING;
+  b->buffer=p->col->type&(UDT_STR|UDT_VSTR)?p->col->gstr(r):p->txt+pr*p->width;
+  b->buffer_length=p->len[pr];
+  return;
+ }
+b->buffer=p->col->pb+r*p->col->itsz; //in place
+b->is_unsigned=p->kind==UDK_U8||p->kind==UDK_U16||p->kind==UDK_U32||p->kind==UDK_U64;
+}
+
+//prepare a statement with ? parameters (NULL: release the current one) .................................................................................................................................
+BOOL VMYSQL::Prepare(char*sql=NULL)
+{
+if(mstmt) mysql_stmt_close(mstmt);
+if(stmt) mysql_stmt_close(stmt);
+mstmt=stmt=NULL;
+mstmtrows=vnc=0;
+USqlParamFree(param,nrparams);
+FREE(param);
+FREE(psql);
+FREE(pbind);
+nrparams=pbindcap=0;
+if(!sql) return 1;
+stmt=mysql_stmt_init(mySQL);
+if(!stmt) return 0;
+if(mysql_stmt_prepare(stmt,sql,sl(sql)))
+ {
+ checkret(mysql_stmt_errno(stmt),"%s\nPrepare failed for: %s",mysql_stmt_error(stmt),sql);
+ mysql_stmt_close(stmt);
+ stmt=NULL;
+ return 0;
+ }
+nrparams=mysql_stmt_param_count(stmt);
+param=(USQL_PARAM*)ALLOC0(nrparams*sizeof(USQL_PARAM)+1);
+psql=SALLOC(sl(sql));
+if(!param||!psql)
+ {
+ Prepare(NULL);
+ return 0;
+ }
+sc(psql,sql);
+if(nrparams&&nrparams<=VMYSQL_MAXPARAMS/2)
+ vnc=VMySqlTuple(psql,&vof);
+return 1;
+}
+
+//bind the parameters to fields of ut: parameter i = field fields[i] (NULL: i), bit r of null[f]: item r is NULL .................................................................................................................................
+BOOL VMYSQL::Bind(UTABLE*ut,NAT*fields=NULL,BYTE**null=NULL)
+{
+if(!stmt) return 0;
+return USqlBind(param,nrparams,ut,fields,null);
+}
+
+//the Prepare()d INSERT with rows VALUES tuples .................................................................................................................................
+MYSQL_STMT*VMYSQL::RowsStmt(NAT rows)
+{
+char*sql;
+NAT r,l;
+if(mstmt&&mstmtrows==rows) return mstmt;
+if(mstmt) mysql_stmt_close(mstmt);
+mstmtrows=0;
+mstmt=mysql_stmt_init(mySQL);
+sql=SALLOC(vof+rows*(vnc+1));
+if(!mstmt||!sql)
+ {
+ FREE(sql);
+ return NULL;
+ }
+CopyMemory(sql,psql,vof+vnc);
+l=vof+vnc;
+for(r=1;r<rows;r++)
+ {
+ sql[l++]=',';
+ CopyMemory(sql+l,psql+vof,vnc);
+ l+=vnc;
+ }
+sql[l]=0;
+if(mysql_stmt_prepare(mstmt,sql,l))
+ {
+ checkret(mysql_stmt_errno(mstmt),"%s\nPrepare failed for %u rows of: %s",mysql_stmt_error(mstmt),rows,psql);
+ mysql_stmt_close(mstmt);
+ mstmt=NULL;
+ }
+else
+ mstmtrows=rows;
+FREE(sql);
+return mstmt;
+}
+
+//execute the Prepare()d statement for the bound rows [from,from+n) .................................................................................................................................
+BOOL VMYSQL::ExecuteBatch(NAT from=0,NAT n=-1)
+{
+MYSQL_STMT*st;
+NAT rows,per,chunk,k,r,j,i;
+if(!stmt) return 0;
+if(!nrparams)
+ {
+ if(!mysql_stmt_execute(stmt)) return 1;
+ checkret(mysql_stmt_errno(stmt),"%s\nExecute failed for: %s",mysql_stmt_error(stmt),psql);
+ return 0;
+ }
+if(!param[0].col) return 0; //not bound
+rows=USqlParamRows(param,nrparams);
+if(from>=rows) return 1;
+n=MIN(n,rows-from);
+per=vnc?MIN(USQL_PARAMROWS,VMYSQL_MAXPARAMS/nrparams):1; //rows per round trip
+if(!ArrayCap((void**)&pbind,&pbindcap,per*nrparams,sizeof(MYSQL_BIND))) return 0;
+while(n)
+ {
+ chunk=MIN(n,vnc?per:USQL_PARAMROWS);
+ for(i=0;i<nrparams;i++)
+  if(!USqlParamPack(param+i,from,chunk,0)) return 0; //strings are sent from the fields
+ for(r=0;r<chunk;r+=k)
+  {
+  k=MIN(chunk-r,per);
+  st=k>1?RowsStmt(k):stmt;
+  if(!st) return 0;
+  ZeroMemory(pbind,k*nrparams*sizeof(MYSQL_BIND));
+  for(j=0;j<k;j++)
+   for(i=0;i<nrparams;i++)
+    VMySqlParam(pbind+j*nrparams+i,param+i,from+r+j,r+j);
+  if(mysql_stmt_bind_param(st,pbind)||mysql_stmt_execute(st))
+   {
+   checkret(mysql_stmt_errno(st),"%s\nExecute failed for rows %u-%u of: %s",mysql_stmt_error(st),from+r,from+r+k-1,psql);
+   return 0;
+   }
+  }
+ from+=chunk;
+ n-=chunk;
+ }
+return 1;
+}
+
 //discard query results.................................................................................................................................
 inline void VMYSQL::DiscardResult()
 {
@@ -477,7 +747,16 @@ FREE(lsbuf);
 //ping MySQL server.................................................................................................................................
 BOOL VMYSQL::Ping()
 {
-return !mysql_ping(mySQL);
+return mySQL&&!mysql_ping(mySQL);
+}
+
+//a thread starts/stops using the client library (USQLPOOL) .................................................................................................................................
+void VMYSQL::Thread(BOOL start)
+{
+if(start)
+ mysql_thread_init();
+else
+ mysql_thread_end();
 }
 
 //show information.................................................................................................................................
@@ -27,6 +27,7 @@
 #define ODBC_LOGON_PWD   		0x00100000
 #define ODBC_LOGON_DIRECTORY    0x00080000
 #define ODBC_LOGON_DATABASE		0x00040000  
+#define ODBC_LOGON_NOUI  		0x00020000  //Connect() fails instead of asking again (UI())
 
 #define ODBC_LOGON_MYSQL (ODBC_LOGON_DRIVER|ODBC_LOGON_UID|ODBC_LOGON_PWD|ODBC_LOGON_HOST|ODBC_LOGON_PORT)
 #define ODBC_LOGON_MSSQL (ODBC_LOGON_DRIVER|ODBC_LOGON_HOST|ODBC_LOGON_NET)	//must use "Trusted_Connection=Yes"
@@ -0,0 +1,427 @@
+#pragma once
+#define V_NUMCONV //exact decimal<->double conversion: Eisel-Lemire parsing, Ryu shortest digits, exact fixed rounding
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(_MSC_VER)
+ #include <intrin.h>
+#endif
+
+//64x64->128 bit product, returns the high half ---------------------------------------------
+inline QWORD NumMul128(QWORD a,QWORD b,QWORD*lo)
+{
+#if defined(__SIZEOF_INT128__)
+unsigned __int128 r=(unsigned __int128)a*b;
+*lo=(QWORD)r;
+return (QWORD)(r>>64);
+#elif defined(_MSC_VER)&&defined(_M_X64)
+QWORD hi;
+*lo=_umul128(a,b,&hi);
+return hi;
+#else
+QWORD a0=(DWORD)a,a1=a>>32,b0=(DWORD)b,b1=b>>32;
+QWORD p00=a0*b0,p01=a0*b1,p10=a1*b0,p11=a1*b1;
+QWORD mid=(p00>>32)+(DWORD)p01+(DWORD)p10;
+*lo=(mid<<32)|(DWORD)p00;
+return p11+(p01>>32)+(p10>>32)+(mid>>32);
+#endif
+}
+
+inline NAT NumClz64(QWORD v) //v!=0
+{
+NAT n=0;
+if(!(v>>32)) n+=32,v<<=32;
+if(!(v>>48)) n+=16,v<<=16;
+if(!(v>>56)) n+=8,v<<=8;
+if(!(v>>60)) n+=4,v<<=4;
+if(!(v>>62)) n+=2,v<<=2;
+if(!(v>>63)) n+=1;
+return n;
+}
+
+//powers of 5 tables, computed on first use with a small bignum ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#define NUMBIG_WORDS 32 //1024 bits > 5^342 (unused words stay 0)
+struct NUMBIG
+{
+ DWORD w[NUMBIG_WORDS];
+ NAT n; //words in use
+
+ NAT Bit(int i) const { return i>=0&&i<(int)n*32?(w[i>>5]>>(i&31))&1:0; }
+ NAT Len() const //bit length
+  {
+  NAT l=(n-1)*32,t=w[n-1];
+  while(t) l++,t>>=1;
+  return l;
+  }
+ void Mul(DWORD m)
+  {
+  QWORD c=0;
+  for(NAT i=0;i<n;i++)
+   {
+   c+=(QWORD)w[i]*m;
+   w[i]=(DWORD)c;
+   c>>=32;
+   }
+  if(c) w[n++]=(DWORD)c;
+  }
+ //floor(this/2^shift) truncated to 128 bits (shift<0: left shift)
+ void Top(int shift,QWORD*hi,QWORD*lo) const
+  {
+  *hi=*lo=0;
+  for(int b=127;b>=0;b--)
+   {
+   *hi=(*hi<<1)|(*lo>>63);
+   *lo=(*lo<<1)|Bit(shift+b);
+   }
+  }
+ //floor(2^t/this) for results below 2^128
+ void Recip(NAT t,QWORD*hi,QWORD*lo) const
+  {
+  NUMBIG r;
+  NAT L=Len(),m=n+1,i,k; //r<2*this may need one more word; w[n]==0
+  ZeroMemory(&r,sizeof(r));
+  r.w[(L-1)>>5]=1u<<((L-1)&31); //the first L-1 quotient bits are 0
+  *hi=*lo=0;
+  for(k=0;k<=t-(L-1);k++)
+   {
+   if(k) //r*=2
+    for(i=m;i--;)
+     r.w[i]=(r.w[i]<<1)|(i?r.w[i-1]>>31:0);
+   for(i=m;i--&&r.w[i]==w[i];); //r>=this ?
+   NAT ge=(i==(NAT)-1)||r.w[i]>w[i];
+   *hi=(*hi<<1)|(*lo>>63);
+   *lo=(*lo<<1)|ge;
+   if(ge) //r-=this
+    {
+    QWORD b=0;
+    for(i=0;i<m;i++)
+     {
+     QWORD d=(QWORD)r.w[i]-w[i]-b;
+     r.w[i]=(DWORD)d;
+     b=(d>>32)&1;
+     }
+    }
+   }
+  }
+};
+
+#define NUM_EL_QMIN (-342) //Eisel-Lemire decimal exponent range
+#define NUM_EL_QMAX 308
+#define NUM_RYU_POW5 326 //Ryu table sizes
+#define NUM_RYU_INV5 342
+struct NUMTAB
+{
+ QWORD el[NUM_EL_QMAX-NUM_EL_QMIN+1][2]; //5^q normalized to 128 bits (hi,lo); q<0: 2^k/5^-q rounded up for q>=-27
+ QWORD pow5[NUM_RYU_POW5][2]; //5^i normalized to 125 bits (lo,hi)
+ QWORD inv5[NUM_RYU_INV5][2]; //2^(len(5^i)-1+125)/5^i+1 (lo,hi)
+
+ NUMTAB()
+  {
+  NUMBIG p;
+  QWORD hi,lo;
+  ZeroMemory(&p,sizeof(p));
+  p.w[0]=1;
+  p.n=1;
+  for(int q=0;q<=-NUM_EL_QMIN;q++,p.Mul(5))
+   {
+   int L=(int)p.Len();
+   if(q<NUM_RYU_POW5)
+    p.Top(L-125,&pow5[q][1],&pow5[q][0]);
+   if(q<NUM_RYU_INV5)
+    {
+    p.Recip(L-1+125,&hi,&lo);
+    inv5[q][0]=lo+1;
+    inv5[q][1]=hi+(inv5[q][0]==0);
+    }
+   if(q<=NUM_EL_QMAX)
+    p.Top(L-128,&el[q-NUM_EL_QMIN][0],&el[q-NUM_EL_QMIN][1]);
+   if(q>0)
+    {
+    p.Recip(L+127,&hi,&lo);
+    if(q<=27) //exact reciprocal rounded up
+     hi+=(++lo==0);
+    el[-q-NUM_EL_QMIN][0]=hi;
+    el[-q-NUM_EL_QMIN][1]=lo;
+    }
+   }
+  }
+};
+
+inline const NUMTAB& NumTab()
+{
+static const NUMTAB tab; //thread safe static init
+return tab;
+}
+
+//decimal to double ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//w*10^q rounded to nearest even, as IEEE bits (Eisel-Lemire, w<2^64 exact) ............................
+QWORD NumEL(QWORD w,int q)
+{
+if(!w||q<NUM_EL_QMIN) return 0;
+if(q>NUM_EL_QMAX) return 0x7ff0000000000000ull;
+const QWORD*t=NumTab().el[q-NUM_EL_QMIN];
+NAT lz=NumClz64(w);
+QWORD lo,hi,lo2,hi2,m;
+w<<=lz;
+hi=NumMul128(w,t[0],&lo);
+if((hi&0x1ff)==0x1ff) //the low word may carry into the bits we keep
+ {
+ hi2=NumMul128(w,t[1],&lo2);
+ lo+=hi2;
+ hi+=hi2>lo;
+ }
+int upper=(int)(hi>>63);
+m=hi>>(upper+9);
+int p2=((((152170+65536)*q)>>16)+63)+upper-(int)lz+1023;
+if(p2<=0) //subnormal
+ {
+ if(-p2+1>=64) return 0;
+ m>>=-p2+1;
+ m+=m&1;
+ m>>=1;
+ return m; //a carry into bit 52 makes it the smallest normal
+ }
+if(lo<=1&&q>=-4&&q<=23&&(m&3)==1&&(m<<(upper+9))==hi) //exactly halfway: round to even
+ m&=~(QWORD)1;
+m+=m&1;
+m>>=1;
+if(m>=(QWORD)2<<52)
+ {
+ m=(QWORD)1<<52;
+ p2++;
+ }
+if(p2>=0x7ff) return 0x7ff0000000000000ull;
+return (m&~((QWORD)1<<52))|((QWORD)p2<<52);
+}
+
+inline double NumBits(QWORD b) { double d; memcpy(&d,&b,8); return d; }
+
+//w*10^q correctly rounded .....................................................................................
+inline double NumDec(QWORD w,int q)
+{
+static const double p10[23]={1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+if(w<=((QWORD)1<<53)&&q>=-22&&q<=22) //both exact, one rounding (Clinger)
+ return q<0?(double)(__int64)w/p10[-q]:(double)(__int64)w*p10[q];
+return NumBits(NumEL(w,q));
+}
+
+//exact fallback on all the digits: w (19 digits), then dig[19..] up to NUMDEC_DIGITS (the rest sticky)
+#define NUMDEC_DIGITS 800 //enough to decide the rounding of any double (a sticky digit stands for the rest)
+double NumDecSlow(QWORD w,NAT nd,int exp,NAT sticky,char*dig)
+{
+NAT st=nd<NUMDEC_DIGITS?nd:NUMDEC_DIGITS;
+char c=dig[19];
+sprintf(dig,"%019llu",(unsigned long long)w);
+dig[19]=c;
+if(sticky) dig[st++]='1';
+sprintf(dig+st,"e%d",exp+(int)(nd-(nd<NUMDEC_DIGITS?nd:NUMDEC_DIGITS))-(sticky?1:0));
+return strtod(dig,NULL);
+}
+
+//digits collected by a parser: value=digits*10^exp; dig: NUMDEC_DIGITS+32 chars kept by the caller
+//(a separate buffer keeps the scalars in registers while parsing) .........................................
+struct NUMDEC
+{
+ QWORD w; //first 19 significant digits
+ NAT nd; //significant digits seen
+ NAT trunc; //nonzero digits after the first 19
+ NAT sticky; //nonzero digits after the first NUMDEC_DIGITS
+ int exp; //exponent of the last digit
+ char*dig; //digits after the first 19, for the rare exact fallback
+
+ void Init(char*buf) { w=0; nd=trunc=sticky=0; exp=0; dig=buf; }
+ void Digit(int d) //value=value*10+d
+  {
+  if(nd<19)
+   {
+   if(!nd&&!d) return; //leading zero
+   w=w*10+d;
+   }
+  else
+   {
+   if(nd<NUMDEC_DIGITS) dig[nd]=(char)('0'+d);
+   else sticky|=d;
+   trunc|=d;
+   }
+  nd++;
+  }
+ void At(int d,int e) //places d at 10^e, below the last digit (zeros in between)
+  {
+  for(;exp>e+1;exp--)
+   Digit(0);
+  Digit(d);
+  exp=e;
+  }
+ double Value() const
+  {
+  if(!nd) return 0.;
+  int q=exp+(nd>19?(int)nd-19:0);
+  if(!trunc) return NumDec(w,q);
+  QWORD b=NumEL(w,q);
+  if(b==NumEL(w+1,q)) //the dropped digits cannot change the rounding
+   return NumBits(b);
+  return NumDecSlow(w,nd,exp,sticky,dig); //rare
+  }
+};
+
+//double to decimal ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+inline NAT NumPow5Bits(int e) { return (NAT)(((e*1217359)>>19)+1); }
+inline NAT NumLog10Pow2(int e) { return (NAT)((e*78913)>>18); }
+inline NAT NumLog10Pow5(int e) { return (NAT)((e*732923)>>20); }
+inline NAT NumPow5Factor(QWORD v) { NAT c=0; for(;v%5==0;v/=5) c++; return c; }
+
+inline QWORD NumMulShift(QWORD m,const QWORD*mul,int j) //(m*mul)>>j, mul=lo,hi, j>64
+{
+QWORD b0lo,b0hi=NumMul128(m,mul[0],&b0lo);
+QWORD b2lo,b2hi=NumMul128(m,mul[1],&b2lo);
+QWORD slo=b0hi+b2lo,shi=b2hi+(slo<b0hi);
+j-=64;
+return j>=64?shi>>(j-64):(slo>>j)|(shi<<(64-j));
+}
+
+//shortest digits that read back as v (v>0, finite): v~digits*10^exp10 (Ryu) ................................
+QWORD NumShortest(double v,int*exp10)
+{
+QWORD bits,m2,vr,vp,vm,output;
+memcpy(&bits,&v,8);
+QWORD mant=bits&(((QWORD)1<<52)-1);
+NAT iexp=(NAT)(bits>>52)&0x7ff;
+int e2,e10,removed=0;
+if(!iexp) e2=1-1023-52-2,m2=mant;
+else e2=(int)iexp-1023-52-2,m2=((QWORD)1<<52)|mant;
+const NAT even=(m2&1)==0;
+const QWORD mv=4*m2;
+const NAT mmShift=mant!=0||iexp<=1;
+NAT vmTZ=0,vrTZ=0,last=0;
+const NUMTAB&t=NumTab();
+if(e2>=0)
+ {
+ const NAT q=NumLog10Pow2(e2)-(e2>3);
+ e10=(int)q;
+ const int k=125+(int)NumPow5Bits((int)q)-1;
+ const int i=-e2+(int)q+k;
+ vr=NumMulShift(4*m2,t.inv5[q],i);
+ vp=NumMulShift(4*m2+2,t.inv5[q],i);
+ vm=NumMulShift(4*m2-1-mmShift,t.inv5[q],i);
+ if(q<=21)
+  {
+  if(mv%5==0) vrTZ=NumPow5Factor(mv)>=q;
+  else if(even) vmTZ=NumPow5Factor(mv-1-mmShift)>=q;
+  else vp-=NumPow5Factor(mv+2)>=q;
+  }
+ }
+else
+ {
+ const NAT q=NumLog10Pow5(-e2)-(-e2>1);
+ e10=(int)q+e2;
+ const int i=-e2-(int)q;
+ const int k=(int)NumPow5Bits(i)-125;
+ const int j=(int)q-k;
+ vr=NumMulShift(4*m2,t.pow5[i],j);
+ vp=NumMulShift(4*m2+2,t.pow5[i],j);
+ vm=NumMulShift(4*m2-1-mmShift,t.pow5[i],j);
+ if(q<=1)
+  {
+  vrTZ=1;
+  if(even) vmTZ=mmShift==1;
+  else vp--;
+  }
+ else if(q<63)
+  vrTZ=(mv&(((QWORD)1<<q)-1))==0;
+ }
+if(vmTZ||vrTZ) //general case (~0.7%)
+ {
+ for(;vp/10>vm/10;removed++)
+  {
+  vmTZ&=vm%10==0;
+  vrTZ&=last==0;
+  last=(NAT)(vr%10);
+  vr/=10; vp/=10; vm/=10;
+  }
+ if(vmTZ)
+  for(;vm%10==0;removed++)
+   {
+   vrTZ&=last==0;
+   last=(NAT)(vr%10);
+   vr/=10; vp/=10; vm/=10;
+   }
+ if(vrTZ&&last==5&&vr%2==0) last=4; //exactly .5: round to even
+ output=vr+((vr==vm&&(!even||!vmTZ))||last>=5);
+ }
+else
+ {
+ NAT up=0;
+ if(vp/100>vm/100) //two digits at once (~86%)
+  {
+  up=vr%100>=50;
+  vr/=100; vp/=100; vm/=100;
+  removed+=2;
+  }
+ for(;vp/10>vm/10;removed++)
+  {
+  up=vr%10>=5;
+  vr/=10; vp/=10; vm/=10;
+  }
+ output=vr+(vr==vm||up);
+ }
+*exp10=e10+removed;
+return output;
+}
+
+//writes v in fixed notation, prec<0: shortest digits that read back as v, else prec decimals
+//rounded to nearest even on the exact value; returns the length (no terminator) ..........................
+#define NUMFMT_SZ 400 //text buffer size for NumFixed
+NAT NumFixed(double v,int prec,char*text)
+{
+char dig[24],*p=text;
+NAT nd=0,i;
+int e; //exponent of the last digit
+if(v<0) *p++='-',v=-v;
+if(prec>=0)
+ {
+ static const double p10[23]={1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+ double x=prec<=22?v*p10[prec]:HUGE_VAL;
+ if(!(x<9007199254740992.)) //beyond the exact product: the CRT rounds exactly too
+  return (NAT)(p-text)+sprintf(p,"%.*f",prec,v);
+ double err=fma(v,p10[prec],-x),n=floor(x),f=x-n; //v*10^prec=x+err exactly, |err|<=ulp(x)/2
+ if(f>0.5||(f==0.5&&(err>0||(err==0&&fmod(n,2.)!=0)))) //x halfway: err decides, else even
+  n++;
+ QWORD r=(QWORD)n;
+ do dig[nd++]=(char)('0'+r%10),r/=10; while(r);
+ while(nd<=(NAT)prec) dig[nd++]='0';
+ for(i=nd;i--;)
+  {
+  *p++=dig[i];
+  if(i==(NAT)prec&&prec) *p++='.';
+  }
+ return (NAT)(p-text);
+ }
+if(v==0)
+ {
+ *p++='0';
+ return (NAT)(p-text);
+ }
+QWORD r=NumShortest(v,&e);
+do dig[nd++]=(char)('0'+r%10),r/=10; while(r);
+if(e>=0) //integer
+ {
+ for(i=nd;i--;) *p++=dig[i];
+ for(;e;e--) *p++='0';
+ }
+else if((int)nd+e>0) //point inside the digits
+ for(i=nd;i--;)
+  {
+  *p++=dig[i];
+  if((int)i==-e) *p++='.';
+  }
+else
+ {
+ *p++='0';
+ *p++='.';
+ for(e=-e-(int)nd;e;e--) *p++='0';
+ for(i=nd;i--;) *p++=dig[i];
+ }
+return (NAT)(p-text);
+}
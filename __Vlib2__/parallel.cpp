@@ -0,0 +1,73 @@
+#pragma once
+#define V_PARALLEL //splits a job over worker threads: fn(ctx,t,nt) for t=0..nt-1
+
+//arguments of one worker
+struct PAR_WORK
+{
+ void (*fn)(void*,NAT,NAT);
+ void*ctx;
+ NAT t,nt;
+};
+
+DWORD WINAPI ParWorkThread(LPVOID par)
+{
+PAR_WORK*pw=(PAR_WORK*)par;
+pw->fn(pw->ctx,pw->t,pw->nt);
+return 0;
+}
+
+//processors available (the default number of threads) ................................................
+inline NAT ParThreads()
+{
+static NAT n=0;
+if(!n)
+ {
+ SYSTEM_INFO si;
+ GetSystemInfo(&si);
+ n=MAX(si.dwNumberOfProcessors,1);
+ }
+return n;
+}
+
+//runs fn(ctx,t,nt) for t=0..nt-1 and waits for all; t=0 runs on the calling thread ..................
+void ParRun(void (*fn)(void*,NAT,NAT),void*ctx,NAT nt)
+{
+NAT t,nh=0;
+if(nt<=1)
+ {
+ fn(ctx,0,1);
+ return;
+ }
+PAR_WORK*work=(PAR_WORK*)ALLOC(nt*sizeof(PAR_WORK));
+HANDLE*hth=(HANDLE*)ALLOC(nt*sizeof(HANDLE));
+if(!work||!hth)
+ {
+ FREE(work);
+ FREE(hth);
+ for(t=0;t<nt;t++)
+  fn(ctx,t,nt);
+ return;
+ }
+for(t=0;t<nt;t++)
+ {
+ work[t].fn=fn;
+ work[t].ctx=ctx;
+ work[t].t=t;
+ work[t].nt=nt;
+ }
+for(t=1;t<nt;t++)
+ {
+ hth[nh]=CreateThread(NULL,0,ParWorkThread,work+t,0,NULL);
+ if(hth[nh])
+  nh++;
+ else
+  fn(ctx,t,nt); //no thread, do it here
+ }
+fn(ctx,0,nt);
+for(t=0;t<nh;t+=MAXIMUM_WAIT_OBJECTS)
+ WaitForMultipleObjects(MIN(nh-t,MAXIMUM_WAIT_OBJECTS),hth+t,TRUE,INFINITE);
+for(t=0;t<nh;t++)
+ CloseHandle(hth[t]);
+FREE(hth);
+FREE(work);
+}
@@ -0,0 +1,316 @@
+#pragma once
+#define V_PFCONV //pixel format conversion kernels (SSSE3/AVX2 shuffles + portable fallback) used by CCONV and BLTRGB
+
+#include <simd.cpp>
+
+//Pixel Format CONVersion ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//built from the masks'n'rolls of CCONV::Tf / BLTRGB::PFs: dst=OR(src&mask[ch] rol roll[ch])
+//a masked channel never wraps around, so every rol is a plain shl or shr; channels sharing the
+//same shift are merged in one group
+struct PFCONV
+{
+ DWORD mask[4]; //group masks
+ BYTE shl[4],shr[4]; //group shifts (one of them is 0)
+ NAT nrg; //groups in use
+ NAT SB,DB; //B/pixel 1..4 (SB=0: nothing to convert)
+ NAT perm; //!0: only whole bytes are moved, shuf maps src to dst bytes of P pixels
+ NAT P; //pixels per 16B block
+ BYTE shuf[16]; //perm: src->dst bytes; else: 32 bit lanes->DB bytes
+ BYTE expand[16]; //!perm: SB bytes->32 bit lanes
+};
+
+typedef void (*PFROWFN)(BYTE*pd,const BYTE*ps,NAT count); //converts a row of pixels
+typedef DWORD (*PFPIXFN)(DWORD s); //converts one pixel
+
+//reads/writes an n bytes pixel (little endian) -------------------------------------------------
+inline DWORD PFLoad(const BYTE*p,NAT n)
+{
+switch(n)
+ {
+ case 4: return *(const DWORD*)p;
+ case 3: return *(const WORD*)p|((DWORD)p[2]<<16);
+ case 2: return *(const WORD*)p;
+ case 1: return *p;
+ }
+return 0;
+}
+
+inline void PFStore(BYTE*p,DWORD v,NAT n)
+{
+switch(n)
+ {
+ case 4: *(DWORD*)p=v; break;
+ case 3: *(WORD*)p=(WORD)v; p[2]=(BYTE)(v>>16); break;
+ case 2: *(WORD*)p=(WORD)v; break;
+ case 1: *p=(BYTE)v; break;
+ }
+}
+
+//one pixel ...............................................................................
+inline DWORD PFConvPix(const PFCONV*pc,DWORD s)
+{
+DWORD d=0;
+for(NAT g=0;g<pc->nrg;g++)
+ d|=((s&pc->mask[g])<<pc->shl[g])>>pc->shr[g];
+return d;
+}
+
+//sets up the kernels for a conversion (mask[4],roll[4] as in CCONV) ----------------------------
+void PFConvInit(PFCONV*pc,const DWORD*mask,const BYTE*roll,NAT sbpp,NAT dbpp)
+{
+NAT ch,g,b,l,r;
+ZeroMemory(pc,sizeof(PFCONV));
+if(sbpp<1||sbpp>4||dbpp<1||dbpp>4) return;
+pc->SB=sbpp;
+pc->DB=dbpp;
+for(ch=0;ch<4;ch++)
+ {
+ if(!mask[ch]) continue;
+ r=roll[ch]&31;
+ if(!(((QWORD)mask[ch]<<r)>>32)) l=r,r=0; //rol==shl
+ else l=0,r=32-r; //rol==shr
+ for(g=0;g<pc->nrg;g++)
+  if(pc->shl[g]==l&&pc->shr[g]==r) break;
+ if(g==pc->nrg)
+  pc->shl[g]=(BYTE)l,pc->shr[g]=(BYTE)r,pc->nrg++;
+ pc->mask[g]|=mask[ch];
+ }
+//a byte permutation: every dst byte is zero or one whole src byte
+BYTE map[4];
+pc->perm=1;
+for(b=0;b<dbpp;b++)
+ {
+ DWORD bm=0xffu<<(b*8),got;
+ map[b]=0x80;
+ for(g=0;g<pc->nrg;g++)
+  {
+  got=((pc->mask[g]<<pc->shl[g])>>pc->shr[g])&bm;
+  if(!got) continue;
+  if(got!=bm||map[b]!=0x80||(pc->shl[g]|pc->shr[g])&7) { pc->perm=0; break; }
+  map[b]=(BYTE)(b-pc->shl[g]/8+pc->shr[g]/8);
+  }
+ if(!pc->perm) break;
+ }
+memset(pc->shuf,0x80,16);
+memset(pc->expand,0x80,16);
+if(pc->perm)
+ {
+ pc->P=16/(MAX(sbpp,dbpp)==3?4:MAX(sbpp,dbpp));
+ for(NAT p=0;p<pc->P;p++)
+  for(b=0;b<dbpp;b++)
+   if(map[b]!=0x80)
+    pc->shuf[p*dbpp+b]=(BYTE)(p*sbpp+map[b]);
+ }
+else
+ {
+ pc->P=4;
+ for(NAT p=0;p<4;p++)
+  {
+  for(b=0;b<sbpp;b++)
+   pc->expand[p*4+b]=(BYTE)(p*sbpp+b);
+  for(b=0;b<dbpp;b++)
+   pc->shuf[p*dbpp+b]=(BYTE)(p*4+b);
+  }
+ }
+}
+
+//block kernels: every 16B load/store stays inside the count pixels, return pixels done ..........
+#if defined(VSIMD_SSSE3)
+NAT PFConvSSSE3(const PFCONV*pc,BYTE*pd,const BYTE*ps,NAT count)
+{
+NAT i=0,P=pc->P,SB=pc->SB,DB=pc->DB;
+const NAT send=count*SB,dend=count*DB;
+__m128i shuf=_mm_loadu_si128((const __m128i*)pc->shuf);
+if(pc->perm)
+ {
+ for(;i*SB+16<=send&&i*DB+16<=dend;i+=P)
+  _mm_storeu_si128((__m128i*)(pd+i*DB),_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(ps+i*SB)),shuf));
+ return i;
+ }
+__m128i ex=_mm_loadu_si128((const __m128i*)pc->expand),m[4],cl[4],cr[4],x,y;
+for(NAT g=0;g<pc->nrg;g++)
+ {
+ m[g]=_mm_set1_epi32(pc->mask[g]);
+ cl[g]=_mm_cvtsi32_si128(pc->shl[g]);
+ cr[g]=_mm_cvtsi32_si128(pc->shr[g]);
+ }
+for(;i*SB+16<=send&&i*DB+16<=dend;i+=4)
+ {
+ x=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(ps+i*SB)),ex);
+ y=_mm_setzero_si128();
+ for(NAT g=0;g<pc->nrg;g++)
+  y=_mm_or_si128(y,_mm_srl_epi32(_mm_sll_epi32(_mm_and_si128(x,m[g]),cl[g]),cr[g]));
+ _mm_storeu_si128((__m128i*)(pd+i*DB),_mm_shuffle_epi8(y,shuf));
+ }
+return i;
+}
+#endif
+
+#if defined(VSIMD_AVX2)
+//two 128 bit lanes of P pixels each (vpshufb does not cross lanes)
+NAT PFConvAVX2(const PFCONV*pc,BYTE*pd,const BYTE*ps,NAT count)
+{
+NAT i=0,P=pc->P,SB=pc->SB,DB=pc->DB;
+const NAT send=count*SB,dend=count*DB;
+__m256i shuf=_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)pc->shuf)),x,y;
+#define PFCONV_LOAD2(i) _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(ps+(i)*SB))),_mm_loadu_si128((const __m128i*)(ps+((i)+P)*SB)),1)
+#define PFCONV_STORE2(i,v) if(P*DB==16) _mm256_storeu_si256((__m256i*)(pd+(i)*DB),v); \
+ else _mm_storeu_si128((__m128i*)(pd+(i)*DB),_mm256_castsi256_si128(v)),_mm_storeu_si128((__m128i*)(pd+((i)+P)*DB),_mm256_extracti128_si256(v,1))
+if(pc->perm)
+ {
+ for(;(i+P)*SB+16<=send&&(i+P)*DB+16<=dend;i+=2*P)
+  {
+  y=_mm256_shuffle_epi8(PFCONV_LOAD2(i),shuf);
+  PFCONV_STORE2(i,y);
+  }
+ return i;
+ }
+__m256i ex=_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)pc->expand)),m[4];
+__m128i cl[4],cr[4];
+for(NAT g=0;g<pc->nrg;g++)
+ {
+ m[g]=_mm256_set1_epi32(pc->mask[g]);
+ cl[g]=_mm_cvtsi32_si128(pc->shl[g]);
+ cr[g]=_mm_cvtsi32_si128(pc->shr[g]);
+ }
+for(;(i+P)*SB+16<=send&&(i+P)*DB+16<=dend;i+=2*P)
+ {
+ x=_mm256_shuffle_epi8(PFCONV_LOAD2(i),ex);
+ y=_mm256_setzero_si256();
+ for(NAT g=0;g<pc->nrg;g++)
+  y=_mm256_or_si256(y,_mm256_srl_epi32(_mm256_sll_epi32(_mm256_and_si256(x,m[g]),cl[g]),cr[g]));
+ y=_mm256_shuffle_epi8(y,shuf);
+ PFCONV_STORE2(i,y);
+ }
+#undef PFCONV_LOAD2
+#undef PFCONV_STORE2
+return i;
+}
+#endif
+
+//converts count pixels (writes exactly count*DB bytes) ---------------------------------------
+void PFConvRow(const PFCONV*pc,void*pdc,const void*psc,NAT count)
+{
+BYTE*pd=(BYTE*)pdc;
+const BYTE*ps=(const BYTE*)psc;
+NAT i=0,SB=pc->SB,DB=pc->DB;
+if(!SB) return;
+#if defined(VSIMD_AVX2)
+if(SimdCPU()&SIMD_CPU_AVX2)
+ i=PFConvAVX2(pc,pd,ps,count);
+#endif
+#if defined(VSIMD_SSSE3)
+if(i<count&&SimdCPU()&SIMD_CPU_SSSE3)
+ i+=PFConvSSSE3(pc,pd+i*DB,ps+i*SB,count-i);
+#endif
+for(;i<count;i++)
+ PFStore(pd+i*DB,PFConvPix(pc,PFLoad(ps+i*SB,SB)),DB);
+}
+
+//converts n palette entries (SB bytes each) to DWORDs holding DB bytes pixels .....................
+void PFConvPal(const PFCONV*pc,DWORD*lut,const void*pal,NAT n)
+{
+const BYTE*pp=(const BYTE*)pal;
+for(NAT k=0;k<n;k++,pp+=pc->SB)
+ lut[k]=PFConvPix(pc,PFLoad(pp,pc->SB));
+}
+
+//looks up count indexes (Bpi bytes masked by Imask) in a converted palette .....................
+void PFConvIdx(NAT DB,void*pdc,const DWORD*lut,const void*psi,NAT count,NAT Bpi,DWORD Imask)
+{
+BYTE*pd=(BYTE*)pdc;
+const BYTE*ps=(const BYTE*)psi;
+NAT i=0;
+#if defined(VSIMD_AVX2)
+if(Bpi==1&&DB==4&&SimdCPU()&SIMD_CPU_AVX2)
+ {
+ __m256i im=_mm256_set1_epi32(Imask);
+ for(;i+8<=count;i+=8)
+  {
+  __m256i k=_mm256_and_si256(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(ps+i))),im);
+  _mm256_storeu_si256((__m256i*)(pd+i*4),_mm256_i32gather_epi32((const int*)lut,k,4));
+  }
+ ps+=i;
+ }
+#endif
+for(;i<count;i++,ps+=Bpi)
+ PFStore(pd+i*DB,lut[PFLoad(ps,Bpi)&Imask],DB);
+}
+
+//palette translation: pal entries are SB bytes, indexes Bpi bytes masked by Imask ...............
+//npal: palette entries, bigger indexes give 0 pixels (0: unknown, only the indexed entries are read)
+void PFConvLut(const PFCONV*pc,void*pdc,const void*pal,const void*psi,NAT count,NAT Bpi,DWORD Imask,NAT npal=0)
+{
+BYTE*pd=(BYTE*)pdc;
+const BYTE*pp=(const BYTE*)pal,*ps=(const BYTE*)psi;
+NAT SB=pc->SB,DB=pc->DB,i,k;
+if(!SB) return;
+if(Imask>0xff) //wide indexes: convert as they come
+ {
+ for(i=0;i<count;i++,ps+=Bpi)
+  {
+  k=PFLoad(ps,Bpi)&Imask;
+  PFStore(pd+i*DB,npal&&k>=npal?0:PFConvPix(pc,PFLoad(pp+k*SB,SB)),DB);
+  }
+ return;
+ }
+DWORD lut[256]; //converted palette, only the entries in use (the palette may be shorter than Imask+1)
+BYTE used[256];
+ZeroMemory(used,Imask+1);
+for(i=0;i<count;i++)
+ used[PFLoad(ps+i*Bpi,Bpi)&Imask]=1;
+for(k=0;k<=Imask;k++)
+ if(used[k])
+  lut[k]=npal&&k>=npal?0:PFConvPix(pc,PFLoad(pp+k*SB,SB));
+PFConvIdx(DB,pd,lut,ps,count,Bpi,Imask);
+}
+
+//converts a pixel rect (pc=NULL: same format, Bpp bytes/pixel; rowfn: specialized row kernel) ...
+void PFConvRect(const PFCONV*pc,NAT Bpp,void*pdc,int dspan,const void*psc,int sspan,NAT lng,NAT lat,PFROWFN rowfn=NULL)
+{
+BYTE*pd=(BYTE*)pdc;
+const BYTE*ps=(const BYTE*)psc;
+for(;lat;lat--,pd+=dspan,ps+=sspan)
+ if(rowfn) rowfn(pd,ps,lng);
+ else if(pc) PFConvRow(pc,pd,ps,lng);
+ else CopyMemory(pd,ps,lng*Bpp);
+}
+
+//stretches a pixel rect taking the nearest pixel, dst rows reading the same src row are copied
+//(pc=NULL: same format, Bpp bytes/pixel; rowfn: specialized row kernel) ................................
+void PFConvZoom(const PFCONV*pc,NAT Bpp,void*pdc,int dspan,NAT dlng,NAT dlat,const void*psc,int sspan,NAT slng,NAT slat,PFROWFN rowfn=NULL)
+{
+if(!dlng||!dlat||!slng||!slat) return;
+NAT SB=pc?pc->SB:Bpp,DB=pc?pc->DB:Bpp,x,y,sy,prev=~0u;
+if(!SB) return;
+NAT*xoff=ALLOC_NAT(dlng); //src byte offset of every dst pixel
+BYTE*row=pc?ALLOC_BYTE(dlng*SB):NULL; //gathered src pixels
+BYTE*pd=(BYTE*)pdc,*last=NULL;
+const BYTE*ps;
+for(x=0;x<dlng;x++)
+ xoff[x]=(NAT)((QWORD)x*slng/dlng)*SB;
+for(y=0;y<dlat;y++,pd+=dspan)
+ {
+ sy=(NAT)((QWORD)y*slat/dlat);
+ if(sy==prev)
+  {
+  CopyMemory(pd,last,dlng*DB);
+  continue;
+  }
+ ps=(const BYTE*)psc+(int)sy*sspan;
+ BYTE*pg=pc?row:pd;
+ switch(SB)
+  {
+  case 4: for(x=0;x<dlng;x++) ((DWORD*)pg)[x]=*(const DWORD*)(ps+xoff[x]); break;
+  case 2: for(x=0;x<dlng;x++) ((WORD*)pg)[x]=*(const WORD*)(ps+xoff[x]); break;
+  case 1: for(x=0;x<dlng;x++) pg[x]=ps[xoff[x]]; break;
+  default: for(x=0;x<dlng;x++) CopyMemory(pg+x*SB,ps+xoff[x],SB);
+  }
+ if(rowfn) rowfn(pd,row,dlng);
+ else if(pc) PFConvRow(pc,pd,row,dlng);
+ prev=sy;
+ last=pd;
+ }
+FREE(row);
+FREE(xoff);
+}
@@ -0,0 +1,91 @@
+#pragma once
+#define V_SIMD //SIMD headers, compile-time gates and CPU feature detection shared by the vectorized paths
+
+#include <stdint.h>
+
+//VSIMD_xxx: the path can be compiled here (MSVC compiles any intrinsic, GCC only what -m flags enable)
+//SimdCPU(): the path can be run on this CPU
+#if defined(_M_X64)||defined(__x86_64__)||defined(__SSE2__)||(defined(_M_IX86_FP)&&_M_IX86_FP>=2)
+ #define VSIMD_SSE2
+ #include <emmintrin.h>
+ #if defined(_MSC_VER)
+  #include <intrin.h>
+  #include <immintrin.h>
+  #define VSIMD_SSSE3
+  #define VSIMD_SSE41
+  #define VSIMD_AVX2
+  #define VSIMD_FMA
+  #define VSIMD_SHANI
+ #else
+  #include <cpuid.h>
+  #include <immintrin.h>
+  #if defined(__SSSE3__)
+   #define VSIMD_SSSE3
+  #endif
+  #if defined(__SSE4_1__)
+   #define VSIMD_SSE41
+  #endif
+  #if defined(__AVX2__)
+   #define VSIMD_AVX2
+  #endif
+  #if defined(__AVX2__)&&defined(__FMA__)
+   #define VSIMD_FMA
+  #endif
+  #if defined(__SHA__)&&defined(__SSE4_1__)
+   #define VSIMD_SHANI
+  #endif
+ #endif
+#endif
+
+#define SIMD_CPU_AVX2     0x1 //AVX2 and the OS saves YMM
+#define SIMD_CPU_SHANI    0x2 //SHA + SSE4.1
+#define SIMD_CPU_SSE41    0x4
+#define SIMD_CPU_FMA      0x8 //FMA3 (only set with SIMD_CPU_AVX2)
+#define SIMD_CPU_SSSE3   0x10
+
+//CPU features usable by the SIMD paths (cached) --------------------------------------------------
+inline NAT SimdCPU()
+{
+static int feat=-1;
+if(feat>=0) return feat;
+feat=0;
+#if defined(VSIMD_SSE2)
+unsigned r[4]={0},r7[4]={0};
+#if defined(_MSC_VER)
+__cpuid((int*)r,0);
+if(r[0]>=7)
+ __cpuidex((int*)r7,7,0);
+if(r[0]>=1)
+ __cpuid((int*)r,1);
+#else
+__get_cpuid(0,&r[0],&r[1],&r[2],&r[3]);
+if(r[0]>=7)
+ __get_cpuid_count(7,0,&r7[0],&r7[1],&r7[2],&r7[3]);
+if(r[0]>=1)
+ __get_cpuid(1,&r[0],&r[1],&r[2],&r[3]);
+#endif
+if((r[2]>>9)&1)
+ feat|=SIMD_CPU_SSSE3;
+if((r[2]>>19)&1)
+ feat|=SIMD_CPU_SSE41;
+if((r7[1]>>29)&1&&(r[2]>>19)&1)
+ feat|=SIMD_CPU_SHANI;
+if((r7[1]>>5)&1&&(r[2]>>27)&1) //AVX2 + OSXSAVE
+ {
+ #if defined(_MSC_VER)
+ unsigned __int64 xcr0=_xgetbv(0);
+ #else
+ unsigned lo,hi;
+ __asm__ __volatile__("xgetbv":"=a"(lo),"=d"(hi):"c"(0));
+ uint64_t xcr0=((uint64_t)hi<<32)|lo;
+ #endif
+ if((xcr0&6)==6) //OS saves YMM
+  {
+  feat|=SIMD_CPU_AVX2;
+  if((r[2]>>12)&1)
+   feat|=SIMD_CPU_FMA;
+  }
+ }
+#endif
+return feat;
+}
@@ -3,6 +3,7 @@
 #define V_STRING
 
 #include <bas.cpp>
+#include <numconv.cpp>
 
 /* All functions asume the strings are null terminated even if size is given;
 also string size is the number of actual characters excluding the terminator.
@@ -149,23 +150,108 @@ LNextArg:
  }
 }
 
-//string length (to terminator) ------------------------------------------------------------
-inline NAT __cdecl sl(char*lstr,char term=0)
+//SIMD scanning core ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//scans walk 32B aligned blocks: a block never crosses a page, so scans without a size may read past
+//the terminator inside its block; the first block is shifted so bit 0 is the first char
+#if defined(VSIMD_AVX2)
+//folds 'a'..'z' to upper case in every lane
+inline __m256i StrFoldAVX2(__m256i x)
 {
-__asm
+__m256i lc=_mm256_and_si256(_mm256_cmpgt_epi8(x,_mm256_set1_epi8('a'-1)),_mm256_cmpgt_epi8(_mm256_set1_epi8('z'+1),x));
+return _mm256_sub_epi8(x,_mm256_and_si256(lc,_mm256_set1_epi8(32)));
+}
+
+//chars equal to one of up to 8 chars
+struct STRSCAN_SET
+{
+ __m256i ch[8];
+ NAT nr;
+ NAT operator()(__m256i x) const
+  {
+  __m256i m=_mm256_cmpeq_epi8(x,ch[0]);
+  for(NAT k=1;k<nr;k++)
+   m=_mm256_or_si256(m,_mm256_cmpeq_epi8(x,ch[k]));
+  return (NAT)_mm256_movemask_epi8(m);
+  }
+};
+
+//offset of the first char in [p,p+n) (n=0: no limit) flagged by test, or R_NULL ...................
+template<class T> NAT StrScanAVX2(const char*p,NAT n,const T&test)
+{
+const char*b=(const char*)((size_t)p&~(size_t)31);
+NAT lim=n?n:~0u,off=(NAT)(b-p),m; //off: block offset from p (wraps for the first block)
+m=test(_mm256_load_si256((const __m256i*)b))>>(p-b);
+if(m) return MemLSB(m)<lim?MemLSB(m):R_NULL;
+for(off+=32;off<lim;off+=32)
+ if((m=test(_mm256_load_si256((const __m256i*)(p+off)))))
+  return off+MemLSB(m)<lim?off+MemLSB(m):R_NULL;
+return R_NULL;
+}
+#endif
+
+inline char StrFold(char c) { return c>='a'&&c<='z'?c-32:c; }
+
+//finds seq[0..seqsz) in lstr[0..maxsz), fold: ASCII case insensitive ..................................
+//candidates are positions matching both the first and the last char of seq (32 per step),
+//only those are compared in full
+NAT StrFind(const char*lstr,NAT maxsz,const char*seq,NAT seqsz,NAT fold)
+{
+NAT i=0,c,last;
+if(!lstr||!seq) return R_NULL;
+if(!seqsz) return 0;
+if(maxsz<seqsz) return R_NULL;
+last=maxsz-seqsz; //last candidate
+#if defined(VSIMD_AVX2)
+if(SimdCPU()&SIMD_CPU_AVX2)
+ {
+ __m256i vf=_mm256_set1_epi8(fold?StrFold(seq[0]):seq[0]),vl=_mm256_set1_epi8(fold?StrFold(seq[seqsz-1]):seq[seqsz-1]),a,b;
+ for(;i+31<=last;i+=32)
+  {
+  a=_mm256_loadu_si256((const __m256i*)(lstr+i));
+  b=_mm256_loadu_si256((const __m256i*)(lstr+i+seqsz-1));
+  if(fold) a=StrFoldAVX2(a),b=StrFoldAVX2(b);
+  NAT m=(NAT)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a,vf),_mm256_cmpeq_epi8(b,vl)));
+  for(;m;m&=m-1)
+   {
+   const char*ps=lstr+i+MemLSB(m);
+   if(!fold)
+    {
+    if(!memcmp(ps+1,seq+1,seqsz-1)) return i+MemLSB(m);
+    continue;
+    }
+   for(c=1;c<seqsz-1;c++)
+    if(StrFold(ps[c])!=StrFold(seq[c])) break;
+   if(c>=seqsz-1) return i+MemLSB(m);
+   }
+  }
+ }
+#endif
+for(;i<=last;i++)
  {
- mov eax,lstr
- mov ecx,eax
- jecxz LBreakOut //if(!lstr) return 0;
- mov dl,term
-LNextchar:
-  cmp dl,[eax]
-  je LBreakOut
-  inc eax
-  jmp LNextchar
-LBreakOut:
- sub eax,ecx
+ for(c=0;c<seqsz;c++)
+  if(fold?StrFold(lstr[i+c])!=StrFold(seq[c]):lstr[i+c]!=seq[c]) break;
+ if(c==seqsz) return i;
  }
+return R_NULL;
+}
+
+//string length (to terminator) ------------------------------------------------------------
+inline NAT __cdecl sl(char*lstr,char term=0)
+{
+if(!lstr) return 0;
+if(!term) return (NAT)strlen(lstr);
+#if defined(VSIMD_AVX2)
+if(SimdCPU()&SIMD_CPU_AVX2)
+ {
+ STRSCAN_SET t;
+ t.ch[0]=_mm256_set1_epi8(term);
+ t.nr=1;
+ return StrScanAVX2(lstr,0,t);
+ }
+#endif
+char*p=lstr;
+while(*p!=term) p++;
+return (NAT)(p-lstr);
 }
 
 //string length to any of the terminators ----------------------------------------------------------
@@ -612,24 +698,31 @@ return nc;
 //numarul de aparitii al ch in str --------------------------------------------------------
 inline NAT __cdecl countch(char sep,LPSTR dstr,NAT dsz=0,char term=0)
 {
-__asm
- {
- mov ebx,dstr
- mov dl,term
- mov dh,sep
- mov ecx,dsz
- xor eax,eax
-LNextChar:
-  cmp dl,[ebx]
-  je LBreakOut
-  cmp dh,[ebx]
-  jne LNoInc
-  inc eax
-LNoInc:
-  inc ebx
-  loop LNextchar
-LBreakOut:
+NAT cnt=0,lim=dsz?dsz:~0u,i=0;
+#if defined(VSIMD_AVX2)
+if(SimdCPU()&SIMD_CPU_AVX2)
+ {
+ __m256i vt=_mm256_set1_epi8(term),vs=_mm256_set1_epi8(sep),x;
+ const char*b=(const char*)((size_t)dstr&~(size_t)31);
+ NAT sh=(NAT)(dstr-b),off,mt,ms,n;
+ for(off=0;;off+=32) //off: offset of the block end-32 from dstr+sh
+  {
+  x=_mm256_load_si256((const __m256i*)(b+off));
+  mt=(NAT)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x,vt));
+  ms=(NAT)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x,vs));
+  if(!off) mt>>=sh,ms>>=sh;
+  n=off?32:32-sh; //chars of dstr in this block, starting at i
+  if(lim-i<n) n=lim-i;
+  if(mt&&MemLSB(mt)<n) n=MemLSB(mt); //stop at term
+  cnt+=MemPopCnt(n<32?ms&((1u<<n)-1):ms);
+  i+=n;
+  if(i>=lim||(mt&&n==MemLSB(mt))) return cnt;
+  }
  }
+#endif
+for(;i<lim&&dstr[i]!=term;i++)
+ cnt+=dstr[i]==sep;
+return cnt;
 }
 
 //returns position of first sep or term in dstr-----------------------------------------------------
@@ -786,140 +879,42 @@ LBreakOut:
 //find any char in terms or R_NULL if none --------------------------------------------------------------------
 inline NAT __cdecl s_anych(char*lstr,char*terms,NAT nrt,NAT maxsz=0)
 {
-__asm
- {
- mov ebx,lstr
-LNextChar:
-  mov edx,terms
-  mov ecx,nrt
-  mov al,[ebx]
-LNextTerm:
-   cmp al,[edx]
-   je LFoundTerm
-   inc edx //next term
-   dec ecx
-   jnz LNextTerm
-  inc ebx
-  dec maxsz
-  jnz LNextChar
- mov eax,R_NULL
- jmp LReturn 
-LFoundTerm:
- mov eax,ebx
- sub eax,lstr  //return strlen(dstr)
-LReturn:
- }
+NAT i,lim=maxsz?maxsz:~0u;
+if(!nrt) return R_NULL;
+#if defined(VSIMD_AVX2)
+if(nrt<=8&&SimdCPU()&SIMD_CPU_AVX2)
+ {
+ STRSCAN_SET t;
+ for(i=0;i<nrt;i++)
+  t.ch[i]=_mm256_set1_epi8(terms[i]);
+ t.nr=nrt;
+ return StrScanAVX2(lstr,maxsz,t);
+ }
+#endif
+BYTE in[256]={0}; //bigger sets: lookup table
+for(i=0;i<nrt;i++)
+ in[(BYTE)terms[i]]=1;
+for(i=0;i<lim;i++)
+ if(in[(BYTE)lstr[i]]) return i;
+return R_NULL;
 }
 
 //find seq in lstr or R_NULL if none --------------------------------------------------------------------
 inline NAT __cdecl s_seq(char*lstr,char*seq,NAT seqsz,NAT maxsz=0)
 {
-__asm
- {
- mov edx,lstr
- mov ebx,maxsz
- cmp ebx,seqsz
- jb	LNotFound       //if(seqsz<maxsz) return R_NULL
- dec seqsz
- sub ebx,seqsz		//maxsz-=seqsz-1
- mov esi,seq
- mov al,[esi]
-LNextChar:
-  cmp al,[edx]
-  je LFoundMatch
-  inc edx //next
-LContinueChar:
-  dec ebx
-  jnz LNextChar
- jmp LNotFound 
-LFoundMatch:
- mov ecx,seqsz
- jecxz LSeqComplete
- mov eax,edx
- inc edx //next
- mov edi,edx
- inc esi
-LNextCharInSeq:
-  cmpsb
-  jne LRestartSeq
-  loop LNextCharInSeq
-LSeqComplete:
- sub eax,lstr  //return strlen(lstr)
- jmp LReturn 
-LRestartSeq:
- mov esi,seq
- mov al,[esi]
- jmp LContinueChar
-LNotFound: 
- mov eax,R_NULL
-LReturn:
- }
+return StrFind(lstr,maxsz,seq,seqsz,0);
 }
 
 //find seq (case sensitive) in lstr or R_NULL if none --------------------------------------------------------------------
 inline NAT s_seqS(char*lstr,char*seq,NAT seqsz,NAT maxsz=0)
 {
-int found;
-if(!lstr||!seq) return R_NULL;
-for(int p=0;p<=(signed)(maxsz-seqsz);p++)
- {
- found=1;
- for(NAT c=0;c<seqsz;c++)
-  {
-  if(lstr[p+c]==seq[c])
-   continue;
-  else
-   {
-   found=0;
-   break;
-   }
-  }
- if(found) return p;
- }
-return R_NULL;
+return StrFind(lstr,maxsz,seq,seqsz,0);
 }
 
 //find seq (case insensitive) in lstr or R_NULL if none --------------------------------------------------------------------
 inline NAT s_seqI(char*lstr,char*seq,NAT seqsz,NAT maxsz=0)
 {
-int found;
-if(!lstr||!seq) return R_NULL;
-for(int p=0;p<=(signed)(maxsz-seqsz);p++)
- {
- found=1;
- for(NAT c=0;c<seqsz;c++)
-  {
-  if(lstr[p+c]==seq[c])
-   continue;
-  else if(seq[c]>='A'&&seq[c]<='Z'&&lstr[p+c]>='a'&&lstr[p+c]<='z')
-   {
-   if(lstr[p+c]-32==seq[c])
-    continue;
-   else
-    {
-    found=0;
-    break;
-    }
-   }
-  else if(seq[c]>='a'&&seq[c]<='z'&&lstr[p+c]>='A'&&lstr[p+c]<='Z')
-   {
-   if(lstr[p+c]==seq[c]-32)
-    continue;
-   else
-    {
-    found=0;
-    break;
-    }
-   }
-  else
-   {
-   found=0;
-   break;
-   }
-  }
- if(found)   return p;
- }
-return R_NULL;
+return StrFind(lstr,maxsz,seq,seqsz,1);
 }
 
 //multiplies a string rep times ------------------------------------------------------------
@@ -937,6 +932,29 @@ return dest;
 //pozitia pe care apare ch in str sau pozitia pe care e NULL-------------------------------------------------------------
 inline int chinstr(char ch,LPSTR str,int ord=1,NAT of=0)
 {
+#if defined(VSIMD_AVX2)
+if(ch&&ord>0&&SimdCPU()&SIMD_CPU_AVX2)
+ {
+ const char*p=str+of,*b=(const char*)((size_t)p&~(size_t)31);
+ __m256i vc=_mm256_set1_epi8(ch),vz=_mm256_setzero_si256(),x;
+ NAT mz,mc,n;
+ for(NAT sh=(NAT)(p-b);;b+=32,sh=0)
+  {
+  x=_mm256_load_si256((const __m256i*)b);
+  mz=(NAT)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x,vz))>>sh<<sh;
+  mc=(NAT)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x,vc))>>sh<<sh;
+  if(mz) mc&=(mz&(0-mz))-1; //only before the terminator
+  n=MemPopCnt(mc);
+  if((NAT)ord<=n)
+   {
+   for(;ord>1;ord--) mc&=mc-1;
+   return (int)(b-str)+MemLSB(mc);
+   }
+  ord-=n;
+  if(mz) return (int)(b-str)+MemLSB(mz);
+  }
+ }
+#endif
 while(str[of])
  {
  if(str[of]==ch)
@@ -1215,9 +1233,61 @@ else while(maxnc)  //left align
 return lstrnc;
 }
 
+//decimal StoR: same syntax, but the digits are kept and rounded once (exact) ..
+double StoR10(LPSTR str,NAT maxnc=80,char**rets=NULL)
+{
+//common case first: [-]digits[.digits] up to where the loop below would stop too
+LPSTR p=str;
+NAT n=maxnc,nd=0,fd=0,neg=0,dec=0;
+QWORD w=0;
+if(n&&*p=='-') neg=1,p++,n--;
+for(;n&&(BYTE)(*p-'0')<10&&nd<19;p++,n--) w=w*10+*p-'0',nd++;
+if(n&&(*p=='.'||*p==','))
+ for(dec=1,p++,n--;n&&(BYTE)(*p-'0')<10&&nd<19;p++,n--) w=w*10+*p-'0',nd++,fd++;
+if(nd<19&&(!n||!*p||(*p=='-'?neg:*p=='.'||*p==','?dec:(BYTE)(*p-'0')>=10&&w)))
+ {
+ if(rets) *rets=p;
+ double val=NumDec(w,-(int)fd);
+ return neg?-val:val;
+ }
+NUMDEC num;
+char dig[NUMDEC_DIGITS+32];
+int decs=0,sgn=0,pos=0; //pos: 10^-pos weight of a decimal (advances on any char, like dig/=rad)
+num.Init(dig);
+while(*str&&maxnc)
+ {
+ if(*str>='0'&&*str<='9')
+  {
+  if(decs)
+   num.At(*str-'0',-pos);
+  else
+   num.Digit(*str-'0');
+  }
+ else if(*str=='-')
+  {
+  if(sgn) break;   //2nd '-' breaks
+  sgn=1;
+  }
+ else if(*str=='.'||*str==',')
+  {
+  if(decs) break; //2nd	'.' breaks
+  decs=1;
+  }
+ else if(num.nd)
+  break;
+ str++;
+ maxnc--;
+ if(decs) pos++;
+ }
+if(rets) *rets=str;
+double val=num.Value();
+return sgn?-val:val;
+}
+
 //string to real ----------------------------------------------------------------
 double StoR(LPSTR str,double rad=10,NAT maxnc=80,char**rets=NULL)
 {
+if(rad==10.) return StoR10(str,maxnc,rets);
 double val=0.,dig=1.0;
 int decs=0,sgn=0;
 char max1=47+rad,max2='A';
@@ -1273,6 +1343,7 @@ else
 }
 
 //real to string (maxnc doesn't include the terminator) ------------------------
+//decimal: exact rounding to prec decimals, prec<0 gives the shortest digits that read back the same
 NAT RtoS(double val,char*str,int lstrnc=80,int rad=10,int prec=0,char fill=C_NULL,char term='\0')
 {
 int maxnc=lstrnc,sgn=1;
@@ -1280,41 +1351,53 @@ double intval;
 if(maxnc<prec) return 0; //RtoS() needs at least prec digits
 str+=maxnc;
 if(term!=C_NULL) *str=term;
-str-=prec;
-maxnc-=prec;
-if(val<0)
- {
- val=_chgsign(val);
- sgn=-1;
- }
-val=modf(val,&intval);
-for(int d=0;d<prec;d++)
- {
- val*=rad;
- str[d]=val;
- val-=str[d];
- if(str[d]<10) str[d]+='0';
- else str[d]+=55;	//'A'-10
- }
-if(maxnc!=lstrnc)
+if(rad==10&&prec<=22&&val-val==0.) //finite
  {
- str--;
- *str='.';
- maxnc--;
+ char text[NUMFMT_SZ];
+ int n=NumFixed(val,prec,text),l=MIN(n,maxnc); //the leading chars are lost, as below
+ str-=l;
+ CopyMem(str,text+n-l,l);
+ maxnc-=l;
  }
-do{
- str--;
- *str=fmod(intval,rad);
- intval/=rad;
- if(*str<10) *str+='0';
- else *str+=55;
- maxnc--;
- }while((intval>=1.)&&maxnc);
-if(sgn<0&&maxnc)
+else
  {
- str--;
- *str='-';
- maxnc--;
+ if(prec<0) prec=0; //shortest digits are decimal only
+ str-=prec;
+ maxnc-=prec;
+ if(val<0)
+  {
+  val=_chgsign(val);
+  sgn=-1;
+  }
+ val=modf(val,&intval);
+ for(int d=0;d<prec;d++)
+  {
+  val*=rad;
+  str[d]=val;
+  val-=str[d];
+  if(str[d]<10) str[d]+='0';
+  else str[d]+=55;	//'A'-10
+  }
+ if(maxnc!=lstrnc)
+  {
+  str--;
+  *str='.';
+  maxnc--;
+  }
+ do{
+  str--;
+  *str=fmod(intval,rad);
+  intval/=rad;
+  if(*str<10) *str+='0';
+  else *str+=55;
+  maxnc--;
+  }while((intval>=1.)&&maxnc);
+ if(sgn<0&&maxnc)
+  {
+  str--;
+  *str='-';
+  maxnc--;
+  }
  }
 if(fill==C_NULL) //right align
  {
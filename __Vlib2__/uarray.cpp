@@ -6,6 +6,7 @@ template <class StaticStruct> class UARRAY
 public:
  StaticStruct*item; //items
  NAT nrit; //nr of items
+ NAT cap; //allocated items (ArrayCap)
     
  UARRAY() { ZEROCLASS(UARRAY); }
  ~UARRAY() { Free(); }
@@ -13,13 +14,18 @@ public:
  void Free()
  {
  FREE(item);
- nrit=0;
+ nrit=cap=0;
+ }
+//room for lnrit items, no reallocation until then............................................................................................ 
+ BOOL reserve(NAT lnrit)
+ {
+ return ArrayCap((void**)&item,&cap,lnrit,sizeof(StaticStruct),1);
  }
 //............................................................................................ 
  NAT dim(NAT lnrit=0)  //ins at end, del from end
  {
  if(lnrit==-1) lnrit=nrit+1; //ins one at end
- item=(StaticStruct*)REALLOC(item,sizeof(StaticStruct)*(lnrit));
+ if(!ArrayCap((void**)&item,&cap,lnrit,sizeof(StaticStruct))) return -1;
  if(lnrit>nrit) ZeroMemory(item+nrit,(lnrit-nrit)*sizeof(StaticStruct));
  nrit=lnrit;
  return nrit-1;
@@ -27,8 +33,9 @@ public:
 //............................................................................................ 
  void ins(NAT pos=0,NAT itcnt=1)
  {
- item=(StaticStruct*)REALLOC(item,sizeof(StaticStruct)*(nrit+itcnt));
- if(pos<nrit&&itcnt)
+ if(!ArrayCap((void**)&item,&cap,nrit+itcnt,sizeof(StaticStruct))) return;
+ if(pos>nrit) pos=nrit;
+ if(itcnt) //also zeroes items added at the end (the block may hold old ones)
   {
   ShiftMemR(item+pos,itcnt*sizeof(StaticStruct),(nrit-pos)*sizeof(StaticStruct));
   ZeroMemory(item+pos,itcnt*sizeof(StaticStruct));
@@ -45,7 +52,7 @@ public:
   ShiftMemL(item+(pos+itcnt),itcnt*sizeof(StaticStruct),(nrit-pos-itcnt)*sizeof(StaticStruct));
   }
  nrit-=itcnt;
- item=(StaticStruct*)REALLOC(item,(nrit-itcnt)*sizeof(StaticStruct));
+ ArrayCap((void**)&item,&cap,nrit,sizeof(StaticStruct));
  }
 //............................................................................................ 
  void Zero(NAT pos=0,NAT itcnt=-1)
@@ -3,6 +3,7 @@
 
 #include <vstr.cpp>
 #include <vtime.cpp>
+#include <parallel.cpp>
 
 //Universal Data Types
 #define UDT_IPOINTER     			0x1	//internal managed pointer
@@ -39,6 +40,29 @@
 #define UD_EXP(type) (((signed)type)>>24) //(+/-exp)
 #define UD_ADJUST(type) pow((int)UD_RAD(type),(int)UD_EXP(type)) //(radix+1)^exp
 
+#define UDATA_PARMIN	0x100000 //Agg() items per thread
+
+//UDATA::Agg() result: the items that are not null, their sum, min, max and mean
+struct UDATA_AGG
+{
+ BITS32 type; //of the column (UDT_NAT: unsigned)
+ NAT count;
+ __int64 isum,imin,imax; //UDT_INT/UDT_NAT (8 byte UDT_NAT as unsigned bits), isum wraps
+ double sum,min,max,mean; //UDT_REAL, set for the integers by UDataAggEnd()
+};
+
+//item kinds with a typed kernel (0: read through gint/greal)
+#define UDK_I8		1
+#define UDK_U8		2
+#define UDK_I16		3
+#define UDK_U16		4
+#define UDK_I32		5
+#define UDK_U32		6
+#define UDK_I64		7
+#define UDK_U64		8
+#define UDK_F32		9
+#define UDK_F64		10
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 struct UDATA
 {
@@ -54,6 +78,7 @@ struct UDATA
  UDATA() { ZeroMemory(this,sizeof(UDATA)); }
  ~UDATA() { Free(); }
  NAT total(NAT);
+ BOOL Agg(UDATA_AGG*,BYTE*,NAT,NAT,NAT); //count,sum,min,max,mean
  NAT scan(NAT,char*,NAT); //from string
  NAT text(NAT,char*,NAT); //to string
  int choose(LPSTR,HWND,int,int);
@@ -80,7 +105,7 @@ struct UDATA
  else if(type&(UDT_NUMBER))
   itsz=8;
  else if(type&UDT_VSTR)
-  itsz=sizeof(VSTR);	//12
+  itsz=sizeof(VSTR);	//36 (40 on x64): pc,nc,stat,f + sbo[VSTR_SBO]
  else if(type&UDT_DATETIME)
   itsz=sizeof(VTIME);	//12
  else
@@ -97,12 +122,20 @@ struct UDATA
  if((type&UDT_NUMBER)&&!(type&UDT_RADIX))  type|=UDTR_DECIMAL; //default to decimal numbers
  pv=ALLOC0(itsz*nrit);
  }
+//VSTR_LOCAL items moved by REALLOC/ShiftMem get pc back at their new place .......................
+ void repoint()
+ {
+ if(type&UDT_VSTR)
+  for(NAT i=0;i<nrit;i++)
+   pvstr[i].str();
+ }
 //ins at end, del from end............................................................................................ 
  void UDATA::resize(NAT lnrit=0)
  {
  pv=REALLOC(pv,itsz*lnrit);
  if(lnrit>nrit) ZeroMemory(pb+nrit*itsz,(lnrit-nrit)*itsz);
  nrit=lnrit;
+ repoint();
  }
 //............................................................................................ 
  void UDATA::ins(NAT pos=0,NAT itcnt=1)
@@ -114,6 +147,7 @@ struct UDATA
   ZeroMemory(pb+itsz*pos,itcnt*itsz);
   }
  nrit+=itcnt;
+ repoint();
  }
 //............................................................................................ 
  void UDATA::del(NAT pos=0,NAT itcnt=1)
@@ -125,7 +159,8 @@ struct UDATA
   ShiftMemL(pb+(pos+itcnt)*itsz,itcnt*itsz,(nrit-pos-itcnt)*itsz);
   }
  nrit-=itcnt;
- pv=REALLOC(pv,itsz*(nrit-itcnt));
+ pv=REALLOC(pv,itsz*nrit);
+ repoint();
  }
 //UDT_IPOINTER............................................................................................ 
  void*UDATA::allocit(NAT itind,NAT szB)	//alloc item
@@ -143,7 +178,7 @@ struct UDATA
   if(type&UDT_NUMBER)
    szB=8;
   else if(type&UDT_VSTR)
-   szB=sizeof(VSTR);	//12
+   szB=sizeof(VSTR);	//36 (40 on x64): pc,nc,stat,f + sbo[VSTR_SBO]
   else if(type&UDT_DATETIME)
    szB=sizeof(VTIME);	//12
   else
@@ -248,7 +283,7 @@ struct UDATA
  if(type&UDT_POINTER)
   return pstr[itind];
  else if(type&UDT_VSTR)
-  return pvstr[itind].pc;
+  return pvstr[itind].str(); //short strings live in the item
  else
   return c+itind*itsz;
  }
@@ -301,6 +336,485 @@ struct UDATA
  }
 };
 
+//kernel of a column type ............................................................................
+inline NAT UDataKind(BITS32 type,NAT itsz)
+{
+if(type&(UDT_INT|UDT_NAT))
+ switch(itsz)
+  {
+  case 1: return type&UDT_NAT?UDK_U8:UDK_I8;
+  case 2: return type&UDT_NAT?UDK_U16:UDK_I16;
+  case 4: return type&UDT_NAT?UDK_U32:UDK_I32;
+  case 8: return type&UDT_NAT?UDK_U64:UDK_I64;
+  }
+else if(type&UDT_REAL)
+ {
+ if(itsz==4) return UDK_F32;
+ if(itsz==8) return UDK_F64;
+ }
+return 0;
+}
+
+//adds aggregate b to a (same column type) ............................................................................
+void UDataAggMerge(UDATA_AGG*a,UDATA_AGG*b)
+{
+if(!b->count) return;
+if(!a->count)
+ {
+ *a=*b;
+ return;
+ }
+a->count+=b->count;
+a->isum=(__int64)((QWORD)a->isum+(QWORD)b->isum);
+a->sum+=b->sum;
+if(!(a->type&(UDT_INT|UDT_NAT)))
+ {
+ if(b->min<a->min) a->min=b->min;
+ if(b->max>a->max) a->max=b->max;
+ }
+else if(a->type&UDT_NAT)
+ {
+ if((QWORD)b->imin<(QWORD)a->imin) a->imin=b->imin;
+ if((QWORD)b->imax>(QWORD)a->imax) a->imax=b->imax;
+ }
+else
+ {
+ if(b->imin<a->imin) a->imin=b->imin;
+ if(b->imax>a->imax) a->imax=b->imax;
+ }
+}
+
+//one integer item ............................................................................
+inline void UDataAggAddI(UDATA_AGG*a,__int64 v)
+{
+if(!a->count++)
+ a->imin=a->imax=v;
+else if(a->type&UDT_NAT)
+ {
+ if((QWORD)v<(QWORD)a->imin) a->imin=v;
+ if((QWORD)v>(QWORD)a->imax) a->imax=v;
+ }
+else
+ {
+ if(v<a->imin) a->imin=v;
+ if(v>a->imax) a->imax=v;
+ }
+a->isum=(__int64)((QWORD)a->isum+(QWORD)v);
+}
+
+//one real item ............................................................................
+inline void UDataAggAddR(UDATA_AGG*a,double v)
+{
+if(!a->count++)
+ a->min=a->max=v;
+else
+ {
+ if(v<a->min) a->min=v;
+ if(v>a->max) a->max=v;
+ }
+a->sum+=v;
+}
+
+//adds item i of col (kind from UDataKind()) ............................................................................
+inline void UDataAggAdd(UDATA_AGG*a,UDATA*col,NAT kind,NAT i)
+{
+const BYTE*p=col->pb+i*col->itsz;
+switch(kind)
+ {
+ case UDK_I8: UDataAggAddI(a,*(const signed char*)p); break;
+ case UDK_U8: UDataAggAddI(a,*p); break;
+ case UDK_I16: UDataAggAddI(a,*(const short*)p); break;
+ case UDK_U16: UDataAggAddI(a,*(const WORD*)p); break;
+ case UDK_I32: UDataAggAddI(a,*(const int*)p); break;
+ case UDK_U32: UDataAggAddI(a,*(const unsigned*)p); break;
+ case UDK_I64: case UDK_U64: UDataAggAddI(a,*(const __int64*)p); break;
+ case UDK_F32: UDataAggAddR(a,*(const float*)p); break;
+ case UDK_F64: UDataAggAddR(a,*(const double*)p); break;
+ default:
+  if(col->type&(UDT_INT|UDT_NAT))
+   UDataAggAddI(a,col->gint(i));
+  else
+   UDataAggAddR(a,col->greal(i));
+ }
+}
+
+//fills the real fields of an integer aggregate (and the other way) and the mean ...........................................
+void UDataAggEnd(UDATA_AGG*a)
+{
+if(!(a->type&(UDT_INT|UDT_NAT)))
+ {
+ a->isum=(__int64)a->sum;
+ a->imin=(__int64)a->min;
+ a->imax=(__int64)a->max;
+ }
+else if(a->type&UDT_NAT)
+ {
+ a->sum=(double)(QWORD)a->isum;
+ a->min=(double)(QWORD)a->imin;
+ a->max=(double)(QWORD)a->imax;
+ }
+else
+ {
+ a->sum=(double)a->isum;
+ a->min=(double)a->imin;
+ a->max=(double)a->imax;
+ }
+a->mean=a->count?a->sum/a->count:0.;
+}
+
+//n>0 integer items, a loop the compiler vectorizes ............................................................................
+template<class T> void UDataAggI(UDATA_AGG*a,const T*p,NAT n)
+{
+UDATA_AGG b;
+QWORD s=0;
+T mn=p[0],mx=p[0];
+for(NAT i=0;i<n;i++)
+ {
+ s+=(QWORD)(__int64)p[i];
+ if(p[i]<mn) mn=p[i];
+ if(p[i]>mx) mx=p[i];
+ }
+ZeroMemory(&b,sizeof(b));
+b.type=a->type;
+b.count=n;
+b.isum=(__int64)s;
+b.imin=(__int64)mn;
+b.imax=(__int64)mx;
+UDataAggMerge(a,&b);
+}
+
+//n>0 real items ............................................................................
+template<class T> void UDataAggR(UDATA_AGG*a,const T*p,NAT n)
+{
+UDATA_AGG b;
+double s=0.;
+T mn=p[0],mx=p[0];
+for(NAT i=0;i<n;i++)
+ {
+ s+=p[i];
+ if(p[i]<mn) mn=p[i];
+ if(p[i]>mx) mx=p[i];
+ }
+ZeroMemory(&b,sizeof(b));
+b.type=a->type;
+b.count=n;
+b.sum=s;
+b.min=mn;
+b.max=mx;
+UDataAggMerge(a,&b);
+}
+
+#if defined(VSIMD_AVX2)
+//8 items as int32 lanes (8 and 16 bit ones widened) ............................................................................
+template<int K> inline __m256i UDataLd32(const BYTE*p,NAT i)
+{
+if(K==UDK_I8) return _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(p+i)));
+if(K==UDK_U8) return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(p+i)));
+if(K==UDK_I16) return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(p+2*i)));
+if(K==UDK_U16) return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(p+2*i)));
+return _mm256_loadu_si256((const __m256i*)(p+4*i));
+}
+
+//items up to 32 bits, 8 at a time: sums in int64 lanes; returns the items done ......................................
+template<int K> NAT UDataAggAVX2I32(UDATA_AGG*a,const BYTE*p,NAT n)
+{
+UDATA_AGG b;
+__m256i s0,s1,mn,mx,v;
+QWORD s[8];
+int m[16];
+NAT i,j;
+if(n<8) return 0;
+s0=s1=_mm256_setzero_si256();
+mn=mx=UDataLd32<K>(p,0);
+for(i=0;i+8<=n;i+=8)
+ {
+ v=UDataLd32<K>(p,i);
+ if(K==UDK_U32)
+  {
+  s0=_mm256_add_epi64(s0,_mm256_cvtepu32_epi64(_mm256_castsi256_si128(v)));
+  s1=_mm256_add_epi64(s1,_mm256_cvtepu32_epi64(_mm256_extracti128_si256(v,1)));
+  mn=_mm256_min_epu32(mn,v);
+  mx=_mm256_max_epu32(mx,v);
+  }
+ else
+  {
+  s0=_mm256_add_epi64(s0,_mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+  s1=_mm256_add_epi64(s1,_mm256_cvtepi32_epi64(_mm256_extracti128_si256(v,1)));
+  mn=_mm256_min_epi32(mn,v);
+  mx=_mm256_max_epi32(mx,v);
+  }
+ }
+_mm256_storeu_si256((__m256i*)s,s0);
+_mm256_storeu_si256((__m256i*)(s+4),s1);
+_mm256_storeu_si256((__m256i*)m,mn);
+_mm256_storeu_si256((__m256i*)(m+8),mx);
+ZeroMemory(&b,sizeof(b));
+b.type=a->type;
+b.count=i;
+b.isum=(__int64)(s[0]+s[1]+s[2]+s[3]+s[4]+s[5]+s[6]+s[7]);
+b.imin=K==UDK_U32?(__int64)(unsigned)m[0]:m[0];
+b.imax=K==UDK_U32?(__int64)(unsigned)m[8]:m[8];
+for(j=1;j<8;j++)
+ if(K==UDK_U32)
+  {
+  if((unsigned)m[j]<(QWORD)b.imin) b.imin=(unsigned)m[j];
+  if((unsigned)m[8+j]>(QWORD)b.imax) b.imax=(unsigned)m[8+j];
+  }
+ else
+  {
+  if(m[j]<b.imin) b.imin=m[j];
+  if(m[8+j]>b.imax) b.imax=m[8+j];
+  }
+UDataAggMerge(a,&b);
+return i;
+}
+
+//64 bit items, 4 at a time (unsigned ones compared with the sign bit flipped) ......................................
+template<int K> NAT UDataAggAVX2I64(UDATA_AGG*a,const BYTE*p,NAT n)
+{
+UDATA_AGG b;
+__m256i s,mn,mx,v,flip=_mm256_set1_epi64x(K==UDK_U64?(__int64)0x8000000000000000ull:0);
+__int64 t[12];
+NAT i,j;
+if(n<4) return 0;
+s=_mm256_setzero_si256();
+mn=mx=_mm256_xor_si256(_mm256_loadu_si256((const __m256i*)p),flip);
+for(i=0;i+4<=n;i+=4)
+ {
+ v=_mm256_loadu_si256((const __m256i*)(p+8*i));
+ s=_mm256_add_epi64(s,v);
+ v=_mm256_xor_si256(v,flip);
+ mn=_mm256_blendv_epi8(mn,v,_mm256_cmpgt_epi64(mn,v));
+ mx=_mm256_blendv_epi8(mx,v,_mm256_cmpgt_epi64(v,mx));
+ }
+_mm256_storeu_si256((__m256i*)t,s);
+_mm256_storeu_si256((__m256i*)(t+4),mn);
+_mm256_storeu_si256((__m256i*)(t+8),mx);
+ZeroMemory(&b,sizeof(b));
+b.type=a->type;
+b.count=i;
+b.isum=(__int64)((QWORD)t[0]+t[1]+t[2]+t[3]);
+b.imin=t[4];
+b.imax=t[8];
+for(j=1;j<4;j++)
+ {
+ if(t[4+j]<b.imin) b.imin=t[4+j];
+ if(t[8+j]>b.imax) b.imax=t[8+j];
+ }
+if(K==UDK_U64)
+ {
+ b.imin^=(__int64)0x8000000000000000ull;
+ b.imax^=(__int64)0x8000000000000000ull;
+ }
+UDataAggMerge(a,&b);
+return i;
+}
+
+//floats 8 at a time, summed as doubles ............................................................................
+NAT UDataAggAVX2F32(UDATA_AGG*a,const float*p,NAT n)
+{
+UDATA_AGG b;
+__m256d s0,s1;
+__m256 mn,mx,v;
+double s[8];
+float m[16];
+NAT i,j;
+if(n<8) return 0;
+s0=s1=_mm256_setzero_pd();
+mn=mx=_mm256_loadu_ps(p);
+for(i=0;i+8<=n;i+=8)
+ {
+ v=_mm256_loadu_ps(p+i);
+ s0=_mm256_add_pd(s0,_mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+ s1=_mm256_add_pd(s1,_mm256_cvtps_pd(_mm256_extractf128_ps(v,1)));
+ mn=_mm256_min_ps(mn,v);
+ mx=_mm256_max_ps(mx,v);
+ }
+_mm256_storeu_pd(s,s0);
+_mm256_storeu_pd(s+4,s1);
+_mm256_storeu_ps(m,mn);
+_mm256_storeu_ps(m+8,mx);
+ZeroMemory(&b,sizeof(b));
+b.type=a->type;
+b.count=i;
+b.sum=((s[0]+s[4])+(s[1]+s[5]))+((s[2]+s[6])+(s[3]+s[7]));
+b.min=m[0];
+b.max=m[8];
+for(j=1;j<8;j++)
+ {
+ if(m[j]<b.min) b.min=m[j];
+ if(m[8+j]>b.max) b.max=m[8+j];
+ }
+UDataAggMerge(a,&b);
+return i;
+}
+
+//doubles 8 at a time in two accumulators ............................................................................
+NAT UDataAggAVX2F64(UDATA_AGG*a,const double*p,NAT n)
+{
+UDATA_AGG b;
+__m256d s0,s1,mn,mx,v0,v1;
+double t[12];
+NAT i,j;
+if(n<8) return 0;
+s0=s1=_mm256_setzero_pd();
+mn=mx=_mm256_loadu_pd(p);
+for(i=0;i+8<=n;i+=8)
+ {
+ v0=_mm256_loadu_pd(p+i);
+ v1=_mm256_loadu_pd(p+i+4);
+ s0=_mm256_add_pd(s0,v0);
+ s1=_mm256_add_pd(s1,v1);
+ mn=_mm256_min_pd(mn,_mm256_min_pd(v0,v1));
+ mx=_mm256_max_pd(mx,_mm256_max_pd(v0,v1));
+ }
+_mm256_storeu_pd(t,_mm256_add_pd(s0,s1));
+_mm256_storeu_pd(t+4,mn);
+_mm256_storeu_pd(t+8,mx);
+ZeroMemory(&b,sizeof(b));
+b.type=a->type;
+b.count=i;
+b.sum=(t[0]+t[1])+(t[2]+t[3]);
+b.min=t[4];
+b.max=t[8];
+for(j=1;j<4;j++)
+ {
+ if(t[4+j]<b.min) b.min=t[4+j];
+ if(t[8+j]>b.max) b.max=t[8+j];
+ }
+UDataAggMerge(a,&b);
+return i;
+}
+#endif
+
+//n items at p, none null ............................................................................
+void UDataAggRun(UDATA_AGG*a,const BYTE*p,NAT kind,NAT n)
+{
+NAT k=0;
+if(!n) return;
+#if defined(VSIMD_AVX2)
+if(SimdCPU()&SIMD_CPU_AVX2)
+ switch(kind)
+  {
+  case UDK_I8: k=UDataAggAVX2I32<UDK_I8>(a,p,n); break;
+  case UDK_U8: k=UDataAggAVX2I32<UDK_U8>(a,p,n); break;
+  case UDK_I16: k=UDataAggAVX2I32<UDK_I16>(a,p,n); break;
+  case UDK_U16: k=UDataAggAVX2I32<UDK_U16>(a,p,n); break;
+  case UDK_I32: k=UDataAggAVX2I32<UDK_I32>(a,p,n); break;
+  case UDK_U32: k=UDataAggAVX2I32<UDK_U32>(a,p,n); break;
+  case UDK_I64: k=UDataAggAVX2I64<UDK_I64>(a,p,n); break;
+  case UDK_U64: k=UDataAggAVX2I64<UDK_U64>(a,p,n); break;
+  case UDK_F32: k=UDataAggAVX2F32(a,(const float*)p,n); break;
+  case UDK_F64: k=UDataAggAVX2F64(a,(const double*)p,n); break;
+  }
+#endif
+if(k>=n) return;
+n-=k;
+switch(kind)
+ {
+ case UDK_I8: UDataAggI(a,(const signed char*)p+k,n); break;
+ case UDK_U8: UDataAggI(a,p+k,n); break;
+ case UDK_I16: UDataAggI(a,(const short*)p+k,n); break;
+ case UDK_U16: UDataAggI(a,(const WORD*)p+k,n); break;
+ case UDK_I32: UDataAggI(a,(const int*)p+k,n); break;
+ case UDK_U32: UDataAggI(a,(const unsigned*)p+k,n); break;
+ case UDK_I64: UDataAggI(a,(const __int64*)p+k,n); break;
+ case UDK_U64: UDataAggI(a,(const unsigned __int64*)p+k,n); break;
+ case UDK_F32: UDataAggR(a,(const float*)p+k,n); break;
+ case UDK_F64: UDataAggR(a,(const double*)p+k,n); break;
+ }
+}
+
+//items [i,e) of col whose null bit is 0 (null=NULL: all), in runs without nulls ..................................
+void UDataAggRange(UDATA_AGG*a,UDATA*col,NAT kind,BYTE*null,NAT i,NAT e)
+{
+NAT j;
+QWORD w;
+if(!kind) //no kernel
+ {
+ for(;i<e;i++)
+  if(!null||!(null[i>>3]>>(i&7)&1))
+   UDataAggAdd(a,col,kind,i);
+ return;
+ }
+if(!null)
+ {
+ UDataAggRun(a,col->pb+i*col->itsz,kind,e-i);
+ return;
+ }
+while(i<e)
+ {
+ while(i<e) //skip the nulls
+  {
+  if(!(i&7)&&i+8<=e&&null[i>>3]==0xff) i+=8;
+  else if(null[i>>3]>>(i&7)&1) i++;
+  else break;
+  }
+ for(j=i;j<e;) //up to the next null
+  {
+  if(!(j&63)&&j+64<=e&&(CopyMemory(&w,null+(j>>3),8),!w)) j+=64;
+  else if(null[j>>3]>>(j&7)&1) break;
+  else j++;
+  }
+ if(j>i) UDataAggRun(a,col->pb+i*col->itsz,kind,j-i);
+ i=j;
+ }
+}
+
+//one Agg() over threads
+struct UDATA_AGGPAR
+{
+ UDATA*col;
+ NAT kind;
+ BYTE*null;
+ NAT from,to;
+ UDATA_AGG*part; //per thread
+};
+
+//Agg() worker t: its 64 item aligned share of [from,to) ............................................................................
+void UDataAggWork(void*ctx,NAT t,NAT nt)
+{
+UDATA_AGGPAR*par=(UDATA_AGGPAR*)ctx;
+NAT n=par->to-par->from,step=((n/nt)+63)&~63,b,e;
+b=par->from+MIN(t*step,n);
+e=t==nt-1?par->to:par->from+MIN((t+1)*step,n);
+UDataAggRange(par->part+t,par->col,par->kind,par->null,b,e);
+}
+
+//count, sum, min, max and mean of items [from,from+n) that are not null (bit i of null set: item i is null),
+//big columns are split over nt threads (0=ParThreads()); 0 if the items are not numbers .....................................
+BOOL UDATA::Agg(UDATA_AGG*a,BYTE*null=NULL,NAT from=0,NAT n=-1,NAT nt=0)
+{
+UDATA_AGGPAR par;
+NAT t;
+ZeroMemory(a,sizeof(UDATA_AGG));
+a->type=type;
+ifn(type&UDT_NUMBER) return 0;
+if(from>nrit) from=nrit;
+if(n>nrit-from) n=nrit-from;
+if(!nt) nt=ParThreads();
+nt=MAX(MIN(nt,n/UDATA_PARMIN),1);
+par.col=this;
+par.kind=UDataKind(type,itsz);
+par.null=null;
+par.from=from;
+par.to=from+n;
+par.part=nt>1?(UDATA_AGG*)ALLOC0(nt*sizeof(UDATA_AGG)):NULL;
+if(!par.part)
+ UDataAggRange(a,this,par.kind,null,from,from+n);
+else
+ {
+ for(t=0;t<nt;t++)
+  par.part[t].type=type;
+ ParRun(UDataAggWork,&par,nt);
+ for(t=0;t<nt;t++)
+  UDataAggMerge(a,par.part+t);
+ FREE(par.part);
+ }
+UDataAggEnd(a);
+return 1;
+}
+
 //UDATA <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
  //............................................................................................ 
  NAT UDATA::total(NAT itind) //calc total
@@ -334,21 +848,17 @@ struct UDATA
    }
   set(itind,lvs.pc,lvs.nc);
   }
- else if(type&(UDT_INT|UDT_NAT)) //int
+ else if(type&UDT_NUMBER) //int or real
   {
-  __int64 big=0;
-  for(i=0;i<nrit;i++)
-   if(i!=itind)
-    big+=gint(i);
-  set(itind,big);
-  }
- else if(type&UDT_REAL)	//real
-  {
-  double ld=0.;
-  for(i=0;i<nrit;i++)
-   if(i!=itind)
-    ld+=greal(i);
-  set(itind,ld);
+  UDATA_AGG agg,after;
+  Agg(&agg,NULL,0,itind);
+  Agg(&after,NULL,itind+1);
+  UDataAggMerge(&agg,&after);
+  UDataAggEnd(&agg);
+  if(type&(UDT_INT|UDT_NAT))
+   set(itind,agg.isum);
+  else
+   set(itind,agg.sum);
   }
  else if(type&UDT_DATETIME)
   (gpdt(itind))->Now();
@@ -6,6 +6,333 @@ class USQLDB;
 #include <net.cpp>
 #include <udata.cpp>
 #include <utable.cpp>
+#include <parallel.cpp>
+
+#define USQL_BATCH		4096 //QStream() default rows per batch
+#define USQL_NULL		0xffffffff //USQL_CELL::nc of a NULL value
+#define USQL_ERRNC		1024 //USQLDB::err size
+
+//QStream() consumer: ut holds rows [first,first+ut->nrrecs) of the result, bit r of null[f] is set if
+//item r of ut->field[f] was NULL; FALSE stops the fetch
+typedef BOOL (*USQL_BATCHFN)(UTABLE*,BYTE**,NAT,void*);
+
+//one value as text in USQL_RAW::buf
+struct USQL_CELL
+{
+ NAT of,nc; //nc=USQL_NULL: NULL
+};
+
+//a batch of rows as fetched, before parsing
+struct USQL_RAW
+{
+ char*buf; //values, each NUL terminated
+ NAT bufsz,bufcap;
+ USQL_CELL*cell; //row by row, nrf per row
+ NAT nrcells,cellcap;
+ NAT nrf,nrrows,cap; //cap: rows per batch
+ BOOL err; //out of memory
+};
+
+//QStream() row source: adds rows to raw (USqlRawCell() then nrrows++) up to raw->cap, returns how many (0: end)
+typedef NAT (*USQL_FETCHFN)(USQL_RAW*,void*);
+
+//appends a value (s=NULL: NULL) of the current row ...................................................................
+BOOL USqlRawCell(USQL_RAW*raw,char*s,NAT nc)
+{
+USQL_CELL*c;
+if(!ArrayCap((void**)&raw->cell,&raw->cellcap,raw->nrcells+1,sizeof(USQL_CELL))) return !(raw->err=1);
+c=raw->cell+raw->nrcells++;
+c->of=raw->bufsz;
+c->nc=s?nc:USQL_NULL;
+if(!s) return 1;
+if(!ArrayCap((void**)&raw->buf,&raw->bufcap,raw->bufsz+nc+1,1)) return !(raw->err=1);
+CopyMemory(raw->buf+raw->bufsz,s,nc);
+raw->bufsz+=nc;
+raw->buf[raw->bufsz++]=0;
+return 1;
+}
+
+//one QStream() pass
+struct USQL_STREAM
+{
+ USQL_RAW raw[2]; //one parsed while the other one is fetched
+ USQL_RAW*parse,*fetch;
+ USQL_FETCHFN fetchfn;
+ void*src;
+ BOOL end; //the source is done
+ UTABLE*ut;
+ BYTE**null; //per field, cap bits
+ HANDLE go,done; //the parser thread: parse requested, parsed
+ volatile LONG stop;
+};
+
+//items of a batch table field: item r from a value (NULL: cleared) ...........................................................
+void USqlParseField(UDATA*col,USQL_RAW*raw,NAT f,BYTE*null)
+{
+NAT r,n=raw->nrrows;
+USQL_CELL*c;
+for(r=n;r<col->nrit;r++) //the items past the batch
+ {
+ if(col->type&UDT_IPOINTER)
+  {
+  FREE(col->pit[r]);
+  }
+ else if(col->type&UDT_VSTR)
+  col->pvstr[r].Free();
+ }
+if(col->nrit!=n) col->resize(n);
+ZeroMemory(null,(raw->cap+7)>>3);
+for(r=0;r<n;r++)
+ {
+ c=raw->cell+r*raw->nrf+f;
+ if(c->nc!=USQL_NULL)
+  col->scan(r,raw->buf+c->of,c->nc);
+ else
+  {
+  null[r>>3]|=1<<(r&7);
+  if(col->type&UDT_IPOINTER)
+   {
+   FREE(col->pit[r]);
+   }
+  else if(col->type&UDT_VSTR)
+   col->pvstr[r].Free();
+  else
+   ZeroMemory(col->pb+r*col->itsz,col->itsz);
+  }
+ }
+}
+
+//QStream() step: t=0 fetches the next batch, t=1 parses the current one into the table ...........................................
+void USqlStreamStep(void*ctx,NAT t,NAT nt)
+{
+USQL_STREAM*st=(USQL_STREAM*)ctx;
+if(t==0)
+ {
+ st->fetch->nrrows=st->fetch->nrcells=st->fetch->bufsz=0;
+ if(!st->end&&st->fetch->cap>st->fetchfn(st->fetch,st->src))
+  st->end=1;
+ }
+else
+ for(NAT f=0;f<st->ut->nrfields;f++)
+  USqlParseField(st->ut->field+f,st->parse,f,st->null[f]);
+}
+
+//the parser thread of a QStream(): parses st->parse each time go is set ...........................................
+DWORD WINAPI USqlParseThread(LPVOID par)
+{
+USQL_STREAM*st=(USQL_STREAM*)par;
+for(;;)
+ {
+ WaitForSingleObject(st->go,INFINITE);
+ if(st->stop) break;
+ USqlStreamStep(st,1,2);
+ SetEvent(st->done);
+ }
+return 0;
+}
+
+//fetches a result in batches of rows through ut (its fields set up by the caller): the values of a batch are
+//parsed on a second thread (one for the whole stream) while the next batch is fetched, then fn gets the batch.
+//Keeps 2 batches in memory
+BOOL USqlStream(UTABLE*ut,NAT batch,USQL_FETCHFN fetchfn,void*src,USQL_BATCHFN fn,void*ctx)
+{
+USQL_STREAM st;
+USQL_RAW*r;
+HANDLE th=NULL;
+NAT f,first=0;
+BOOL ok=1;
+if(!batch) batch=USQL_BATCH;
+ZeroMemory(&st,sizeof(st));
+st.fetchfn=fetchfn;
+st.src=src;
+st.ut=ut;
+st.raw[0].nrf=st.raw[1].nrf=ut->nrfields;
+st.raw[0].cap=st.raw[1].cap=batch;
+st.null=(BYTE**)ALLOC0(ut->nrfields*sizeof(BYTE*)+1);
+if(!st.null) return 0;
+for(f=0;f<ut->nrfields;f++)
+ if(!(st.null[f]=(BYTE*)ALLOC((batch+7)>>3))) ok=0;
+st.fetch=st.raw;
+st.go=CreateEvent(NULL,FALSE,FALSE,NULL);
+st.done=CreateEvent(NULL,FALSE,FALSE,NULL);
+if(ok&&st.go&&st.done)
+ th=CreateThread(NULL,0,USqlParseThread,&st,0,NULL); //none: parsed here
+if(ok) USqlStreamStep(&st,0,2); //first batch
+while(ok&&st.fetch->nrrows&&!st.fetch->err)
+ {
+ r=st.parse=st.fetch;
+ st.fetch=st.raw+(st.fetch==st.raw);
+ if(th) SetEvent(st.go);
+ USqlStreamStep(&st,0,2); //the next batch meanwhile
+ if(th)
+  WaitForSingleObject(st.done,INFINITE);
+ else
+  USqlStreamStep(&st,1,2);
+ ut->nrrecs=r->nrrows;
+ if(!fn(ut,st.null,first,ctx)) break;
+ first+=r->nrrows;
+ }
+if(th)
+ {
+ st.stop=1;
+ SetEvent(st.go);
+ WaitForSingleObject(th,INFINITE);
+ CloseHandle(th);
+ }
+if(st.go) CloseHandle(st.go);
+if(st.done) CloseHandle(st.done);
+if(st.raw[0].err||st.raw[1].err) ok=0;
+for(f=0;f<ut->nrfields;f++)
+ FREE(st.null[f]);
+FREE(st.null);
+for(f=0;f<2;f++)
+ {
+ FREE(st.raw[f].buf);
+ FREE(st.raw[f].cell);
+ }
+return ok;
+}
+
+//the columns of a QStream() batch table in an empty ut ..........................................................
+void USqlLayout(UTABLE*ut,UTABLE*batch)
+{
+UDATA*s;
+for(NAT f=0;f<batch->nrfields;f++)
+ {
+ s=batch->field+f;
+ ut->AddField(batch->fieldname.gstr(f),s->type,0,(s->type&UDT_STR)&&!(s->type&UDT_POINTER)?s->itsz-1:s->itsz,batch->fieldw[f]);
+ }
+}
+
+//QStream() consumer that appends the batches to the UTABLE ctx, emptied by QResult() before ..........................................................
+BOOL USqlAppend(UTABLE*batch,BYTE**null,NAT first,void*ctx)
+{
+UTABLE*ut=(UTABLE*)ctx;
+UDATA*s,*d;
+NAT f,r,n0;
+if(!ut->nrfields) USqlLayout(ut,batch);
+for(f=0;f<batch->nrfields;f++)
+ {
+ s=batch->field+f;
+ d=ut->field+f;
+ n0=d->nrit;
+ d->resize(n0+batch->nrrecs);
+ if(s->type&(UDT_POINTER|UDT_VSTR))
+  {
+  for(r=0;r<batch->nrrecs;r++)
+   if(s->gstr(r))
+    d->set(n0+r,s->gstr(r));
+  }
+ else
+  CopyMemory(d->pb+n0*d->itsz,s->pb,batch->nrrecs*s->itsz);
+ }
+ut->nrrecs=first+batch->nrrecs;
+return 1;
+}
+
+#define USQL_PARAMROWS	1024 //ExecuteBatch() rows packed (and at most sent) at once
+#define USQL_PTEXT		48 //ExecuteBatch() text of a number or a date
+#define USQL_PACKMAX	0x1000000 //ExecuteBatch() text of a parameter packed at once (16MB; a longer value goes alone)
+
+//ExecuteBatch() parameter: a UTABLE field bound to a ? of the Prepare()d statement
+struct USQL_PARAM
+{
+ UDATA*col;
+ BYTE*null; //bit r set: item r is NULL (NULL: no NULLs)
+ NAT kind; //UDK_*: sent in place from col, 0: packed as text in txt
+ char*txt; //packed rows, width chars each (asciiz): numbers and dates as text, strings if copied
+ NAT*len; //per packed row: chars or itsz, USQL_NULL: NULL
+ NAT width,txtcap,lencap;
+};
+
+//binds parameter i to ut->field[fields?fields[i]:i] and its null mask (QStream() layout) ..........
+BOOL USqlBind(USQL_PARAM*param,NAT nrp,UTABLE*ut,NAT*fields,BYTE**null)
+{
+NAT i,f;
+UDATA*col;
+for(i=0;i<nrp;i++)
+ {
+ f=fields?fields[i]:i;
+ if(f>=ut->nrfields) return 0;
+ col=ut->field+f;
+ if(!(col->type&(UDT_STR|UDT_VSTR|UDT_NUMBER|UDT_DATETIME))) return 0; //binary
+ param[i].col=col;
+ param[i].null=null?null[f]:NULL;
+ param[i].kind=(col->type&UDT_NUMBER)&&!(col->type&UDT_POINTER)&&!UD_EXP(col->type)?UDataKind(col->type,col->itsz):0; //scaled numbers go as text
+ }
+return 1;
+}
+
+//rows available in the bound fields ..........................................................
+NAT USqlParamRows(USQL_PARAM*param,NAT nrp)
+{
+NAT i,n=nrp?param[0].col->nrit:0;
+for(i=1;i<nrp;i++)
+ n=MIN(n,param[i].col->nrit);
+return n;
+}
+
+//lengths of the rows [from,from+n) of a parameter, and the text of those not sent in place (strings only if copystr,
+//as rows as wide as the longest one); stops before the text passes USQL_PACKMAX. Returns the rows packed (0: no memory) ..........
+NAT USqlParamPack(USQL_PARAM*p,NAT from,NAT n,BOOL copystr=1)
+{
+UDATA*col=p->col;
+NAT r,l,w=1;
+BOOL str=(col->type&(UDT_STR|UDT_VSTR))!=0;
+char*s;
+if(!ArrayCap((void**)&p->len,&p->lencap,n,sizeof(NAT))) return 0;
+for(r=0;r<n;r++)
+ {
+ if(p->null&&(p->null[(from+r)>>3]>>((from+r)&7))&1)
+  p->len[r]=USQL_NULL;
+ else if(p->kind)
+  p->len[r]=col->itsz;
+ else if(str)
+  {
+  s=col->gstr(from+r);
+  if(s&&copystr)
+   {
+   l=MAX(w,sl(s)+1);
+   if(r&&(QWORD)(r+1)*l>USQL_PACKMAX) break; //this row and on go with the next chunk
+   w=l;
+   }
+  p->len[r]=s?sl(s):USQL_NULL;
+  }
+ else
+  p->len[r]=0;
+ }
+n=r;
+if(p->kind||(str&&!copystr)) return n;
+if(!str) w=USQL_PTEXT;
+if(!ArrayCap((void**)&p->txt,&p->txtcap,n*w,1)) return 0;
+p->width=w;
+for(r=0;r<n;r++)
+ {
+ if(p->len[r]==USQL_NULL) continue;
+ s=p->txt+r*w;
+ if(col->type&(UDT_STR|UDT_VSTR))
+  CopyMemory(s,col->gstr(from+r),p->len[r]+1);
+ else
+  {
+  *s=0;
+  col->text(from+r,s,w);
+  p->len[r]=sl(s);
+  }
+ }
+return n;
+}
+
+//frees the packing buffers of nrp parameters ..........................................................
+void USqlParamFree(USQL_PARAM*param,NAT nrp)
+{
+NAT i;
+if(!param) return;
+for(i=0;i<nrp;i++)
+ {
+ FREE(param[i].txt);
+ FREE(param[i].len);
+ }
+}
 
 //USQLDB types
 #define USQL_ODBC		1
@@ -20,6 +347,8 @@ public:
  int connections;
  char databname[PATHSZ];
  char tablename[NAMESZ];
+ BOOL noui; //errors don't ask (MessageBox), the last one is kept in err (worker threads)
+ char err[USQL_ERRNC];
 
  virtual BOOL Connect(LOGON_INFO*,char*)=0;
  virtual BOOL Disconnect()=0;
@@ -30,13 +359,266 @@ public:
  virtual BOOL E_field(LPSTR)=0;
  virtual int E_value(LPSTR,LPSTR,int)=0;
  virtual BOOL Query(char*,...)=0;
+ virtual BOOL QueryRaw(char*,NAT)=0; //sql of nc chars as is (any length)
  virtual void StartQuery()=0;
  virtual BOOL Astr(char*,...)=0;
  virtual BOOL Abin(void*,NAT)=0;
  virtual BOOL DoQuery()=0;
  virtual BOOL QResult(UTABLE*)=0;
+ virtual BOOL QStream(UTABLE*,NAT,USQL_BATCHFN,void*)=0; //results in batches of rows
+ virtual BOOL Prepare(char*)=0; //statement with ? parameters (NULL: release it)
+ virtual BOOL Bind(UTABLE*,NAT*,BYTE**)=0; //parameters to UTABLE fields, with null masks
+ virtual BOOL ExecuteBatch(NAT,NAT)=0; //Prepare()d statement for many bound rows per round trip
  //not garanted to be universally supported (mostly dependent on SQL grammar)
  virtual int Database(LPSTR)=0;
  virtual BOOL DropDB(LPSTR)=0;  //drop database
- 
-};
\ No newline at end of file
+ //connection
+ virtual BOOL Ping()=0; //the connection is alive
+ virtual void Thread(BOOL) {} //a thread starts (1) or stops (0) using this connection
+ virtual ~USQLDB() {}
+};
+#define USQLPOOL_PINGMS	30000 //a connection idle longer is Ping()ed before its next query
+
+//QueryAsync() result: Wait() for it (once), Ready() polls
+struct USQL_FUTURE
+{
+ LPSTR sql; //SALLOC-ed
+ NAT nc; //its chars
+ UTABLE*ut; //results (NULL: discarded)
+ HANDLE done; //set when the query ran
+ BOOL ok;
+ LPSTR err; //!ok: the error (SALLOC-ed)
+ USQL_FUTURE*next; //queued after
+};
+
+class USQLPOOL;
+
+//one pooled connection and the thread that owns it
+struct USQLPOOL_CONN
+{
+ USQLPOOL*pool;
+ USQLDB*db;
+ HANDLE th;
+ DWORD used; //GetTickCount() of the last query
+ BOOL dead; //last query failed or reconnect failed
+};
+
+template<class DB> USQLDB*USqlNew() { return new DB; } //Open() factory: pool.Open(USqlNew<VMYSQL>,&li,8)
+
+//N connections opened up front, each owned by a thread that runs the queued queries in order;
+//independent queries are spread over all of them ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class USQLPOOL
+{
+public:
+ USQLPOOL_CONN*conn;
+ NAT nrconn;
+ LOGON_INFO li; //copy for reconnects (ODBC_LOGON_NOUI, not saved)
+ LPSTR opts;
+ CRITICAL_SECTION cs; //guards the queue
+ USQL_FUTURE*head,*tail;
+ HANDLE sem; //counts queued queries (and the stop signals)
+ volatile LONG stop;
+
+ USQLPOOL() { ZEROCLASS(USQLPOOL); }
+ BOOL Open(USQLDB*(*)(),LOGON_INFO*,NAT,LPSTR);
+ void Close();
+ USQL_FUTURE*QueryAsync(UTABLE*,char*,...);
+ BOOL Ready(USQL_FUTURE*);
+ BOOL Wait(USQL_FUTURE*,LPSTR*);
+ BOOL Reconnect(USQLPOOL_CONN*);
+ USQL_FUTURE*Take();
+ ~USQLPOOL() { Close(); }
+};
+
+//drops a dead connection (whatever its connections count) and connects it again, without asking ............
+BOOL USQLPOOL::Reconnect(USQLPOOL_CONN*c)
+{
+while(c->db->connections>0)
+ c->db->Disconnect();
+c->db->connections=0;
+c->dead=!c->db->Connect(&li,opts);
+return !c->dead;
+}
+
+//next queued query (NULL: none) ..........................................................................
+USQL_FUTURE*USQLPOOL::Take()
+{
+USQL_FUTURE*f;
+EnterCriticalSection(&cs);
+f=head;
+if(f)
+ {
+ head=f->next;
+ if(!head) tail=NULL;
+ }
+LeaveCriticalSection(&cs);
+return f;
+}
+
+//a connection's thread: checks its health, runs the queries it takes, signals them ......................
+DWORD WINAPI USqlPoolThread(LPVOID par)
+{
+USQLPOOL_CONN*c=(USQLPOOL_CONN*)par;
+USQLPOOL*pool=c->pool;
+USQL_FUTURE*f;
+c->db->Thread(1);
+for(;;)
+ {
+ WaitForSingleObject(pool->sem,INFINITE);
+ f=pool->Take();
+ if(!f)
+  {
+  if(pool->stop) break;
+  continue;
+  }
+ *c->db->err=0;
+ if(c->dead||GetTickCount()-c->used>USQLPOOL_PINGMS)
+  if(!c->db->Ping()) pool->Reconnect(c);
+ f->ok=!c->dead&&c->db->QueryRaw(f->sql,f->nc)&&c->db->QResult(f->ut);
+ if(!f->ok)
+  {
+  if(!*c->db->err) sc(c->db->err,c->dead?"Connection lost":"Query failed");
+  f->err=SALLOC(sl(c->db->err));
+  if(f->err) sc(f->err,c->db->err);
+  }
+ c->dead=!f->ok&&!c->db->Ping();
+ c->used=GetTickCount();
+ SetEvent(f->done);
+ }
+c->db->Thread(0);
+return 0;
+}
+
+//opens n (0: a thread per processor) connections with li and starts their threads ...........................
+BOOL USQLPOOL::Open(USQLDB*(*newdb)(),LOGON_INFO*lli,NAT n=0,LPSTR connopts=NULL)
+{
+NAT i;
+Close();
+if(!n) n=ParThreads();
+conn=(USQLPOOL_CONN*)ALLOC0(n*sizeof(USQLPOOL_CONN));
+sem=CreateSemaphore(NULL,0,0x7fffffff,NULL);
+if(!conn||!sem)
+ {
+ FREE(conn);
+ if(sem) CloseHandle(sem);
+ sem=NULL;
+ return 0;
+ }
+InitializeCriticalSection(&cs);
+for(i=0;i<n;i++)
+ {
+ conn[i].pool=this;
+ conn[i].db=newdb();
+ if(!conn[i].db) break;
+ nrconn++;
+ if(!conn[i].db->Connect(lli,connopts)) break; //the first one may ask (UI) and update lli
+ conn[i].used=GetTickCount();
+ }
+if(i<n)
+ {
+ Close();
+ return 0;
+ }
+CopyMemory(&li,lli,sizeof(LOGON_INFO));
+*li.title=0; //not saved
+li.flags|=ODBC_LOGON_NOUI;
+for(i=0;i<n;i++)
+ conn[i].db->noui=1; //errors go to the USQL_FUTURE
+opts=connopts?SALLOC(sl(connopts)):NULL;
+if(opts) sc(opts,connopts);
+for(i=0;i<n;i++)
+ conn[i].th=CreateThread(NULL,0,USqlPoolThread,conn+i,0,NULL);
+return 1;
+}
+
+//runs the queries queued, stops the threads and closes the connections ...................................
+void USQLPOOL::Close()
+{
+NAT i,nt=0;
+if(!conn)
+ {
+ if(sem) CloseHandle(sem);
+ sem=NULL;
+ return;
+ }
+stop=1;
+for(i=0;i<nrconn;i++)
+ if(conn[i].th) nt++;
+if(nt) ReleaseSemaphore(sem,nt,NULL);
+for(i=0;i<nrconn;i++)
+ if(conn[i].th)
+  {
+  WaitForSingleObject(conn[i].th,INFINITE);
+  CloseHandle(conn[i].th);
+  }
+for(i=0;i<nrconn;i++)
+ delete conn[i].db;
+DeleteCriticalSection(&cs);
+CloseHandle(sem);
+FREE(conn);
+FREE(opts);
+sem=NULL;
+nrconn=0;
+stop=0;
+head=tail=NULL;
+}
+
+//queues a query (printf format), run on the first free connection; ut: its results (NULL: discarded) ..............
+USQL_FUTURE*USQLPOOL::QueryAsync(UTABLE*ut,char*formstr,...)
+{
+USQL_FUTURE*f;
+va_list vparam;
+int nc;
+if(!conn||stop) return NULL;
+f=(USQL_FUTURE*)ALLOC0(sizeof(USQL_FUTURE));
+if(!f) return NULL;
+va_start(vparam,formstr);
+nc=_vscprintf(formstr,vparam);
+va_end(vparam);
+f->sql=nc>=0?SALLOC(nc):NULL;
+f->done=CreateEvent(NULL,TRUE,FALSE,NULL);
+if(!f->sql||!f->done)
+ {
+ FREE(f->sql);
+ if(f->done) CloseHandle(f->done);
+ FREE(f);
+ return NULL;
+ }
+va_start(vparam,formstr);
+f->nc=vsprintf(f->sql,formstr,vparam);
+va_end(vparam);
+f->ut=ut;
+EnterCriticalSection(&cs);
+if(tail)
+ tail->next=f;
+else
+ head=f;
+tail=f;
+LeaveCriticalSection(&cs);
+ReleaseSemaphore(sem,1,NULL);
+return f;
+}
+
+//the query of f ran ......................................................................................
+BOOL USQLPOOL::Ready(USQL_FUTURE*f)
+{
+return f&&WaitForSingleObject(f->done,0)==WAIT_OBJECT_0;
+}
+
+//waits for the query of f, releases f: its success; err (if given) gets the error message (FREE it) or NULL ........
+BOOL USQLPOOL::Wait(USQL_FUTURE*f,LPSTR*err=NULL)
+{
+BOOL ok;
+if(err) *err=NULL;
+if(!f) return 0;
+WaitForSingleObject(f->done,INFINITE);
+ok=f->ok;
+if(err)
+ *err=f->err;
+else
+ FREE(f->err);
+CloseHandle(f->done);
+FREE(f->sql);
+FREE(f);
+return ok;
+}
\ No newline at end of file
@@ -6,6 +6,7 @@ template <class DynStruct> class USTRUCT
 public:
  DynStruct**item; //items
  NAT nrit; //nr of items
+ NAT cap; //allocated items (ArrayCap)
     
  USTRUCT() { ZEROCLASS(USTRUCT); }
  ~USTRUCT() { Free(); }
@@ -15,13 +16,18 @@ public:
  for(int i=0;i<nrit;i++)
   FREE(item[i]);
  FREE(item);
- nrit=0;
+ nrit=cap=0;
+ }
+//room for lnrit items, no reallocation until then............................................................................................ 
+ BOOL reserve(NAT lnrit)
+ {
+ return ArrayCap((void**)&item,&cap,lnrit,sizeof(DynStruct*),1);
  }
 //............................................................................................ 
  NAT dim(NAT lnrit=0)  //ins at end, del from end
  {
  if(lnrit==-1) lnrit=nrit+1; //ins one at end
- item=(DynStruct**)REALLOC(item,sizeof(DynStruct*)*(lnrit));
+ if(!ArrayCap((void**)&item,&cap,lnrit,sizeof(DynStruct*))) return -1;
  if(lnrit>nrit) ZeroMemory(item+nrit,(lnrit-nrit)*sizeof(DynStruct*));
  nrit=lnrit;
  return nrit-1;
@@ -29,8 +35,9 @@ public:
 //............................................................................................ 
  void ins(NAT pos=0,NAT itcnt=1)
  {
- item=(DynStruct**)REALLOC(item,sizeof(DynStruct*)*(nrit+itcnt));
- if(pos<nrit&&itcnt)
+ if(!ArrayCap((void**)&item,&cap,nrit+itcnt,sizeof(DynStruct*))) return;
+ if(pos>nrit) pos=nrit;
+ if(itcnt) //also zeroes items added at the end (the block may hold old ones)
   {
   ShiftMemR(item+pos,itcnt*sizeof(DynStruct*),(nrit-pos)*sizeof(DynStruct*));
   ZeroMemory(item+pos,itcnt*sizeof(DynStruct*));
@@ -47,7 +54,7 @@ public:
   ShiftMemL(item+(pos+itcnt),itcnt*sizeof(DynStruct*),(nrit-pos-itcnt)*sizeof(DynStruct*));
   }
  nrit-=itcnt;
- item=(DynStruct**)REALLOC(item,(nrit-itcnt)*sizeof(DynStruct*));
+ ArrayCap((void**)&item,&cap,nrit,sizeof(DynStruct*));
  }
 //............................................................................................ 
  void freeit(NAT itind,NAT szB=0)
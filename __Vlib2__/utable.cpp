@@ -2,6 +2,7 @@
 #pragma once
 
 #include <udata.cpp>
+#include <hash.cpp>
 
 class UTABLE
 {
@@ -25,6 +26,7 @@ public:
  int AddField(char*,BITS32,NAT,NAT,int); //(propagates to storage)
  int AddRows(NAT,NAT);
  void Totals(NAT);
+ NAT GroupBy(UTABLE*,NAT*,NAT,NAT*,NAT,BYTE**,NAT); //hash group-by with count,sum,min,max,mean
  void Draw();
  void Edit(int,int);
  void Scroll(int,int);
@@ -88,6 +90,204 @@ for(int f=0;f<nrfields;f++)
  field[f].total(pos);
 }
 
+#define UTABLE_NOGROUP	0xffffffff //GroupBy() empty slot
+
+//one GroupBy() over threads
+struct UTABLE_GROUPBY
+{
+ UTABLE*tab;
+ NAT*key,nrkey,*val,nrval;
+ NAT*kind; //UDataKind() of each val
+ BYTE**null; //per field, NULL: no nulls
+ NAT nrows,nrgrp;
+ QWORD*hash; //per row
+ NAT*grp; //group of each row
+ UDATA_AGG*part; //nrgrp x nrval, per thread unless bygrp
+ BOOL bygrp; //thread t aggregates the groups g%nt==t over all rows (many groups), else its share of the rows
+};
+
+//key hash of row r .............................................................................................
+inline QWORD UTableKeyHash(UTABLE*tab,NAT*key,NAT nrkey,NAT r)
+{
+QWORD h=0;
+for(NAT k=0;k<nrkey;k++)
+ {
+ UDATA*col=tab->field+key[k];
+ if(col->type&(UDT_STR|UDT_VSTR))
+  {
+  char*s=col->gstr(r);
+  h=s?VHash64(s,sl(s),h):h+1;
+  }
+ else
+  h=VHash64(col->pb+r*col->itsz,col->itsz,h);
+ }
+return h;
+}
+
+//rows r1 and r2 have the same keys .............................................................................................
+inline BOOL UTableKeyEq(UTABLE*tab,NAT*key,NAT nrkey,NAT r1,NAT r2)
+{
+for(NAT k=0;k<nrkey;k++)
+ {
+ UDATA*col=tab->field+key[k];
+ if(col->type&(UDT_STR|UDT_VSTR))
+  {
+  char*s1=col->gstr(r1),*s2=col->gstr(r2);
+  if(s1==s2) continue;
+  if(!s1||!s2||!scmp(s1,s2)) return 0; //NULL is a key of its own (hashed apart from "")
+  }
+ else if(memcmp(col->pb+r1*col->itsz,col->pb+r2*col->itsz,col->itsz))
+  return 0;
+ }
+return 1;
+}
+
+//GroupBy() worker t: hashes its share of the rows (part=NULL) or aggregates it (or its groups) by group ..............................
+void UTableGroupWork(void*ctx,NAT t,NAT nt)
+{
+UTABLE_GROUPBY*gb=(UTABLE_GROUPBY*)ctx;
+NAT b=(NAT)((QWORD)gb->nrows*t/nt),e=(NAT)((QWORD)gb->nrows*(t+1)/nt),r,v,f;
+UDATA_AGG*agg=gb->part;
+if(!gb->part)
+ {
+ for(r=b;r<e;r++)
+  gb->hash[r]=UTableKeyHash(gb->tab,gb->key,gb->nrkey,r);
+ return;
+ }
+if(gb->bygrp)
+ b=0,e=gb->nrows;
+else
+ agg+=t*gb->nrgrp*gb->nrval;
+for(r=b;r<e;r++)
+ {
+ if(gb->bygrp&&gb->grp[r]%nt!=t) continue;
+ for(v=0;v<gb->nrval;v++)
+  {
+  f=gb->val[v];
+  if(gb->null&&gb->null[f]&&gb->null[f][r>>3]>>(r&7)&1) continue;
+  UDataAggAdd(agg+gb->grp[r]*gb->nrval+v,gb->tab->field+f,gb->kind[v],r);
+  }
+ }
+}
+
+//hash group-by: out gets the key fields, "count" and sum/min/max/mean of each val field for each group,
+//in the order the groups first appear; null[f] (optional) marks null items of val field f. Returns the groups
+NAT UTABLE::GroupBy(UTABLE*out,NAT*key,NAT nrkey,NAT*val,NAT nrval,BYTE**null=NULL,NAT nt=0)
+{
+UTABLE_GROUPBY gb;
+NAT r,g,k,v,f,t,*first=NULL,*slot=NULL,*count=NULL,cap=0,nslot,ret=-1;
+char lsbuf[256];
+if(!out||out==this) return -1;
+for(k=0;k<nrkey;k++)
+ if(key[k]>=nrfields) return -1;
+for(v=0;v<nrval;v++)
+ if(val[v]>=nrfields||!(field[val[v]].type&UDT_NUMBER)) return -1;
+ZeroMemory(&gb,sizeof(gb));
+gb.tab=this;
+gb.key=key;
+gb.nrkey=nrkey;
+gb.val=val;
+gb.nrval=nrval;
+gb.null=null;
+gb.nrows=nrrecs;
+for(k=0;k<nrkey;k++)
+ gb.nrows=MIN(gb.nrows,field[key[k]].nrit);
+for(v=0;v<nrval;v++)
+ gb.nrows=MIN(gb.nrows,field[val[v]].nrit);
+if(!nt) nt=ParThreads();
+nt=MAX(MIN(nt,gb.nrows/UDATA_PARMIN),1);
+for(nslot=64;nslot<2*gb.nrows;nslot<<=1);
+gb.hash=(QWORD*)ALLOC(gb.nrows*sizeof(QWORD)+1);
+gb.grp=(NAT*)ALLOC(gb.nrows*sizeof(NAT)+1);
+gb.kind=(NAT*)ALLOC(nrval*sizeof(NAT)+1);
+slot=(NAT*)ALLOC(nslot*sizeof(NAT));
+if(!gb.hash||!gb.grp||!gb.kind||!slot) goto LEnd;
+FillDW((DWORD*)slot,UTABLE_NOGROUP,nslot);
+for(v=0;v<nrval;v++)
+ gb.kind[v]=UDataKind(field[val[v]].type,field[val[v]].itsz);
+ParRun(UTableGroupWork,&gb,nt); //hashes
+for(r=0;r<gb.nrows;r++) //groups in order of appearance
+ {
+ for(k=gb.hash[r]&(nslot-1);(g=slot[k])!=UTABLE_NOGROUP;k=(k+1)&(nslot-1))
+  if(gb.hash[first[g]]==gb.hash[r]&&UTableKeyEq(this,key,nrkey,first[g],r)) break;
+ if(g==UTABLE_NOGROUP)
+  {
+  if(!ArrayCap((void**)&first,&cap,gb.nrgrp+1,sizeof(NAT))) goto LEnd;
+  g=slot[k]=gb.nrgrp++;
+  first[g]=r;
+  }
+ gb.grp[r]=g;
+ }
+gb.bygrp=(QWORD)nt*gb.nrgrp>gb.nrows/8; //per thread partials would outgrow the rows
+t=gb.bygrp?1:nt;
+gb.part=(UDATA_AGG*)ALLOC0(t*gb.nrgrp*nrval*sizeof(UDATA_AGG)+1);
+count=(NAT*)ALLOC0(gb.nrgrp*sizeof(NAT)+1);
+if(!gb.part||!count) goto LEnd;
+for(k=0;k<t*gb.nrgrp*nrval;k++)
+ gb.part[k].type=field[val[k%nrval]].type;
+ParRun(UTableGroupWork,&gb,nt); //aggregates
+for(r=0;r<gb.nrows;r++)
+ count[gb.grp[r]]++;
+for(t=1;t<nt&&!gb.bygrp;t++)
+ for(k=0;k<gb.nrgrp*nrval;k++)
+  UDataAggMerge(gb.part+k,gb.part+t*gb.nrgrp*nrval+k);
+out->Free();
+for(k=0;k<nrkey;k++)
+ {
+ UDATA*col=field+key[k];
+ out->AddField(fieldname.gstr(key[k]),col->type,gb.nrgrp,(col->type&UDT_STR)&&!(col->type&UDT_POINTER)?col->itsz-1:col->itsz);
+ for(g=0;g<gb.nrgrp;g++)
+  if(col->type&(UDT_STR|UDT_VSTR))
+   out->field[k].set(g,col->gstr(first[g]));
+  else
+   out->field[k].setu(g,col->pb+first[g]*col->itsz);
+ }
+out->AddField("count",UDT_NAT,gb.nrgrp,8);
+for(g=0;g<gb.nrgrp;g++)
+ out->field[nrkey].set(g,(__int64)count[g]);
+for(v=0;v<nrval;v++)
+ {
+ BITS32 ty=field[val[v]].type&(UDT_INT|UDT_NAT)?field[val[v]].type&(UDT_NUMBER|UDT_RADIX|UDT_EXP):UDT_REAL;
+ f=out->nrfields;
+ sprintf(lsbuf,"sum(%.200s)",fieldname.gstr(val[v]));
+ out->AddField(lsbuf,ty,gb.nrgrp,8);
+ sprintf(lsbuf,"min(%.200s)",fieldname.gstr(val[v]));
+ out->AddField(lsbuf,ty,gb.nrgrp,8);
+ sprintf(lsbuf,"max(%.200s)",fieldname.gstr(val[v]));
+ out->AddField(lsbuf,ty,gb.nrgrp,8);
+ sprintf(lsbuf,"mean(%.200s)",fieldname.gstr(val[v]));
+ out->AddField(lsbuf,UDT_REAL,gb.nrgrp,8);
+ for(g=0;g<gb.nrgrp;g++)
+  {
+  UDATA_AGG*a=gb.part+g*nrval+v;
+  UDataAggEnd(a);
+  if(ty&UDT_REAL)
+   {
+   out->field[f].set(g,a->sum);
+   out->field[f+1].set(g,a->min);
+   out->field[f+2].set(g,a->max);
+   }
+  else
+   {
+   out->field[f].set(g,a->isum);
+   out->field[f+1].set(g,a->imin);
+   out->field[f+2].set(g,a->imax);
+   }
+  out->field[f+3].set(g,a->mean);
+  }
+ }
+ret=gb.nrgrp;
+LEnd:
+FREE(count);
+FREE(gb.part);
+FREE(first);
+FREE(slot);
+FREE(gb.kind);
+FREE(gb.grp);
+FREE(gb.hash);
+return ret;
+}
+
 //.............................................................................................
 inline void UTABLE::Draw()
 {
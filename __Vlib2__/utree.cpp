@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vtime.cpp>
+#include <parallel.cpp>
 
 class UTREE;
 
@@ -18,16 +19,52 @@ public:
  void Set(char*,int,VTIME*,NAT,void*);
 };
 
+#define UTREE_STREAM	0x10 //Dir() flag: files only go to the callback, not into the tree
+#ifndef FIND_FIRST_EX_LARGE_FETCH
+#define FIND_FIRST_EX_LARGE_FETCH	2
+#endif
+
+//Dir() callback, called from the worker threads: entry (valid during the call), its full path, ctx; FALSE drops it
+typedef BOOL (*UTREE_DIRFN)(UTREE_NODE*,LPSTR,void*);
+
+//a folder to list into its (sub)tree
+struct UTREE_DIRTASK
+{
+ UTREE*tree;
+ LPSTR path; //SALLOC-ed
+};
+
+//a worker's folders: it takes the last one (depth first), the others steal the first (the bigger subtrees)
+struct UTREE_DIRQ
+{
+ CRITICAL_SECTION cs;
+ UTREE_DIRTASK*task;
+ NAT beg,end,cap;
+};
+
+//one parallel Dir() walk
+struct UTREE_DIRWALK
+{
+ UTREE_DIRQ*q; //one per worker
+ NAT nt;
+ volatile LONG pending; //folders queued or being listed
+ int flags;
+ LPSTR filter;
+ UTREE_DIRFN fn;
+ void*ctx;
+};
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 class UTREE
 {
 public:
  UTREE_NODE*node; //root nodes
  NAT nrnodes; //number of root nodes
+ NAT nodecap; //allocated nodes (ArrayCap)
  int ienum; //internal enumeration index
  
  UTREE() { ZEROCLASS(UTREE); }
- void Dir(LPSTR,int,LPSTR);
+ void Dir(LPSTR,int,LPSTR,NAT,UTREE_DIRFN,void*);
  void MkDir(LPSTR,int); //makes dir structure
  BOOL SaveTXT(LPSTR,int);
  BOOL LoadTXT(LPSTR,int);
@@ -44,12 +81,18 @@ public:
     }
    } 
   FREE(node);
+  nodecap=0;
+  }
+ //room for lnrnodes root nodes, no reallocation until then..........................................................................................
+ BOOL Reserve(NAT lnrnodes)
+  {
+  return ArrayCap((void**)&node,&nodecap,lnrnodes,sizeof(UTREE_NODE),1);
   }
  //..........................................................................................
  NAT Add(char*lstr,int lnr=0,VTIME*ptm=NULL,NAT ldtsz=0,void*ldt=NULL)
   {
+  if(!ArrayCap((void**)&node,&nodecap,nrnodes+1,sizeof(UTREE_NODE))) return -1;
   nrnodes++;
-  node=(UTREE_NODE*)REALLOC(node,nrnodes*sizeof(UTREE_NODE));
   ZeroMemory(&node[nrnodes-1],sizeof(UTREE_NODE));
   node[nrnodes-1].Set(lstr,lnr,ptm,ldtsz,ldt);
   return nrnodes-1; //index
@@ -72,7 +115,7 @@ public:
   ShiftMemL(node+pos+itcnt,itcnt*sizeof(UTREE_NODE),(nrnodes-pos-itcnt)*sizeof(UTREE_NODE));
   }
  nrnodes-=itcnt;
- node=(UTREE_NODE*)REALLOC(node,nrnodes*sizeof(UTREE_NODE));
+ ArrayCap((void**)&node,&nodecap,nrnodes,sizeof(UTREE_NODE));
  }
  //....................................................................................................... 
  NAT CountLeafs()
@@ -90,29 +133,41 @@ public:
  //....................................................................................................... 
  NAT CountNodes()
  {
- NAT nrnodes=0;
+ NAT n=0;
  for(int i=0;i<nrnodes;i++)
   {
   if(node[i].next)
-   nrnodes+=1+node[i].next->CountNodes();
+   n+=1+node[i].next->CountNodes();
   } 
- return nrnodes;
+ return n;
  }
- //delete empty nodes ....................................................................................................... 
- void DelEmpty()
+ //delete empty nodes (subtrees without leafs) in one pass, returns the leafs left ...........................
+ NAT DelEmpty()
  {
+ NAT nrleafs=0,n,k=0;
  for(int i=0;i<nrnodes;i++)
   {
   if(node[i].next)
    {
-   node[i].next->DelEmpty();
-   if(node[i].next->CountLeafs()<1)
+   n=node[i].next->DelEmpty();
+   if(n<1)
     {
-    Del(i,1);
-    i--;
+    node[i].FreeNode();
+    continue;
     }
+   nrleafs+=n;
    }
-  } 
+  else
+   nrleafs++;
+  if(k!=i) node[k]=node[i];
+  k++;
+  }
+ if(k<nrnodes)
+  {
+  nrnodes=k;
+  ArrayCap((void**)&node,&nodecap,nrnodes,sizeof(UTREE_NODE));
+  }
+ return nrleafs;
  }
 
  //............................................................................................ 
@@ -309,55 +364,149 @@ public:
   }
  }
 
-//append dir structure (!Functie recursiva) ......................................................................................
-void UTREE::Dir(LPSTR root=NULL,int flags=0,LPSTR filter="*")
-{ //b0=fullpath, b1=only folders, b2=only files, b3=skip subfolders
+//queues a folder on worker t ..........................................................................
+BOOL UTreeDirPush(UTREE_DIRWALK*w,NAT t,UTREE*tree,LPSTR path)
+{
+UTREE_DIRQ*q=w->q+t;
+NAT nc=sl(path);
+LPSTR p=SALLOC(nc);
+if(!p) return 0;
+sc(p,path,nc);
+EnterCriticalSection(&q->cs);
+if(q->beg==q->end) q->beg=q->end=0;
+if(!ArrayCap((void**)&q->task,&q->cap,q->end+1,sizeof(UTREE_DIRTASK)))
+ {
+ LeaveCriticalSection(&q->cs);
+ FREE(p);
+ return 0;
+ }
+q->task[q->end].tree=tree;
+q->task[q->end].path=p;
+q->end++;
+InterlockedIncrement(&w->pending);
+LeaveCriticalSection(&q->cs);
+return 1;
+}
+
+//next folder for worker t: its own last one, else the first one of another worker ...........................
+BOOL UTreeDirTake(UTREE_DIRWALK*w,NAT t,UTREE_DIRTASK*task)
+{
+for(NAT k=0;k<w->nt;k++)
+ {
+ UTREE_DIRQ*q=w->q+(t+k)%w->nt;
+ if(q->beg==q->end) continue; //looks empty, not worth the lock
+ EnterCriticalSection(&q->cs);
+ if(q->beg<q->end)
+  {
+  *task=k?q->task[q->beg++]:q->task[--q->end];
+  LeaveCriticalSection(&q->cs);
+  return 1;
+  }
+ LeaveCriticalSection(&q->cs);
+ }
+return 0;
+}
+
+//lists one folder into its tree (filters applied here), queues its subfolders on worker t ...................
+void UTreeDirList(UTREE_DIRWALK*w,NAT t,UTREE_DIRTASK*task)
+{ //b0=fullpath, b1=only folders, b2=only files, b3=skip subfolders, b4=UTREE_STREAM
 HANDLE hff;
 WIN32_FIND_DATA wfd;
+UTREE_NODE en;
+UTREE*tree=task->tree;
 char lBufDir[PATHSZ];
 VTIME ltm;
+int flags=w->flags;
+BOOL isdir;
 ltm.init(VTMF_VLAD);
-mergepath(lBufDir,root,filter);
-hff=FindFirstFile(lBufDir,&wfd);
+mergepath(lBufDir,task->path,w->filter);
+hff=FindFirstFileEx(lBufDir,(FINDEX_INFO_LEVELS)1,&wfd,FindExSearchNameMatch,NULL,FIND_FIRST_EX_LARGE_FETCH); //FindExInfoBasic: no short names
+if(hff==INVALID_HANDLE_VALUE&&GetLastError()==ERROR_INVALID_PARAMETER) //before Windows 7
+ hff=FindFirstFile(lBufDir,&wfd);
 if(hff!=INVALID_HANDLE_VALUE)
  {
  do{
-  if(wfd.cFileName[0]!='.') //exclude parent and current because they can cause infinite loops
+  if(wfd.cFileName[0]=='.') continue; //exclude parent and current because they can cause infinite loops
+  isdir=(wfd.dwFileAttributes&FILE_ATTRIBUTE_DIRECTORY)!=0;
+  if((!isdir&&flags&0x2)||(isdir&&flags&0x4)) continue;
+  ltm=wfd.ftCreationTime;
+  mergepath(lBufDir,task->path,wfd.cFileName);
+  if(w->fn)
    {
-   if(wfd.dwFileAttributes&FILE_ATTRIBUTE_DIRECTORY||!(flags&0x2))
-    {
-    if(!(wfd.dwFileAttributes&FILE_ATTRIBUTE_DIRECTORY)||!(flags&0x4))
-     {
-     ltm=wfd.ftCreationTime;
-     if(flags&0x1)
-      {
-      mergepath(lBufDir,root,wfd.cFileName);
-      Add(lBufDir,wfd.dwFileAttributes,&ltm);
-      }
-     else 
-      Add(wfd.cFileName,wfd.dwFileAttributes,&ltm);
-     } 
-    }
-   } 
+   ZeroMemory(&en,sizeof(UTREE_NODE));
+   en.name=flags&0x1?lBufDir:wfd.cFileName;
+   en.nr=wfd.dwFileAttributes;
+   CopyMemory(&en.tm,&ltm,sizeof(VTIME));
+   if(!w->fn(&en,lBufDir,w->ctx)) continue;
+   }
+  if(!isdir&&flags&UTREE_STREAM) continue;
+  tree->Add(flags&0x1?lBufDir:wfd.cFileName,wfd.dwFileAttributes,&ltm);
   }while(FindNextFile(hff,&wfd));
  FindClose(hff);
- } 
+ }
 if(flags&0xC) return;
-for(int i=0; i<nrnodes; i++)
+for(NAT i=0;i<tree->nrnodes;i++)
  {
- if(node[i].nr&FILE_ATTRIBUTE_DIRECTORY)
+ if(tree->node[i].nr&FILE_ATTRIBUTE_DIRECTORY)
   {
-  ifn(node[i].next)
-   node[i].next=(UTREE*)ALLOC0(sizeof(UTREE)); //=Spawn(i);
+  ifn(tree->node[i].next)
+   tree->node[i].next=(UTREE*)ALLOC0(sizeof(UTREE));
+  if(!tree->node[i].next) continue;
   if(flags&0x1)
-   node[i].next->Dir(node[i].name,flags,filter);
+   UTreeDirPush(w,t,tree->node[i].next,tree->node[i].name);
   else
    {
-   mergepath(lBufDir,root,node[i].name);
-   node[i].next->Dir(lBufDir,flags,filter);
+   mergepath(lBufDir,task->path,tree->node[i].name);
+   UTreeDirPush(w,t,tree->node[i].next,lBufDir);
    }
   }
  }
+}
+
+//Dir() worker t: lists folders until none is queued or being listed .......................................
+void UTreeDirWork(void*ctx,NAT t,NAT nt)
+{
+UTREE_DIRWALK*w=(UTREE_DIRWALK*)ctx;
+UTREE_DIRTASK task;
+while(w->pending)
+ {
+ if(UTreeDirTake(w,t,&task))
+  {
+  UTreeDirList(w,t,&task);
+  FREE(task.path);
+  InterlockedDecrement(&w->pending);
+  }
+ else
+  SwitchToThread(); //the others are listing, their subfolders may come
+ }
+}
+
+//append dir structure: each folder is listed by one of nt threads (0=ParThreads()) that steal subfolders
+//from each other; fn (optional) sees the entries while the walk goes on ........................................
+void UTREE::Dir(LPSTR root=NULL,int flags=0,LPSTR filter="*",NAT nt=0,UTREE_DIRFN fn=NULL,void*ctx=NULL)
+{ //b0=fullpath, b1=only folders, b2=only files, b3=skip subfolders, b4=UTREE_STREAM
+UTREE_DIRWALK w;
+NAT t;
+if(!nt) nt=ParThreads();
+if(flags&0xC) nt=1; //one folder
+ZeroMemory(&w,sizeof(w));
+w.q=(UTREE_DIRQ*)ALLOC0(nt*sizeof(UTREE_DIRQ));
+if(!w.q) return;
+w.nt=nt;
+w.flags=flags;
+w.filter=filter;
+w.fn=fn;
+w.ctx=ctx;
+for(t=0;t<nt;t++)
+ InitializeCriticalSection(&w.q[t].cs);
+if(UTreeDirPush(&w,0,this,root))
+ ParRun(UTreeDirWork,&w,nt);
+for(t=0;t<nt;t++)
+ {
+ DeleteCriticalSection(&w.q[t].cs);
+ FREE(w.q[t].task);
+ }
+FREE(w.q);
 }//TODO: properly support FILETIME
 
 //make dir structure (!Functie recursiva) ......................................................................................
@@ -386,30 +535,412 @@ else
  } 
 }
 
-//save as text file (only curent node)......................................................................................
+#define UTREE_TXTDEPTH	256 //LoadTXT() levels
+#define UTREE_TXTHEAD	"//UTREE 2" //first line of the SaveTXT() tree format; files without it are flat lists
+
+//starts a SaveTXT() file with UTREE_TXTHEAD (not when appending to a non empty one)
+void UTreeTXTHead(FILE*fis)
+{
+fseek(fis,0,SEEK_END);
+if(!ftell(fis)) fprintf(fis,"%s\n",UTREE_TXTHEAD);
+}
+
+//is buf the UTREE_TXTHEAD line?
+BOOL UTreeTXTIsHead(LPSTR buf)
+{
+NAT nc=sl(UTREE_TXTHEAD);
+return CmpMem(buf,(char*)UTREE_TXTHEAD,nc)&&(!buf[nc]||buf[nc]=='\n'||buf[nc]=='\r');
+}
+
+//SaveTXT() lines: one tab per level, the nodes with a subtree end with '/' (a flat list stays one name per line)
+void UTreeSaveTXT(FILE*fis,UTREE*tree,NAT depth)
+{
+for(NAT i=0;i<tree->nrnodes;i++)
+ {
+ for(NAT d=0;d<depth;d++)
+  fputc('\t',fis);
+ fprintf(fis,tree->node[i].next?"%s/\n":"%s\n",tree->node[i].name);
+ if(tree->node[i].next)
+  UTreeSaveTXT(fis,tree->node[i].next,depth+1);
+ }
+}
+
+//one SaveTXT() line: its level, if it has a subtree; returns the name (cut in buf) or NULL for an empty line
+//tree=0: a line of an old flat list, level 0 and a trailing '/' is part of the name
+LPSTR UTreeTXTLine(LPSTR buf,NAT*depth,BOOL*sub,BOOL tree)
+{
+NAT d=0,nc;
+while(buf[d]=='\t') d++;
+nc=sl(buf+d);
+while(nc&&(buf[d+nc-1]=='\n'||buf[d+nc-1]=='\r')) nc--;
+*sub=tree&&nc>1&&buf[d+nc-1]=='/';
+if(*sub) nc--;
+buf[d+nc]=0;
+*depth=tree?MIN(d,UTREE_TXTDEPTH-1):0;
+return nc?buf+d:NULL;
+}
+
+//save as text file (the whole tree, UFTREE::LoadTXT reads it too)......................................................................................
 BOOL UTREE::SaveTXT(LPSTR path,int append=0)
 {
 FILE *fis;
 fis=FOPEN(path,append?"a+t":"wt");
 if(!fis) return 0;
-for(int i=0;i<nrnodes;i++)
- fprintf(fis,"%s\r\n",node[i].name);
+UTreeTXTHead(fis);
+UTreeSaveTXT(fis,this,0);
 fclose(fis); 
 return 1;
 }
 
-//load from text file (only curent node)......................................................................................
+//load from text file (SaveTXT() of UTREE or UFTREE, or an old list of one name per line)......................................................................................
 BOOL UTREE::LoadTXT(LPSTR path,int append=0)
 {
 FILE *fis;
 char buf[1024];
+LPSTR name;
+UTREE*level[UTREE_TXTDEPTH]; //parents of the current line
+NAT last[UTREE_TXTDEPTH]; //last node added on each level
+NAT d,k;
+int top=-1; //level of the last node
+BOOL sub,tree=0,first=1;
+fis=FOPEN(path,"rt");
+if(!fis) return 0;
+ifn(append) Free();
+level[0]=this;
+while(fgets(buf,sizeof(buf),fis))
+ {
+ if(first&&(first=0,tree=UTreeTXTIsHead(buf))) continue;
+ if(!(name=UTreeTXTLine(buf,&d,&sub,tree))) continue;
+ if((int)d>top+1) d=top+1;
+ if(d&&(int)d==top+1) //first child of the last node
+  {
+  level[d]=level[d-1]->node[last[d-1]].next;
+  if(!level[d]&&!(level[d]=level[d-1]->Spawn(last[d-1]))) break;
+  }
+ k=level[d]->Add(name);
+ if(k==(NAT)-1) break;
+ if(sub) level[d]->Spawn(k);
+ last[d]=k;
+ top=d;
+ }
+fclose(fis); 
+return 1;
+}
+
+#define UFT_NONE	0xffffffff //no node
+
+//flat tree node: links are UFTREE::node indexes, name and dt are UFTREE::pool offsets
+struct UFTREE_NODE
+{
+ NAT name; //interned
+ int nr; //color,state,flags,etc.
+ VTIME tm;
+ NAT dtsz; //extra data size (may be used for other purpose if not using extra data)
+ NAT dt; //extra data (0=none)
+ NAT parent,child,last,sibling; //first and last child, next node on the same level
+ NAT nrleafs; //leafs in its subtree (1 for a leaf)
+ NAT nrsub; //nodes with a subtree below it (as UTREE::CountNodes())
+ BOOL sub; //has a subtree (maybe empty), as UTREE_NODE::next
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//UTREE in one node array and one string pool (each name stored once): node 0 is the root and
+//From()/LoadTXT()/Order() lay the others out in preorder, so walks go straight through the array
+class UFTREE
+{
+public:
+ UFTREE_NODE*node; //node[0]= root
+ NAT nrnodes,nodecap; //with the root
+ char*pool; //names and extra data, pool[0]= ""
+ NAT poolsz,poolcap;
+ NAT*hash; //name offsets by hash, open addressing, 0=free slot
+ NAT hashcap,nrhash; //hashcap is a power of 2, at most half full
+ 
+ UFTREE() { ZEROCLASS(UFTREE); }
+ ~UFTREE() { Free(); }
+ BOOL Init();
+ NAT Intern(char*,NAT);
+ NAT Add(NAT,char*,int,VTIME*,NAT,void*,BOOL);
+ BOOL From(UTREE*,NAT);
+ BOOL To(UTREE*,NAT);
+ BOOL Order(BOOL);
+ BOOL SaveTXT(LPSTR,int);
+ BOOL LoadTXT(LPSTR,int);
+ 
+ //..........................................................................................
+ void Free()
+  {
+  FREE(node);
+  FREE(pool);
+  FREE(hash);
+  nrnodes=nodecap=poolsz=poolcap=hashcap=nrhash=0;
+  }
+ //valid until the next Add()..........................................................................................
+ char* Name(NAT i) { return pool+node[i].name; }
+ void* Data(NAT i) { return node[i].dt?pool+node[i].dt:NULL; }
+ NAT CountLeafs(NAT i=0) { return nrnodes?node[i].nrleafs:0; }
+ NAT CountNodes(NAT i=0) { return nrnodes?node[i].nrsub:0; }
+ //delete empty nodes (subtrees without leafs)..........................................................................................
+ BOOL DelEmpty() { return Order(1); }
+ //room for n more nodes..........................................................................................
+ BOOL Reserve(NAT n)
+  {
+  return ArrayCap((void**)&node,&nodecap,nrnodes+n,sizeof(UFTREE_NODE),1);
+  }
+ //adds dl leafs and ds subtree nodes to i and its parents..........................................................................................
+ void Count(NAT i,int dl,int ds)
+  {
+  for(;i!=UFT_NONE;i=node[i].parent)
+   {
+   node[i].nrleafs+=dl;
+   node[i].nrsub+=ds;
+   }
+  }
+ //n bytes at the end of the pool, aligned; returns the offset or 0..........................................................................................
+ NAT Put(void*dt,NAT n,NAT align=1)
+  {
+  NAT of=(poolsz+align-1)&~(align-1);
+  if(!ArrayCap((void**)&pool,&poolcap,of+n,1)) return 0;
+  CopyMemory(pool+of,dt,n);
+  poolsz=of+n;
+  return of;
+  }
+}; //end of UFTREE class
+
+//empty tree: the root node and the "" name .........................................................................
+BOOL UFTREE::Init()
+{
+if(nrnodes) return 1;
+if(!Reserve(1)) return 0;
+poolsz=0;
+if(!ArrayCap((void**)&pool,&poolcap,1,1)) return 0;
+pool[poolsz++]=0;
+ZeroMemory(node,sizeof(UFTREE_NODE));
+node[0].parent=node[0].child=node[0].last=node[0].sibling=UFT_NONE;
+node[0].sub=1;
+nrnodes=1;
+return 1;
+}
+
+//pool offset of the name (nc chars), stored once; UFT_NONE on no memory .........................................
+NAT UFTREE::Intern(char*name,NAT nc)
+{
+NAT h=2166136261,i,j,of,*nh;
+char zero=0;
+if(!nc) return 0;
+if(2*(nrhash+1)>hashcap) //rehash into twice the slots
+ {
+ NAT ncap=hashcap?2*hashcap:256;
+ nh=(NAT*)ALLOC0(ncap*sizeof(NAT));
+ if(!nh) return UFT_NONE;
+ for(j=0;j<hashcap;j++)
+  if(hash[j])
+   {
+   NAT hj=2166136261;
+   for(char*s=pool+hash[j];*s;s++)
+    hj=(hj^(BYTE)*s)*16777619;
+   for(i=hj&(ncap-1);nh[i];i=(i+1)&(ncap-1));
+   nh[i]=hash[j];
+   }
+ FREE(hash);
+ hash=nh;
+ hashcap=ncap;
+ }
+for(i=0;i<nc;i++)
+ h=(h^(BYTE)name[i])*16777619;
+for(i=h&(hashcap-1);hash[i];i=(i+1)&(hashcap-1))
+ if(!memcmp(pool+hash[i],name,nc)&&!pool[hash[i]+nc])
+  return hash[i];
+if(!(of=Put(name,nc))||!Put(&zero,1)) return UFT_NONE;
+hash[i]=of;
+nrhash++;
+return of;
+}
+
+//adds a node as the last child of parent (0=root), a leaf becoming a parent gets a subtree; returns the index or UFT_NONE
+NAT UFTREE::Add(NAT parent,char*lstr,int lnr=0,VTIME*ptm=NULL,NAT ldtsz=0,void*ldt=NULL,BOOL lsub=0)
+{
+UFTREE_NODE*n;
+NAT i,nm,dt=0;
+if(!Init()||parent>=nrnodes) return UFT_NONE;
+if((nm=Intern(lstr,sl(lstr)))==UFT_NONE) return UFT_NONE;
+if(ldt&&ldtsz&&!(dt=Put(ldt,ldtsz,8))) return UFT_NONE;
+if(!ArrayCap((void**)&node,&nodecap,nrnodes+1,sizeof(UFTREE_NODE))) return UFT_NONE;
+i=nrnodes++;
+n=node+i;
+ZeroMemory(n,sizeof(UFTREE_NODE));
+n->name=nm;
+n->nr=lnr;
+if(ptm)
+ CopyMemory(&n->tm,ptm,sizeof(VTIME));
+else
+ n->tm.Now();
+n->dtsz=ldtsz;
+n->dt=dt;
+n->parent=parent;
+n->child=n->last=n->sibling=UFT_NONE;
+n->sub=lsub;
+n->nrleafs=!lsub;
+ifn(node[parent].sub) //the leaf becomes a node
+ {
+ node[parent].sub=1;
+ Count(parent,-1,0);
+ Count(node[parent].parent,0,1);
+ }
+if(node[parent].last==UFT_NONE)
+ node[parent].child=i;
+else
+ node[node[parent].last].sibling=i;
+node[parent].last=i;
+if(lsub)
+ Count(parent,0,1);
+else
+ Count(parent,1,0);
+return i;
+}
+
+//appends a UTREE under parent (0=root) ..........................................................................................
+BOOL UFTREE::From(UTREE*tree,NAT parent=0)
+{
+NAT k;
+for(NAT i=0;i<tree->nrnodes;i++)
+ {
+ UTREE_NODE*n=tree->node+i;
+ k=Add(parent,n->name,n->nr,&n->tm,n->dtsz,n->dt,n->next!=NULL);
+ if(k==UFT_NONE) return 0;
+ if(n->next&&!From(n->next,k)) return 0;
+ }
+return 1;
+}
+
+//appends the children of parent (0=root) to a UTREE ..........................................................................................
+BOOL UFTREE::To(UTREE*tree,NAT parent=0)
+{
+NAT k;
+if(parent>=nrnodes) return nrnodes==0;
+for(NAT i=node[parent].child;i!=UFT_NONE;i=node[i].sibling)
+ {
+ k=tree->Add(Name(i),node[i].nr,&node[i].tm,node[i].dtsz,Data(i));
+ if(k==(NAT)-1) return 0;
+ if(node[i].sub&&(!tree->Spawn(k)||!To(tree->node[k].next,i))) return 0;
+ }
+return 1;
+}
+
+//lays the nodes out in preorder (after Add()-s to older parents) and recounts; dropempty also deletes
+//the subtrees without leafs. Names of deleted nodes stay in the pool. ......................................................
+BOOL UFTREE::Order(BOOL dropempty=0)
+{
+UFTREE_NODE*nn;
+NAT i,k=0,p,*map;
+BOOL keep;
+if(nrnodes<2) return 1;
+nn=(UFTREE_NODE*)ALLOC(nrnodes*sizeof(UFTREE_NODE));
+map=(NAT*)ALLOC(nrnodes*sizeof(NAT));
+if(!nn||!map)
+ {
+ FREE(nn);
+ FREE(map);
+ return 0;
+ }
+for(i=0;;)
+ {
+ keep=!i||!dropempty||!node[i].sub||node[i].nrleafs;
+ if(keep)
+  {
+  map[i]=k;
+  nn[k]=node[i];
+  nn[k].parent=i?map[node[i].parent]:UFT_NONE;
+  nn[k].child=nn[k].last=nn[k].sibling=UFT_NONE;
+  nn[k].nrleafs=!nn[k].sub;
+  nn[k].nrsub=0;
+  k++;
+  if(node[i].child!=UFT_NONE)
+   {
+   i=node[i].child;
+   continue;
+   }
+  }
+ while(i&&node[i].sibling==UFT_NONE) i=node[i].parent;
+ if(!i) break;
+ i=node[i].sibling;
+ }
+for(i=1;i<k;i++) //parents come first, children in their old order
+ {
+ p=nn[i].parent;
+ if(nn[p].last==UFT_NONE)
+  nn[p].child=i;
+ else
+  nn[nn[p].last].sibling=i;
+ nn[p].last=i;
+ }
+for(i=k-1;i>0;i--) //children come after their parent
+ {
+ p=nn[i].parent;
+ nn[p].nrleafs+=nn[i].nrleafs;
+ nn[p].nrsub+=nn[i].nrsub+(nn[i].sub?1:0);
+ }
+FREE(map);
+FREE(node);
+node=nn;
+nodecap=nrnodes;
+nrnodes=k;
+return 1;
+}
+
+//save as text file, same format as UTREE::SaveTXT() ......................................................................................
+BOOL UFTREE::SaveTXT(LPSTR path,int append=0)
+{
+FILE *fis;
+NAT i,d=0;
+fis=FOPEN(path,append?"a+t":"wt");
+if(!fis) return 0;
+UTreeTXTHead(fis);
+for(i=nrnodes?node[0].child:UFT_NONE;i!=UFT_NONE;)
+ {
+ for(NAT t=0;t<d;t++)
+  fputc('\t',fis);
+ fprintf(fis,node[i].sub?"%s/\n":"%s\n",Name(i));
+ if(node[i].child!=UFT_NONE)
+  {
+  i=node[i].child;
+  d++;
+  continue;
+  }
+ while(i&&node[i].sibling==UFT_NONE)
+  {
+  i=node[i].parent;
+  d--;
+  }
+ i=i?node[i].sibling:UFT_NONE;
+ }
+fclose(fis); 
+return 1;
+}
+
+//load from text file (SaveTXT() of UTREE or UFTREE, or an old list of one name per line), under the root ......................................................................................
+BOOL UFTREE::LoadTXT(LPSTR path,int append=0)
+{
+FILE *fis;
+char buf[1024];
+LPSTR name;
+NAT level[UTREE_TXTDEPTH]; //parents of the current line
+NAT d,k;
+int top=-1; //level of the last node
+BOOL sub,tree=0,first=1;
 fis=FOPEN(path,"rt");
 if(!fis) return 0;
 ifn(append) Free();
-while(!feof(fis))
+level[0]=0;
+while(fgets(buf,sizeof(buf),fis))
  {
- if(fscanf(fis,"%s",buf)>0)
-  Add(buf);
+ if(first&&(first=0,tree=UTreeTXTIsHead(buf))) continue;
+ if(!(name=UTreeTXTLine(buf,&d,&sub,tree))) continue;
+ if((int)d>top+1) d=top+1;
+ k=Add(level[d],name,0,NULL,0,NULL,sub);
+ if(k==UFT_NONE) break;
+ if(d+1<UTREE_TXTDEPTH) level[d+1]=k;
+ top=d;
  }
 fclose(fis); 
 return 1;
@@ -8,6 +8,24 @@
 
 #define MAX_ODBC_QUERY_NC 8192 //8KB
 
+#define VODBC_ROWS		256 //QStream() rows per SQLFetchScroll()
+#define VODBC_CELLMAX	8192 //QStream() columns wider (or of unknown size) are read with SQLGetData()
+
+//QStream() column-wise bound row array
+struct VODBC_FETCH
+{
+ SQLHSTMT hstmt;
+ NAT nrf;
+ char**col; //per column: VODBC_ROWS x width[f] chars
+ SQLLEN**ind; //per column: VODBC_ROWS lengths or SQL_NULL_DATA
+ NAT*width;
+ NAT nbound; //columns [0,nbound) are bound, the long ones after are read by SQLGetData() (one row per fetch)
+ char*buf; //a long value
+ NAT bufcap;
+ SQLULEN fetched,pos; //rows in the arrays, the next one to copy
+ SQLRETURN ret; //last SQLFetchScroll() or SQLGetData()
+};
+
 //<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 class VODBC:public USQLDB
 {
@@ -19,11 +37,18 @@ public:
  SQLRETURN ret;  //last return value
  char Qbuf[MAX_ODBC_QUERY_NC]; //buffer for last query
  NAT Qnc; //last query size in chars
+ SQLHSTMT hpstmt; //Prepare()d statement
+ USQL_PARAM*param;
+ NAT nrparams,prows; //parameters, rows per SQLExecute()
+ SQLLEN*pind; //nrparams x prows lengths
+ NAT pindcap;
  
  VODBC() { ZEROCLASSV(VODBC);  type=USQL_ODBC; }
  int ifer(int,char*,...);
  int checkret(char*,...);
- void UTYPE(enum_field_types,NAT,NAT,BITS32*,NAT*);
+ int checkstmt(SQLHSTMT,char*,...);
+ int vcheckret(SQLHSTMT,char*,va_list);
+ void UTYPE(SQLSMALLINT,NAT,NAT,BITS32*,NAT*);
  //USQLDB
  virtual BOOL Connect(LOGON_INFO*,char*);
  virtual BOOL Disconnect();
@@ -34,14 +59,21 @@ public:
  virtual BOOL E_value(LPSTR,LPSTR,int);
  virtual BOOL DropTable(LPSTR);  //drop table
  virtual BOOL Query(char*,...);
+ virtual BOOL QueryRaw(char*,NAT);
  virtual void StartQuery();
  virtual BOOL Astr(char*,...);
  virtual BOOL Abin(void*,NAT);
  virtual BOOL DoQuery();
  virtual BOOL QResult(UTABLE*);
+ virtual BOOL QStream(UTABLE*,NAT,USQL_BATCHFN,void*);
+ virtual BOOL Prepare(char*);
+ virtual BOOL Bind(UTABLE*,NAT*,BYTE**);
+ virtual BOOL ExecuteBatch(NAT,NAT);
  virtual int Database(LPSTR);
  virtual BOOL DropDB(LPSTR);  //drop database
+ virtual BOOL Ping();
  //~USQLDB
+ BOOL BindRows(NAT,NAT,NAT);
  void ShowResult(SQLHSTMT);
  void Info();
  void Status();
@@ -59,7 +91,7 @@ public:
 #define SQL_NEED_DATA             99
 */
 // [vendor][ODBC-component][data-source]message-text .................................................................................................................................
-int VODBC::checkret(char *formstr=NULL,...)
+int VODBC::vcheckret(SQLHSTMT hs,char *formstr,va_list vparam)
 {
 if(ret==SQL_SUCCESS||ret==SQL_SUCCESS_WITH_INFO) return 0;
 char lsbuf[MAX_QUERY_NC];
@@ -68,29 +100,106 @@ SQLINTEGER native;
 SQLSMALLINT w;
 int retv,i;
 NAT l=0;
-va_list vparam;
-va_start(vparam,formstr);
 if(formstr)
  l=vsprintf(lsbuf,formstr,vparam);
-va_end(vparam);
 l+=sprintf(lsbuf+l," returned %i\n",ret);
 retv=1;
-while(SQLGetDiagRec(SQL_HANDLE_STMT,hstmt,retv,state,&native,(SQLCHAR*)(lsbuf+l),MAX_QUERY_NC-l,&w)==SQL_SUCCESS)
+while(SQLGetDiagRec(SQL_HANDLE_STMT,hs,retv,state,&native,(SQLCHAR*)(lsbuf+l),MAX_QUERY_NC-l,&w)==SQL_SUCCESS)
  {
  retv++;
  l+=w;
  lsbuf[l++]='\n';
  }
 lsbuf[l]=0;
+if(noui)
+ {
+ sc(err,lsbuf,USQL_ERRNC-1);
+ return 0;
+ }
 retv=MessageBox(HWND_DESKTOP,lsbuf,"ODBC ERROR",MB_ICONWARNING|MB_ABORTRETRYIGNORE|MB_TASKMODAL|MB_TOPMOST);
 if(retv==IDABORT) exit(1);
 if(retv==IDRETRY) DebugBreak();
 return (retv==IDRETRY);	//should retry
 }
 
-//.................................................................................................................................
-void VODBC::UTYPE(enum_field_types mytype,NAT prec,NAT size,BITS32*utype,NAT*uitsz)
+//checks ret of a call on the default statement .................................................................................................................................
+int VODBC::checkret(char *formstr=NULL,...)
+{
+int retv;
+va_list vparam;
+va_start(vparam,formstr);
+retv=vcheckret(hstmt,formstr,vparam);
+va_end(vparam);
+return retv;
+}
+
+//checks ret of a call on statement hs .................................................................................................................................
+int VODBC::checkstmt(SQLHSTMT hs,char *formstr=NULL,...)
+{
+int retv;
+va_list vparam;
+va_start(vparam,formstr);
+retv=vcheckret(hs,formstr,vparam);
+va_end(vparam);
+return retv;
+}
+
+//convert ODBC SQL type to internal(UDATA) field type (values are fetched as text).................................................................................................................................
+void VODBC::UTYPE(SQLSMALLINT sqltype,NAT prec,NAT size,BITS32*utype,NAT*uitsz)
 {
+*uitsz=0;
+switch(sqltype)
+ {
+ case SQL_CHAR:
+  *utype=UDT_STR;
+  *uitsz=size;
+  break;
+ case SQL_BIT:
+ case SQL_TINYINT:
+  *utype=UDT_INT;
+  *uitsz=1;
+  break;
+ case SQL_SMALLINT:
+  *utype=UDT_INT;
+  *uitsz=2;
+  break;
+ case SQL_INTEGER:
+  *utype=UDT_INT;
+  *uitsz=4;
+  break;
+ case SQL_DECIMAL:
+ case SQL_NUMERIC:
+  *utype=UDT_INT|UD_PREC(prec);
+  *uitsz=8;
+  break;
+ case SQL_BIGINT:
+  *utype=UDT_INT;
+  *uitsz=8;
+  break;
+ case SQL_REAL:
+  *utype=UDT_REAL;
+  *uitsz=4;
+  break;
+ case SQL_FLOAT:
+ case SQL_DOUBLE:
+  *utype=UDT_REAL;
+  *uitsz=8;
+  break;
+ case SQL_TYPE_TIMESTAMP:
+ case SQL_TIMESTAMP:
+  *utype=UDT_DATETIME;
+  break;
+ case SQL_TYPE_DATE:
+ case SQL_DATE:
+  *utype=UDT_DATE;
+  break;
+ case SQL_TYPE_TIME:
+ case SQL_TIME:
+  *utype=UDT_TIME;
+  break;
+ default: //VARCHAR, LONGVARCHAR, W*, BINARY, GUID, ...
+  *utype=UDT_PSTR;
+ }
 }
 
 //.................................................................................................................................
@@ -139,11 +248,11 @@ for(;;)
  
  connstr+connopts;
  //connstr.show();
- ret=SQLDriverConnect(hdbc,hmwnd,(SQLCHAR*)connstr.pc,connstr.nc,(SQLCHAR*)Qbuf,sizeof(Qbuf),&rl,SQL_DRIVER_COMPLETE_REQUIRED);
+ ret=SQLDriverConnect(hdbc,hmwnd,(SQLCHAR*)connstr.pc,connstr.nc,(SQLCHAR*)Qbuf,sizeof(Qbuf),&rl,li->flags&ODBC_LOGON_NOUI?SQL_DRIVER_NOPROMPT:SQL_DRIVER_COMPLETE_REQUIRED);
  //printbox(Qbuf);
  if(ret==SQL_SUCCESS||ret==SQL_SUCCESS_WITH_INFO)
   break; //connected
- if(!li->UI())
+ if((li->flags&ODBC_LOGON_NOUI)||!li->UI())
   {
   connections=0;
   return 0; //failed
@@ -159,6 +268,7 @@ BOOL VODBC::Disconnect()
 {
 connections--;
 if(connections>0) return 1;
+Prepare(NULL);
 if(hstmt)
  {
  SQLFreeHandle(SQL_HANDLE_STMT,hstmt);
@@ -252,6 +362,18 @@ checkret("Query");
 return 1;
 }
 
+//nc chars of sql as they are, of any size (Qbuf keeps the start for messages).................................................................................................................................
+inline BOOL VODBC::QueryRaw(char*sql,NAT nc)
+{
+Qnc=MIN(nc,MAX_ODBC_QUERY_NC-1);
+CopyMemory(Qbuf,sql,Qnc);
+Qbuf[Qnc]=0;
+ret=SQLExecDirect(hstmt,(SQLCHAR*)sql,nc);
+if(ret==SQL_SUCCESS||ret==SQL_SUCCESS_WITH_INFO||ret==SQL_NO_DATA) return 1;
+checkret("Query %.4096s",Qbuf);
+return 0;
+}
+
 //.................................................................................................................................
 inline void VODBC::StartQuery()
 {
@@ -287,47 +409,301 @@ checkret("Query");
 return 1;
 }
 
-//.................................................................................................................................
+//get the results of the last query in a UTABLE (NULL: discard them).................................................................................................................................
 BOOL VODBC::QResult(UTABLE*ut=NULL)
 {
-//MYSQL_RES*myResult;
-//MYSQL_FIELD*fields;
-//MYSQL_ROW row;
-//NAT nrr,nrf;
-//int f,r;
-//DWORD*rownc;
-//if(!ut) mysql_free_result(mysql_use_result(mySQL));
-//myResult=mysql_store_result(mySQL);
-//if(!myResult)
-// {
-// ifer(mysql_field_count(mySQL),"Couldn't get result for: %s",myQuery);
-// return 0;
-// }
-//nrr=mysql_num_rows(myResult);
-//nrf=mysql_num_fields(myResult);
-//fields=mysql_fetch_fields(myResult);
-//BITS32 utype;
-//NAT uitsz;
-//if(!fields) return 0;
-//ut->Free();
-//for(f=0;f<nrf;f++)
-// {
-// UTYPE(fields[f].type,fields[f].decimals,fields[f].length,&utype,&uitsz);
-// ut->AddField(fields[f].name,utype,nrr,uitsz,fields[f].max_length*12);
-// } 
-//for(r=0;r<nrr;r++)
-// {
-// row=mysql_fetch_row(myResult);
-// if(!row) break;
-// rownc=mysql_fetch_lengths(myResult);
-// for(f=0;f<nrf;f++)
-//  {
-//  if(row[f]) ut->field[f].scan(r,row[f],rownc[f]);
-//  //ut->field[f].text(r,REGs,256);
-//  //printbox("%s",REGs);
-//  }
-// }
-//mysql_free_result(myResult);
+UTABLE batch;
+BOOL ok;
+if(!ut)
+ {
+ SQLCloseCursor(hstmt);
+ return 1;
+ }
+ut->Free(); //no rows of the last result, even if this one has none
+ok=QStream(&batch,0,USqlAppend,ut);
+if(!ut->nrfields) USqlLayout(ut,&batch); //empty result (no USqlAppend() call): the columns anyway
+return ok;
+}
+
+//unbound column f of the current row, of any length, by SQLGetData() into fs->buf: its chars (USQL_NULL: NULL) .........................................
+BOOL VOdbcLong(VODBC_FETCH*fs,NAT f,NAT*nc)
+{
+SQLLEN l;
+NAT got=0;
+for(;;)
+ {
+ if(fs->bufcap-got<2&&!ArrayCap((void**)&fs->buf,&fs->bufcap,MAX(2*got,VODBC_CELLMAX),1)) return 0;
+ fs->ret=SQLGetData(fs->hstmt,f+1,SQL_C_CHAR,fs->buf+got,fs->bufcap-got,&l);
+ if(fs->ret==SQL_NO_DATA) break; //all read by the calls before
+ if(fs->ret!=SQL_SUCCESS&&fs->ret!=SQL_SUCCESS_WITH_INFO) return 0;
+ if(l==SQL_NULL_DATA)
+  {
+  *nc=USQL_NULL;
+  return 1;
+  }
+ if(l!=SQL_NO_TOTAL&&l<(SQLLEN)(fs->bufcap-got))
+  {
+  got+=(NAT)l;
+  break;
+  }
+ got=fs->bufcap-1; //01004: cut, the rest comes with the next call
+ }
+fs->ret=SQL_SUCCESS;
+*nc=got;
+return 1;
+}
+
+//QStream() rows from the bound arrays, refilled by SQLFetchScroll() .................................................................................................................................
+NAT VOdbcFetch(USQL_RAW*raw,void*src)
+{
+VODBC_FETCH*fs=(VODBC_FETCH*)src;
+NAT f,nc,n=0;
+SQLLEN l;
+while(raw->nrrows<raw->cap)
+ {
+ if(fs->pos>=fs->fetched)
+  {
+  fs->pos=fs->fetched=0;
+  fs->ret=SQLFetchScroll(fs->hstmt,SQL_FETCH_NEXT,0);
+  if((fs->ret!=SQL_SUCCESS&&fs->ret!=SQL_SUCCESS_WITH_INFO)||!fs->fetched) break;
+  }
+ for(f=0;f<fs->nrf;f++)
+  {
+  if(f>=fs->nbound)
+   {
+   if(!VOdbcLong(fs,f,&nc)||!USqlRawCell(raw,nc==USQL_NULL?NULL:fs->buf,nc)) return n;
+   continue;
+   }
+  l=fs->ind[f][fs->pos];
+  if(l==SQL_NULL_DATA)
+   USqlRawCell(raw,NULL,0);
+  else if(!USqlRawCell(raw,fs->col[f]+fs->pos*fs->width[f],l<0||l>=fs->width[f]?fs->width[f]-1:(NAT)l)) //SQL_NO_TOTAL or cut
+   return n;
+  }
+ fs->pos++;
+ raw->nrrows++;
+ n++;
+ }
+return n;
+}
+
+//get the results of the last query in batches of rows, VODBC_ROWS rows per fetch .................................................................................................................................
+BOOL VODBC::QStream(UTABLE*ut,NAT batch,USQL_BATCHFN fn,void*ctx=NULL)
+{
+VODBC_FETCH fs;
+char cname[NAMESZ];
+SQLSMALLINT cnnc,dtype,cdec,cnull,nrf=0;
+SQLULEN csize;
+BITS32 utype;
+NAT uitsz,f,rows=VODBC_ROWS;
+BOOL ok=0,lng;
+if(!batch) batch=USQL_BATCH;
+ret=SQLNumResultCols(hstmt,&nrf);
+if(ret!=SQL_SUCCESS&&ret!=SQL_SUCCESS_WITH_INFO)
+ {
+ checkret("QStream");
+ return 0;
+ }
+if(nrf<=0) return 0;
+ZeroMemory(&fs,sizeof(fs));
+fs.hstmt=hstmt;
+fs.nrf=nrf;
+fs.col=(char**)ALLOC0(nrf*sizeof(char*));
+fs.ind=(SQLLEN**)ALLOC0(nrf*sizeof(SQLLEN*));
+fs.width=(NAT*)ALLOC0(nrf*sizeof(NAT));
+if(!fs.col||!fs.ind||!fs.width) goto LEnd;
+ut->Free();
+fs.nbound=nrf;
+for(f=0;f<nrf;f++)
+ {
+ ret=SQLDescribeCol(hstmt,f+1,(SQLCHAR*)cname,sizeof(cname),&cnnc,&dtype,&csize,&cdec,&cnull);
+ if(ret!=SQL_SUCCESS&&ret!=SQL_SUCCESS_WITH_INFO) goto LEnd;
+ lng=!csize||csize>VODBC_CELLMAX||dtype==SQL_LONGVARCHAR||dtype==SQL_WLONGVARCHAR||dtype==SQL_LONGVARBINARY;
+ if(lng) //varchar(max), text, ...: this column and the ones after by SQLGetData()
+  fs.nbound=MIN(fs.nbound,f);
+ UTYPE(dtype,cdec,(NAT)MIN(csize,(SQLULEN)VODBC_CELLMAX),&utype,&uitsz);
+ if(lng&&utype==UDT_STR)
+  {
+  utype=UDT_PSTR;
+  uitsz=0;
+  }
+ ut->AddField(cname,utype,batch,uitsz,0);
+ fs.width[f]=(NAT)MIN(csize,(SQLULEN)VODBC_CELLMAX)+32; //+sign, point and exponent of numbers
+ }
+if(fs.nbound<nrf)
+ rows=1; //SQLGetData() needs the row as current
+for(f=0;f<fs.nbound;f++)
+ {
+ fs.col[f]=(char*)ALLOC(rows*fs.width[f]);
+ fs.ind[f]=(SQLLEN*)ALLOC(rows*sizeof(SQLLEN));
+ if(!fs.col[f]||!fs.ind[f]) goto LEnd;
+ SQLBindCol(hstmt,f+1,SQL_C_CHAR,fs.col[f],fs.width[f],fs.ind[f]);
+ }
+SQLSetStmtAttr(hstmt,SQL_ATTR_ROW_BIND_TYPE,(SQLPOINTER)SQL_BIND_BY_COLUMN,0);
+SQLSetStmtAttr(hstmt,SQL_ATTR_ROW_ARRAY_SIZE,(SQLPOINTER)(SQLULEN)rows,0);
+SQLSetStmtAttr(hstmt,SQL_ATTR_ROWS_FETCHED_PTR,&fs.fetched,0);
+ok=USqlStream(ut,batch,VOdbcFetch,&fs,fn,ctx);
+if(fs.ret==SQL_ERROR)
+ {
+ ret=fs.ret;
+ checkret("Fetch");
+ ok=0;
+ }
+SQLSetStmtAttr(hstmt,SQL_ATTR_ROW_ARRAY_SIZE,(SQLPOINTER)1,0); //back to one row per fetch, unbound
+SQLSetStmtAttr(hstmt,SQL_ATTR_ROWS_FETCHED_PTR,NULL,0);
+LEnd:
+SQLFreeStmt(hstmt,SQL_UNBIND);
+SQLCloseCursor(hstmt);
+for(f=0;f<fs.nrf;f++)
+ {
+ if(fs.col) FREE(fs.col[f]);
+ if(fs.ind) FREE(fs.ind[f]);
+ }
+FREE(fs.col);
+FREE(fs.ind);
+FREE(fs.width);
+FREE(fs.buf);
+return ok;
+}
+
+//Prepare()d statements .................................................................................................................................
+//ExecuteBatch() binds column-wise parameter arrays (SQL_ATTR_PARAMSET_SIZE) of up to USQL_PARAMROWS rows, numbers in place
+//from the UTABLE; drivers without parameter arrays get one row per SQLExecute()
+
+//prepare a statement with ? parameters on hpstmt (NULL: release it) .................................................................................................................................
+BOOL VODBC::Prepare(char*sql=NULL)
+{
+SQLSMALLINT nrp=0;
+SQLULEN pset=0;
+if(hpstmt)
+ {
+ SQLFreeHandle(SQL_HANDLE_STMT,hpstmt);
+ hpstmt=NULL;
+ }
+USqlParamFree(param,nrparams);
+FREE(param);
+FREE(pind);
+nrparams=pindcap=0;
+if(!sql) return 1;
+ret=SQLAllocHandle(SQL_HANDLE_STMT,hdbc,&hpstmt);
+if(ret!=SQL_SUCCESS&&ret!=SQL_SUCCESS_WITH_INFO)
+ {
+ hpstmt=NULL;
+ return 0;
+ }
+ret=SQLPrepare(hpstmt,(SQLCHAR*)sql,SQL_NTS);
+if(ret==SQL_SUCCESS||ret==SQL_SUCCESS_WITH_INFO)
+ ret=SQLNumParams(hpstmt,&nrp);
+if(ret!=SQL_SUCCESS&&ret!=SQL_SUCCESS_WITH_INFO)
+ {
+ checkstmt(hpstmt,"Prepare %s",sql);
+ Prepare(NULL);
+ return 0;
+ }
+nrparams=nrp;
+param=(USQL_PARAM*)ALLOC0(nrparams*sizeof(USQL_PARAM)+1);
+if(!param)
+ {
+ Prepare(NULL);
+ return 0;
+ }
+SQLSetStmtAttr(hpstmt,SQL_ATTR_PARAM_BIND_TYPE,(SQLPOINTER)SQL_PARAM_BIND_BY_COLUMN,0);
+SQLSetStmtAttr(hpstmt,SQL_ATTR_PARAMSET_SIZE,(SQLPOINTER)USQL_PARAMROWS,0);
+SQLGetStmtAttr(hpstmt,SQL_ATTR_PARAMSET_SIZE,&pset,0,NULL); //changed by drivers without parameter arrays (01S02)
+prows=pset>1?MIN((NAT)pset,USQL_PARAMROWS):1;
+SQLSetStmtAttr(hpstmt,SQL_ATTR_PARAMSET_SIZE,(SQLPOINTER)1,0);
+return 1;
+}
+
+//bind the parameters to fields of ut: parameter i = field fields[i] (NULL: i), bit r of null[f]: item r is NULL .................................................................................................................................
+BOOL VODBC::Bind(UTABLE*ut,NAT*fields=NULL,BYTE**null=NULL)
+{
+if(!hpstmt) return 0;
+return USqlBind(param,nrparams,ut,fields,null);
+}
+
+//binds the packed rows [pr,pr+k) (rows [r,r+k) of the fields) of all parameters .................................................................................................................................
+BOOL VODBC::BindRows(NAT r,NAT pr,NAT k)
+{
+USQL_PARAM*p;
+SQLLEN*ind;
+SQLSMALLINT ctype,stype;
+SQLULEN csize;
+NAT i,j;
+for(i=0;i<nrparams;i++)
+ {
+ p=param+i;
+ ind=pind+i*prows;
+ for(j=0;j<k;j++)
+  ind[j]=p->len[pr+j]==USQL_NULL?SQL_NULL_DATA:(SQLLEN)p->len[pr+j];
+ csize=0;
+ switch(p->kind)
+  {
+  case UDK_I8: ctype=SQL_C_STINYINT; stype=SQL_TINYINT; break;
+  case UDK_U8: ctype=SQL_C_UTINYINT; stype=SQL_TINYINT; break;
+  case UDK_I16: ctype=SQL_C_SSHORT; stype=SQL_SMALLINT; break;
+  case UDK_U16: ctype=SQL_C_USHORT; stype=SQL_SMALLINT; break;
+  case UDK_I32: ctype=SQL_C_SLONG; stype=SQL_INTEGER; break;
+  case UDK_U32: ctype=SQL_C_ULONG; stype=SQL_BIGINT; break; //past INTEGER
+  case UDK_I64: ctype=SQL_C_SBIGINT; stype=SQL_BIGINT; break;
+  case UDK_U64: ctype=SQL_C_UBIGINT; stype=SQL_NUMERIC; csize=20; break; //past BIGINT
+  case UDK_F32: ctype=SQL_C_FLOAT; stype=SQL_REAL; break;
+  case UDK_F64: ctype=SQL_C_DOUBLE; stype=SQL_DOUBLE; break;
+  default: ctype=SQL_C_CHAR; stype=SQL_VARCHAR; //text, converted by the server
+  }
+ if(p->kind)
+  ret=SQLBindParameter(hpstmt,i+1,SQL_PARAM_INPUT,ctype,stype,csize,0,p->col->pb+r*p->col->itsz,p->col->itsz,ind); //in place
+ else
+  ret=SQLBindParameter(hpstmt,i+1,SQL_PARAM_INPUT,ctype,stype,MAX(p->width-1,1),0,p->txt+pr*p->width,p->width,ind);
+ if(ret!=SQL_SUCCESS&&ret!=SQL_SUCCESS_WITH_INFO)
+  {
+  checkstmt(hpstmt,"BindParameter %u",i+1);
+  return 0;
+  }
+ }
+return 1;
+}
+
+//execute the Prepare()d statement for the bound rows [from,from+n) .................................................................................................................................
+BOOL VODBC::ExecuteBatch(NAT from=0,NAT n=-1)
+{
+NAT rows,chunk,k,r,i;
+if(!hpstmt) return 0;
+if(!nrparams)
+ {
+ ret=SQLExecute(hpstmt);
+ if(ret!=SQL_SUCCESS&&ret!=SQL_SUCCESS_WITH_INFO&&ret!=SQL_NO_DATA)
+  checkstmt(hpstmt,"Execute"); //before SQLFreeStmt() clears the diagnostics
+ SQLFreeStmt(hpstmt,SQL_CLOSE);
+ return ret==SQL_SUCCESS||ret==SQL_SUCCESS_WITH_INFO||ret==SQL_NO_DATA;
+ }
+if(!param[0].col) return 0; //not bound
+rows=USqlParamRows(param,nrparams);
+if(from>=rows) return 1;
+n=MIN(n,rows-from);
+if(!ArrayCap((void**)&pind,&pindcap,nrparams*prows,sizeof(SQLLEN))) return 0;
+while(n)
+ {
+ chunk=MIN(n,USQL_PARAMROWS);
+ for(i=0;i<nrparams;i++) //long text can shorten the chunk
+  if(!(chunk=USqlParamPack(param+i,from,chunk))) return 0;
+ for(r=0;r<chunk;r+=k)
+  {
+  k=MIN(chunk-r,prows);
+  if(!BindRows(from+r,r,k)) return 0;
+  SQLSetStmtAttr(hpstmt,SQL_ATTR_PARAMSET_SIZE,(SQLPOINTER)(SQLULEN)k,0);
+  ret=SQLExecute(hpstmt);
+  if(ret!=SQL_SUCCESS&&ret!=SQL_SUCCESS_WITH_INFO&&ret!=SQL_NO_DATA)
+   {
+   checkstmt(hpstmt,"Execute rows %u-%u",from+r,from+r+k-1);
+   SQLFreeStmt(hpstmt,SQL_CLOSE);
+   return 0;
+   }
+  SQLFreeStmt(hpstmt,SQL_CLOSE); //results of row counts, if any
+  }
+ from+=chunk;
+ n-=chunk;
+ }
 return 1;
 }
 
@@ -425,6 +801,16 @@ if(l) MessageBox(hmwnd,lsbuf,Qbuf,MB_OK);
 FREE(lsbuf);
 }
 
+//the driver hasn't seen the connection drop (SQL_ATTR_CONNECTION_DEAD, no round trip) .................................................................................................................................
+BOOL VODBC::Ping()
+{
+SQLUINTEGER dead=SQL_CD_TRUE;
+if(!hdbc) return 0;
+ret=SQLGetConnectAttr(hdbc,SQL_ATTR_CONNECTION_DEAD,&dead,0,NULL);
+if(ret!=SQL_SUCCESS&&ret!=SQL_SUCCESS_WITH_INFO) return 1; //ODBC<3.5 driver: can't tell
+return dead==SQL_CD_FALSE;
+}
+
 //.................................................................................................................................
 void VODBC::Info()
 {
@@ -4,7 +4,9 @@
 #include <io.cpp>
 
 #define VSTR_CONST			0x8000	//or external (no free)
+#define VSTR_LOCAL			0x4000	//short string kept in sbo[] (no heap block)
 #define VSTR_SELECTED		0x0100
+#define VSTR_SBO			24		//inline buffer: strings up to 23 chars don't allocate
 
 //<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 #pragma pack(push,default_pack)
@@ -21,17 +23,99 @@ public:
  DWORD nc;
  WORD stat; //state
  WORD f; //flags 
+ union
+  {
+  DWORD cap; //heap block size (appends grow it geometrically)
+  char sbo[VSTR_SBO]; //VSTR_LOCAL text
+  };
 #pragma pack(pop,default_pack)
  VSTR() { ZeroMemory(this,sizeof(VSTR)); }   //zero
  ~VSTR() { Free(); } //copy size
- void Free() { if(!(f&VSTR_CONST)) FREE(pc); nc=0; f=0; }
+ void Free() { if(!(f&(VSTR_CONST|VSTR_LOCAL))) FREE(pc); pc=NULL; nc=0; f=0; }
  
+ //text; a VSTR_LOCAL string moved with its array (REALLOC, ShiftMem) gets pc back here ..............
+ char* str()
+  {
+  if(f&VSTR_LOCAL) pc=sbo;
+  return pc;
+  }
+ //storage for lnc chars+0, keep: with the current text ..............................................
+ //appends double the block, assignments reuse it unless it is much bigger than needed
+ char* room(NAT lnc,BOOL keep=1)
+  {
+  char*old=str(),*np;
+  BOOL own=old&&!(f&(VSTR_CONST|VSTR_LOCAL));
+  NAT lcap;
+  if(lnc<VSTR_SBO&&!(own&&keep)) //short: inline
+   {
+   if(keep&&old&&old!=sbo) CopyMem(sbo,old,MIN(nc,lnc));
+   if(own) FREE(old);
+   pc=sbo;
+   f=(f&~VSTR_CONST)|VSTR_LOCAL;
+   return pc;
+   }
+  if(own&&lnc<cap&&(keep||cap<=2*(lnc+VSTR_SBO))) return pc;
+  lcap=lnc+1;
+  if(keep) lcap=MAX(lcap,2*(own?cap:VSTR_SBO));
+  if(own&&keep)
+   {
+   np=(char*)REALLOC(old,lcap);
+   if(!np) FREE(old);
+   }
+  else
+   {
+   np=(char*)ALLOC(lcap);
+   if(np&&keep&&old) CopyMem(np,old,MIN(nc,lnc));
+   if(own) FREE(old);
+   }
+  f&=~(VSTR_CONST|VSTR_LOCAL);
+  pc=np;
+  if(!np)
+   {
+   nc=0;
+   return NULL;
+   }
+  cap=lcap;
+  return pc;
+  }
  //....................................................................................................
- operator char*() //char*,LPSTR
+ char* reserve(NAT lnc) //room for lnc chars, without reallocations until then
   {
+  if(!room(MAX(lnc,nc))) return NULL;
+  pc[nc]=0;
   return pc;
   }
  //....................................................................................................
+ NAT capacity() //chars that fit without a reallocation
+  {
+  if(f&VSTR_CONST) return nc;
+  if(f&VSTR_LOCAL) return VSTR_SBO-1;
+  return pc?cap-1:0;
+  }
+ //gives back the unused part of the block ...........................................................
+ void shrink()
+  {
+  char*old=pc;
+  if(f&(VSTR_CONST|VSTR_LOCAL)||!pc) return;
+  if(nc<VSTR_SBO)
+   {
+   CopyMem(sbo,old,nc+1);
+   FREE(old);
+   pc=sbo;
+   f|=VSTR_LOCAL;
+   }
+  else if(cap>nc+1&&(old=(char*)REALLOC(pc,nc+1)))
+   {
+   pc=old;
+   cap=nc+1;
+   }
+  }
+ //....................................................................................................
+ operator char*() //char*,LPSTR
+  {
+  return str();
+  }
+ //....................................................................................................
  operator NAT() //NAT
   {
   return nc;
@@ -45,11 +129,9 @@ public:
  char* operator =(char*lstr) //copy
   {
   if(!lstr) return NULL;
-  nc=sl(lstr);
-  if(!(f&VSTR_CONST)) FREE(pc);
-  pc=SALLOC(nc);
-  f&=~VSTR_CONST;
-  if(!pv) return NULL;
+  NAT l=sl(lstr);
+  if(!room(l,0)) return NULL;
+  nc=l;
   CopyMem(pv,lstr,nc);
   pc[nc]=0;
   return pc;
@@ -64,11 +146,9 @@ public:
  char* operator +(char*lstr) //copy
   {
   NAT l;
-  if((!lstr)||(f&VSTR_CONST)) return pc;
+  if((!lstr)||(f&VSTR_CONST)) return str();
   l=sl(lstr);
-  f&=~VSTR_CONST;
-  pv=REALLOC(pv,nc+l+1);
-  if(!pv) return NULL;
+  if(!room(nc+l)) return NULL;
   CopyMem(pc+nc,lstr,l);
   nc+=l;
   pc[nc]=0;
@@ -77,11 +157,9 @@ public:
  //....................................................................................................
  char* operator =(HWND hwnd) //=HWND
   {
-  if(!(f&VSTR_CONST)) FREE(pc);
-  nc=GetWindowTextLength(hwnd);
-  pc=SALLOC(nc);
-  if(!pv) return NULL;
-  f&=~VSTR_CONST;
+  NAT l=GetWindowTextLength(hwnd);
+  if(!room(l,0)) return NULL;
+  nc=l;
   GetWindowText(hwnd,pc,nc+1);
   return pc;
   }
@@ -91,9 +169,7 @@ public:
   NAT l;
   if(f&VSTR_CONST) return pc;
   l=GetWindowTextLength(hwnd);
-  f&=~VSTR_CONST;
-  pv=REALLOC(pv,nc+l+1);
-  if(!pv) return NULL;
+  if(!room(nc+l)) return NULL;
   GetWindowText(hwnd,pc+nc,l+1);
   nc+=l;
   return pc;
@@ -101,16 +177,13 @@ public:
  //....................................................................................................
  void operator ()(HWND hwnd) //=HWND
   {
-  SetWindowText(hwnd,pc);
+  SetWindowText(hwnd,str());
   }
  //....................................................................................................
  char* alloc(NAT lsize=0) //copy size
   {
+  if(!room(lsize,0)) return NULL;
   nc=lsize;
-  if(!(f&VSTR_CONST)) FREE(pc);
-  pc=SALLOC(nc);
-  f&=~VSTR_CONST;
-  if(!pv) return NULL;
   *pc=0;
   return pc;
   }
@@ -118,11 +191,9 @@ public:
  char* copy(char*lstr,NAT lsize=0) //copy size
   {
   if(!lstr) return NULL;
-  nc=lsize?lsize:sl(lstr);
-  if(!(f&VSTR_CONST)) FREE(pc);
-  pc=SALLOC(nc);
-  f&=~VSTR_CONST;
-  if(!pv) return NULL;
+  if(!lsize) lsize=sl(lstr);
+  if(!room(lsize,0)) return NULL;
+  nc=lsize;
   CopyMem(pv,lstr,nc);
   pc[nc]=0;
   return pc;
@@ -131,8 +202,8 @@ public:
  char* bind(char*lstr,NAT lsize=0) //bind
   {
   if(!lstr) return NULL;
-  if(!(f&VSTR_CONST)) FREE(pc);
-  f|=VSTR_CONST;
+  if(!(f&(VSTR_CONST|VSTR_LOCAL))) FREE(pc);
+  f=(f&~VSTR_LOCAL)|VSTR_CONST;
   pc=lstr;
   nc=lsize?lsize:sl(pc);
   return pc;
@@ -140,10 +211,8 @@ public:
  //concatenate....................................................................................................
  char* ccat(char*lstr,NAT lsize=0) //copy
   {
-  if((!lstr)||(!lsize)||(f&VSTR_CONST)) return pc;
-  f&=~VSTR_CONST;
-  pv=REALLOC(pv,nc+lsize+1);
-  if(!pv) return NULL;
+  if((!lstr)||(!lsize)||(f&VSTR_CONST)) return str();
+  if(!room(nc+lsize)) return NULL;
   CopyMem(pc+nc,lstr,lsize);
   nc+=lsize;
   pc[nc]=0;
@@ -155,8 +224,7 @@ public:
   if(f&VSTR_CONST) return;  //can't insert in const char
   if(pos>nc) pos=nc;
   if(!lsize) lsize=sl(lstr);
-  pv=REALLOC(pv,nc+lsize+1);
-  if(!pv) return;
+  if(!room(nc+lsize)) return;
   ShiftMemR(pc+pos,lsize,nc-pos);
   CopyMem(pc+pos,lstr,lsize);
   nc+=lsize;
@@ -189,6 +257,6 @@ public:
  //....................................................................................................
  void show(char*title=NULL)
   {
-  MessageBox(hmwnd,pc,title?title:"VSTR",MB_OK);
+  MessageBox(hmwnd,str(),title?title:"VSTR",MB_OK);
   } 
 };
@@ -2,12 +2,14 @@
 
 #include <str.cpp>
 #include <io.cpp>
+#include <parallel.cpp>
 
 
 //<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 //CString like class ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #define VCHARS_CONST		0x1	//prevent memory deallocation
 #define VCHARS_SELECTED     0x2 //select flag (used in an array of these)
+#define VCHARS_CAP			0xff000000 //log2 of the block size once ins() grew it (0: exact, sz+1)
 class VCHARS
 {
 public:
@@ -21,7 +23,8 @@ public:
 
  VCHARS() { ZEROCLASS(VCHARS); }   //zero
  ~VCHARS() { Free(); } //copy size
- void Free() { sz=0; if(!(f&VCHARS_CONST)) FREE(pc); }
+ void Free() { sz=0; if(!(f&VCHARS_CONST)) FREE(pc); f&=~VCHARS_CAP; }
+ NAT capacity() { return f&VCHARS_CAP?(1u<<(f>>24))-1:sz; } //chars that fit without a reallocation
 //copy string.......................................................................... 
  char* operator =(char*lstr)
   {
@@ -29,7 +32,7 @@ public:
   sz=sl(lstr);
   if(!(f&VCHARS_CONST)) FREE(pc);
   pc=SALLOC(sz);
-  f&=~VCHARS_CONST;
+  f&=~(VCHARS_CONST|VCHARS_CAP);
   if(!pv) return NULL;
   CopyMem(pv,lstr,sz);
   pc[sz]=0;
@@ -40,18 +43,25 @@ public:
   {
   sz=lsize;
   pc=SALLOC(sz);
-  f&=~VCHARS_CONST;
+  f&=~(VCHARS_CONST|VCHARS_CAP);
   if(!pv) return;
   CopyMem(pv,lstr,sz);
   pc[sz]=0;
   }
 //insert sting:lstr of size:lsize at position:pos .......................................................................... 
+//the block grows to powers of 2, so building a line by inserts reallocates O(log n) times
  void ins(int pos,char*lstr,NAT lsize=0)
   {
   if(f&VCHARS_CONST) return;  //can't insert in const char
   if(pos>sz) pos=sz;
   if(!lsize) lsize=sl(lstr);
-  pv=REALLOC(pv,sz+lsize+1);
+  if(sz+lsize>capacity())
+   {
+   DWORD e=4;
+   while((1u<<e)<sz+lsize+1) e++;
+   pv=REALLOC(pv,1u<<e);
+   if(pv) f=(f&~VCHARS_CAP)|e<<24;
+   }
   if(!pv) return;
   ShiftMemR(pc+pos,lsize,sz-pos);
   CopyMem(pc+pos,lstr,lsize);
@@ -66,6 +76,9 @@ public:
 };
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>> 
 //text file parser ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#define VTEXT_VIEW		0x2 //Mem() flag: lines point into the caller's buffer (kept alive by the caller)
+#define VTEXT_PARCHUNK	(16<<20) //Index() gives each thread at least this many bytes
+#define VTEXT_SCANMAX	0x7fffffff //bytes per s_seq call: offsets from 0x80000000 up read as R_NULL
 class VText
 {
 public:
@@ -75,13 +88,28 @@ public:
  char*sep; //separator between lines (must be a const)
  int sepnc; //length of separator
  int ctxbeg,ctxend; //range of active lines
+ char*map; //Map(): read only view of the file, the lines are VCHARS_CONST views into it
+ size_t mapsz;
+ char*keylead; //KeyIndex(): labels are looked up at the line key, after these chars (NULL=anywhere)
+ NAT*keyord; //lines sorted by key, built on the first lookup (NULL=to build)
+ NAT*keyhit,nrkeyhit; //lines (ascending) whose key starts with keylab, the last label looked up
+ char*keylab;
+ NAT keylabnc;
  
  VText() { ZEROCLASS(VText); }
  ~VText() { Free(); }
  void Free();
  NAT Add(char*,NAT);
+ NAT Index(char*,size_t,NAT);
  BOOL Mem(char*,NAT,char*,DWORD);
  BOOL Load(char*,char*,DWORD,char*,NAT);
+ BOOL Map(char*,char*,char*,NAT,NAT);
+ void KeyIndex(char*);
+ NAT KeyPos(NAT);
+ int KeyCmp(NAT,char*,NAT);
+ void KeyBuild();
+ void KeyFree();
+ NAT Find(char*,NAT,NAT,NAT,BOOL,NAT*);
  BOOL Save(char*,char*,DWORD);
  void SelectAll();
  void Unselect();
@@ -114,12 +142,20 @@ for(NAT l=0;l<nrlines;l++)
  line[l].Free();
  }
 FREE(line);
+KeyFree();
 nrlines=ctxbeg=ctxend=0;
+if(map)
+ {
+ UnmapViewOfFile(map);
+ map=NULL;
+ mapsz=0;
+ }
 }
 
 //add line at the end.......................................................................................................................
 inline NAT VText::Add(char*lline,NAT llinesz=0)
 {
+KeyFree();
 if(ctxend==nrlines) ctxend++;
 nrlines++;
 line=(VCHARS*)REALLOC(line,nrlines*sizeof(VCHARS));
@@ -127,10 +163,151 @@ line[nrlines-1].copy(lline,llinesz);
 return 1;
 }
 
+//line index ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//counts (line==NULL) or records the separators starting in buf[a..b); separator k starts line k+1,
+//recorded as line[k+1].pc. A separator that cannot overlap itself (no border, like "\n" or "\r\n")
+//makes every occurrence a split, so the chunks can be scanned independently ...........................
+NAT VTextScan(const char*buf,size_t a,size_t b,size_t sz,const char*sep,NAT sepnc,VCHARS*line)
+{
+NAT n=0;
+size_t i=a,last;
+if(sz<sepnc) return 0;
+last=MIN(b,sz-sepnc+1); //candidates i<last
+#if defined(VSIMD_AVX2)
+if(SimdCPU()&SIMD_CPU_AVX2)
+ {
+ __m256i vf=_mm256_set1_epi8(sep[0]),vl=_mm256_set1_epi8(sep[sepnc-1]);
+ for(;i+32<=last;i+=32)
+  {
+  NAT m=(NAT)_mm256_movemask_epi8(_mm256_and_si256(
+   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(buf+i)),vf),
+   _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(buf+i+sepnc-1)),vl)));
+  for(;m;m&=m-1)
+   {
+   size_t p=i+MemLSB(m);
+   if(sepnc>2&&memcmp(buf+p+1,sep+1,sepnc-2)) continue;
+   if(line) line[n+1].pc=(char*)buf+p+sepnc;
+   n++;
+   }
+  }
+ }
+#endif
+for(;i<last;i++)
+ if(buf[i]==sep[0]&&!memcmp(buf+i+1,sep+1,sepnc-1))
+  {
+  if(line) line[n+1].pc=(char*)buf+i+sepnc;
+  n++;
+  }
+return n;
+}
+
+//a separator with a border ("--", "abab") can match overlapping itself
+inline BOOL VTextSelfOverlap(const char*sep,NAT sepnc)
+{
+for(NAT k=1;k<sepnc;k++)
+ if(!memcmp(sep,sep+k,sepnc-k)) return 1;
+return 0;
+}
+
+struct VTEXT_INDEX
+{
+ const char*buf;
+ size_t sz;
+ const char*sep;
+ NAT sepnc;
+ NAT*cnt; //separators per chunk, then the first one of the chunk
+ VCHARS*line; //first new line
+ NAT nrl; //new lines
+};
+
+void VTextIndexCount(void*ctx,NAT t,NAT nt)
+{
+VTEXT_INDEX*x=(VTEXT_INDEX*)ctx;
+x->cnt[t]=VTextScan(x->buf,x->sz/nt*t,t+1<nt?x->sz/nt*(t+1):x->sz,x->sz,x->sep,x->sepnc,NULL);
+}
+
+void VTextIndexFill(void*ctx,NAT t,NAT nt)
+{
+VTEXT_INDEX*x=(VTEXT_INDEX*)ctx;
+VTextScan(x->buf,x->sz/nt*t,t+1<nt?x->sz/nt*(t+1):x->sz,x->sz,x->sep,x->sepnc,x->line+x->cnt[t]);
+}
+
+void VTextIndexSize(void*ctx,NAT t,NAT nt) //line k ends where separator k starts
+{
+VTEXT_INDEX*x=(VTEXT_INDEX*)ctx;
+NAT k=(NAT)((QWORD)x->nrl*t/nt),e=(NAT)((QWORD)x->nrl*(t+1)/nt);
+for(;k<e;k++)
+ {
+ const char*end=k+1<x->nrl?x->line[k+1].pc-x->sepnc:x->buf+x->sz;
+ x->line[k].sz=(int)(end-x->line[k].pc);
+ x->line[k].f=VCHARS_CONST|VCHARS_SELECTED;
+ }
+}
+
+//appends the lines of buf as VCHARS_CONST views (buf must outlive them); splits like Mem() did with
+//s_seq, one allocation for the index, nthreads scan big buffers in parallel (0=processors) ..............
+NAT VText::Index(char*buf,size_t sz,NAT nthreads=0)
+{
+VTEXT_INDEX x;
+NAT nt=1,t,c,l,old=nrlines;
+size_t p;
+if(!sep) return error("No separator in VText::Index()");
+BOOL all=!VTextSelfOverlap(sep,sepnc); //every occurrence splits: chunks are independent
+x.buf=buf;
+x.sz=sz;
+x.sep=sep;
+x.sepnc=sepnc;
+if(all)
+ {
+ nt=nthreads?nthreads:ParThreads();
+ nt=(NAT)MAX(MIN((size_t)nt,sz/VTEXT_PARCHUNK),1);
+ }
+x.cnt=ALLOC_NAT(nt);
+if(!x.cnt) return 0;
+SimdCPU(); //before the threads read it
+x.nrl=1;
+if(all)
+ {
+ ParRun(VTextIndexCount,&x,nt);
+ for(t=0;t<nt;t++) //prefix sums
+  {
+  c=x.cnt[t];
+  x.cnt[t]=x.nrl-1;
+  x.nrl+=c;
+  }
+ }
+else //leftmost, non overlapping matches like s_seq
+ for(p=0;p<sz&&(l=s_seq(buf+p,sep,sepnc,(NAT)MIN(sz-p,(size_t)VTEXT_SCANMAX)))!=R_NULL;p+=l+sepnc)
+  x.nrl++;
+VCHARS*nl=(VCHARS*)REALLOC(line,(old+x.nrl)*sizeof(VCHARS));
+if(!nl)
+ {
+ FREE(x.cnt);
+ return error("VText::Index() out of memory");
+ }
+line=nl;
+KeyFree();
+x.line=line+old;
+x.line[0].pc=buf;
+if(all)
+ ParRun(VTextIndexFill,&x,nt);
+else
+ for(p=0,c=1;p<sz&&(l=s_seq(buf+p,sep,sepnc,(NAT)MIN(sz-p,(size_t)VTEXT_SCANMAX)))!=R_NULL;)
+  {
+  p+=l+sepnc;
+  x.line[c++].pc=buf+p;
+  }
+ParRun(VTextIndexSize,&x,x.nrl>=(1<<20)?nt:1);
+if(ctxend==(int)nrlines) ctxend+=x.nrl;
+nrlines+=x.nrl;
+FREE(x.cnt);
+return x.nrl;
+}
+
 //initilize from a text buffer in memory..........................................................................................................................
 BOOL VText::Mem(char*fbuf,NAT fsz,char*lsep,DWORD flags=0)
-{ //flags: b0=remove empty lines (TODO)
-NAT l,p=0;
+{ //flags: b0=remove empty lines (TODO), VTEXT_VIEW=lines point into fbuf instead of copies
+NAT old=nrlines;
 if(lsep)
  {
  sep=lsep;
@@ -138,13 +315,10 @@ if(lsep)
  }
 if(!fbuf) return 0;
 if(!sep) return error("No separator in VText::Load()");
-do{
- l=s_seq(fbuf+p,sep,sepnc,fsz-p);
- if(l==R_NULL) break;
- Add(fbuf+p,l);
- p+=l+sepnc;
- }while(p<fsz);
-Add(fbuf+p,fsz-p);
+Index(fbuf,fsz);
+if(!(flags&VTEXT_VIEW))
+ for(NAT l=old;l<nrlines;l++)
+  line[l].copy(line[l].pc,line[l].sz);
 SelectAll();
 return nrlines;
 }
@@ -172,6 +346,45 @@ FREE(fbuf);
 return nrlines;
 }
 
+//map a file read only and index its lines, optionaly starting with "label"; lines are views into the
+//mapping, nothing is copied (for big text dumps), so there are no Mem() flags. Replaces the current lines ...
+BOOL VText::Map(char*path,char*lsep=NULL,char*label=NULL,NAT labelnc=0,NAT nthreads=0)
+{
+HANDLE hf,hm;
+LARGE_INTEGER fsz;
+size_t p=0;
+Free();
+if(lsep)
+ {
+ sep=lsep;
+ sepnc=sl(sep);
+ }
+if(!sep) return error("No separator in VText::Map()");
+hf=CreateFile(path,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,NULL);
+if(hf==INVALID_HANDLE_VALUE) return 0;
+if(!GetFileSizeEx(hf,&fsz)||!fsz.QuadPart||(QWORD)fsz.QuadPart>(QWORD)(size_t)-1)
+ {
+ CloseHandle(hf);
+ return 0;
+ }
+hm=CreateFileMapping(hf,NULL,PAGE_READONLY,0,0,NULL);
+CloseHandle(hf);
+if(!hm) return error("VText::Map() couldn't map the file");
+map=(char*)MapViewOfFile(hm,FILE_MAP_READ,0,0,0); //the view keeps the mapping open
+CloseHandle(hm);
+if(!map) return error("VText::Map() couldn't map the file");
+mapsz=(size_t)fsz.QuadPart;
+if(label)
+ {
+ if(!labelnc) labelnc=sl(label);
+ p=s_seqI(map,label,labelnc,(NAT)MIN(mapsz,(size_t)VTEXT_SCANMAX));
+ if(p==R_NULL)
+  return error("VText::Map() couldn't find trim string in file !!!");
+ }
+Index(map+p,mapsz-p,nthreads);
+return nrlines;
+}
+
 //save in a text file...................................................................................................................
 BOOL VText::Save(char*path,char*lterm=NULL,DWORD flags=0)
 {
@@ -190,6 +403,184 @@ for(NAT l=0;l<nrlines;l++)
 return nrlines;
 }
 
+//keyed lookups ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//lookups by label (GetINT, GetSTR, SelectC, Context...) scan every line with s_seqI. For reports and
+//configs where each line starts with its label, KeyIndex(lead) makes them match the label only at the
+//line key (after the lead chars, ex " \t") through an index sorted by key: O(log n) per lookup.
+//The index is built on the first lookup and dropped by Add/Mem/Map; KeyIndex(NULL) goes back to scans
+void VText::KeyIndex(char*lead=" \t")
+{
+keylead=lead;
+KeyFree();
+}
+
+//drops the index (the lines changed) ...........................................................................................................
+void VText::KeyFree()
+{
+FREE(keyord);
+FREE(keyhit);
+FREE(keylab);
+nrkeyhit=keylabnc=0;
+}
+
+//offset of the key in line l ...................................................................................................................
+inline NAT VText::KeyPos(NAT l)
+{
+NAT p=0;
+while(p<(NAT)line[l].sz&&line[l].pc[p]&&strchr(keylead,line[l].pc[p])) p++;
+return p;
+}
+
+//key of line l against the first n chars of key (ASCII case insensitive), 0: the key starts with it ....
+int VText::KeyCmp(NAT l,char*key,NAT n)
+{
+NAT p=KeyPos(l),c;
+for(c=0;c<n;c++,p++)
+ {
+ if(p>=(NAT)line[l].sz) return -1;
+ char a=StrFold(line[l].pc[p]),b=StrFold(key[c]);
+ if(a!=b) return (BYTE)a<(BYTE)b?-1:1;
+ }
+return 0;
+}
+
+//sorts the lines by key (merge sort, equal keys stay in line order); the runs carry the first 8 folded
+//key chars so most compares don't touch the lines .................................................................................
+struct VTEXT_KEY
+{
+ QWORD pre; //first 8 chars of the key, folded, big endian (shorter keys padded with 0)
+ NAT l,kp; //line, key offset
+};
+
+void VText::KeyBuild()
+{
+NAT n=nrlines,w,i,a,b,m,e,k,c,na,nb;
+KeyFree();
+keyord=ALLOC_NAT(n);
+VTEXT_KEY*run=(VTEXT_KEY*)ALLOC(n*sizeof(VTEXT_KEY)),*tmp=(VTEXT_KEY*)ALLOC(n*sizeof(VTEXT_KEY)),*t;
+if(!keyord||!run||!tmp)
+ {
+ FREE(keyord);
+ FREE(run);
+ FREE(tmp);
+ return;
+ }
+for(i=0;i<n;i++)
+ {
+ run[i].l=i;
+ run[i].kp=KeyPos(i);
+ run[i].pre=0;
+ for(c=0;c<8;c++)
+  run[i].pre=run[i].pre<<8|(run[i].kp+c<(NAT)line[i].sz?(BYTE)StrFold(line[i].pc[run[i].kp+c]):0);
+ }
+for(w=1;w<n;w*=2)
+ {
+ for(i=0;i<n;i+=2*w)
+  {
+  a=i;
+  m=b=MIN(i+w,n);
+  e=MIN(i+2*w,n);
+  for(k=i;k<e;k++)
+   {
+   BOOL first=a<m; //run[a] goes first unless run[b]'s key is smaller
+   if(first&&b<e)
+    {
+    if(run[a].pre!=run[b].pre)
+     first=run[a].pre<run[b].pre;
+    else
+     {
+     char*pa=line[run[a].l].pc+run[a].kp,*pb=line[run[b].l].pc+run[b].kp;
+     na=line[run[a].l].sz-run[a].kp;
+     nb=line[run[b].l].sz-run[b].kp;
+     for(c=8;c<na&&c<nb&&StrFold(pa[c])==StrFold(pb[c]);c++);
+     first=c<na&&c<nb?(BYTE)StrFold(pa[c])<(BYTE)StrFold(pb[c]):c>=na;
+     }
+    }
+   tmp[k]=first?run[a++]:run[b++];
+   }
+  }
+ t=run; run=tmp; tmp=t;
+ }
+for(i=0;i<n;i++)
+ keyord[i]=run[i].l;
+FREE(run);
+FREE(tmp);
+}
+
+//first line in [l,end) holding label (only selected lines if sel), *pos=label offset in the line; end if
+//none. Keyed (KeyIndex) the label must start the line key ..........................................................................
+NAT VText::Find(char*label,NAT labelnc,NAT l,NAT end,BOOL sel,NAT*pos)
+{
+if(end>nrlines) end=nrlines;
+if(keylead)
+ {
+ NAT lo=0,hi,m;
+ if(!keyord) KeyBuild();
+ if(!keyord) return end;
+ if(!keylab||keylabnc!=labelnc||StrFind(keylab,labelnc,label,labelnc,1)) //new label: its hits in line order
+  {
+  FREE(keyhit);
+  FREE(keylab);
+  for(lo=0,hi=nrlines;lo<hi;) //first key >= label
+   {
+   m=(lo+hi)/2;
+   if(KeyCmp(keyord[m],label,labelnc)<0) lo=m+1;
+   else hi=m;
+   }
+  for(hi=lo;hi<nrlines&&!KeyCmp(keyord[hi],label,labelnc);hi++); //keys starting with label
+  nrkeyhit=hi-lo;
+  keyhit=ALLOC_NAT(nrkeyhit+1);
+  keylab=SALLOC(labelnc);
+  if(!keyhit||!keylab)
+   {
+   KeyFree();
+   return end;
+   }
+  CopyMemory(keylab,label,labelnc);
+  keylabnc=labelnc;
+  if(nrkeyhit<=64) //few: insertion sort
+   for(NAT i=0,j;i<nrkeyhit;i++)
+    {
+    for(j=i;j&&keyhit[j-1]>keyord[lo+i];j--) keyhit[j]=keyhit[j-1];
+    keyhit[j]=keyord[lo+i];
+    }
+  else //many: through a bitmap of the lines
+   {
+   NAT nw=nrlines/32+1,*bit=ALLOC_NAT(nw),i=0;
+   if(!bit)
+    {
+    KeyFree();
+    return end;
+    }
+   ZeroMemory(bit,nw*sizeof(NAT));
+   for(m=lo;m<hi;m++)
+    bit[keyord[m]/32]|=1u<<(keyord[m]%32);
+   for(m=0;m<nw;m++)
+    for(NAT w=bit[m];w;w&=w-1)
+     keyhit[i++]=m*32+MemLSB(w);
+   FREE(bit);
+   }
+  }
+ for(lo=0,hi=nrkeyhit;lo<hi;) //first hit >= l
+  {
+  m=(lo+hi)/2;
+  if(keyhit[m]<l) lo=m+1;
+  else hi=m;
+  }
+ for(;lo<nrkeyhit&&keyhit[lo]<end;lo++)
+  if(!sel||line[keyhit[lo]].f&VCHARS_SELECTED)
+   {
+   *pos=KeyPos(keyhit[lo]);
+   return keyhit[lo];
+   }
+ return end;
+ }
+for(;l<end;l++)
+ if(!sel||line[l].f&VCHARS_SELECTED)
+  if((*pos=s_seqI(line[l].pc,label,labelnc,line[l].sz))!=R_NULL) return l;
+return end;
+}
+
 //mark all lines as selected  ..................................................................................................................
 inline void VText::SelectAll()
 {
@@ -218,16 +609,12 @@ int VText::SelectC(char*label,NAT labelnc=0)
 NAT p;
 int match=0;
 if(!labelnc) labelnc=sl(label);
-for(NAT l=0;l<nrlines;l++)
+Unselect();
+for(NAT l=Find(label,labelnc,0,nrlines,0,&p);l<nrlines;l=Find(label,labelnc,l+1,nrlines,0,&p))
  {
- line[l].f&=~VCHARS_SELECTED;
- p=s_seqI(line[l].pc,label,labelnc,line[l].sz);
- if(p!=R_NULL)
-  {
-  line[l].f|=VCHARS_SELECTED;
-  match++;
-  //line[l].show();
-  }
+ line[l].f|=VCHARS_SELECTED;
+ match++;
+ //line[l].show();
  }
 return match;
 }
@@ -238,18 +625,14 @@ int VText::SelectAX(int labelind,char*label,NAT labelnc=0)
 NAT p;
 int match=0;
 if(!labelnc) labelnc=sl(label);
-for(NAT l=0;l<nrlines;l++)
+Unselect();
+for(NAT l=Find(label,labelnc,0,nrlines,0,&p);l<nrlines;l=Find(label,labelnc,l+1,nrlines,0,&p))
  {
- line[l].f&=~VCHARS_SELECTED;
- p=s_seqI(line[l].pc,label,labelnc,line[l].sz);
- if(p!=R_NULL)
+ if(StoI(line[l].pc+p+labelnc,10,NULL,line[l].sz-p-labelnc)==labelind)
   {
-  if(StoI(line[l].pc+p+labelnc,10,NULL,line[l].sz)==labelind)
-   {
-   line[l].f|=VCHARS_SELECTED;
-   match++;
-   //line[l].show();
-   }
+  line[l].f|=VCHARS_SELECTED;
+  match++;
+  //line[l].show();
   }
  }
 return match;
@@ -260,15 +643,8 @@ int VText::Context(char*context,NAT contextnc=0)
 {
 NAT p;
 if(!contextnc) contextnc=sl(context);
-for(NAT l=0;l<nrlines;l++)
- {
- p=s_seqI(line[l].pc,context,contextnc,line[l].sz);
- if(p!=R_NULL)
-  {
-  return l;
-  }
- } 
-return -1;
+NAT l=Find(context,contextnc,0,nrlines,0,&p);
+return l<nrlines?(int)l:-1;
 }
 
 //get number preceded by label (ex: "System ID #0345" returns 345)  ...................................................................................................................
@@ -276,17 +652,9 @@ int VText::GetINT(char*label,NAT labelnc=0)
 {//uses selection
 NAT p;
 if(!labelnc) labelnc=sl(label);
-for(NAT l=ctxbeg;l<ctxend;l++)
- {
- if(line[l].f&VCHARS_SELECTED)
-  {
-  p=s_seqI(line[l].pc,label,labelnc,line[l].sz);
-  if(p!=R_NULL)
-   {
-   return StoI(line[l].pc+p+labelnc,10,NULL,line[l].sz);
-   }
-  }
- }
+NAT l=Find(label,labelnc,ctxbeg,ctxend,1,&p);
+if(l<(NAT)ctxend)
+ return StoI(line[l].pc+p+labelnc,10,NULL,line[l].sz-p-labelnc);
 return 0;
 }
 
@@ -296,21 +664,14 @@ int VText::GetINTs(int*res,NAT nri,char*label,NAT labelnc=0)
 NAT p;
 char*mark;
 if(!labelnc) labelnc=sl(label);
-for(NAT l=ctxbeg;l<ctxend;l++)
+for(NAT l=Find(label,labelnc,ctxbeg,ctxend,1,&p);l<(NAT)ctxend;l=Find(label,labelnc,l+1,ctxend,1,&p))
  {
- if(line[l].f&VCHARS_SELECTED)
+ mark=line[l].pc+p+labelnc;
+ while(mark<line[l].pc+line[l].sz&&nri>0)
   {
-  p=s_seqI(line[l].pc,label,labelnc,line[l].sz);
-  if(p!=R_NULL)
-   {
-   mark=line[l].pc+p+labelnc;
-   while(mark<line[l].pc+line[l].sz&&nri>0)
-    {
-    *res=StoF(mark,10,2,1,line[l].sz,&mark);
-    res++;
-    nri--;
-    }
-   }
+  *res=StoF(mark,10,2,1,line[l].pc+line[l].sz-mark,&mark);
+  res++;
+  nri--;
   }
  }
 return nri;
@@ -322,21 +683,14 @@ int VText::Get_HEX(char*label,NAT labelnc=0,char*start=NULL,NAT startnc=0,int ra
 NAT p,d;
 if(!labelnc) labelnc=sl(label);
 if(!startnc) startnc=sl(start);
-for(NAT l=ctxbeg;l<ctxend;l++)
+for(NAT l=Find(label,labelnc,ctxbeg,ctxend,1,&p);l<(NAT)ctxend;l=Find(label,labelnc,l+1,ctxend,1,&p))
  {
- if(line[l].f&VCHARS_SELECTED)
+ p+=labelnc;
+ d=s_seqI(line[l].pc+p,start,startnc,line[l].sz-p);
+ if(d!=R_NULL)
   {
-  p=s_seqI(line[l].pc,label,labelnc,line[l].sz);
-  if(p!=R_NULL)
-   {
-   p+=labelnc;
-   d=s_seqI(line[l].pc+p,start,startnc,line[l].sz-p);
-   if(d!=R_NULL)
-    {
-    d+=startnc+p;
-    return StoI(line[l].pc+d,radix,NULL,line[l].sz-d);
-    }
-   }
+  d+=startnc+p;
+  return StoI(line[l].pc+d,radix,NULL,line[l].sz-d);
   }
  }
 return 0;
@@ -347,20 +701,13 @@ int VText::Get_INT(char*label,NAT labelnc=0,char*start=NULL,NAT nrstch=0)
 {//uses selection
 NAT p,d;
 if(!labelnc) labelnc=sl(label);
-for(NAT l=ctxbeg;l<ctxend;l++)
+for(NAT l=Find(label,labelnc,ctxbeg,ctxend,1,&p);l<(NAT)ctxend;l=Find(label,labelnc,l+1,ctxend,1,&p))
  {
- if(line[l].f&VCHARS_SELECTED)
+ p+=labelnc;
+ d=s_anych(line[l].pc+p,start,nrstch,line[l].sz-p);
+ if(d!=R_NULL)
   {
-  p=s_seqI(line[l].pc,label,labelnc,line[l].sz);
-  if(p!=R_NULL)
-   {
-   p+=labelnc;
-   d=s_anych(line[l].pc+p,start,nrstch,line[l].sz-p);
-   if(d!=R_NULL)
-    {
-    return StoI(line[l].pc+p+d+1,10,NULL,line[l].sz-p-d);
-    }
-   }
+  return StoI(line[l].pc+p+d+1,10,NULL,line[l].sz-p-d-1);
   }
  }
 return 0;
@@ -371,20 +718,13 @@ double VText::Get_REAL(char*label,NAT labelnc=0,char*start=NULL,NAT nrstch=0)
 {//uses selection
 NAT p,d;
 if(!labelnc) labelnc=sl(label);
-for(NAT l=ctxbeg;l<ctxend;l++)
+for(NAT l=Find(label,labelnc,ctxbeg,ctxend,1,&p);l<(NAT)ctxend;l=Find(label,labelnc,l+1,ctxend,1,&p))
  {
- if(line[l].f&VCHARS_SELECTED)
+ p+=labelnc;
+ d=s_anych(line[l].pc+p,start,nrstch,line[l].sz-p);
+ if(d!=R_NULL)
   {
-  p=s_seqI(line[l].pc,label,labelnc,line[l].sz);
-  if(p!=R_NULL)
-   {
-   p+=labelnc;
-   d=s_anych(line[l].pc+p,start,nrstch,line[l].sz-p);
-   if(d!=R_NULL)
-    {
-    return StoR(line[l].pc+p+d+1,10.,line[l].sz-p-d);
-    }
-   }
+  return StoR(line[l].pc+p+d+1,10.,line[l].sz-p-d-1);
   }
  }
 return 0;
@@ -395,26 +735,22 @@ int VText::GetSTR(char*retbuf,NAT maxsz,char*label,NAT labelnc,char*start,NAT nr
 {
 NAT p=0,d,e;
 if(!labelnc) labelnc=sl(label);
-for(NAT l=ctxbeg;l<ctxend;l++)
+for(NAT l=Find(label,labelnc,ctxbeg,ctxend,0,&d);l<(NAT)ctxend;l=Find(label,labelnc,l+1,ctxend,0,&d))
  {
- d=s_seqI(line[l].pc,label,labelnc,line[l].sz);
- if(d!=R_NULL)
+ d+=labelnc;
+ p=s_anych(line[l].pc+d,start,nrstch,line[l].sz-d);
+ if(p!=R_NULL)
   {
-  d+=labelnc;
-  p=s_anych(line[l].pc+d,start,nrstch,line[l].sz-d);
-  if(p!=R_NULL)
+  p+=d+1;
+  if(end)
    {
-   p+=d+1;
-   if(end)
-    {
-    e=s_seqI(line[l].pc+p,end,endnc,line[l].sz-p);
-    if(e==R_NULL) e=line[l].sz;
-    }
-   else 
-    e=line[l].sz;
-   d=sc(retbuf,line[l].pc+p,maxsz<=e-p?maxsz:e-p);
-   return TrimStr(0,32,retbuf,d);
+   e=s_seqI(line[l].pc+p,end,endnc,line[l].sz-p);
+   if(e==R_NULL) e=line[l].sz;
    }
+  else 
+   e=line[l].sz;
+  d=sc(retbuf,line[l].pc+p,maxsz<=e-p?maxsz:e-p);
+  return TrimStr(0,32,retbuf,d);
   }
  }
 return 0;
@@ -456,15 +792,11 @@ int VText::GetARRAYofINT(int labelind,char*label,NAT labelnc)
 NAT p;
 char *atf;
 if(!labelnc) labelnc=sl(label);
-for(NAT l=ctxbeg;l<ctxend;l++)
+for(NAT l=Find(label,labelnc,ctxbeg,ctxend,0,&p);l<(NAT)ctxend;l=Find(label,labelnc,l+1,ctxend,0,&p))
  {
- p=s_seqI(line[l].pc,label,labelnc,line[l].sz);
- if(p!=R_NULL)
+ if(StoI(line[l].pc+p+labelnc,10,&atf,line[l].sz-p-labelnc)==labelind)
   {
-  if(StoI(line[l].pc+p+labelnc,10,&atf,line[l].sz)==labelind)
-   {
-   return StoI(atf,10,NULL,line[l].sz-(atf-line[l].pc));
-   }
+  return StoI(atf,10,NULL,line[l].sz-(atf-line[l].pc));
   }
  }
 return 0;
@@ -476,19 +808,15 @@ int VText::GetARRAYofINTs(int*res,NAT nri,int labelind,char*label,NAT labelnc)
 NAT p;
 char *mark;
 if(!labelnc) labelnc=sl(label);
-for(NAT l=ctxbeg;l<ctxend;l++)
+for(NAT l=Find(label,labelnc,ctxbeg,ctxend,0,&p);l<(NAT)ctxend;l=Find(label,labelnc,l+1,ctxend,0,&p))
  {
- p=s_seqI(line[l].pc,label,labelnc,line[l].sz);
- if(p!=R_NULL)
+ if(StoI(line[l].pc+p+labelnc,10,&mark,line[l].sz-p-labelnc)==labelind)
   {
-  if(StoI(line[l].pc+p+labelnc,10,&mark,line[l].sz)==labelind)
+  while(mark<line[l].pc+line[l].sz&&nri>0)
    {
-   while(mark<line[l].pc+line[l].sz&&nri>0)
-    {
-    *res=StoF(mark,10,2,1,line[l].sz,&mark);
-    res++;
-    nri--;
-    }
+   *res=StoF(mark,10,2,1,line[l].pc+line[l].sz-mark,&mark);
+   res++;
+   nri--;
    }
   }
  }
@@ -545,47 +873,43 @@ NAT dt[7],M;
 int i;
 char*mark;
 if(!labelnc) labelnc=sl(label);
-for(NAT l=ctxbeg;l<ctxend;l++)
+for(NAT l=Find(label,labelnc,ctxbeg,ctxend,0,&d);l<(NAT)ctxend;l=Find(label,labelnc,l+1,ctxend,0,&d))
  {
- d=s_seqI(line[l].pc,label,labelnc,line[l].sz);
- if(d!=R_NULL)
+ d+=labelnc;
+ p=s_anych(line[l].pc+d,start,nrstch,line[l].sz-d);
+ if(p!=R_NULL)
   {
-  d+=labelnc;
-  p=s_anych(line[l].pc+d,start,nrstch,line[l].sz-d);
-  if(p!=R_NULL)
+  p+=d+1;
+  ptm->getDate((int&)dt[6],dt[5],dt[4],i);
+  ptm->getTime(dt[3],dt[2],dt[1],dt[0]);
+  dt[5]++;
+  if(order&0x80000000) //search literal month
    {
-   p+=d+1;
-   ptm->getDate((int&)dt[6],dt[5],dt[4],i);
-   ptm->getTime(dt[3],dt[2],dt[1],dt[0]);
-   dt[5]++;
-   if(order&0x80000000) //search literal month
-    {
-    for(M=0;M<12;M++)
-     if(s_seqI(line[l].pc+p,MonthName[M],sl(MonthName[M]),line[l].sz-p)!=R_NULL)
-      {
-      dt[5]=M+1;
-      goto LFound;
-      }
-    for(M=0;M<12;M++) //search only for first 3 letters in month name
-     if(s_seqI(line[l].pc+p,MonthName[M],3,line[l].sz-p)!=R_NULL)
-      {
-      dt[5]=M+1;
-      goto LFound;
-      }
-    }
+   for(M=0;M<12;M++)
+    if(s_seqI(line[l].pc+p,MonthName[M],sl(MonthName[M]),line[l].sz-p)!=R_NULL)
+     {
+     dt[5]=M+1;
+     goto LFound;
+     }
+   for(M=0;M<12;M++) //search only for first 3 letters in month name
+    if(s_seqI(line[l].pc+p,MonthName[M],3,line[l].sz-p)!=R_NULL)
+     {
+     dt[5]=M+1;
+     goto LFound;
+     }
+   }
 LFound:
-   mark=line[l].pc+p;
-   i=0;
-   while((mark<line[l].pc+line[l].sz)&&(i<7))
-    {
-    if(((order>>(i<<2))&0xf)<7)
-     dt[((order>>(i<<2))&0xf)]=StoI(mark,10,&mark,line[l].sz-(mark-line[l].pc));
-    i++;
-    }
-   ptm->setDate(dt[6],dt[5]-1,dt[4],0);
-   ptm->setTime(dt[3],dt[2],dt[1],dt[0]);
-   return 1;
+  mark=line[l].pc+p;
+  i=0;
+  while((mark<line[l].pc+line[l].sz)&&(i<7))
+   {
+   if(((order>>(i<<2))&0xf)<7)
+    dt[((order>>(i<<2))&0xf)]=StoI(mark,10,&mark,line[l].sz-(mark-line[l].pc));
+   i++;
    }
+  ptm->setDate(dt[6],dt[5]-1,dt[4],0);
+  ptm->setTime(dt[3],dt[2],dt[1],dt[0]);
+  return 1;
   }
  }
 return 0;